@@ -36,8 +36,12 @@
  ******************************************************************************/
 
 #include "CrcChecksum.h"
+#include <errno.h>
 #include <fcntl.h>
-#include <string>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <android-base/stringprintf.h>
 #include <base/logging.h>
 
@@ -45,7 +49,7 @@ using android::base::StringPrintf;
 
 extern bool nfc_debug_enabled;
 
-static const unsigned short crctab[256] = {
+static constexpr unsigned short crctab[256] = {
     0x0000, 0xc0c1, 0xc181, 0x0140, 0xc301, 0x03c0, 0x0280, 0xc241, 0xc601,
     0x06c0, 0x0780, 0xc741, 0x0500, 0xc5c1, 0xc481, 0x0440, 0xcc01, 0x0cc0,
     0x0d80, 0xcd41, 0x0f00, 0xcfc1, 0xce81, 0x0e40, 0x0a00, 0xcac1, 0xcb81,
@@ -77,26 +81,62 @@ static const unsigned short crctab[256] = {
     0x4100, 0x81c1, 0x8081, 0x4040,
 };
 
+/* crcslice[k][b] is the CRC of byte b followed by k zero bytes, so eight bytes
+ * can be folded into the CRC with eight independent lookups (slicing-by-8) */
+struct CrcSliceTables {
+  unsigned short t[8][256];
+
+  constexpr CrcSliceTables() : t() {
+    for (int i = 0; i < 256; i++) t[0][i] = crctab[i];
+    for (int k = 1; k < 8; k++)
+      for (int i = 0; i < 256; i++)
+        t[k][i] = (t[k - 1][i] >> 8) ^ crctab[t[k - 1][i] & 0xff];
+  }
+};
+
+static constexpr CrcSliceTables crcslice;
+
 /*******************************************************************************
 **
-** Function         crcChecksumCompute
+** Function         crcChecksumUpdate
 **
-** Description      Compute a checksum on a buffer of data.
+** Description      Continue a checksum with more data.
+**                  crc: checksum of the preceding data, 0 to start.
 **
 ** Returns          2-byte checksum.
 **
 *******************************************************************************/
-unsigned short crcChecksumCompute(const unsigned char* buffer, int bufferLen) {
-  unsigned short crc = 0;
+unsigned short crcChecksumUpdate(unsigned short crc, const unsigned char* buffer,
+                                 size_t bufferLen) {
   const unsigned char* cp = buffer;
-  int cnt = bufferLen;
+  const unsigned short(*t)[256] = crcslice.t;
 
-  while (cnt--) {
+  while (bufferLen >= 8) {
+    unsigned int a = crc ^ cp[0] ^ (cp[1] << 8);
+    crc = t[7][a & 0xff] ^ t[6][a >> 8] ^ t[5][cp[2]] ^ t[4][cp[3]] ^
+          t[3][cp[4]] ^ t[2][cp[5]] ^ t[1][cp[6]] ^ t[0][cp[7]];
+    cp += 8;
+    bufferLen -= 8;
+  }
+  while (bufferLen--) {
     crc = ((crc >> 8) & 0xff) ^ crctab[(crc & 0xff) ^ *cp++];
   }
   return (crc);
 }
 
+/*******************************************************************************
+**
+** Function         crcChecksumCompute
+**
+** Description      Compute a checksum on a buffer of data.
+**
+** Returns          2-byte checksum.
+**
+*******************************************************************************/
+unsigned short crcChecksumCompute(const unsigned char* buffer, int bufferLen) {
+  return crcChecksumUpdate(0, buffer, bufferLen);
+}
+
 /*******************************************************************************
 **
 ** Function         crcChecksumVerifyIntegrity
@@ -110,29 +150,32 @@ unsigned short crcChecksumCompute(const unsigned char* buffer, int bufferLen) {
 bool crcChecksumVerifyIntegrity(const char* filename) {
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: filename=%s", __func__, filename);
   bool isGood = false;
-  int fileStream = open(filename, O_RDONLY);
+  int fileStream = open(filename, O_RDONLY | O_CLOEXEC);
   if (fileStream >= 0) {
     unsigned short checksum = 0;
-    std::string data;
-    size_t actualReadCrc = read(fileStream, &checksum, sizeof(checksum));
-    while (true) {
-      char buffer[1024];
-      ssize_t actualReadData = read(fileStream, buffer, sizeof(buffer));
-      if (actualReadData > 0)
-        data.append(buffer, actualReadData);
-      else
-        break;
-    }
-    close(fileStream);
-    if ((actualReadCrc == sizeof(checksum)) && (data.size() > 0)) {
-      DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: data size=%zu", __func__, data.size());
-      if (checksum ==
-          crcChecksumCompute((const unsigned char*)data.data(), data.size()))
-        isGood = true;
-      else
-        LOG(ERROR) << StringPrintf("%s: checksum mismatch", __func__);
+    struct stat file_stat;
+    /* The checksum is followed by at least one byte of data */
+    if ((fstat(fileStream, &file_stat) == 0) &&
+        (file_stat.st_size > (off_t)sizeof(checksum))) {
+      size_t size = file_stat.st_size;
+      void* p_map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileStream, 0);
+      if (p_map != MAP_FAILED) {
+        const unsigned char* p = (const unsigned char*)p_map;
+        madvise(p_map, size, MADV_SEQUENTIAL);
+        memcpy(&checksum, p, sizeof(checksum));
+        DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: data size=%zu", __func__, size - sizeof(checksum));
+        if (checksum ==
+            crcChecksumUpdate(0, p + sizeof(checksum), size - sizeof(checksum)))
+          isGood = true;
+        else
+          LOG(ERROR) << StringPrintf("%s: checksum mismatch", __func__);
+        munmap(p_map, size);
+      } else
+        LOG(ERROR) << StringPrintf("%s: fail to map, error = %d", __func__,
+                                   errno);
     } else
       LOG(ERROR) << StringPrintf("%s: invalid length", __func__);
+    close(fileStream);
   } else
     isGood = true;  // assume file does not exist
   return isGood;
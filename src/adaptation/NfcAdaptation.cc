@@ -43,10 +43,18 @@
 #include <cutils/properties.h>
 #include <hidl/LegacySupport.h>
 #include <hwbinder/ProcessState.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <algorithm>
 #include <vector>
 #include "debug_nfcsnoop.h"
 #include "hal_nxpese.h"
 #include "nfa_api.h"
+#include "nfa_mem_co.h"
 #include "nfa_rw_api.h"
 #include "nfc_config.h"
 #include "nfc_int.h"
@@ -87,6 +95,7 @@ sp<INfcV1_1> NfcAdaptation::mHal_1_1;
 INfcClientCallback* NfcAdaptation::mCallback;
 tHAL_NFC_CBACK* NfcAdaptation::mHalCallback = NULL;
 tHAL_NFC_DATA_CBACK* NfcAdaptation::mHalDataCallback = NULL;
+tHAL_NFC_RX_CBACKS NfcAdaptation::mHalRxCallbacks = {NULL, NULL};
 ThreadCondVar NfcAdaptation::mHalOpenCompletedEvent;
 ThreadCondVar NfcAdaptation::mHalCloseCompletedEvent;
 
@@ -115,6 +124,16 @@ extern bool nfa_poll_bail_out_mode;
 // ETSI TS 102 622, section 6.1.3.1
 static std::vector<uint8_t> host_whitelist;
 
+// How long the config files must stay unchanged before they are reloaded, so
+// that a file written in several steps is read once it is complete
+#ifndef NFC_CONFIG_WATCH_SETTLE_MS
+#define NFC_CONFIG_WATCH_SETTLE_MS 500
+#endif
+
+static int config_watch_fd = -1;
+static int config_watch_stop[2] = {-1, -1};
+static pthread_t config_watch_thread;
+
 namespace {
 void initializeGlobalDebugEnabledFlag() {
   nfc_debug_enabled =
@@ -137,25 +156,42 @@ void initializeGlobalDebugEnabledFlag() {
 class NfcClientCallback : public INfcClientCallback {
  public:
   NfcClientCallback(tHAL_NFC_CBACK* eventCallback,
-                    tHAL_NFC_DATA_CBACK dataCallback) {
+                    tHAL_NFC_DATA_CBACK dataCallback,
+                    const tHAL_NFC_RX_CBACKS& rxCallbacks) {
     mEventCallback = eventCallback;
     mDataCallback = dataCallback;
+    mRxCallbacks = rxCallbacks;
   };
   virtual ~NfcClientCallback() = default;
   Return<void> sendEvent_1_1(
       ::android::hardware::nfc::V1_1::NfcEvent event,
       ::android::hardware::nfc::V1_0::NfcStatus event_status) override {
+    /* HIDL callback threads are not GKI tasks, give them a stable id */
+    GKI_register_thread();
     mEventCallback((uint8_t)event, (tHAL_NFC_STATUS)event_status);
     return Void();
   };
   Return<void> sendEvent(
       ::android::hardware::nfc::V1_0::NfcEvent event,
       ::android::hardware::nfc::V1_0::NfcStatus event_status) override {
+    /* HIDL callback threads are not GKI tasks, give them a stable id */
+    GKI_register_thread();
     mEventCallback((uint8_t)event, (tHAL_NFC_STATUS)event_status);
     return Void();
   };
   Return<void> sendData(
       const ::android::hardware::nfc::V1_0::NfcData& data) override {
+    GKI_register_thread();
+    if (mRxCallbacks.rx_lease != nullptr) {
+      // copy the packet once, straight into a buffer of the stack
+      void* p_buf;
+      uint8_t* p = mRxCallbacks.rx_lease(data.size(), &p_buf);
+      if (p != nullptr) {
+        memcpy(p, data.data(), data.size());
+        mRxCallbacks.rx_deliver(p_buf);
+      }
+      return Void();
+    }
     ::android::hardware::nfc::V1_0::NfcData copy = data;
     mDataCallback(copy.size(), &copy[0]);
     return Void();
@@ -164,6 +200,7 @@ class NfcClientCallback : public INfcClientCallback {
  private:
   tHAL_NFC_CBACK* mEventCallback;
   tHAL_NFC_DATA_CBACK* mDataCallback;
+  tHAL_NFC_RX_CBACKS mRxCallbacks;
 };
 
 class NfcDeathRecipient : public hidl_death_recipient {
@@ -424,9 +461,11 @@ void NfcAdaptation::Initialize() {
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: enter", func);
 
   nfc_storage_path = NfcConfig::getString(NAME_NFA_STORAGE, "/data/nfc");
+  nfa_mem_co_init();
 
   if (NfcConfig::hasKey(NAME_NFA_DM_CFG)) {
-    std::vector<uint8_t> dm_config = NfcConfig::getBytes(NAME_NFA_DM_CFG);
+    const std::vector<uint8_t>& dm_config =
+        NfcConfig::getBytes(NAME_NFA_DM_CFG);
     if (dm_config.size() > 0) nfa_dm_cfg.auto_detect_ndef = dm_config[0];
     if (dm_config.size() > 1) nfa_dm_cfg.auto_read_ndef = dm_config[1];
     if (dm_config.size() > 2) nfa_dm_cfg.auto_presence_check = dm_config[2];
@@ -452,7 +491,7 @@ void NfcAdaptation::Initialize() {
   }
 
   if (NfcConfig::hasKey(NAME_NFA_PROPRIETARY_CFG)) {
-    std::vector<uint8_t> p_config =
+    const std::vector<uint8_t>& p_config =
         NfcConfig::getBytes(NAME_NFA_PROPRIETARY_CFG);
     if (p_config.size() > 0)
       nfa_proprietary_cfg.pro_protocol_18092_active = p_config[0];
@@ -501,6 +540,7 @@ void NfcAdaptation::Initialize() {
   }
 
   debug_nfcsnoop_init();
+  StartConfigWatch();
   configureRpcThreadpool(2, false);
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: exit", func);
 }
@@ -565,6 +605,7 @@ void NfcAdaptation::Finalize() {
   }
   sIoctlMutex.unlock();
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: enter", func);
+  StopConfigWatch();
   GKI_shutdown();
 
   NfcConfig::clear();
@@ -576,6 +617,119 @@ void NfcAdaptation::Finalize() {
   mpInstance = NULL;
 }
 
+/*******************************************************************************
+**
+** Function:    NfcAdaptation::StartConfigWatch()
+**
+** Description: Watch the config files and reload them when they change, if
+**              NFC_CONFIG_HOT_RELOAD is set.
+**
+** Returns:     none
+**
+*******************************************************************************/
+void NfcAdaptation::StartConfigWatch() {
+  if (NfcConfig::getUnsigned(NAME_NFC_CONFIG_HOT_RELOAD, 0) == 0) return;
+
+  int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd < 0) {
+    LOG(ERROR) << StringPrintf("%s: inotify_init1 failed: %s", __func__,
+                               strerror(errno));
+    return;
+  }
+  // Watch the directories, since the files may be replaced by a rename or
+  // created after start
+  for (const std::string& path : NfcConfig::getConfigPaths()) {
+    std::string dir = path.substr(0, path.rfind('/'));
+    if (inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO |
+                                               IN_MOVED_FROM | IN_DELETE) < 0)
+      LOG(ERROR) << StringPrintf("%s: cannot watch %s: %s", __func__,
+                                 dir.c_str(), strerror(errno));
+  }
+  if (pipe2(config_watch_stop, O_CLOEXEC) != 0) {
+    LOG(ERROR) << StringPrintf("%s: pipe2 failed: %s", __func__,
+                               strerror(errno));
+    close(fd);
+    return;
+  }
+
+  config_watch_fd = fd;
+  if (pthread_create(&config_watch_thread, NULL, ConfigWatchThread, NULL) !=
+      0) {
+    LOG(ERROR) << StringPrintf("%s: pthread_create failed", __func__);
+    close(config_watch_stop[0]);
+    close(config_watch_stop[1]);
+    close(config_watch_fd);
+    config_watch_fd = -1;
+  }
+}
+
+/*******************************************************************************
+**
+** Function:    NfcAdaptation::StopConfigWatch()
+**
+** Description: Stop watching the config files.
+**
+** Returns:     none
+**
+*******************************************************************************/
+void NfcAdaptation::StopConfigWatch() {
+  if (config_watch_fd < 0) return;
+
+  // The thread stops when the write end of the pipe is closed
+  close(config_watch_stop[1]);
+  pthread_join(config_watch_thread, NULL);
+  close(config_watch_stop[0]);
+  close(config_watch_fd);
+  config_watch_fd = -1;
+}
+
+/*******************************************************************************
+**
+** Function:    NfcAdaptation::ConfigWatchThread()
+**
+** Description: Wait for changes of the config files and have the NFA task
+**              reload them once the changes settle.
+**
+** Returns:     none
+**
+*******************************************************************************/
+void* NfcAdaptation::ConfigWatchThread(__attribute__((unused)) void* arg) {
+  std::vector<std::string> names;
+  for (const std::string& path : NfcConfig::getConfigPaths())
+    names.push_back(path.substr(path.rfind('/') + 1));
+
+  struct pollfd fds[2] = {{config_watch_fd, POLLIN, 0},
+                          {config_watch_stop[0], POLLIN, 0}};
+  char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  bool changed = false;
+
+  while (true) {
+    int ret = poll(fds, 2, changed ? NFC_CONFIG_WATCH_SETTLE_MS : -1);
+    if (ret < 0) {
+      if (errno == EINTR) continue;
+      LOG(ERROR) << StringPrintf("%s: poll failed: %s", __func__,
+                                 strerror(errno));
+      break;
+    }
+    if (fds[1].revents) break;
+    if (ret == 0) {
+      changed = false;
+      NFA_ReloadConfig();
+      continue;
+    }
+
+    ssize_t length = read(config_watch_fd, buf, sizeof(buf));
+    for (char* p = buf; length > 0 && p < buf + length;) {
+      struct inotify_event* event = (struct inotify_event*)p;
+      if (event->len && std::find(names.begin(), names.end(), event->name) !=
+                            names.end())
+        changed = true;
+      p += sizeof(struct inotify_event) + event->len;
+    }
+  }
+  return NULL;
+}
+
 /*******************************************************************************
 **
 ** Function:    NfcAdaptation::Dump
@@ -585,7 +739,11 @@ void NfcAdaptation::Finalize() {
 ** Returns:     None.
 **
 *******************************************************************************/
-void NfcAdaptation::Dump(int fd) { debug_nfcsnoop_dump(fd); }
+void NfcAdaptation::Dump(int fd) {
+  debug_nfcsnoop_dump(fd);
+  nfa_mem_co_dump(fd);
+  GKI_dump_pools(fd);
+}
 
 /*******************************************************************************
 **
@@ -679,6 +837,7 @@ void NfcAdaptation::InitializeHalDeviceContext() {
   mHalEntryFuncs.control_granted = HalControlGranted;
   mHalEntryFuncs.power_cycle = HalPowerCycle;
   mHalEntryFuncs.get_max_ee = HalGetMaxNfcee;
+  mHalEntryFuncs.set_rx_cbacks = HalSetRxCallbacks;
   LOG(INFO) << StringPrintf("%s: Try INfcV1_1::getService()", func);
   mHal = mHal_1_1 = INfcV1_1::tryGetService();
   if (mHal_1_1 == nullptr) {
@@ -747,13 +906,32 @@ void NfcAdaptation::HalOpen(tHAL_NFC_CBACK* p_hal_cback,
                             tHAL_NFC_DATA_CBACK* p_data_cback) {
   const char* func = "NfcAdaptation::HalOpen";
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s", func);
-  mCallback = new NfcClientCallback(p_hal_cback, p_data_cback);
+  mCallback =
+      new NfcClientCallback(p_hal_cback, p_data_cback, mHalRxCallbacks);
+  /* receive buffers only apply to the open they were set for */
+  memset(&mHalRxCallbacks, 0, sizeof(mHalRxCallbacks));
   if (mHal_1_1 != nullptr) {
     mHal_1_1->open_1_1(mCallback);
   } else {
     mHal->open(mCallback);
   }
 }
+/*******************************************************************************
+**
+** Function:    NfcAdaptation::HalSetRxCallbacks
+**
+** Description: Receive NCI packets of the next HalOpen straight into buffers
+**              leased from the stack instead of through its data callback.
+**
+** Returns:     None.
+**
+*******************************************************************************/
+void NfcAdaptation::HalSetRxCallbacks(const tHAL_NFC_RX_CBACKS* p_rx_cbacks) {
+  const char* func = "NfcAdaptation::HalSetRxCallbacks";
+  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s", func);
+  mHalRxCallbacks = *p_rx_cbacks;
+}
+
 /*******************************************************************************
 **
 ** Function:    NfcAdaptation::HalClose
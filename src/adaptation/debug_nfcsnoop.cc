@@ -17,60 +17,230 @@
  ******************************************************************************/
 
 #include <android-base/logging.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
 #include <resolv.h>
+#include <string.h>
+#include <time.h>
 #include <zlib.h>
+#include <algorithm>
+#include <atomic>
 #include <mutex>
+#include <string>
+#include <vector>
 
 #include <ringbuffer.h>
 
 #include "bt_types.h"
 #include "include/debug_nfcsnoop.h"
+#include "nfc_config.h"
 #include "nfc_int.h"
 
 #define USEC_PER_SEC 1000000ULL
+#define NSEC_PER_USEC 1000ULL
 
 // Total nfcsnoop memory log buffer size
 #ifndef NFCSNOOP_MEM_BUFFER_SIZE
 static const size_t NFCSNOOP_MEM_BUFFER_SIZE = (256 * 1024);
 #endif
 
+// Number of capture rings the buffer is split into. Each capturing thread
+// owns one; the last one is shared by any threads beyond that.
+#ifndef NFCSNOOP_MAX_RINGS
+static const size_t NFCSNOOP_MAX_RINGS = 4;
+#endif
+
+static const size_t RING_SIZE = NFCSNOOP_MEM_BUFFER_SIZE / NFCSNOOP_MAX_RINGS;
+static_assert((RING_SIZE & (RING_SIZE - 1)) == 0,
+              "nfcsnoop ring size must be a power of 2");
+
 // Block size for copying buffers (for compression/encoding etc.)
 static const size_t BLOCK_SIZE = 16384;
 
 // Maximum line length in bugreport (should be multiple of 4 for base64 output)
 static const uint8_t MAX_LINE_LENGTH = 128;
 
-static std::mutex buffer_mutex;
-static ringbuffer_t* buffer = NULL;
-static uint64_t last_timestamp_ms = 0;
+// One header for each NCI packet in a capture ring
+typedef struct nfcsnoop_record_t {
+  uint64_t timestamp_us;
+  uint16_t length;
+  uint8_t is_received;
+} __attribute__((__packed__)) nfcsnoop_record_t;
+
+// Capture ring. Only its owner writes to it; the dump copies it while it is
+// being written and keeps what the writer did not reclaim meanwhile.
+typedef struct nfcsnoop_ring_t {
+  std::atomic<bool> in_use;
+  std::atomic<uint64_t> head;  // total bytes written
+  std::atomic<uint64_t> tail;  // start of the oldest record kept
+  uint8_t* data;
+} nfcsnoop_ring_t;
+
+// Gives the ring of a thread back when the thread exits
+struct nfcsnoop_ring_owner_t {
+  ~nfcsnoop_ring_owner_t() {
+    if (ring) ring->in_use.store(false, std::memory_order_release);
+  }
+  nfcsnoop_ring_t* ring = NULL;
+};
+
+static nfcsnoop_ring_t rings[NFCSNOOP_MAX_RINGS];
+static nfcsnoop_ring_t* const shared_ring = &rings[NFCSNOOP_MAX_RINGS - 1];
+static std::mutex shared_ring_mutex;
+static thread_local nfcsnoop_ring_owner_t ring_owner;
+static std::atomic<bool> initialized(false);
+
+// Number of data packet payload bytes kept after the NCI header (0-255)
+static uint8_t payload_budget = 0;
+
+static uint64_t nfcsnoop_timestamp_us(clockid_t clock_id) {
+  struct timespec ts;
+  clock_gettime(clock_id, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * USEC_PER_SEC +
+         static_cast<uint64_t>(ts.tv_nsec) / NSEC_PER_USEC;
+}
 
-static void nfcsnoop_cb(const uint8_t* data, const size_t length,
-                        bool is_received, const uint64_t timestamp_us) {
-  nfcsnooz_header_t header;
+static void nfcsnoop_ring_write(nfcsnoop_ring_t* ring, uint64_t pos,
+                                const uint8_t* p, size_t length) {
+  const size_t offset = pos & (RING_SIZE - 1);
+  const size_t first = std::min(length, RING_SIZE - offset);
 
-  std::lock_guard<std::mutex> lock(buffer_mutex);
+  memcpy(ring->data + offset, p, first);
+  memcpy(ring->data, p + first, length - first);
+}
+
+static void nfcsnoop_ring_read(const nfcsnoop_ring_t* ring, uint64_t pos,
+                               uint8_t* p, size_t length) {
+  const size_t offset = pos & (RING_SIZE - 1);
+  const size_t first = std::min(length, RING_SIZE - offset);
 
-  // Make room in the ring buffer
+  memcpy(p, ring->data + offset, first);
+  memcpy(p + first, ring->data, length - first);
+}
 
-  while (ringbuffer_available(buffer) < (length + sizeof(nfcsnooz_header_t))) {
-    ringbuffer_pop(buffer, (uint8_t*)&header, sizeof(nfcsnooz_header_t));
-    ringbuffer_delete(buffer, header.length - 1);
+static nfcsnoop_ring_t* nfcsnoop_claim_ring(void) {
+  for (size_t i = 0; i < NFCSNOOP_MAX_RINGS - 1; i++) {
+    bool expected = false;
+    if (rings[i].in_use.compare_exchange_strong(expected, true,
+                                                std::memory_order_acquire))
+      return &rings[i];
+  }
+  return NULL;
+}
+
+static void nfcsnoop_cb(nfcsnoop_ring_t* ring, const uint8_t* data,
+                        const size_t length, bool is_received,
+                        const uint64_t timestamp_us) {
+  nfcsnoop_record_t record;
+  const size_t total = sizeof(nfcsnoop_record_t) + length;
+  const uint64_t head = ring->head.load(std::memory_order_relaxed);
+  uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+
+  if (total > RING_SIZE) return;
+
+  // Make room in the ring. The new tail is published before the space is
+  // reused so that a concurrent dump can tell what it copied was overwritten.
+
+  if (head + total - tail > RING_SIZE) {
+    while (head + total - tail > RING_SIZE) {
+      nfcsnoop_ring_read(ring, tail, (uint8_t*)&record, sizeof(record));
+      tail += sizeof(record) + record.length;
+    }
+    ring->tail.store(tail, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
   }
 
   // Insert data
-  header.length = length;
-  header.is_received = is_received ? 1 : 0;
+  record.timestamp_us = timestamp_us;
+  record.length = length;
+  record.is_received = is_received ? 1 : 0;
+
+  nfcsnoop_ring_write(ring, head, (uint8_t*)&record, sizeof(record));
+  nfcsnoop_ring_write(ring, head + sizeof(record), data, length);
+  ring->head.store(head + total, std::memory_order_release);
+}
+
+// Copies the records of a ring written from |from| on that were not
+// overwritten during the copy. Returns the position the copy ends at.
+static uint64_t nfcsnoop_ring_snapshot(const nfcsnoop_ring_t* ring,
+                                       uint64_t from,
+                                       std::vector<uint8_t>& out) {
+  const uint64_t head = ring->head.load(std::memory_order_acquire);
+  const uint64_t tail =
+      std::max(from, ring->tail.load(std::memory_order_acquire));
+
+  out.clear();
+  if (ring->data == NULL || tail >= head) return head;
+
+  out.resize(head - tail);
+  nfcsnoop_ring_read(ring, tail, out.data(), out.size());
+
+  std::atomic_thread_fence(std::memory_order_acquire);
+  const uint64_t valid = ring->tail.load(std::memory_order_relaxed);
+  if (valid >= head)
+    out.clear();
+  else if (valid > tail)
+    out.erase(out.begin(), out.begin() + (valid - tail));
+  return head;
+}
+
+typedef void (*nfcsnoop_record_cb_t)(const nfcsnoop_record_t* p_record,
+                                     const uint8_t* p_data, void* p_context);
+
+// Walks the records of the ring snapshots in timestamp order
+static void nfcsnoop_merge(const std::vector<uint8_t>* snapshots,
+                           nfcsnoop_record_cb_t p_cback, void* p_context) {
+  size_t cursors[NFCSNOOP_MAX_RINGS] = {0};
+
+  for (;;) {
+    nfcsnoop_record_t next;
+    int next_ring = -1;
+
+    for (size_t i = 0; i < NFCSNOOP_MAX_RINGS; i++) {
+      nfcsnoop_record_t record;
+      if (cursors[i] + sizeof(record) > snapshots[i].size()) continue;
+      memcpy(&record, snapshots[i].data() + cursors[i], sizeof(record));
+      if (next_ring < 0 || record.timestamp_us < next.timestamp_us) {
+        next = record;
+        next_ring = i;
+      }
+    }
+    if (next_ring < 0) break;
 
-  uint64_t delta_time_ms = 0;
-  if (last_timestamp_ms) {
-    __builtin_sub_overflow(timestamp_us, last_timestamp_ms, &delta_time_ms);
+    const size_t offset = cursors[next_ring] + sizeof(next);
+    if (offset + next.length > snapshots[next_ring].size()) {
+      cursors[next_ring] = snapshots[next_ring].size();
+      continue;
+    }
+
+    (*p_cback)(&next, snapshots[next_ring].data() + offset, p_context);
+    cursors[next_ring] = offset + next.length;
   }
-  header.delta_time_ms = delta_time_ms;
+}
 
-  last_timestamp_ms = timestamp_us;
+typedef struct {
+  ringbuffer_t* rb_dst;
+  uint64_t last_timestamp_us;
+} nfcsnooz_merge_t;
 
-  ringbuffer_insert(buffer, (uint8_t*)&header, sizeof(nfcsnooz_header_t));
-  ringbuffer_insert(buffer, data, length);
+// Appends one record to the nfcsnooz stream of the base64 dump
+static void nfcsnooz_merge_cback(const nfcsnoop_record_t* p_record,
+                                 const uint8_t* p_data, void* p_context) {
+  nfcsnooz_merge_t* p_merge = (nfcsnooz_merge_t*)p_context;
+  nfcsnooz_header_t header;
+
+  header.length = p_record->length;
+  header.is_received = p_record->is_received;
+  header.delta_time_ms =
+      p_merge->last_timestamp_us
+          ? p_record->timestamp_us - p_merge->last_timestamp_us
+          : 0;
+  p_merge->last_timestamp_us = p_record->timestamp_us;
+
+  ringbuffer_insert(p_merge->rb_dst, (uint8_t*)&header,
+                    sizeof(nfcsnooz_header_t));
+  ringbuffer_insert(p_merge->rb_dst, p_data, p_record->length);
 }
 
 static bool nfcsnoop_compress(ringbuffer_t* rb_dst, ringbuffer_t* rb_src) {
@@ -114,74 +284,410 @@ static bool nfcsnoop_compress(ringbuffer_t* rb_dst, ringbuffer_t* rb_src) {
   return rc;
 }
 
+// pcapng block types and options used by the streaming export
+#define PCAPNG_SHB_TYPE 0x0A0D0D0A
+#define PCAPNG_BYTE_ORDER_MAGIC 0x1A2B3C4D
+#define PCAPNG_IDB_TYPE 0x00000001
+#define PCAPNG_EPB_TYPE 0x00000006
+#define PCAPNG_OPT_ENDOFOPT 0
+#define PCAPNG_OPT_EPB_FLAGS 2
+#define PCAPNG_EPB_FLAGS_INBOUND 1
+#define PCAPNG_EPB_FLAGS_OUTBOUND 2
+
+// Link type of the NCI packets in the export, LINKTYPE_USER0 by default
+#ifndef NFCSNOOP_PCAPNG_LINKTYPE
+#define NFCSNOOP_PCAPNG_LINKTYPE 147
+#endif
+
+// How often the export thread drains the capture rings
+#ifndef NFCSNOOP_EXPORT_INTERVAL_MS
+#define NFCSNOOP_EXPORT_INTERVAL_MS 200
+#endif
+
+static const char NFCSNOOP_EXPORT_FILE[] = "nfcsnoop.pcapng";
+
+typedef struct pcapng_shb_t {
+  uint32_t block_type;
+  uint32_t block_length;
+  uint32_t byte_order_magic;
+  uint16_t major_version;
+  uint16_t minor_version;
+  int64_t section_length;
+  uint32_t block_length_trailer;
+} __attribute__((__packed__)) pcapng_shb_t;
+
+typedef struct pcapng_idb_t {
+  uint32_t block_type;
+  uint32_t block_length;
+  uint16_t link_type;
+  uint16_t reserved;
+  uint32_t snap_length;
+  uint32_t block_length_trailer;
+} __attribute__((__packed__)) pcapng_idb_t;
+
+// Enhanced packet block up to the packet data
+typedef struct pcapng_epb_t {
+  uint32_t block_type;
+  uint32_t block_length;
+  uint32_t interface_id;
+  uint32_t timestamp_high;
+  uint32_t timestamp_low;
+  uint32_t captured_length;
+  uint32_t original_length;
+} __attribute__((__packed__)) pcapng_epb_t;
+
+// Options and trailer following the packet data of an enhanced packet block
+typedef struct pcapng_epb_trailer_t {
+  uint16_t flags_code;
+  uint16_t flags_length;
+  uint32_t flags;
+  uint16_t end_code;
+  uint16_t end_length;
+  uint32_t block_length_trailer;
+} __attribute__((__packed__)) pcapng_epb_trailer_t;
+
+typedef struct nfcsnoop_export_t {
+  std::string dir;
+  size_t file_size;
+  unsigned file_count;
+  int fd = -1;
+  size_t written;
+  uint64_t clock_offset_us;
+  uint64_t positions[NFCSNOOP_MAX_RINGS];
+  std::vector<uint8_t> snapshots[NFCSNOOP_MAX_RINGS];
+  std::vector<uint8_t> blocks;
+  std::atomic<bool> running;
+  std::atomic<uint64_t> packets;
+  std::atomic<uint64_t> lost_bytes;
+} nfcsnoop_export_t;
+
+static nfcsnoop_export_t export_cb;
+
+static std::string nfcsnoop_export_name(unsigned index) {
+  std::string name = export_cb.dir + "/" + NFCSNOOP_EXPORT_FILE;
+  if (index) name += "." + std::to_string(index) + ".gz";
+  return name;
+}
+
+// Writes all of |p_data| to the active export file
+static bool nfcsnoop_export_write(const void* p_data, size_t length) {
+  const uint8_t* p = (const uint8_t*)p_data;
+
+  while (length) {
+    ssize_t ret = write(export_cb.fd, p, length);
+    if (ret < 0 && errno == EINTR) continue;
+    if (ret <= 0) {
+      LOG(ERROR) << __func__ << ": fail to write, error = " << errno;
+      return false;
+    }
+    p += ret;
+    length -= ret;
+    export_cb.written += ret;
+  }
+  return true;
+}
+
+// Opens a new active export file, starting with the section and interface
+static bool nfcsnoop_export_open(void) {
+  const std::string name = nfcsnoop_export_name(0);
+  export_cb.fd = open(name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                      S_IRUSR | S_IWUSR);
+  if (export_cb.fd < 0) {
+    LOG(ERROR) << __func__ << ": fail to open " << name << ", error = "
+               << errno;
+    return false;
+  }
+
+  pcapng_shb_t shb = {PCAPNG_SHB_TYPE, sizeof(shb), PCAPNG_BYTE_ORDER_MAGIC,
+                      1, 0, -1, sizeof(shb)};
+  pcapng_idb_t idb = {PCAPNG_IDB_TYPE, sizeof(idb), NFCSNOOP_PCAPNG_LINKTYPE,
+                      0, 0, sizeof(idb)};
+  export_cb.written = 0;
+  if (!nfcsnoop_export_write(&shb, sizeof(shb)) ||
+      !nfcsnoop_export_write(&idb, sizeof(idb))) {
+    close(export_cb.fd);
+    export_cb.fd = -1;
+    return false;
+  }
+  return true;
+}
+
+// Deflates a closed export file into |dst| and removes it
+static void nfcsnoop_export_compress(const std::string& src,
+                                     const std::string& dst) {
+  int fd = open(src.c_str(), O_RDONLY | O_CLOEXEC);
+  int gz_fd = open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                   S_IRUSR | S_IWUSR);
+  gzFile gz = (gz_fd >= 0) ? gzdopen(gz_fd, "wb") : NULL;
+  uint8_t block[BLOCK_SIZE];
+  ssize_t length;
+
+  if (fd >= 0 && gz != NULL) {
+    while ((length = read(fd, block, sizeof(block))) > 0) {
+      if (gzwrite(gz, block, length) != length) {
+        LOG(ERROR) << __func__ << ": fail to compress " << src;
+        break;
+      }
+    }
+  }
+  if (gz != NULL)
+    gzclose(gz);
+  else if (gz_fd >= 0)
+    close(gz_fd);
+  if (fd >= 0) close(fd);
+  unlink(src.c_str());
+}
+
+// Closes the active export file, compresses it as the newest archive and
+// drops the oldest archive beyond the configured file count
+static bool nfcsnoop_export_rotate(void) {
+  close(export_cb.fd);
+  export_cb.fd = -1;
+
+  const std::string active = nfcsnoop_export_name(0);
+  if (export_cb.file_count < 2) {
+    unlink(active.c_str());
+    return nfcsnoop_export_open();
+  }
+
+  const std::string closed = active + ".closed";
+  rename(active.c_str(), closed.c_str());
+  if (!nfcsnoop_export_open()) return false;
+
+  for (unsigned i = export_cb.file_count - 1; i > 1; i--) {
+    rename(nfcsnoop_export_name(i - 1).c_str(),
+           nfcsnoop_export_name(i).c_str());
+  }
+  nfcsnoop_export_compress(closed, nfcsnoop_export_name(1));
+  return true;
+}
+
+// Appends one record to the pending export blocks as an enhanced packet
+static void nfcsnoop_export_cback(const nfcsnoop_record_t* p_record,
+                                  const uint8_t* p_data, void* p_context) {
+  std::vector<uint8_t>& blocks = *(std::vector<uint8_t>*)p_context;
+  const uint32_t padded = (p_record->length + 3) & ~3u;
+  const uint64_t timestamp_us =
+      p_record->timestamp_us + export_cb.clock_offset_us;
+  pcapng_epb_t epb;
+  pcapng_epb_trailer_t trailer;
+
+  epb.block_type = PCAPNG_EPB_TYPE;
+  epb.block_length = sizeof(epb) + padded + sizeof(trailer);
+  epb.interface_id = 0;
+  epb.timestamp_high = timestamp_us >> 32;
+  epb.timestamp_low = timestamp_us & 0xFFFFFFFF;
+  epb.captured_length = p_record->length;
+  // The NCI header gives the length of packets cut to the payload budget
+  epb.original_length = p_record->length;
+  if (p_record->length >= NCI_MSG_HDR_SIZE)
+    epb.original_length = p_data[2] + NCI_MSG_HDR_SIZE;
+
+  trailer.flags_code = PCAPNG_OPT_EPB_FLAGS;
+  trailer.flags_length = sizeof(trailer.flags);
+  trailer.flags = p_record->is_received ? PCAPNG_EPB_FLAGS_INBOUND
+                                        : PCAPNG_EPB_FLAGS_OUTBOUND;
+  trailer.end_code = PCAPNG_OPT_ENDOFOPT;
+  trailer.end_length = 0;
+  trailer.block_length_trailer = epb.block_length;
+
+  blocks.insert(blocks.end(), (uint8_t*)&epb, (uint8_t*)(&epb + 1));
+  blocks.insert(blocks.end(), p_data, p_data + p_record->length);
+  blocks.insert(blocks.end(), padded - p_record->length, 0);
+  blocks.insert(blocks.end(), (uint8_t*)&trailer, (uint8_t*)(&trailer + 1));
+  export_cb.packets.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Writes the packets captured since the last call to the active export file
+static bool nfcsnoop_export_flush(void) {
+  uint64_t lost = 0;
+
+  for (size_t i = 0; i < NFCSNOOP_MAX_RINGS; i++) {
+    const uint64_t from = export_cb.positions[i];
+    const uint64_t head =
+        nfcsnoop_ring_snapshot(&rings[i], from, export_cb.snapshots[i]);
+    const uint64_t start = head - export_cb.snapshots[i].size();
+    if (start > from) lost += start - from;
+    export_cb.positions[i] = head;
+  }
+  if (lost) export_cb.lost_bytes.fetch_add(lost, std::memory_order_relaxed);
+
+  export_cb.clock_offset_us = nfcsnoop_timestamp_us(CLOCK_REALTIME) -
+                              nfcsnoop_timestamp_us(CLOCK_MONOTONIC);
+  export_cb.blocks.clear();
+  nfcsnoop_merge(export_cb.snapshots, nfcsnoop_export_cback,
+                 &export_cb.blocks);
+  if (export_cb.blocks.empty()) return true;
+
+  if (!nfcsnoop_export_write(export_cb.blocks.data(), export_cb.blocks.size()))
+    return false;
+
+  if (export_cb.written >= export_cb.file_size) return nfcsnoop_export_rotate();
+  return true;
+}
+
+static void* nfcsnoop_export_thread(void*) {
+  while (nfcsnoop_export_flush()) usleep(NFCSNOOP_EXPORT_INTERVAL_MS * 1000);
+
+  LOG(ERROR) << __func__ << ": nfcsnoop export stopped";
+  if (export_cb.fd >= 0) close(export_cb.fd);
+  export_cb.fd = -1;
+  export_cb.running.store(false, std::memory_order_release);
+  return NULL;
+}
+
+// Starts streaming the captured packets to a rotating set of pcapng files if
+// a directory is configured for it
+static void nfcsnoop_export_start(void) {
+  export_cb.dir = NfcConfig::getString(NAME_NFCSNOOP_EXPORT_PATH, "");
+  if (export_cb.dir.empty()) return;
+
+  export_cb.file_size =
+      NfcConfig::getUnsigned(NAME_NFCSNOOP_EXPORT_FILE_SIZE, 1024 * 1024);
+  export_cb.file_count =
+      std::max(1u, NfcConfig::getUnsigned(NAME_NFCSNOOP_EXPORT_FILE_COUNT, 4));
+  if (!nfcsnoop_export_open()) return;
+
+  pthread_attr_t attr;
+  pthread_t thread;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  export_cb.running.store(true, std::memory_order_release);
+  if (pthread_create(&thread, &attr, nfcsnoop_export_thread, NULL) != 0) {
+    LOG(ERROR) << __func__ << ": fail to create export thread";
+    export_cb.running.store(false, std::memory_order_release);
+    close(export_cb.fd);
+    export_cb.fd = -1;
+  }
+  pthread_attr_destroy(&attr);
+}
+
 void nfcsnoop_capture(const NFC_HDR* packet, bool is_received) {
-  struct timeval tv;
-  gettimeofday(&tv, NULL);
-  uint64_t timestamp = static_cast<uint64_t>(tv.tv_sec) * USEC_PER_SEC +
-                       static_cast<uint64_t>(tv.tv_usec);
+  if (!initialized.load(std::memory_order_acquire)) return;
+
+  uint64_t timestamp = nfcsnoop_timestamp_us(CLOCK_MONOTONIC);
   uint8_t* p = (uint8_t*)(packet + 1) + packet->offset;
   uint8_t mt = (*(p)&NCI_MT_MASK) >> NCI_MT_SHIFT;
+  size_t length;
 
   if (mt == NCI_MT_DATA) {
-    nfcsnoop_cb(p, NCI_DATA_HDR_SIZE, is_received, timestamp);
+    length = NCI_DATA_HDR_SIZE;
+    if (payload_budget && packet->len > NCI_DATA_HDR_SIZE)
+      length += std::min<size_t>(std::min(p[2], payload_budget),
+                                 packet->len - NCI_DATA_HDR_SIZE);
   } else if (packet->len > 2) {
-    nfcsnoop_cb(p, p[2] + NCI_MSG_HDR_SIZE, is_received, timestamp);
+    length = p[2] + NCI_MSG_HDR_SIZE;
+  } else {
+    return;
+  }
+
+  nfcsnoop_ring_t* ring = ring_owner.ring;
+  if (ring == NULL) ring = ring_owner.ring = nfcsnoop_claim_ring();
+
+  if (ring != NULL) {
+    nfcsnoop_cb(ring, p, length, is_received, timestamp);
+  } else {
+    std::lock_guard<std::mutex> lock(shared_ring_mutex);
+    nfcsnoop_cb(shared_ring, p, length, is_received, timestamp);
   }
 }
 
 void debug_nfcsnoop_init(void) {
-  if (buffer == NULL) buffer = ringbuffer_init(NFCSNOOP_MEM_BUFFER_SIZE);
+  if (initialized.load(std::memory_order_acquire)) return;
+
+  unsigned budget = NfcConfig::getUnsigned(NAME_NFCSNOOP_PAYLOAD_BUDGET, 0);
+  payload_budget = std::min(budget, 0xFFu);
+
+  for (auto& ring : rings) {
+    if (ring.data == NULL) ring.data = (uint8_t*)malloc(RING_SIZE);
+    if (ring.data == NULL) {
+      LOG(ERROR) << __func__ << ": unable to allocate capture ring";
+      return;
+    }
+  }
+  initialized.store(true, std::memory_order_release);
+
+  nfcsnoop_export_start();
 }
 
 void debug_nfcsnoop_dump(int fd) {
+  // Point at the export files, the export reads the capture rings without
+  // consuming them so the summary below is written in either case
+
+  if (export_cb.running.load(std::memory_order_acquire)) {
+    dprintf(fd,
+            "--- NFCSNOOP_EXPORT: %s (%" PRIu64 " packets, %" PRIu64
+            " bytes lost) ---\n",
+            nfcsnoop_export_name(0).c_str(),
+            export_cb.packets.load(std::memory_order_relaxed),
+            export_cb.lost_bytes.load(std::memory_order_relaxed));
+  }
+
   ringbuffer_t* ringbuffer = ringbuffer_init(NFCSNOOP_MEM_BUFFER_SIZE);
   if (ringbuffer == NULL) {
     dprintf(fd, "%s Unable to allocate memory for compression", __func__);
     return;
   }
+  ringbuffer_t* merged = ringbuffer_init(NFCSNOOP_MEM_BUFFER_SIZE);
+  if (merged == NULL) {
+    dprintf(fd, "%s Unable to allocate memory for compression", __func__);
+    ringbuffer_free(ringbuffer);
+    return;
+  }
+
+  // Collect the capture rings, oldest packet first
+
+  std::vector<uint8_t> snapshots[NFCSNOOP_MAX_RINGS];
+  for (size_t i = 0; i < NFCSNOOP_MAX_RINGS; i++)
+    nfcsnoop_ring_snapshot(&rings[i], 0, snapshots[i]);
+  nfcsnooz_merge_t merge = {merged, 0};
+  nfcsnoop_merge(snapshots, nfcsnooz_merge_cback, &merge);
 
-  // Prepend preamble
+  // Prepend preamble, with the last timestamp moved to the wall clock
 
   nfcsnooz_preamble_t preamble;
   preamble.version = NFCSNOOZ_CURRENT_VERSION;
-  preamble.last_timestamp_ms = last_timestamp_ms;
+  preamble.last_timestamp_ms = 0;
+  if (merge.last_timestamp_us) {
+    preamble.last_timestamp_ms = merge.last_timestamp_us +
+                                 nfcsnoop_timestamp_us(CLOCK_REALTIME) -
+                                 nfcsnoop_timestamp_us(CLOCK_MONOTONIC);
+  }
   ringbuffer_insert(ringbuffer, (uint8_t*)&preamble,
                     sizeof(nfcsnooz_preamble_t));
 
   // Compress data
 
   uint8_t b64_in[3] = {0};
-  char b64_out[5] = {0};
+  char line[MAX_LINE_LENGTH + 5];
 
   size_t line_length = 0;
 
-  bool rc;
-  {
-    std::lock_guard<std::mutex> lock(buffer_mutex);
-    dprintf(fd, "--- BEGIN:NFCSNOOP_LOG_SUMMARY (%zu bytes in) ---\n",
-            ringbuffer_size(buffer));
-    rc = nfcsnoop_compress(ringbuffer, buffer);
-  }
+  dprintf(fd, "--- BEGIN:NFCSNOOP_LOG_SUMMARY (%zu bytes in) ---\n",
+          ringbuffer_size(merged));
+  bool rc = nfcsnoop_compress(ringbuffer, merged);
 
   if (rc == false) {
     dprintf(fd, "%s Log compression failed", __func__);
     goto error;
   }
 
-  // Base64 encode & output
+  // Base64 encode & output, one line per write
 
   while (ringbuffer_size(ringbuffer) > 0) {
     size_t read = ringbuffer_pop(ringbuffer, b64_in, 3);
     if (line_length >= MAX_LINE_LENGTH) {
-      dprintf(fd, "\n");
+      line[line_length++] = '\n';
+      write(fd, line, line_length);
       line_length = 0;
     }
-    line_length += b64_ntop(b64_in, read, b64_out, 5);
-    dprintf(fd, "%s", b64_out);
+    line_length += b64_ntop(b64_in, read, line + line_length, 5);
   }
+  write(fd, line, line_length);
 
   dprintf(fd, "\n--- END:NFCSNOOP_LOG_SUMMARY ---\n");
 
 error:
+  ringbuffer_free(merged);
   ringbuffer_free(ringbuffer);
 }
@@ -17,11 +17,20 @@
  ******************************************************************************/
 #include <android-base/stringprintf.h>
 #include <base/logging.h>
+#include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 #include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "nfa_mem_co.h"
 #include "nfa_nv_ci.h"
+#include "nfc_config.h"
 #include "nfc_hal_nv_co.h"
 #include "CrcChecksum.h"
+#include <algorithm>
+#include <map>
+#include <mutex>
 #include <vector>
 
 using android::base::StringPrintf;
@@ -29,13 +38,353 @@ using android::base::StringPrintf;
 extern std::string nfc_storage_path;
 extern bool nfc_debug_enabled;
 
+/* A write of a block appends the regions that changed since the block was
+ * last read or written to the journal of the block. Regions are compared in
+ * units of this many bytes. */
+#ifndef NFA_NV_CO_REGION_SIZE
+#define NFA_NV_CO_REGION_SIZE 32
+#endif
+
+/* Once the journal of a block would grow beyond this, the whole block is
+ * written as a new snapshot and the journal starts over */
+#ifndef NFA_NV_CO_JOURNAL_MAX_SIZE
+#define NFA_NV_CO_JOURNAL_MAX_SIZE 4096
+#endif
+
+/* nfa_mem_co_alloc hands out blocks of NFA_MEM_CO_NUM_CLASSES power of two
+ * sizes, starting at 1 << NFA_MEM_CO_MIN_CLASS_SHIFT bytes. Freed blocks are
+ * kept for the next request of their class; larger requests go to the heap. */
+#ifndef NFA_MEM_CO_MIN_CLASS_SHIFT
+#define NFA_MEM_CO_MIN_CLASS_SHIFT 6
+#endif
+
+#ifndef NFA_MEM_CO_NUM_CLASSES
+#define NFA_MEM_CO_NUM_CLASSES 11
+#endif
+
+/* Class index of the blocks that bypass the size classes */
+#define NFA_MEM_CO_LARGE NFA_MEM_CO_NUM_CLASSES
+
+/* Every block starts with a header telling which class it belongs to */
+#define NFA_MEM_CO_HDR_SIZE alignof(max_align_t)
+
+typedef struct {
+  void* p_free;         /* freed blocks, linked through their first bytes */
+  uint32_t in_use;      /* blocks currently allocated */
+  uint32_t high_water;  /* most blocks ever allocated at the same time */
+  uint32_t allocs;      /* requests served */
+  uint32_t heap_allocs; /* requests that needed a new block from the heap */
+} tNFA_MEM_CO_CLASS;
+
+typedef struct {
+  std::mutex lock;
+  tNFA_MEM_CO_CLASS classes[NFA_MEM_CO_NUM_CLASSES + 1];
+  uint8_t* p_arena; /* preallocated memory new blocks are carved from */
+  size_t arena_size;
+  size_t arena_used;
+} tNFA_MEM_CO_CB;
+
+static tNFA_MEM_CO_CB nfa_mem_co_cb;
+
 namespace {
+uint32_t nfa_mem_co_class(uint32_t num_bytes) {
+  if (num_bytes <= (1u << NFA_MEM_CO_MIN_CLASS_SHIFT)) return 0;
+  uint32_t idx =
+      32 - __builtin_clz(num_bytes - 1) - NFA_MEM_CO_MIN_CLASS_SHIFT;
+  return std::min<uint32_t>(idx, NFA_MEM_CO_LARGE);
+}
+
+size_t nfa_mem_co_class_size(uint32_t idx) {
+  return (size_t)1 << (idx + NFA_MEM_CO_MIN_CLASS_SHIFT);
+}
+
 std::string getFilenameForBlock(const unsigned block) {
   std::string bin = "nfaStorage.bin";
   return StringPrintf("%s/%s%u", nfc_storage_path.c_str(), bin.c_str(), block);
 }
+
+std::string getJournalFilenameForBlock(const unsigned block) {
+  return getFilenameForBlock(block) + ".journal";
+}
+
+/* A journal starts with this header. It names the snapshot the journal
+ * applies to by the checksum and length of the snapshot, so that a journal
+ * left behind by a crash after its snapshot was replaced is not replayed on
+ * the new snapshot. */
+typedef struct {
+  uint16_t snapshot_crc;
+  uint16_t snapshot_length;
+  uint16_t crc; /* covers the fields above */
+} __attribute__((__packed__)) tNFA_NV_CO_JOURNAL_HDR;
+
+/* Each journal record overwrites one region of the snapshot, and is followed
+ * by the new contents of the region. Records are applied in order. */
+typedef struct {
+  uint16_t offset;
+  uint16_t length;
+  uint16_t crc; /* covers the offset, the length and the contents */
+} __attribute__((__packed__)) tNFA_NV_CO_JOURNAL_REC;
+
+/* Contents of each block as it is stored, to find what a write changes. Empty
+ * until the block is read or written, and after a failure, so that the next
+ * write stores a full snapshot. */
+std::map<uint8_t, std::vector<uint8_t>> nv_shadow;
+
+uint16_t journalRecordCrc(const tNFA_NV_CO_JOURNAL_REC& rec,
+                          const uint8_t* p_data) {
+  uint16_t crc = crcChecksumUpdate(0, (const uint8_t*)&rec,
+                                   offsetof(tNFA_NV_CO_JOURNAL_REC, crc));
+  return crcChecksumUpdate(crc, p_data, rec.length);
+}
+
+void journalHeaderInit(tNFA_NV_CO_JOURNAL_HDR* p_hdr, uint16_t snapshot_crc,
+                       uint16_t snapshot_length) {
+  p_hdr->snapshot_crc = snapshot_crc;
+  p_hdr->snapshot_length = snapshot_length;
+  p_hdr->crc = crcChecksumCompute((const uint8_t*)p_hdr,
+                                  offsetof(tNFA_NV_CO_JOURNAL_HDR, crc));
+}
+
+/* Reads the header of the journal of a block. Returns false if there is no
+ * journal, or its header is torn or corrupt. */
+bool readJournalHeader(uint8_t block, tNFA_NV_CO_JOURNAL_HDR* p_hdr) {
+  int fileStream =
+      open(getJournalFilenameForBlock(block).c_str(), O_RDONLY | O_CLOEXEC);
+  if (fileStream < 0) return false;
+  ssize_t actualRead =
+      TEMP_FAILURE_RETRY(read(fileStream, p_hdr, sizeof(*p_hdr)));
+  close(fileStream);
+  return (actualRead == sizeof(*p_hdr)) &&
+         (p_hdr->crc ==
+          crcChecksumCompute((const uint8_t*)p_hdr,
+                             offsetof(tNFA_NV_CO_JOURNAL_HDR, crc)));
+}
+
+/* Reads the checksum and length of the snapshot of a block */
+bool readSnapshotStamp(uint8_t block, uint16_t* p_crc, uint16_t* p_length) {
+  int fileStream =
+      open(getFilenameForBlock(block).c_str(), O_RDONLY | O_CLOEXEC);
+  if (fileStream < 0) return false;
+  struct stat file_stat;
+  bool stamped =
+      (fstat(fileStream, &file_stat) == 0) &&
+      (file_stat.st_size >= (off_t)sizeof(*p_crc)) &&
+      (file_stat.st_size - sizeof(*p_crc) <= UINT16_MAX) &&
+      (TEMP_FAILURE_RETRY(read(fileStream, p_crc, sizeof(*p_crc))) ==
+       sizeof(*p_crc));
+  close(fileStream);
+  if (stamped) *p_length = file_stat.st_size - sizeof(*p_crc);
+  return stamped;
+}
+
+bool writeFully(int fd, const void* p, size_t length) {
+  const uint8_t* p_data = (const uint8_t*)p;
+  while (length > 0) {
+    ssize_t written = TEMP_FAILURE_RETRY(write(fd, p_data, length));
+    if (written <= 0) return false;
+    p_data += written;
+    length -= written;
+  }
+  return true;
+}
+
+/* Replaces the snapshot of a block with a file written and synced under a
+ * temporary name, then drops the journal it supersedes */
+bool writeSnapshot(const uint8_t* pBuffer, uint16_t nbytes, uint8_t block) {
+  std::string journal_filename = getJournalFilenameForBlock(block);
+  std::string filename = getFilenameForBlock(block);
+  std::string tmp_filename = filename + ".tmp";
+
+  int fileStream = open(tmp_filename.c_str(),
+                        O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                        S_IRUSR | S_IWUSR);
+  if (fileStream < 0) {
+    LOG(ERROR) << StringPrintf("%s: fail to open, error = %d", __func__, errno);
+    return false;
+  }
+  unsigned short checksum = crcChecksumCompute(pBuffer, nbytes);
+  bool written = writeFully(fileStream, &checksum, sizeof(checksum)) &&
+                 writeFully(fileStream, pBuffer, nbytes) &&
+                 (fsync(fileStream) == 0);
+  close(fileStream);
+
+  /* If the crash happens after the rename, the journal header tells the new
+   * snapshot from the old one, unless they have the same checksum and
+   * length. Then the journal is emptied before the rename. */
+  tNFA_NV_CO_JOURNAL_HDR hdr;
+  if (written && readJournalHeader(block, &hdr) &&
+      (hdr.snapshot_crc == checksum) && (hdr.snapshot_length == nbytes)) {
+    int journal = open(journal_filename.c_str(),
+                       O_WRONLY | O_TRUNC | O_CLOEXEC);
+    written = (journal >= 0) && (fsync(journal) == 0);
+    if (journal >= 0) close(journal);
+  }
+  if (!written || rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+    LOG(ERROR) << StringPrintf("%s: fail to write, error = %d", __func__, errno);
+    unlink(tmp_filename.c_str());
+    return false;
+  }
+
+  /* The rename must be durable before the journal goes away */
+  int dir = open(nfc_storage_path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dir >= 0) {
+    fsync(dir);
+    close(dir);
+  }
+  unlink(journal_filename.c_str());
+  DLOG_IF(INFO, nfc_debug_enabled)
+      << StringPrintf("%s: %u bytes written", __func__, nbytes);
+  return true;
+}
+
+/* Appends the regions of the block that differ from |shadow| to its journal.
+ * Returns false if the journal is full or cannot be written. */
+bool appendJournal(const uint8_t* pBuffer, uint16_t nbytes, uint8_t block,
+                   const std::vector<uint8_t>& shadow) {
+  std::vector<uint8_t> records;
+  size_t offset = 0;
+
+  while (offset < nbytes) {
+    size_t length = std::min<size_t>(NFA_NV_CO_REGION_SIZE, nbytes - offset);
+    if (memcmp(pBuffer + offset, shadow.data() + offset, length) == 0) {
+      offset += length;
+      continue;
+    }
+    /* Merge the dirty regions that follow into the same record */
+    size_t end = offset + length;
+    while (end < nbytes) {
+      length = std::min<size_t>(NFA_NV_CO_REGION_SIZE, nbytes - end);
+      if (memcmp(pBuffer + end, shadow.data() + end, length) == 0) break;
+      end += length;
+    }
+
+    tNFA_NV_CO_JOURNAL_REC rec;
+    rec.offset = offset;
+    rec.length = end - offset;
+    rec.crc = journalRecordCrc(rec, pBuffer + offset);
+    records.insert(records.end(), (const uint8_t*)&rec,
+                   (const uint8_t*)&rec + sizeof(rec));
+    records.insert(records.end(), pBuffer + offset, pBuffer + end);
+    offset = end;
+  }
+  if (records.empty()) return true;
+
+  std::string filename = getJournalFilenameForBlock(block);
+  int fileStream =
+      open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+           S_IRUSR | S_IWUSR);
+  if (fileStream < 0) return false;
+  struct stat file_stat;
+  if ((fstat(fileStream, &file_stat) == 0) && (file_stat.st_size == 0)) {
+    /* A new journal, name the snapshot it applies to */
+    tNFA_NV_CO_JOURNAL_HDR hdr;
+    uint16_t snapshot_crc, snapshot_length;
+    if (!readSnapshotStamp(block, &snapshot_crc, &snapshot_length)) {
+      close(fileStream);
+      return false;
+    }
+    journalHeaderInit(&hdr, snapshot_crc, snapshot_length);
+    records.insert(records.begin(), (const uint8_t*)&hdr,
+                   (const uint8_t*)&hdr + sizeof(hdr));
+  }
+  bool written =
+      (fstat(fileStream, &file_stat) == 0) &&
+      (file_stat.st_size + records.size() <= NFA_NV_CO_JOURNAL_MAX_SIZE) &&
+      writeFully(fileStream, records.data(), records.size()) &&
+      (fdatasync(fileStream) == 0);
+  close(fileStream);
+  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
+      "%s: %zu bytes appended: %d", __func__, records.size(), written);
+  return written;
+}
+
+/* Applies the journal of a block to its snapshot in |pBuffer|, which has
+ * the checksum |snapshot_crc|. A journal written for another snapshot is
+ * dropped. Returns false if the journal ends in a torn or corrupt record. */
+bool replayJournal(uint8_t* pBuffer, size_t nbytes, uint8_t block,
+                   uint16_t snapshot_crc) {
+  std::string filename = getJournalFilenameForBlock(block);
+  int fileStream = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fileStream < 0) return true;
+
+  std::vector<uint8_t> journal;
+  uint8_t buffer[1024];
+  ssize_t actualRead;
+  while ((actualRead = TEMP_FAILURE_RETRY(
+              read(fileStream, buffer, sizeof(buffer)))) > 0)
+    journal.insert(journal.end(), buffer, buffer + actualRead);
+  close(fileStream);
+
+  /* An empty or torn header is a journal that never got a record */
+  tNFA_NV_CO_JOURNAL_HDR hdr;
+  tNFA_NV_CO_JOURNAL_HDR expected;
+  journalHeaderInit(&expected, snapshot_crc, nbytes);
+  if (journal.size() >= sizeof(hdr)) memcpy(&hdr, journal.data(), sizeof(hdr));
+  if ((journal.size() < sizeof(hdr)) || memcmp(&hdr, &expected, sizeof(hdr))) {
+    if (!journal.empty())
+      LOG(ERROR) << StringPrintf("%s: journal of block %u is stale", __func__,
+                                 block);
+    unlink(filename.c_str());
+    return true;
+  }
+
+  size_t pos = sizeof(hdr);
+  while (pos + sizeof(tNFA_NV_CO_JOURNAL_REC) <= journal.size()) {
+    tNFA_NV_CO_JOURNAL_REC rec;
+    memcpy(&rec, &journal[pos], sizeof(rec));
+    const uint8_t* p_data = &journal[pos + sizeof(rec)];
+    if ((rec.length == 0) ||
+        (rec.length > journal.size() - pos - sizeof(rec)) ||
+        (rec.offset + rec.length > nbytes) ||
+        (rec.crc != journalRecordCrc(rec, p_data)))
+      break;
+    memcpy(pBuffer + rec.offset, p_data, rec.length);
+    pos += sizeof(rec) + rec.length;
+  }
+  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
+      "%s: %zu of %zu bytes replayed", __func__, pos, journal.size());
+  if (pos != journal.size()) {
+    LOG(ERROR) << StringPrintf("%s: journal of block %u is truncated",
+                               __func__, block);
+    return false;
+  }
+  return true;
+}
 }  // namespace
 
+/*******************************************************************************
+**
+** Function         nfa_mem_co_init
+**
+** Description      Reserve the arena of NFA_MEM_ARENA_SIZE bytes the blocks
+**                  of nfa_mem_co_alloc are carved from. Without it, blocks
+**                  come from the heap the first time their class runs out.
+**                  The arena is kept across NFC restarts.
+**
+** Returns:
+**                  Nothing
+**
+*******************************************************************************/
+void nfa_mem_co_init(void) {
+  std::lock_guard<std::mutex> lock(nfa_mem_co_cb.lock);
+
+  if (nfa_mem_co_cb.p_arena != NULL) return;
+  size_t arena_size = NfcConfig::getUnsigned(NAME_NFA_MEM_ARENA_SIZE, 0);
+  if (arena_size == 0) return;
+
+  nfa_mem_co_cb.p_arena = (uint8_t*)aligned_alloc(
+      NFA_MEM_CO_HDR_SIZE, (arena_size + NFA_MEM_CO_HDR_SIZE - 1) &
+                               ~(NFA_MEM_CO_HDR_SIZE - 1));
+  if (nfa_mem_co_cb.p_arena == NULL) {
+    LOG(ERROR) << StringPrintf("%s: fail to reserve %zu bytes", __func__,
+                               arena_size);
+    return;
+  }
+  nfa_mem_co_cb.arena_size = arena_size;
+  DLOG_IF(INFO, nfc_debug_enabled)
+      << StringPrintf("%s: arena of %zu bytes", __func__, arena_size);
+}
+
 /*******************************************************************************
 **
 ** Function         nfa_mem_co_alloc
@@ -47,7 +396,49 @@ std::string getFilenameForBlock(const unsigned block) {
 **                  NULL otherwise
 **
 *******************************************************************************/
-extern void* nfa_mem_co_alloc(uint32_t num_bytes) { return malloc(num_bytes); }
+extern void* nfa_mem_co_alloc(uint32_t num_bytes) {
+  uint32_t idx = nfa_mem_co_class(num_bytes);
+  tNFA_MEM_CO_CLASS* p_class = &nfa_mem_co_cb.classes[idx];
+  uint8_t* p_blk = NULL;
+
+  {
+    std::lock_guard<std::mutex> lock(nfa_mem_co_cb.lock);
+    if (p_class->p_free != NULL) {
+      p_blk = (uint8_t*)p_class->p_free - NFA_MEM_CO_HDR_SIZE;
+      memcpy(&p_class->p_free, p_class->p_free, sizeof(void*));
+    } else if (idx != NFA_MEM_CO_LARGE) {
+      size_t blk_size = NFA_MEM_CO_HDR_SIZE + nfa_mem_co_class_size(idx);
+      if (nfa_mem_co_cb.arena_size - nfa_mem_co_cb.arena_used >= blk_size) {
+        p_blk = nfa_mem_co_cb.p_arena + nfa_mem_co_cb.arena_used;
+        nfa_mem_co_cb.arena_used += blk_size;
+      }
+    }
+    if (p_blk != NULL) {
+      p_class->allocs++;
+      if (++p_class->in_use > p_class->high_water)
+        p_class->high_water = p_class->in_use;
+    }
+  }
+
+  if (p_blk == NULL) {
+    size_t size = (idx == NFA_MEM_CO_LARGE) ? num_bytes
+                                            : nfa_mem_co_class_size(idx);
+    p_blk = (uint8_t*)malloc(NFA_MEM_CO_HDR_SIZE + size);
+    if (p_blk == NULL) {
+      LOG(ERROR) << StringPrintf("%s: fail to allocate %u bytes", __func__,
+                                 num_bytes);
+      return NULL;
+    }
+    std::lock_guard<std::mutex> lock(nfa_mem_co_cb.lock);
+    p_class->allocs++;
+    p_class->heap_allocs++;
+    if (++p_class->in_use > p_class->high_water)
+      p_class->high_water = p_class->in_use;
+  }
+
+  memcpy(p_blk, &idx, sizeof(idx));
+  return p_blk + NFA_MEM_CO_HDR_SIZE;
+}
 
 /*******************************************************************************
 **
@@ -59,7 +450,51 @@ extern void* nfa_mem_co_alloc(uint32_t num_bytes) { return malloc(num_bytes); }
 **                  Nothing
 **
 *******************************************************************************/
-extern void nfa_mem_co_free(void* pBuffer) { free(pBuffer); }
+extern void nfa_mem_co_free(void* pBuffer) {
+  if (pBuffer == NULL) return;
+
+  uint8_t* p_blk = (uint8_t*)pBuffer - NFA_MEM_CO_HDR_SIZE;
+  uint32_t idx;
+  memcpy(&idx, p_blk, sizeof(idx));
+  tNFA_MEM_CO_CLASS* p_class = &nfa_mem_co_cb.classes[idx];
+
+  std::lock_guard<std::mutex> lock(nfa_mem_co_cb.lock);
+  p_class->in_use--;
+  if (idx == NFA_MEM_CO_LARGE) {
+    free(p_blk);
+    return;
+  }
+  memcpy(pBuffer, &p_class->p_free, sizeof(void*));
+  p_class->p_free = pBuffer;
+}
+
+/*******************************************************************************
+**
+** Function         nfa_mem_co_dump
+**
+** Description      Write the usage of each size class to fd
+**
+** Returns:
+**                  Nothing
+**
+*******************************************************************************/
+void nfa_mem_co_dump(int fd) {
+  std::lock_guard<std::mutex> lock(nfa_mem_co_cb.lock);
+
+  dprintf(fd, "nfa_mem_co: arena %zu of %zu bytes used\n",
+          nfa_mem_co_cb.arena_used, nfa_mem_co_cb.arena_size);
+  for (uint32_t idx = 0; idx <= NFA_MEM_CO_LARGE; idx++) {
+    const tNFA_MEM_CO_CLASS* p_class = &nfa_mem_co_cb.classes[idx];
+    if (p_class->allocs == 0) continue;
+    if (idx == NFA_MEM_CO_LARGE)
+      dprintf(fd, "  large:");
+    else
+      dprintf(fd, "  %6zu:", nfa_mem_co_class_size(idx));
+    dprintf(fd, " in use %u, high water %u, allocs %u, heap allocs %u\n",
+            p_class->in_use, p_class->high_water, p_class->allocs,
+            p_class->heap_allocs);
+  }
+}
 
 /*******************************************************************************
 **
@@ -95,10 +530,16 @@ extern void nfa_nv_co_read(uint8_t* pBuffer, uint16_t nbytes, uint8_t block) {
       close(fileStream);
       return;
     }
-    size_t actualReadData = read(fileStream, pBuffer, nbytes);
+    ssize_t actualReadData = read(fileStream, pBuffer, nbytes);
     close(fileStream);
     if (actualReadData > 0) {
-      DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: data size=%zu", __func__, actualReadData);
+      DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: data size=%zd", __func__, actualReadData);
+      /* Changes since the snapshot are in the journal. If it is damaged,
+       * the next write stores a new snapshot instead of appending to it. */
+      if (replayJournal(pBuffer, actualReadData, block, checksum))
+        nv_shadow[block].assign(pBuffer, pBuffer + actualReadData);
+      else
+        nv_shadow[block].clear();
       nfa_nv_ci_read(actualReadData, NFA_NV_CO_OK, block);
     } else {
       LOG(ERROR) << StringPrintf("%s: fail to read", __func__);
@@ -106,6 +547,8 @@ extern void nfa_nv_co_read(uint8_t* pBuffer, uint16_t nbytes, uint8_t block) {
     }
   } else {
     DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: fail to open", __func__);
+    /* A journal without its snapshot cannot be replayed */
+    unlink(getJournalFilenameForBlock(block).c_str());
     nfa_nv_ci_read(0, NFA_NV_CO_FAIL, block);
   }
 }
@@ -131,25 +574,18 @@ extern void nfa_nv_co_read(uint8_t* pBuffer, uint16_t nbytes, uint8_t block) {
 *******************************************************************************/
 extern void nfa_nv_co_write(const uint8_t* pBuffer, uint16_t nbytes,
                             uint8_t block) {
-  std::string filename = getFilenameForBlock(block);
+  std::vector<uint8_t>& shadow = nv_shadow[block];
 
-  int fileStream =
-      open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
-  if (fileStream >= 0) {
-    unsigned short checksum = crcChecksumCompute(pBuffer, nbytes);
-    size_t actualWrittenCrc = write(fileStream, &checksum, sizeof(checksum));
-    size_t actualWrittenData = write(fileStream, pBuffer, nbytes);
-    DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: %zu bytes written", __func__, actualWrittenData);
-    if ((actualWrittenData == nbytes) &&
-        (actualWrittenCrc == sizeof(checksum))) {
-      nfa_nv_ci_write(NFA_NV_CO_OK);
-    } else {
-      LOG(ERROR) << StringPrintf("%s: fail to write", __func__);
-      nfa_nv_ci_write(NFA_NV_CO_FAIL);
-    }
-    close(fileStream);
+  /* Append what changed, or store the whole block if the journal cannot
+   * describe the change */
+  if (((shadow.size() == nbytes) &&
+       appendJournal(pBuffer, nbytes, block, shadow)) ||
+      writeSnapshot(pBuffer, nbytes, block)) {
+    shadow.assign(pBuffer, pBuffer + nbytes);
+    nfa_nv_ci_write(NFA_NV_CO_OK);
   } else {
-    LOG(ERROR) << StringPrintf("%s: fail to open, error = %d", __func__, errno);
+    LOG(ERROR) << StringPrintf("%s: fail to write", __func__);
+    shadow.clear();
     nfa_nv_ci_write(NFA_NV_CO_FAIL);
   }
 }
@@ -173,11 +609,12 @@ void delete_stack_non_volatile_store(bool forceDelete) {
 
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s", __func__);
 
-  remove(getFilenameForBlock(DH_NV_BLOCK).c_str());
-  remove(getFilenameForBlock(HC_F2_NV_BLOCK).c_str());
-  remove(getFilenameForBlock(HC_F3_NV_BLOCK).c_str());
-  remove(getFilenameForBlock(HC_F4_NV_BLOCK).c_str());
-  remove(getFilenameForBlock(HC_F5_NV_BLOCK).c_str());
+  for (auto block : {DH_NV_BLOCK, HC_F2_NV_BLOCK, HC_F3_NV_BLOCK,
+                     HC_F4_NV_BLOCK, HC_F5_NV_BLOCK}) {
+    remove(getFilenameForBlock(block).c_str());
+    remove(getJournalFilenameForBlock(block).c_str());
+  }
+  nv_shadow.clear();
 }
 
 /*******************************************************************************
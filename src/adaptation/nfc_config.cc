@@ -22,12 +22,33 @@
 #include <android-base/strings.h>
 
 #include <config.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "CrcChecksum.h"
 
 using namespace ::std;
 using namespace ::android::base;
 #define PATH_TRANSIT_CONF "/data/nfc/libnfc-nxpTransit.conf"
+#define PATH_CONFIG_CACHE "/data/nfc/libnfc-nci.conf.cache"
 namespace {
 
+const uint32_t CONFIG_CACHE_MAGIC = 0x4e434643;  // "CFCN"
+const uint16_t CONFIG_CACHE_VERSION = 2;
+
+// The cache file starts with this header, followed by the description of
+// the text configs it was compiled from and the serialized ConfigFile. The
+// CRC covers everything after the header.
+typedef struct {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t crc;
+  uint32_t sources_length;
+  uint32_t config_length;
+} __attribute__((__packed__)) tConfigCacheHeader;
+
 std::string findConfigPath() {
   const vector<string> search_path = {"/odm/etc/", "/vendor/etc/",
                                       "/product/etc/", "/etc/"};
@@ -42,62 +63,252 @@ std::string findConfigPath() {
   return "";
 }
 
+// Identifies the text configs by path, size, modification time and a CRC of
+// their contents, so that any change to them, including one appearing or
+// going away, invalidates the cache. Images are built with fixed
+// modification times, so an OTA may change a file without changing its size
+// or time.
+std::vector<uint8_t> describeConfigSources(const vector<string>& paths) {
+  std::vector<uint8_t> sources;
+  for (const string& path : paths) {
+    struct stat file_stat;
+    string contents;
+    int64_t stamp[4] = {-1, -1, -1, -1};
+    if (stat(path.c_str(), &file_stat) == 0) {
+      stamp[0] = file_stat.st_size;
+      stamp[1] = file_stat.st_mtim.tv_sec;
+      stamp[2] = file_stat.st_mtim.tv_nsec;
+    }
+    if (ReadFileToString(path, &contents)) {
+      stamp[3] = crcChecksumCompute((const unsigned char*)contents.data(),
+                                    contents.size());
+    }
+    sources.insert(sources.end(), path.begin(), path.end());
+    sources.push_back(0);
+    sources.insert(sources.end(), (uint8_t*)stamp, (uint8_t*)(stamp + 4));
+  }
+  return sources;
+}
+
+// Loads the config from the cache if it was compiled from |sources|
+bool readConfigCache(const std::vector<uint8_t>& sources, ConfigFile& config) {
+  int fd = open(PATH_CONFIG_CACHE, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+
+  struct stat file_stat;
+  void* map = MAP_FAILED;
+  if (fstat(fd, &file_stat) == 0 &&
+      file_stat.st_size >= (off_t)sizeof(tConfigCacheHeader)) {
+    map = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (map == MAP_FAILED) return false;
+
+  const uint8_t* p = (const uint8_t*)map;
+  const size_t length = file_stat.st_size;
+  tConfigCacheHeader header;
+  memcpy(&header, p, sizeof(header));
+
+  bool loaded = false;
+  if (header.magic != CONFIG_CACHE_MAGIC ||
+      header.version != CONFIG_CACHE_VERSION ||
+      length != sizeof(header) + (size_t)header.sources_length +
+                    header.config_length) {
+    LOG(ERROR) << __func__ << ": invalid config cache";
+  } else if (header.crc != crcChecksumCompute(p + sizeof(header),
+                                              length - sizeof(header))) {
+    LOG(ERROR) << __func__ << ": config cache checksum mismatch";
+  } else if (header.sources_length == sources.size() &&
+             memcmp(p + sizeof(header), sources.data(), sources.size()) ==
+                 0) {
+    loaded = config.parseFromBinary(p + sizeof(header) + sources.size(),
+                                    header.config_length);
+  }
+  munmap(map, length);
+  return loaded;
+}
+
+// Compiles the config parsed from |sources| into the cache
+void writeConfigCache(const std::vector<uint8_t>& sources,
+                      ConfigFile& config) {
+  std::vector<uint8_t> cache(sizeof(tConfigCacheHeader));
+  cache.insert(cache.end(), sources.begin(), sources.end());
+  config.serializeToBinary(&cache);
+
+  tConfigCacheHeader header;
+  header.magic = CONFIG_CACHE_MAGIC;
+  header.version = CONFIG_CACHE_VERSION;
+  header.sources_length = sources.size();
+  header.config_length = cache.size() - sizeof(header) - sources.size();
+  header.crc = crcChecksumCompute(cache.data() + sizeof(header),
+                                  cache.size() - sizeof(header));
+  memcpy(cache.data(), &header, sizeof(header));
+
+  // Write a new file and rename it, so a reader never sees a partial cache
+  const string temp_path = string(PATH_CONFIG_CACHE) + ".tmp";
+  int fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                S_IRUSR | S_IWUSR);
+  if (fd < 0) {
+    LOG(ERROR) << __func__ << ": fail to open, error = " << errno;
+    return;
+  }
+  bool written = WriteFully(fd, cache.data(), cache.size());
+  close(fd);
+  if (!written || rename(temp_path.c_str(), PATH_CONFIG_CACHE) != 0) {
+    LOG(ERROR) << __func__ << ": fail to write, error = " << errno;
+    unlink(temp_path.c_str());
+  }
+}
+
 }  // namespace
 
-void NfcConfig::loadConfig() {
+ConfigKey KEY_UICC_LISTEN_TECH_MASK(NAME_UICC_LISTEN_TECH_MASK);
+#if (NXP_EXTNS == TRUE)
+ConfigKey KEY_NFA_DM_DISC_NTF_TIMEOUT(NAME_NFA_DM_DISC_NTF_TIMEOUT);
+ConfigKey KEY_HOST_LISTEN_TECH_MASK(NAME_HOST_LISTEN_TECH_MASK);
+ConfigKey KEY_NXP_FWD_FUNCTIONALITY_ENABLE(NAME_NXP_FWD_FUNCTIONALITY_ENABLE);
+ConfigKey KEY_NXP_ESE_LISTEN_TECH_MASK(NAME_NXP_ESE_LISTEN_TECH_MASK);
+ConfigKey KEY_P2P_LISTEN_TECH_MASK(NAME_P2P_LISTEN_TECH_MASK);
+ConfigKey KEY_DEFAULT_OFFHOST_ROUTE(NAME_DEFAULT_OFFHOST_ROUTE);
+ConfigKey KEY_NXP_DUAL_UICC_ENABLE(NAME_NXP_DUAL_UICC_ENABLE);
+#endif
+
+bool NfcConfig::readConfig(ConfigFile& config) {
   string config_path = findConfigPath();
-  CHECK(config_path != "");
-  config_.parseFromFile(config_path);
-  struct stat file_stat;
-  /* Read Transit configs if available */
-  if (stat(PATH_TRANSIT_CONF, &file_stat) == 0)
-    config_.parseFromFile(PATH_TRANSIT_CONF);
+  if (config_path == "") return false;
+  /* Use the configs compiled at a previous start if the files are unchanged */
+  std::vector<uint8_t> sources =
+      describeConfigSources({config_path, PATH_TRANSIT_CONF});
+  if (!readConfigCache(sources, config)) {
+    if (!config.tryParseFromFile(config_path)) return false;
+    struct stat file_stat;
+    /* Read Transit configs if available */
+    if (stat(PATH_TRANSIT_CONF, &file_stat) == 0 &&
+        !config.tryParseFromFile(PATH_TRANSIT_CONF))
+      return false;
+    writeConfigCache(sources, config);
+  }
+  for (auto vendor_config : vendor_configs_) {
+    config.addConfig(vendor_config.first, vendor_config.second);
+  }
+  return true;
+}
+
+void NfcConfig::loadConfig() {
   /* Read vendor specific configs */
   NfcAdaptation& theInstance = NfcAdaptation::GetInstance();
-  std::map<std::string, ConfigValue> configMap;
-  theInstance.GetVendorConfigs(configMap);
-  theInstance.GetNxpConfigs(configMap);
-  for (auto config : configMap) {
-    config_.addConfig(config.first, config.second);
-  }
+  vendor_configs_.clear();
+  theInstance.GetVendorConfigs(vendor_configs_);
+  theInstance.GetNxpConfigs(vendor_configs_);
+  bool config_read = readConfig(*config_.load());
+  CHECK(config_read);
 }
 
-NfcConfig::NfcConfig() { loadConfig(); }
+NfcConfig::NfcConfig() {
+  configs_.emplace_back(new ConfigFile());
+  config_ = configs_.back().get();
+  loadConfig();
+}
 
 NfcConfig& NfcConfig::getInstance() {
   static NfcConfig theInstance;
-  if (theInstance.config_.isEmpty()) {
-    theInstance.loadConfig();
-  }
   return theInstance;
 }
 
+ConfigFile& NfcConfig::getConfig() {
+  NfcConfig& instance = getInstance();
+  ConfigFile* config = instance.config_.load();
+  /* Read the configs again after clear() */
+  if (config->isEmpty()) instance.loadConfig();
+  return *config;
+}
+
+bool NfcConfig::reload(std::vector<std::string>* changed_keys) {
+  NfcConfig& instance = getInstance();
+  std::unique_ptr<ConfigFile> config(new ConfigFile());
+
+  if (!instance.readConfig(*config)) {
+    LOG(ERROR) << "NfcConfig - config files not readable, keeping the configs";
+    return false;
+  }
+  instance.config_.load()->diff(*config, changed_keys);
+  if (changed_keys->empty()) return false;
+
+  for (const std::string& key : *changed_keys)
+    LOG(INFO) << "NfcConfig - reloaded [" << key << "]";
+  /* The replaced config stays in configs_, a caller may still hold a value
+   * of it */
+  instance.configs_.push_back(std::move(config));
+  instance.config_ = instance.configs_.back().get();
+  return true;
+}
+
+std::vector<std::string> NfcConfig::getConfigPaths() {
+  return {findConfigPath(), PATH_TRANSIT_CONF};
+}
+
 bool NfcConfig::hasKey(const std::string& key) {
-  return getInstance().config_.hasKey(key);
+  return getConfig().hasKey(key);
 }
 
-std::string NfcConfig::getString(const std::string& key) {
-  return getInstance().config_.getString(key);
+const std::string& NfcConfig::getString(const std::string& key) {
+  return getConfig().getString(key);
 }
 
 std::string NfcConfig::getString(const std::string& key,
                                  std::string default_value) {
-  if (hasKey(key)) return getString(key);
+  ConfigFile& config = getConfig();
+  if (config.hasKey(key)) return config.getString(key);
   return default_value;
 }
 
 unsigned NfcConfig::getUnsigned(const std::string& key) {
-  return getInstance().config_.getUnsigned(key);
+  return getConfig().getUnsigned(key);
 }
 
 unsigned NfcConfig::getUnsigned(const std::string& key,
                                 unsigned default_value) {
-  if (hasKey(key)) return getUnsigned(key);
+  ConfigFile& config = getConfig();
+  if (config.hasKey(key)) return config.getUnsigned(key);
+  return default_value;
+}
+
+const std::vector<uint8_t>& NfcConfig::getBytes(const std::string& key) {
+  return getConfig().getBytes(key);
+}
+
+bool NfcConfig::hasKey(const ConfigKey& key) {
+  return getConfig().hasKey(key);
+}
+
+const std::string& NfcConfig::getString(const ConfigKey& key) {
+  return getConfig().getString(key);
+}
+
+std::string NfcConfig::getString(const ConfigKey& key,
+                                 std::string default_value) {
+  ConfigFile& config = getConfig();
+  if (config.hasKey(key)) return config.getString(key);
+  return default_value;
+}
+
+unsigned NfcConfig::getUnsigned(const ConfigKey& key) {
+  return getConfig().getUnsigned(key);
+}
+
+unsigned NfcConfig::getUnsigned(const ConfigKey& key, unsigned default_value) {
+  ConfigFile& config = getConfig();
+  if (config.hasKey(key)) return config.getUnsigned(key);
   return default_value;
 }
 
-std::vector<uint8_t> NfcConfig::getBytes(const std::string& key) {
-  return getInstance().config_.getBytes(key);
+const std::vector<uint8_t>& NfcConfig::getBytes(const ConfigKey& key) {
+  return getConfig().getBytes(key);
 }
 
-void NfcConfig::clear() { getInstance().config_.clear(); }
\ No newline at end of file
+void NfcConfig::clear() {
+  NfcConfig& instance = getInstance();
+  instance.configs_.erase(instance.configs_.begin(),
+                          instance.configs_.end() - 1);
+  instance.config_.load()->clear();
+}
\ No newline at end of file
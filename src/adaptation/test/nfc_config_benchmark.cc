@@ -0,0 +1,70 @@
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <vector>
+
+#include "nfc_config.h"
+
+namespace {
+
+/* The getters as the stack calls them, on the config files of the device.
+ * The keys looked up are in libnfc-nci.conf or set by the vendor HAL. */
+ConfigKey proprietary_key(NAME_NFA_PROPRIETARY_CFG);
+
+void BM_NfcHasKeyGetUnsigned(benchmark::State& state) {
+  if (!NfcConfig::hasKey(KEY_UICC_LISTEN_TECH_MASK)) {
+    state.SkipWithError(NAME_UICC_LISTEN_TECH_MASK " is not set");
+    return;
+  }
+  for (auto _ : state) {
+    if (NfcConfig::hasKey(KEY_UICC_LISTEN_TECH_MASK))
+      benchmark::DoNotOptimize(
+          NfcConfig::getUnsigned(KEY_UICC_LISTEN_TECH_MASK));
+  }
+}
+BENCHMARK(BM_NfcHasKeyGetUnsigned);
+
+void BM_NfcGetUnsignedDefault(benchmark::State& state) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        NfcConfig::getUnsigned(KEY_UICC_LISTEN_TECH_MASK, 0));
+  }
+}
+BENCHMARK(BM_NfcGetUnsignedDefault);
+
+/* Copying the bytes out, as every caller paid when getBytes returned by
+ * value */
+void BM_NfcGetBytesCopy(benchmark::State& state) {
+  if (!NfcConfig::hasKey(proprietary_key)) {
+    state.SkipWithError(NAME_NFA_PROPRIETARY_CFG " is not set");
+    return;
+  }
+  for (auto _ : state) {
+    std::vector<uint8_t> bytes = NfcConfig::getBytes(proprietary_key);
+    benchmark::DoNotOptimize(bytes.data());
+  }
+}
+BENCHMARK(BM_NfcGetBytesCopy);
+
+void BM_NfcGetBytes(benchmark::State& state) {
+  if (!NfcConfig::hasKey(proprietary_key)) {
+    state.SkipWithError(NAME_NFA_PROPRIETARY_CFG " is not set");
+    return;
+  }
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(NfcConfig::getBytes(proprietary_key).data());
+  }
+}
+BENCHMARK(BM_NfcGetBytes);
+
+void BM_NfcGetStringDefault(benchmark::State& state) {
+  for (auto _ : state) {
+    std::string path = NfcConfig::getString(NAME_NFA_STORAGE, "/data/nfc");
+    benchmark::DoNotOptimize(path.data());
+  }
+}
+BENCHMARK(BM_NfcGetStringDefault);
+
+}  // namespace
+
+BENCHMARK_MAIN();
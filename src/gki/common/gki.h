@@ -300,23 +300,38 @@ struct TIMER_LIST_ENT;
 typedef void(TIMER_CBACK)(TIMER_LIST_ENT* p_tle);
 
 /* Define a timer list entry
+** ticks is the timeout when the entry is added. Once added it is 0 if the
+** entry has expired and positive otherwise; use GKI_get_remaining_ticks() for
+** the time left.
 */
 struct TIMER_LIST_ENT {
   TIMER_LIST_ENT* p_next;
-  TIMER_LIST_ENT* p_prev;
+  TIMER_LIST_ENT* p_prev; /* the head's p_prev points to the tail */
   TIMER_CBACK* p_cback;
   int32_t ticks;
   uintptr_t param;
   uint16_t event;
   uint8_t in_use;
+  uint8_t slot;    /* wheel slot holding the entry, GKI_TIMER_SLOT_EXPIRED */
+  uint32_t expiry; /* expiry time in list units */
 };
 
+#define GKI_TIMER_WHEEL_SLOTS (1 << GKI_TIMER_WHEEL_BITS)
+#define GKI_TIMER_WHEEL_MASK (GKI_TIMER_WHEEL_SLOTS - 1)
+#define GKI_TIMER_SLOT_EXPIRED 0xFF
+
 /* Define a timer list queue
+** p_first is the first expired entry, or if none has expired one of the
+** running entries, or NULL if the list is empty.
 */
 typedef struct {
   TIMER_LIST_ENT* p_first;
-  TIMER_LIST_ENT* p_last;
-  int32_t last_ticks;
+  TIMER_LIST_ENT* p_expired; /* expired entries, in order of expiry */
+  uint32_t now;              /* current time of the list, in list units */
+  uint16_t num_running;
+  uint16_t num_expired;
+  uint32_t slot_mask[GKI_TIMER_WHEEL_LEVELS]; /* non-empty slots */
+  TIMER_LIST_ENT* p_slot[GKI_TIMER_WHEEL_LEVELS][GKI_TIMER_WHEEL_SLOTS];
 } TIMER_LIST_Q;
 
 /***********************************************************************
@@ -347,6 +362,7 @@ extern uint8_t GKI_create_task(TASKPTR, uint8_t, int8_t*, uint16_t*, uint16_t,
                                void*, void*);
 extern void GKI_exit_task(uint8_t);
 extern uint8_t GKI_get_taskid(void);
+extern uint8_t GKI_register_thread(void);
 extern void GKI_init(void);
 extern int8_t* GKI_map_taskname(uint8_t);
 extern uint8_t GKI_resume_task(uint8_t);
@@ -380,8 +396,10 @@ extern void* GKI_getpoolbuf(uint8_t);
 
 extern uint16_t GKI_poolcount(uint8_t);
 extern uint16_t GKI_poolfreecount(uint8_t);
+extern uint16_t GKI_poolcachecount(uint8_t);
 extern uint16_t GKI_poolutilization(uint8_t);
 extern void GKI_register_mempool(void* p_mem);
+extern void GKI_dump_pools(int fd);
 extern uint8_t GKI_set_pool_permission(uint8_t, uint8_t);
 
 /* User buffer queue management
@@ -412,6 +430,7 @@ extern void GKI_stop_timer(uint8_t);
 extern void GKI_timer_update(int32_t);
 extern uint16_t GKI_update_timer_list(TIMER_LIST_Q*, int32_t);
 extern uint32_t GKI_get_remaining_ticks(TIMER_LIST_Q*, TIMER_LIST_ENT*);
+extern int32_t GKI_get_next_expiry(TIMER_LIST_Q*);
 extern uint16_t GKI_wait(uint16_t, uint32_t);
 
 /* Start and Stop system time tick callback
@@ -17,6 +17,7 @@
  ******************************************************************************/
 #include <android-base/stringprintf.h>
 #include <base/logging.h>
+#include <stdio.h>
 #include "gki_int.h"
 
 #if (GKI_NUM_TOTAL_BUF_POOLS > 16)
@@ -30,6 +31,136 @@ static void gki_remove_from_pool_list(uint8_t pool_id);
 
 using android::base::StringPrintf;
 
+#if (GKI_BUF_CACHE_SIZE > 0)
+/* Per-thread cache of free buffers for one pool */
+typedef struct {
+  uint32_t gen;   /* pool generation the cached buffers belong to */
+  uint16_t count; /* number of buffers in p_buf[] */
+  BUFFER_HDR_T* p_buf[GKI_BUF_CACHE_SIZE];
+} tGKI_BUF_CACHE_POOL;
+
+/* Per-thread buffer caches, flushed back to the pools when the thread exits */
+class GkiBufCache {
+ public:
+  ~GkiBufCache();
+  tGKI_BUF_CACHE_POOL pool[GKI_NUM_TOTAL_BUF_POOLS];
+};
+
+static thread_local GkiBufCache gki_buf_cache;
+#endif
+
+/* Bumped each time a pool is (re)initialized or deleted so that stale per-
+** thread cache entries are dropped instead of being handed out again. Kept
+** outside of gki_cb since GKI_init() wipes the control block. */
+static uint32_t gki_pool_gen[GKI_NUM_TOTAL_BUF_POOLS];
+
+/*******************************************************************************
+**
+** Function         gki_freeq_hdr
+**
+** Description      Internal function to map a free list slot (buffer index + 1)
+**                  of a pool to its buffer header.
+**
+** Returns          buffer header
+**
+*******************************************************************************/
+static inline BUFFER_HDR_T* gki_freeq_hdr(uint8_t id, uint32_t slot) {
+  tGKI_COM_CB* p_cb = &gki_cb.com;
+
+  return ((BUFFER_HDR_T*)(p_cb->pool_start[id] +
+                          (slot - 1) * (uint32_t)p_cb->pool_size[id]));
+}
+
+/*******************************************************************************
+**
+** Function         gki_freeq_slot
+**
+** Description      Internal function to map a buffer header to its free list
+**                  slot (buffer index + 1).
+**
+** Returns          slot, or 0 if the header is not inside the pool
+**
+*******************************************************************************/
+static inline uint32_t gki_freeq_slot(uint8_t id, BUFFER_HDR_T* p_hdr) {
+  tGKI_COM_CB* p_cb = &gki_cb.com;
+  uint8_t* p = (uint8_t*)p_hdr;
+
+  if ((p < p_cb->pool_start[id]) || (p >= p_cb->pool_end[id])) return (0);
+
+  return ((uint32_t)((p - p_cb->pool_start[id]) / p_cb->pool_size[id]) + 1);
+}
+
+/*******************************************************************************
+**
+** Function         gki_freeq_pop
+**
+** Description      Internal function to take up to max buffers off the lock-
+**                  free free list of a pool with a single compare-and-swap.
+**                  The ABA tag in the list head guarantees that the chain
+**                  walked below was not modified if the swap succeeds.
+**
+** Returns          number of buffers stored in pp_hdr
+**
+*******************************************************************************/
+static uint16_t gki_freeq_pop(uint8_t id, BUFFER_HDR_T** pp_hdr,
+                              uint16_t max) {
+  FREE_QUEUE_T* Q = &gki_cb.com.freeq[id];
+  uint64_t old_head = __atomic_load_n(&Q->head, __ATOMIC_ACQUIRE);
+  uint64_t new_head;
+  uint32_t slot;
+  uint16_t n;
+
+  do {
+    n = 0;
+    slot = (uint32_t)(old_head & GKI_FREEQ_SLOT_MASK);
+    while ((slot != 0) && (n < max)) {
+      BUFFER_HDR_T* p_hdr = gki_freeq_hdr(id, slot);
+      BUFFER_HDR_T* p_next = __atomic_load_n(&p_hdr->p_next, __ATOMIC_RELAXED);
+
+      pp_hdr[n++] = p_hdr;
+      /* a foreign pointer means the buffer was taken meanwhile, the swap
+       * below will fail and the walk is retried */
+      slot = p_next ? gki_freeq_slot(id, p_next) : 0;
+    }
+
+    if (n == 0) return (0);
+
+    new_head = ((old_head & ~GKI_FREEQ_SLOT_MASK) + GKI_FREEQ_TAG_INC) | slot;
+  } while (!__atomic_compare_exchange_n(&Q->head, &old_head, new_head, true,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+  return (n);
+}
+
+/*******************************************************************************
+**
+** Function         gki_freeq_push
+**
+** Description      Internal function to return a chain of buffers, already
+**                  linked from p_first to p_last, to the lock-free free list
+**                  of a pool.
+**
+** Returns          void
+**
+*******************************************************************************/
+static void gki_freeq_push(uint8_t id, BUFFER_HDR_T* p_first,
+                           BUFFER_HDR_T* p_last) {
+  FREE_QUEUE_T* Q = &gki_cb.com.freeq[id];
+  uint32_t slot = gki_freeq_slot(id, p_first);
+  uint64_t old_head = __atomic_load_n(&Q->head, __ATOMIC_RELAXED);
+  uint64_t new_head;
+  uint32_t old_slot;
+
+  do {
+    old_slot = (uint32_t)(old_head & GKI_FREEQ_SLOT_MASK);
+    __atomic_store_n(&p_last->p_next,
+                     old_slot ? gki_freeq_hdr(id, old_slot) : NULL,
+                     __ATOMIC_RELAXED);
+    new_head = ((old_head & ~GKI_FREEQ_SLOT_MASK) + GKI_FREEQ_TAG_INC) | slot;
+  } while (!__atomic_compare_exchange_n(&Q->head, &old_head, new_head, true,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
 /*******************************************************************************
 **
 ** Function         gki_init_free_queue
@@ -66,11 +197,15 @@ static void gki_init_free_queue(uint8_t id, uint16_t size, uint16_t total,
   p_cb->freeq[id].total = total;
   p_cb->freeq[id].cur_cnt = 0;
   p_cb->freeq[id].max_cnt = 0;
+  p_cb->freeq[id].cache_cnt = 0;
+  p_cb->freeq[id].head = 0;
+
+  /* Buffers cached by threads for a previous incarnation are now invalid */
+  __atomic_add_fetch(&gki_pool_gen[id], 1, __ATOMIC_RELEASE);
 
   /* Initialize  index table */
   if (p_mem) {
     hdr = (BUFFER_HDR_T*)p_mem;
-    p_cb->freeq[id].p_first = hdr;
     for (i = 0; i < total; i++) {
       hdr->task_id = GKI_INVALID_TASK;
       hdr->q_id = id;
@@ -81,9 +216,10 @@ static void gki_init_free_queue(uint8_t id, uint16_t size, uint16_t total,
       hdr = (BUFFER_HDR_T*)((uint8_t*)hdr + act_size);
       hdr1->p_next = hdr;
     }
-    if (hdr1 != NULL) hdr = hdr1;
-    hdr->p_next = NULL;
-    p_cb->freeq[id].p_last = hdr;
+    if (hdr1 != NULL) {
+      hdr1->p_next = NULL;
+      __atomic_store_n(&p_cb->freeq[id].head, (uint64_t)1, __ATOMIC_RELEASE);
+    }
   }
   return;
 }
@@ -91,20 +227,250 @@ static void gki_init_free_queue(uint8_t id, uint16_t size, uint16_t total,
 static bool gki_alloc_free_queue(uint8_t id) {
   FREE_QUEUE_T* Q;
   tGKI_COM_CB* p_cb = &gki_cb.com;
+  bool status = true;
 
-  Q = &p_cb->freeq[p_cb->pool_list[id]];
+  GKI_disable();
+
+  Q = &p_cb->freeq[id];
 
-  if (Q->p_first == 0) {
+  if (p_cb->pool_start[id] == NULL) {
     void* p_mem = GKI_os_malloc((Q->size + BUFFER_PADDING_SIZE) * Q->total);
     if (p_mem) {
-// re-initialize the queue with allocated memory
+      // re-initialize the queue with allocated memory
       gki_init_free_queue(id, Q->size, Q->total, p_mem);
-      return true;
+    } else {
+      GKI_exception(GKI_ERROR_BUF_SIZE_TOOBIG,
+                    "gki_alloc_free_queue: Not enough memory");
+      status = false;
     }
-    GKI_exception(GKI_ERROR_BUF_SIZE_TOOBIG,
-                  "gki_alloc_free_queue: Not enough memory");
   }
-  return false;
+
+  GKI_enable();
+
+  return (status);
+}
+
+#if (GKI_BUF_CACHE_SIZE > 0)
+/*******************************************************************************
+**
+** Function         gki_buf_cache_get
+**
+** Description      Internal function to get the calling thread's cache for a
+**                  pool. Entries left over from a previous incarnation of the
+**                  pool are dropped.
+**
+** Returns          the cache, or NULL if the pool is not cached per thread
+**
+*******************************************************************************/
+static tGKI_BUF_CACHE_POOL* gki_buf_cache_get(uint8_t id) {
+  tGKI_BUF_CACHE_POOL* p_cache;
+  uint32_t gen;
+
+  if (gki_cb.com.freeq[id].total < GKI_BUF_CACHE_MIN_POOL) return (NULL);
+
+  p_cache = &gki_buf_cache.pool[id];
+  gen = __atomic_load_n(&gki_pool_gen[id], __ATOMIC_ACQUIRE);
+  if (p_cache->gen != gen) {
+    p_cache->gen = gen;
+    p_cache->count = 0;
+  }
+
+  return (p_cache);
+}
+
+/*******************************************************************************
+**
+** Function         gki_buf_cache_reserve
+**
+** Description      Internal function to account for num buffers about to be
+**                  parked in a thread cache, bounded by the pool share.
+**
+** Returns          true if the buffers may be cached
+**
+*******************************************************************************/
+static bool gki_buf_cache_reserve(FREE_QUEUE_T* Q, uint16_t num) {
+  uint16_t limit = Q->total / GKI_BUF_CACHE_POOL_SHARE;
+
+  if (__atomic_add_fetch(&Q->cache_cnt, num, __ATOMIC_RELAXED) <= limit)
+    return (true);
+
+  __atomic_sub_fetch(&Q->cache_cnt, num, __ATOMIC_RELAXED);
+  return (false);
+}
+
+/*******************************************************************************
+**
+** Function         gki_buf_cache_flush
+**
+** Description      Internal function to return the num most recently cached
+**                  buffers of a thread cache to the pool in one batch.
+**
+** Returns          void
+**
+*******************************************************************************/
+static void gki_buf_cache_flush(uint8_t id, tGKI_BUF_CACHE_POOL* p_cache,
+                                uint16_t num) {
+  uint16_t first = p_cache->count - num;
+  uint16_t xx;
+
+  if (num == 0) return;
+
+  for (xx = first; xx < p_cache->count - 1; xx++)
+    p_cache->p_buf[xx]->p_next = p_cache->p_buf[xx + 1];
+
+  gki_freeq_push(id, p_cache->p_buf[first], p_cache->p_buf[p_cache->count - 1]);
+
+  p_cache->count = first;
+  __atomic_sub_fetch(&gki_cb.com.freeq[id].cache_cnt, num, __ATOMIC_RELAXED);
+}
+
+GkiBufCache::~GkiBufCache() {
+  uint8_t id;
+
+  for (id = 0; id < GKI_NUM_TOTAL_BUF_POOLS; id++) {
+    if (pool[id].gen == __atomic_load_n(&gki_pool_gen[id], __ATOMIC_ACQUIRE))
+      gki_buf_cache_flush(id, &pool[id], pool[id].count);
+  }
+}
+#endif
+
+/*******************************************************************************
+**
+** Function         gki_pool_alloc
+**
+** Description      Internal function to take a free buffer out of a pool,
+**                  from the calling thread's cache first, refilling it in
+**                  batches from the lock-free free list.
+**
+** Returns          buffer header, or NULL if the pool is empty
+**
+*******************************************************************************/
+static BUFFER_HDR_T* gki_pool_alloc(uint8_t id) {
+  FREE_QUEUE_T* Q = &gki_cb.com.freeq[id];
+  BUFFER_HDR_T* p_hdr = NULL;
+  uint16_t cnt;
+
+#if (GKI_BUF_CACHE_SIZE > 0)
+  tGKI_BUF_CACHE_POOL* p_cache = gki_buf_cache_get(id);
+
+  if (p_cache) {
+    if ((p_cache->count == 0) &&
+        gki_buf_cache_reserve(Q, GKI_BUF_CACHE_BATCH)) {
+      cnt = gki_freeq_pop(id, p_cache->p_buf, GKI_BUF_CACHE_BATCH);
+      if (cnt < GKI_BUF_CACHE_BATCH)
+        __atomic_sub_fetch(&Q->cache_cnt, GKI_BUF_CACHE_BATCH - cnt,
+                           __ATOMIC_RELAXED);
+      p_cache->count = cnt;
+    }
+
+    if (p_cache->count) {
+      p_hdr = p_cache->p_buf[--p_cache->count];
+      __atomic_sub_fetch(&Q->cache_cnt, 1, __ATOMIC_RELAXED);
+    }
+  }
+#endif
+
+  if ((p_hdr == NULL) && (gki_freeq_pop(id, &p_hdr, 1) == 0)) {
+    /* Pool memory may not have been allocated yet */
+    if ((gki_cb.com.pool_start[id] != NULL) || (Q->total == 0) ||
+        !gki_alloc_free_queue(id) || (gki_freeq_pop(id, &p_hdr, 1) == 0))
+      return (NULL);
+  }
+
+  cnt = __atomic_add_fetch(&Q->cur_cnt, 1, __ATOMIC_RELAXED);
+  uint16_t max_cnt = __atomic_load_n(&Q->max_cnt, __ATOMIC_RELAXED);
+  while ((cnt > max_cnt) &&
+         !__atomic_compare_exchange_n(&Q->max_cnt, &max_cnt, cnt, true,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+
+  return (p_hdr);
+}
+
+/*******************************************************************************
+**
+** Function         gki_pool_free
+**
+** Description      Internal function to give a buffer back to its pool, via
+**                  the calling thread's cache when there is room for it.
+**
+** Returns          void
+**
+*******************************************************************************/
+static void gki_pool_free(uint8_t id, BUFFER_HDR_T* p_hdr) {
+  FREE_QUEUE_T* Q = &gki_cb.com.freeq[id];
+  uint16_t cnt = __atomic_load_n(&Q->cur_cnt, __ATOMIC_RELAXED);
+
+  while ((cnt > 0) &&
+         !__atomic_compare_exchange_n(&Q->cur_cnt, &cnt, cnt - 1, true,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+
+#if (GKI_BUF_CACHE_SIZE > 0)
+  tGKI_BUF_CACHE_POOL* p_cache = gki_buf_cache_get(id);
+
+  if (p_cache) {
+    if (p_cache->count == GKI_BUF_CACHE_SIZE)
+      gki_buf_cache_flush(id, p_cache, GKI_BUF_CACHE_BATCH);
+
+    if (gki_buf_cache_reserve(Q, 1)) {
+      p_cache->p_buf[p_cache->count++] = p_hdr;
+      return;
+    }
+  }
+#endif
+
+  gki_freeq_push(id, p_hdr, p_hdr);
+}
+
+/*******************************************************************************
+**
+** Function         gki_build_size_classes
+**
+** Description      Internal function to precompute, from the configured pool
+**                  sizes and permissions, the pool GKI_getbuf() starts with
+**                  for every size class and the chain of larger public pools
+**                  it falls back to when that pool is exhausted. Called
+**                  whenever pools are created, deleted or change permission;
+**                  pool configuration is not expected to race with itself.
+**
+** Returns          void
+**
+*******************************************************************************/
+static void gki_build_size_classes(void) {
+  tGKI_COM_CB* p_cb = &gki_cb.com;
+  uint8_t order[GKI_NUM_TOTAL_BUF_POOLS];
+  uint8_t num = 0;
+  uint8_t xx, yy, id;
+  uint32_t cls;
+
+  /* Public pools holding buffers, sorted by size */
+  for (xx = 0; xx < p_cb->curr_total_no_of_pools; xx++) {
+    id = p_cb->pool_list[xx];
+    if ((((uint16_t)1 << id) & p_cb->pool_access_mask) ||
+        (p_cb->freeq[id].total == 0))
+      continue;
+
+    for (yy = num; (yy > 0) &&
+                   (p_cb->freeq[order[yy - 1]].size > p_cb->freeq[id].size);
+         yy--)
+      order[yy] = order[yy - 1];
+    order[yy] = id;
+    num++;
+  }
+
+  for (xx = 0; xx < GKI_NUM_TOTAL_BUF_POOLS; xx++)
+    p_cb->pool_fallback[xx] = GKI_INVALID_POOL;
+
+  for (xx = 0; xx + 1 < num; xx++) p_cb->pool_fallback[order[xx]] = order[xx + 1];
+
+  /* Each class maps to the first pool that holds its smallest size */
+  for (cls = 0, xx = 0; cls < GKI_NUM_SIZE_CLASSES; cls++) {
+    while ((xx < num) &&
+           (p_cb->freeq[order[xx]].size < (cls << GKI_SIZE_CLASS_SHIFT) + 1))
+      xx++;
+    p_cb->size_class_pool[cls] = (xx < num) ? order[xx] : GKI_INVALID_POOL;
+  }
 }
 
 /*******************************************************************************
@@ -124,8 +490,9 @@ void gki_buffer_init(void) {
   /* Initialize mailboxes */
   for (tt = 0; tt < GKI_MAX_TASKS; tt++) {
     for (mb = 0; mb < NUM_TASK_MBOX; mb++) {
-      p_cb->OSTaskQFirst[tt][mb] = NULL;
-      p_cb->OSTaskQLast[tt][mb] = NULL;
+      p_cb->OSTaskQStub[tt][mb].p_next = NULL;
+      p_cb->OSTaskQFirst[tt][mb] = &p_cb->OSTaskQStub[tt][mb];
+      p_cb->OSTaskQLast[tt][mb] = &p_cb->OSTaskQStub[tt][mb];
     }
   }
 
@@ -134,12 +501,12 @@ void gki_buffer_init(void) {
     p_cb->pool_end[tt] = NULL;
     p_cb->pool_size[tt] = 0;
 
-    p_cb->freeq[tt].p_first = 0;
-    p_cb->freeq[tt].p_last = 0;
+    p_cb->freeq[tt].head = 0;
     p_cb->freeq[tt].size = 0;
     p_cb->freeq[tt].total = 0;
     p_cb->freeq[tt].cur_cnt = 0;
     p_cb->freeq[tt].max_cnt = 0;
+    p_cb->freeq[tt].cache_cnt = 0;
   }
 
   /* Use default from target.h */
@@ -216,6 +583,8 @@ void gki_buffer_init(void) {
 
   p_cb->curr_total_no_of_pools = GKI_NUM_FIXED_BUF_POOLS;
 
+  gki_build_size_classes();
+
   return;
 }
 
@@ -252,8 +621,7 @@ void GKI_init_q(BUFFER_Q* p_q) {
 **
 *******************************************************************************/
 void* GKI_getbuf(uint16_t size) {
-  uint8_t i;
-  FREE_QUEUE_T* Q;
+  uint8_t pool_id;
   BUFFER_HDR_T* p_hdr;
   tGKI_COM_CB* p_cb = &gki_cb.com;
 
@@ -262,49 +630,25 @@ void* GKI_getbuf(uint16_t size) {
     return (NULL);
   }
 
-  /* Find the first buffer pool that is public that can hold the desired size */
-  for (i = 0; i < p_cb->curr_total_no_of_pools; i++) {
-    if (size <= p_cb->freeq[p_cb->pool_list[i]].size) break;
-  }
-
-  if (i == p_cb->curr_total_no_of_pools) {
+  if (size > MAX_USER_BUF_SIZE) {
     GKI_exception(GKI_ERROR_BUF_SIZE_TOOBIG, "getbuf: Size is too big");
     return (NULL);
   }
 
-  /* Make sure the buffers aren't disturbed til finished with allocation */
-  GKI_disable();
-
-  /* search the public buffer pools that are big enough to hold the size
-   * until a free buffer is found */
-  for (; i < p_cb->curr_total_no_of_pools; i++) {
-    /* Only look at PUBLIC buffer pools (bypass RESTRICTED pools) */
-    if (((uint16_t)1 << p_cb->pool_list[i]) & p_cb->pool_access_mask) continue;
-
-    Q = &p_cb->freeq[p_cb->pool_list[i]];
-    if (Q->cur_cnt < Q->total) {
-      if (Q->p_first == 0 && gki_alloc_free_queue(i) != true) {
-        LOG(ERROR) << StringPrintf("out of buffer");
-        GKI_enable();
-        return NULL;
-      }
-
-      if (Q->p_first == 0) {
-        /* gki_alloc_free_queue() failed to alloc memory */
-        LOG(ERROR) << StringPrintf("fail alloc free queue");
-        GKI_enable();
-        return NULL;
-      }
-
-      p_hdr = Q->p_first;
-      Q->p_first = p_hdr->p_next;
-
-      if (!Q->p_first) Q->p_last = NULL;
+  /* Start with the smallest public pool that can hold the desired size */
+  pool_id = p_cb->size_class_pool[GKI_SIZE_CLASS(size)];
+  while ((pool_id != GKI_INVALID_POOL) && (size > p_cb->freeq[pool_id].size))
+    pool_id = p_cb->pool_fallback[pool_id];
 
-      if (++Q->cur_cnt > Q->max_cnt) Q->max_cnt = Q->cur_cnt;
-
-      GKI_enable();
+  if (pool_id == GKI_INVALID_POOL) {
+    GKI_exception(GKI_ERROR_BUF_SIZE_TOOBIG, "getbuf: Size is too big");
+    return (NULL);
+  }
 
+  /* walk the larger public buffer pools until a free buffer is found */
+  for (; pool_id != GKI_INVALID_POOL; pool_id = p_cb->pool_fallback[pool_id]) {
+    p_hdr = gki_pool_alloc(pool_id);
+    if (p_hdr) {
       p_hdr->task_id = GKI_get_taskid();
 
       p_hdr->status = BUF_STATUS_UNLINKED;
@@ -316,8 +660,6 @@ void* GKI_getbuf(uint16_t size) {
 
   LOG(ERROR) << StringPrintf("unable to allocate buffer!!!!!");
 
-  GKI_enable();
-
   return (NULL);
 }
 
@@ -338,34 +680,13 @@ void* GKI_getbuf(uint16_t size) {
 **
 *******************************************************************************/
 void* GKI_getpoolbuf(uint8_t pool_id) {
-  FREE_QUEUE_T* Q;
   BUFFER_HDR_T* p_hdr;
   tGKI_COM_CB* p_cb = &gki_cb.com;
 
   if (pool_id >= GKI_NUM_TOTAL_BUF_POOLS) return (NULL);
 
-  /* Make sure the buffers aren't disturbed til finished with allocation */
-  GKI_disable();
-
-  Q = &p_cb->freeq[pool_id];
-  if (Q->cur_cnt < Q->total) {
-    if (Q->p_first == 0 && gki_alloc_free_queue(pool_id) != true) return NULL;
-
-    if (Q->p_first == 0) {
-      /* gki_alloc_free_queue() failed to alloc memory */
-      LOG(ERROR) << StringPrintf("fail alloc free queue");
-      return NULL;
-    }
-
-    p_hdr = Q->p_first;
-    Q->p_first = p_hdr->p_next;
-
-    if (!Q->p_first) Q->p_last = NULL;
-
-    if (++Q->cur_cnt > Q->max_cnt) Q->max_cnt = Q->cur_cnt;
-
-    GKI_enable();
-
+  p_hdr = gki_pool_alloc(pool_id);
+  if (p_hdr) {
     p_hdr->task_id = GKI_get_taskid();
 
     p_hdr->status = BUF_STATUS_UNLINKED;
@@ -376,7 +697,7 @@ void* GKI_getpoolbuf(uint8_t pool_id) {
   }
 
   /* If here, no buffers in the specified pool */
-  GKI_enable();
+  if (p_cb->freeq[pool_id].size == 0) return (NULL);
 
   /* try for free buffers in public pools */
   return (GKI_getbuf(p_cb->freeq[pool_id].size));
@@ -395,7 +716,6 @@ void* GKI_getpoolbuf(uint8_t pool_id) {
 **
 *******************************************************************************/
 void GKI_freebuf(void* p_buf) {
-  FREE_QUEUE_T* Q;
   BUFFER_HDR_T* p_hdr;
 
 #if (GKI_ENABLE_BUF_CORRUPTION_CHECK == true)
@@ -417,24 +737,13 @@ void GKI_freebuf(void* p_buf) {
     return;
   }
 
-  GKI_disable();
-
   /*
   ** Release the buffer
   */
-  Q = &gki_cb.com.freeq[p_hdr->q_id];
-  if (Q->p_last)
-    Q->p_last->p_next = p_hdr;
-  else
-    Q->p_first = p_hdr;
-
-  Q->p_last = p_hdr;
-  p_hdr->p_next = NULL;
   p_hdr->status = BUF_STATUS_FREE;
   p_hdr->task_id = GKI_INVALID_TASK;
-  if (Q->cur_cnt > 0) Q->cur_cnt--;
 
-  GKI_enable();
+  gki_pool_free(p_hdr->q_id, p_hdr);
 
   return;
 }
@@ -497,6 +806,99 @@ bool gki_chk_buf_damage(void* p_buf) {
 #endif
 }
 
+/*******************************************************************************
+**
+** Function         gki_mbox_push
+**
+** Description      Internal function to append a buffer to a task mailbox.
+**                  Safe to call from any number of threads concurrently.
+**
+** Returns          void
+**
+*******************************************************************************/
+static void gki_mbox_push(uint8_t task_id, uint8_t mbox, BUFFER_HDR_T* p_hdr) {
+  BUFFER_HDR_T* p_prev;
+
+  __atomic_store_n(&p_hdr->p_next, (BUFFER_HDR_T*)NULL, __ATOMIC_RELAXED);
+  p_prev = __atomic_exchange_n(&gki_cb.com.OSTaskQLast[task_id][mbox], p_hdr,
+                               __ATOMIC_ACQ_REL);
+  /* Until this store the reader cannot see p_hdr, nor anything queued after
+   * it; the sender signals the task afterwards so nothing is lost */
+  __atomic_store_n(&p_prev->p_next, p_hdr, __ATOMIC_RELEASE);
+}
+
+/*******************************************************************************
+**
+** Function         gki_mbox_pop
+**
+** Description      Internal function to take the first buffer out of a task
+**                  mailbox. Must only be called by the task owning the
+**                  mailbox.
+**
+** Returns          buffer header, or NULL if no complete message is queued
+**
+*******************************************************************************/
+static BUFFER_HDR_T* gki_mbox_pop(uint8_t task_id, uint8_t mbox) {
+  tGKI_COM_CB* p_cb = &gki_cb.com;
+  BUFFER_HDR_T* p_stub = &p_cb->OSTaskQStub[task_id][mbox];
+  BUFFER_HDR_T* p_first = p_cb->OSTaskQFirst[task_id][mbox];
+  BUFFER_HDR_T* p_next = __atomic_load_n(&p_first->p_next, __ATOMIC_ACQUIRE);
+
+  if (p_first == p_stub) {
+    if (p_next == NULL) return (NULL);
+    p_cb->OSTaskQFirst[task_id][mbox] = p_next;
+    p_first = p_next;
+    p_next = __atomic_load_n(&p_next->p_next, __ATOMIC_ACQUIRE);
+  }
+
+  if (p_next) {
+    p_cb->OSTaskQFirst[task_id][mbox] = p_next;
+    return (p_first);
+  }
+
+  /* A sender is half way through appending behind p_first */
+  if (p_first !=
+      __atomic_load_n(&p_cb->OSTaskQLast[task_id][mbox], __ATOMIC_ACQUIRE))
+    return (NULL);
+
+  /* p_first is the last message, requeue the stub so it can be unlinked */
+  gki_mbox_push(task_id, mbox, p_stub);
+
+  p_next = __atomic_load_n(&p_first->p_next, __ATOMIC_ACQUIRE);
+  if (p_next) {
+    p_cb->OSTaskQFirst[task_id][mbox] = p_next;
+    return (p_first);
+  }
+
+  return (NULL);
+}
+
+/*******************************************************************************
+**
+** Function         gki_mbox_pending
+**
+** Description      Internal function to check which mailboxes of a task hold
+**                  messages.
+**
+** Returns          mailbox event mask of the non-empty mailboxes
+**
+*******************************************************************************/
+uint16_t gki_mbox_pending(uint8_t task_id) {
+  tGKI_COM_CB* p_cb = &gki_cb.com;
+  uint16_t mask = 0;
+  uint8_t mbox;
+
+  for (mbox = 0; mbox < NUM_TASK_MBOX; mbox++) {
+    BUFFER_HDR_T* p_first = p_cb->OSTaskQFirst[task_id][mbox];
+
+    if ((p_first != &p_cb->OSTaskQStub[task_id][mbox]) ||
+        __atomic_load_n(&p_first->p_next, __ATOMIC_ACQUIRE))
+      mask |= EVENT_MASK(mbox);
+  }
+
+  return (mask);
+}
+
 /*******************************************************************************
 **
 ** Function         GKI_send_msg
@@ -532,20 +934,10 @@ void GKI_send_msg(uint8_t task_id, uint8_t mbox, void* msg) {
     return;
   }
 
-  GKI_disable();
-
-  if (p_cb->OSTaskQFirst[task_id][mbox])
-    p_cb->OSTaskQLast[task_id][mbox]->p_next = p_hdr;
-  else
-    p_cb->OSTaskQFirst[task_id][mbox] = p_hdr;
-
-  p_cb->OSTaskQLast[task_id][mbox] = p_hdr;
-
-  p_hdr->p_next = NULL;
   p_hdr->status = BUF_STATUS_QUEUED;
   p_hdr->task_id = task_id;
 
-  GKI_enable();
+  gki_mbox_push(task_id, mbox, p_hdr);
 
   GKI_send_event(task_id, (uint16_t)EVENT_MASK(mbox));
 
@@ -571,20 +963,14 @@ void* GKI_read_mbox(uint8_t mbox) {
 
   if ((task_id >= GKI_MAX_TASKS) || (mbox >= NUM_TASK_MBOX)) return (NULL);
 
-  GKI_disable();
-
-  if (gki_cb.com.OSTaskQFirst[task_id][mbox]) {
-    p_hdr = gki_cb.com.OSTaskQFirst[task_id][mbox];
-    gki_cb.com.OSTaskQFirst[task_id][mbox] = p_hdr->p_next;
-
+  p_hdr = gki_mbox_pop(task_id, mbox);
+  if (p_hdr) {
     p_hdr->p_next = NULL;
     p_hdr->status = BUF_STATUS_UNLINKED;
 
     p_buf = (uint8_t*)p_hdr + BUFFER_HDR_SIZE;
   }
 
-  GKI_enable();
-
   return (p_buf);
 }
 
@@ -916,6 +1302,8 @@ uint8_t GKI_set_pool_permission(uint8_t pool_id, uint8_t permission) {
       p_cb->pool_access_mask =
           (uint16_t)(p_cb->pool_access_mask & ~(1 << pool_id));
 
+    gki_build_size_classes();
+
     return (GKI_SUCCESS);
   } else
     return (GKI_INVALID_POOL);
@@ -1001,7 +1389,8 @@ uint16_t GKI_poolcount(uint8_t pool_id) {
 ** Function         GKI_poolfreecount
 **
 ** Description      Called by an application to get the number of free buffers
-**                  in the specified buffer pool.
+**                  in the specified buffer pool. Free buffers parked in the
+**                  per-thread caches are not counted, see GKI_poolcachecount.
 **
 ** Parameters       pool_id - (input) pool ID to get the free count of.
 **
@@ -1010,12 +1399,63 @@ uint16_t GKI_poolcount(uint8_t pool_id) {
 *******************************************************************************/
 uint16_t GKI_poolfreecount(uint8_t pool_id) {
   FREE_QUEUE_T* Q;
+  uint16_t used;
 
   if (pool_id >= GKI_NUM_TOTAL_BUF_POOLS) return (0);
 
   Q = &gki_cb.com.freeq[pool_id];
 
-  return ((uint16_t)(Q->total - Q->cur_cnt));
+  used = __atomic_load_n(&Q->cur_cnt, __ATOMIC_RELAXED) +
+         __atomic_load_n(&Q->cache_cnt, __ATOMIC_RELAXED);
+  if (used >= Q->total) return (0);
+
+  return ((uint16_t)(Q->total - used));
+}
+
+/*******************************************************************************
+**
+** Function         GKI_poolcachecount
+**
+** Description      Called by an application to get the number of free buffers
+**                  of the specified buffer pool that are parked in the
+**                  per-thread caches.
+**
+** Parameters       pool_id - (input) pool ID to get the cached count of.
+**
+** Returns          the number of cached buffers of the pool
+**
+*******************************************************************************/
+uint16_t GKI_poolcachecount(uint8_t pool_id) {
+  if (pool_id >= GKI_NUM_TOTAL_BUF_POOLS) return (0);
+
+  return (__atomic_load_n(&gki_cb.com.freeq[pool_id].cache_cnt,
+                          __ATOMIC_RELAXED));
+}
+
+/*******************************************************************************
+**
+** Function         GKI_dump_pools
+**
+** Description      Write the usage of each buffer pool to fd. Buffers parked
+**                  in the per-thread caches are reported separately from the
+**                  free buffers.
+**
+** Returns          void
+**
+*******************************************************************************/
+void GKI_dump_pools(int fd) {
+  for (uint8_t id = 0; id < GKI_NUM_TOTAL_BUF_POOLS; id++) {
+    FREE_QUEUE_T* Q = &gki_cb.com.freeq[id];
+
+    if (Q->total == 0) continue;
+    dprintf(fd,
+            "gki: pool %u (%u bytes): total %u, in use %u, cached %u, "
+            "free %u, high water %u\n",
+            id, Q->size, Q->total,
+            __atomic_load_n(&Q->cur_cnt, __ATOMIC_RELAXED),
+            GKI_poolcachecount(id), GKI_poolfreecount(id),
+            __atomic_load_n(&Q->max_cnt, __ATOMIC_RELAXED));
+  }
 }
 
 /*******************************************************************************
@@ -1081,17 +1521,11 @@ void GKI_isend_msg(uint8_t task_id, uint8_t mbox, void* msg) {
     return;
   }
 
-  if (p_cb->OSTaskQFirst[task_id][mbox])
-    p_cb->OSTaskQLast[task_id][mbox]->p_next = p_hdr;
-  else
-    p_cb->OSTaskQFirst[task_id][mbox] = p_hdr;
-
-  p_cb->OSTaskQLast[task_id][mbox] = p_hdr;
-
-  p_hdr->p_next = NULL;
   p_hdr->status = BUF_STATUS_QUEUED;
   p_hdr->task_id = task_id;
 
+  gki_mbox_push(task_id, mbox, p_hdr);
+
   GKI_isend_event(task_id, (uint16_t)EVENT_MASK(mbox));
 
   return;
@@ -1147,6 +1581,7 @@ uint8_t GKI_create_pool(uint16_t size, uint16_t count, uint8_t permission,
     gki_add_to_pool_list(xx);
     (void)GKI_set_pool_permission(xx, permission);
     p_cb->curr_total_no_of_pools++;
+    gki_build_size_classes();
 
     return (xx);
   } else
@@ -1182,8 +1617,11 @@ void GKI_delete_pool(uint8_t pool_id) {
     Q->total = 0;
     Q->cur_cnt = 0;
     Q->max_cnt = 0;
-    Q->p_first = NULL;
-    Q->p_last = NULL;
+    Q->cache_cnt = 0;
+    Q->head = 0;
+
+    /* Drop whatever threads still cache from this pool */
+    __atomic_add_fetch(&gki_pool_gen[pool_id], 1, __ATOMIC_RELEASE);
 
     GKI_os_free(p_cb->pool_start[pool_id]);
 
@@ -1193,6 +1631,7 @@ void GKI_delete_pool(uint8_t pool_id) {
 
     gki_remove_from_pool_list(pool_id);
     p_cb->curr_total_no_of_pools--;
+    gki_build_size_classes();
   } else
     GKI_exception(GKI_ERROR_DELETE_POOL_BAD_QID, "Deleting bad pool");
 
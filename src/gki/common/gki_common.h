@@ -76,14 +76,19 @@ typedef struct _buffer_hdr {
 } BUFFER_HDR_T;
 
 typedef struct _free_queue {
-  BUFFER_HDR_T* p_first; /* first buffer in the queue */
-  BUFFER_HDR_T* p_last;  /* last buffer in the queue */
-  uint16_t size;         /* size of the buffers in the pool */
-  uint16_t total;        /* toatal number of buffers */
-  uint16_t cur_cnt;      /* number of  buffers currently allocated */
-  uint16_t max_cnt;      /* maximum number of buffers allocated at any time */
+  uint64_t head;      /* lock-free free list head: ABA tag in the upper 32 bits,
+                         (buffer index + 1) in the lower 32 bits, 0 if empty */
+  uint16_t size;      /* size of the buffers in the pool */
+  uint16_t total;     /* toatal number of buffers */
+  uint16_t cur_cnt;   /* number of  buffers currently allocated */
+  uint16_t max_cnt;   /* maximum number of buffers allocated at any time */
+  uint16_t cache_cnt; /* number of free buffers parked in per-thread caches */
 } FREE_QUEUE_T;
 
+/* Free list head encoding */
+#define GKI_FREEQ_SLOT_MASK ((uint64_t)0xFFFFFFFF)
+#define GKI_FREEQ_TAG_INC ((uint64_t)1 << 32)
+
 /* Buffer related defines
 */
 #if (NXP_EXTNS == TRUE)
@@ -101,6 +106,11 @@ typedef struct _free_queue {
 #define MAX_USER_BUF_SIZE ((uint16_t)0xffff - BUFFER_PADDING_SIZE)
 #define MAGIC_NO 0xDDBADDBA
 
+/* Granularity of the GKI_getbuf() size to pool lookup table */
+#define GKI_SIZE_CLASS_SHIFT 5
+#define GKI_NUM_SIZE_CLASSES ((MAX_USER_BUF_SIZE >> GKI_SIZE_CLASS_SHIFT) + 1)
+#define GKI_SIZE_CLASS(size) (((size)-1) >> GKI_SIZE_CLASS_SHIFT)
+
 #define BUF_STATUS_FREE 0
 #define BUF_STATUS_UNLINKED 1
 #define BUF_STATUS_QUEUED 2
@@ -246,6 +256,10 @@ typedef struct {
 #endif
 
   /* Buffer related variables
+  ** Task mailboxes are intrusive multi-producer/single-consumer queues:
+  ** senders atomically swap themselves into OSTaskQLast, only the owning
+  ** task advances OSTaskQFirst. Each mailbox owns a stub node so that the
+  ** queue never becomes truly empty.
   */
   BUFFER_HDR_T*
       OSTaskQFirst[GKI_MAX_TASKS][NUM_TASK_MBOX]; /* array of pointers to the
@@ -255,6 +269,7 @@ typedef struct {
       OSTaskQLast[GKI_MAX_TASKS][NUM_TASK_MBOX]; /* array of pointers to the
                                                     last event in the task
                                                     mailbox */
+  BUFFER_HDR_T OSTaskQStub[GKI_MAX_TASKS][NUM_TASK_MBOX]; /* mailbox stubs */
 
   /* Define the buffer pool management variables
   */
@@ -284,6 +299,11 @@ typedef struct {
   uint8_t
       curr_total_no_of_pools; /* number of fixed buf pools + current number of
                                  dynamic pools */
+  uint8_t size_class_pool[GKI_NUM_SIZE_CLASSES]; /* smallest public pool able
+                                                    to hold each size class */
+  uint8_t pool_fallback[GKI_NUM_TOTAL_BUF_POOLS]; /* next larger public pool
+                                                     to try when a pool is
+                                                     exhausted */
 
   bool timer_nesting; /* flag to prevent timer interrupt nesting */
 
@@ -302,6 +322,7 @@ typedef struct {
 extern bool gki_chk_buf_damage(void*);
 extern bool gki_chk_buf_owner(void*);
 extern void gki_buffer_init(void);
+extern uint16_t gki_mbox_pending(uint8_t task_id);
 extern void gki_timers_init(void);
 extern void gki_adjust_timer_count(int32_t);
 
@@ -30,6 +30,11 @@
 #define GKI_UNUSED_LIST_ENTRY (0x80000000L)
 #define GKI_MAX_INT32 (0x7fffffffL)
 
+#if (GKI_TIMER_WHEEL_BITS > 5 || \
+     GKI_TIMER_WHEEL_BITS * GKI_TIMER_WHEEL_LEVELS > 30)
+#error GKI timer wheel too large
+#endif
+
 using android::base::StringPrintf;
 
 extern bool nfc_debug_enabled;
@@ -140,7 +145,15 @@ bool gki_timers_is_timer_running(void) {
 ** Returns          The current number of system ticks
 **
 *******************************************************************************/
-uint32_t GKI_get_tick_count(void) { return gki_cb.com.OSTicks; }
+uint32_t GKI_get_tick_count(void) {
+  uint32_t ticks;
+
+  /* the timer service only advances the tick count when a timer is due */
+  GKI_disable();
+  ticks = gki_cb.com.OSTicks + gki_timer_elapsed();
+  GKI_enable();
+  return ticks;
+}
 
 /*******************************************************************************
 **
@@ -185,18 +198,23 @@ int32_t GKI_ready_to_sleep(void) { return (gki_cb.com.OSTicksTilExp); }
 void GKI_start_timer(uint8_t tnum, int32_t ticks, bool is_continuous) {
   int32_t reload;
   int32_t orig_ticks;
+  int32_t elapsed;
   uint8_t task_id = GKI_get_taskid();
 
-  /*if task_id doesnt found in the array, use default task id 14*/
-  if(task_id == 255) {
-    task_id = 14;
+  /* A registered thread has no timers and could not get their events */
+  if (task_id >= GKI_FOREIGN_TASK_BASE && task_id != (uint8_t)-1) {
+    LOG(ERROR) << StringPrintf("%s: thread %d is not a GKI task", __func__,
+                               task_id);
+    return;
+  }
+  /*if task_id doesnt found in the array, use the timers of the last task*/
+  if (task_id >= GKI_MAX_TASKS) {
+    task_id = GKI_MAX_TASKS - 1;
   }
   bool bad_timer = false;
 
   if (ticks <= 0) ticks = 1;
 
-  orig_ticks = ticks; /* save the ticks in case adjustment is necessary */
-
   /* If continuous timer, set reload, else set it to 0 */
   if (is_continuous)
     reload = ticks;
@@ -206,6 +224,8 @@ void GKI_start_timer(uint8_t tnum, int32_t ticks, bool is_continuous) {
   GKI_disable();
 
   if (gki_timers_is_timer_running() == false) {
+    /* Nothing to expire, the last update can be moved up to now */
+    gki_timer_rebase();
 #if (GKI_DELAY_STOP_SYS_TICK > 0)
     /* if inactivity delay timer is not running, start system tick */
     if (gki_cb.com.OSTicksTilStop == 0) {
@@ -222,6 +242,16 @@ void GKI_start_timer(uint8_t tnum, int32_t ticks, bool is_continuous) {
     }
 #endif
   }
+  /* The timer service has not counted the ticks since its last update yet,
+  ** and will take them off this timer too.
+  */
+  elapsed = (int32_t)gki_timer_elapsed();
+  if (GKI_MAX_INT32 - elapsed > ticks) {
+    ticks += elapsed;
+  } else
+    ticks = GKI_MAX_INT32;
+  orig_ticks = ticks; /* save the ticks in case adjustment is necessary */
+
   /* Add the time since the last task timer update.
   ** Note that this works when no timers are active since
   ** both OSNumOrigTicks and OSTicksTilExp are 0.
@@ -269,6 +299,7 @@ void GKI_start_timer(uint8_t tnum, int32_t ticks, bool is_continuous) {
     /* Only update the timeout value if it is less than any other newly started
      * timers */
     gki_adjust_timer_count(orig_ticks);
+    gki_timer_arm();
   }
 
   GKI_enable();
@@ -290,9 +321,15 @@ void GKI_start_timer(uint8_t tnum, int32_t ticks, bool is_continuous) {
 void GKI_stop_timer(uint8_t tnum) {
   uint8_t task_id = GKI_get_taskid();
 
-    /*if task_id doesnt found in the array, use default task id 14*/
-  if(task_id == 255) {
-    task_id = 14;
+  /* A registered thread has no timers and could not get their events */
+  if (task_id >= GKI_FOREIGN_TASK_BASE && task_id != (uint8_t)-1) {
+    LOG(ERROR) << StringPrintf("%s: thread %d is not a GKI task", __func__,
+                               task_id);
+    return;
+  }
+  /*if task_id doesnt found in the array, use the timers of the last task*/
+  if (task_id >= GKI_MAX_TASKS) {
+    task_id = GKI_MAX_TASKS - 1;
   }
   GKI_disable();
 
@@ -335,6 +372,7 @@ void GKI_stop_timer(uint8_t tnum) {
         /* set inactivity delay timer */
         /* when timer expires, system tick will be stopped */
         gki_cb.com.OSTicksTilStop = GKI_DELAY_STOP_SYS_TICK;
+        gki_timer_arm();
       }
 #else
       gki_cb.com.system_tick_running = false;
@@ -580,6 +618,180 @@ void GKI_timer_queue_register_callback(SYSTEM_TICK_CBACK* p_callback) {
   return;
 }
 
+/*******************************************************************************
+**
+** Function         gki_timer_list_append
+**
+** Description      Appends an entry to a wheel slot or to the expired list.
+**                  The lists are linked through p_next, and the p_prev of the
+**                  head points to the tail so appending is O(1).
+**
+** Returns          void
+**
+*******************************************************************************/
+static void gki_timer_list_append(TIMER_LIST_ENT** pp_head,
+                                  TIMER_LIST_ENT* p_tle) {
+  TIMER_LIST_ENT* p_head = *pp_head;
+
+  p_tle->p_next = NULL;
+  if (p_head == NULL) {
+    p_tle->p_prev = p_tle;
+    *pp_head = p_tle;
+  } else {
+    p_tle->p_prev = p_head->p_prev;
+    p_head->p_prev->p_next = p_tle;
+    p_head->p_prev = p_tle;
+  }
+}
+
+/*******************************************************************************
+**
+** Function         gki_timer_list_unlink
+**
+** Description      Removes an entry from a wheel slot or from the expired
+**                  list.
+**
+** Returns          void
+**
+*******************************************************************************/
+static void gki_timer_list_unlink(TIMER_LIST_ENT** pp_head,
+                                  TIMER_LIST_ENT* p_tle) {
+  TIMER_LIST_ENT* p_head = *pp_head;
+
+  if (p_tle == p_head) {
+    *pp_head = p_tle->p_next;
+    if (p_tle->p_next != NULL) p_tle->p_next->p_prev = p_tle->p_prev;
+  } else {
+    p_tle->p_prev->p_next = p_tle->p_next;
+    if (p_tle->p_next != NULL)
+      p_tle->p_next->p_prev = p_tle->p_prev;
+    else
+      p_head->p_prev = p_tle->p_prev;
+  }
+  p_tle->p_next = p_tle->p_prev = NULL;
+}
+
+/*******************************************************************************
+**
+** Function         gki_timer_list_set_first
+**
+** Description      Points p_first at the first expired entry, or at a running
+**                  entry of the lowest non-empty wheel level.
+**
+** Returns          void
+**
+*******************************************************************************/
+static void gki_timer_list_set_first(TIMER_LIST_Q* p_timer_listq) {
+  uint8_t level;
+
+  p_timer_listq->p_first = p_timer_listq->p_expired;
+  if (p_timer_listq->p_first != NULL || p_timer_listq->num_running == 0)
+    return;
+
+  for (level = 0; level < GKI_TIMER_WHEEL_LEVELS; level++) {
+    if (p_timer_listq->slot_mask[level]) {
+      p_timer_listq->p_first =
+          p_timer_listq->p_slot[level]
+                               [__builtin_ctz(p_timer_listq->slot_mask[level])];
+      return;
+    }
+  }
+}
+
+/*******************************************************************************
+**
+** Function         gki_timer_list_expire
+**
+** Description      Moves an entry to the tail of the expired list.
+**
+** Returns          void
+**
+*******************************************************************************/
+static void gki_timer_list_expire(TIMER_LIST_Q* p_timer_listq,
+                                  TIMER_LIST_ENT* p_tle) {
+  /* Expired entries have 0 ticks, the legacy code checks for it */
+  p_tle->ticks = 0;
+  p_tle->slot = GKI_TIMER_SLOT_EXPIRED;
+  gki_timer_list_append(&p_timer_listq->p_expired, p_tle);
+  p_timer_listq->num_expired++;
+}
+
+/*******************************************************************************
+**
+** Function         gki_timer_list_place
+**
+** Description      Puts a running entry into the wheel slot for its expiry.
+**                  Level n holds the entries that expire within
+**                  2^(GKI_TIMER_WHEEL_BITS * (n + 1)) units, so the entries
+**                  of a level 0 slot all expire at the same time. Entries
+**                  beyond the wheel go into the top level slot furthest away
+**                  and are placed again when that slot is reached.
+**
+** Returns          void
+**
+*******************************************************************************/
+static void gki_timer_list_place(TIMER_LIST_Q* p_timer_listq,
+                                 TIMER_LIST_ENT* p_tle) {
+  uint32_t delta = p_tle->expiry - p_timer_listq->now;
+  uint32_t expiry = p_tle->expiry;
+  uint8_t level;
+  uint8_t slot;
+
+  if ((int32_t)delta <= 0) {
+    gki_timer_list_expire(p_timer_listq, p_tle);
+    return;
+  }
+
+  for (level = 0; level < GKI_TIMER_WHEEL_LEVELS - 1; level++) {
+    if (delta < (1u << (GKI_TIMER_WHEEL_BITS * (level + 1)))) break;
+  }
+  if (delta >= (1u << (GKI_TIMER_WHEEL_BITS * GKI_TIMER_WHEEL_LEVELS))) {
+    expiry = p_timer_listq->now +
+             (1u << (GKI_TIMER_WHEEL_BITS * GKI_TIMER_WHEEL_LEVELS)) - 1;
+  }
+
+  slot = (expiry >> (GKI_TIMER_WHEEL_BITS * level)) & GKI_TIMER_WHEEL_MASK;
+  p_tle->slot = level * GKI_TIMER_WHEEL_SLOTS + slot;
+  gki_timer_list_append(&p_timer_listq->p_slot[level][slot], p_tle);
+  p_timer_listq->slot_mask[level] |= (1u << slot);
+  p_timer_listq->num_running++;
+}
+
+/*******************************************************************************
+**
+** Function         gki_timer_list_cascade
+**
+** Description      Called when the list time reaches the start of the current
+**                  slot of a level. The entries of that slot are placed again,
+**                  which moves them to a lower level or expires them.
+**
+** Returns          void
+**
+*******************************************************************************/
+static void gki_timer_list_cascade(TIMER_LIST_Q* p_timer_listq, uint8_t level) {
+  TIMER_LIST_ENT* p_tle;
+  TIMER_LIST_ENT* p_next;
+  uint8_t slot;
+
+  if (level >= GKI_TIMER_WHEEL_LEVELS) return;
+
+  slot = (p_timer_listq->now >> (GKI_TIMER_WHEEL_BITS * level)) &
+         GKI_TIMER_WHEEL_MASK;
+  if (slot == 0) gki_timer_list_cascade(p_timer_listq, level + 1);
+
+  if (!(p_timer_listq->slot_mask[level] & (1u << slot))) return;
+
+  p_tle = p_timer_listq->p_slot[level][slot];
+  p_timer_listq->p_slot[level][slot] = NULL;
+  p_timer_listq->slot_mask[level] &= ~(1u << slot);
+
+  for (; p_tle != NULL; p_tle = p_next) {
+    p_next = p_tle->p_next;
+    p_timer_listq->num_running--;
+    gki_timer_list_place(p_timer_listq, p_tle);
+  }
+}
+
 /*******************************************************************************
 **
 ** Function         GKI_init_timer_list
@@ -594,9 +806,7 @@ void GKI_timer_queue_register_callback(SYSTEM_TICK_CBACK* p_callback) {
 **
 *******************************************************************************/
 void GKI_init_timer_list(TIMER_LIST_Q* p_timer_listq) {
-  p_timer_listq->p_first = NULL;
-  p_timer_listq->p_last = NULL;
-  p_timer_listq->last_ticks = 0;
+  memset(p_timer_listq, 0, sizeof(TIMER_LIST_Q));
 
   return;
 }
@@ -630,6 +840,10 @@ void GKI_init_timer_list_entry(TIMER_LIST_ENT* p_tle) {
 **                  timer list unit tick, e.g. once per sec, once per minute
 **                  etc.
 **
+**                  The list time only stops at the level 0 slots that hold
+**                  entries and at level 0 wrap-arounds, where higher levels
+**                  cascade. Each entry is moved at most once per level.
+**
 ** Parameters       p_timer_listq - (input) pointer to the timer list queue
 **                  object
 **                  num_units_since_last_update - (input) number of units since
@@ -644,52 +858,52 @@ void GKI_init_timer_list_entry(TIMER_LIST_ENT* p_tle) {
 *******************************************************************************/
 uint16_t GKI_update_timer_list(TIMER_LIST_Q* p_timer_listq,
                                int32_t num_units_since_last_update) {
+  uint32_t rem_units;
+  uint32_t step;
+  uint32_t slot;
+  uint32_t pending;
   TIMER_LIST_ENT* p_tle;
-  uint16_t num_time_out = 0;
-  int32_t rem_ticks;
-  int32_t temp_ticks;
-
-  p_tle = p_timer_listq->p_first;
-
-  /* First, get the guys who have previously timed out */
-  /* Note that the tick value of the timers should always be '0' */
-  while ((p_tle) && (p_tle->ticks <= 0)) {
-    num_time_out++;
-    p_tle = p_tle->p_next;
-  }
+  TIMER_LIST_ENT* p_next;
+
+  if (num_units_since_last_update <= 0) return (p_timer_listq->num_expired);
+  rem_units = (uint32_t)num_units_since_last_update;
+
+  while (rem_units && p_timer_listq->num_running) {
+    /* Go to the next level 0 slot with entries, at most to the wrap-around */
+    slot = p_timer_listq->now & GKI_TIMER_WHEEL_MASK;
+    step = GKI_TIMER_WHEEL_SLOTS - slot;
+    if (slot < GKI_TIMER_WHEEL_MASK) {
+      pending = p_timer_listq->slot_mask[0] & (~0u << (slot + 1));
+      if (pending) step = __builtin_ctz(pending) - slot;
+    }
+    if (step > rem_units) step = rem_units;
 
-  /* Timer entriy tick values are relative to the preceeding entry */
-  rem_ticks = num_units_since_last_update;
+    p_timer_listq->now += step;
+    rem_units -= step;
 
-  /* Now, adjust remaining timer entries */
-  while ((p_tle != NULL) && (rem_ticks > 0)) {
-    temp_ticks = p_tle->ticks;
-    p_tle->ticks -= rem_ticks;
+    slot = p_timer_listq->now & GKI_TIMER_WHEEL_MASK;
+    if (slot == 0) gki_timer_list_cascade(p_timer_listq, 1);
 
-    /* See if this timer has just timed out */
-    if (p_tle->ticks <= 0) {
-      /* We set the number of ticks to '0' so that the legacy code
-       * that assumes a '0' or nonzero value will still work as coded. */
-      p_tle->ticks = 0;
+    /* The entries of a level 0 slot all expire now */
+    if (p_timer_listq->slot_mask[0] & (1u << slot)) {
+      p_tle = p_timer_listq->p_slot[0][slot];
+      p_timer_listq->p_slot[0][slot] = NULL;
+      p_timer_listq->slot_mask[0] &= ~(1u << slot);
 
-      num_time_out++;
+      for (; p_tle != NULL; p_tle = p_next) {
+        p_next = p_tle->p_next;
+        p_timer_listq->num_running--;
+        gki_timer_list_expire(p_timer_listq, p_tle);
+      }
     }
-
-    rem_ticks -= temp_ticks; /* Decrement the remaining ticks to process */
-    p_tle = p_tle->p_next;
   }
 
-  if (p_timer_listq->last_ticks > 0) {
-    p_timer_listq->last_ticks -= num_units_since_last_update;
+  /* No running entries, just keep the list time */
+  p_timer_listq->now += rem_units;
 
-    /* If the last timer has expired set last_ticks to 0 so that other list
-    * update
-    * functions will calculate correctly
-    */
-    if (p_timer_listq->last_ticks < 0) p_timer_listq->last_ticks = 0;
-  }
+  gki_timer_list_set_first(p_timer_listq);
 
-  return (num_time_out);
+  return (p_timer_listq->num_expired);
 }
 
 /*******************************************************************************
@@ -709,32 +923,59 @@ uint16_t GKI_update_timer_list(TIMER_LIST_Q* p_timer_listq,
 *******************************************************************************/
 uint32_t GKI_get_remaining_ticks(TIMER_LIST_Q* p_timer_listq,
                                  TIMER_LIST_ENT* p_target_tle) {
-  TIMER_LIST_ENT* p_tle;
-  uint32_t rem_ticks = 0;
+  if (!p_target_tle->in_use) {
+    LOG(ERROR) << StringPrintf(
+                     "GKI_get_remaining_ticks: timer entry is not active");
+    return (0);
+  }
 
-  if (p_target_tle->in_use) {
-    p_tle = p_timer_listq->p_first;
+  if (p_target_tle->slot == GKI_TIMER_SLOT_EXPIRED) return (0);
 
-    /* adding up all of ticks in previous entries */
-    while ((p_tle) && (p_tle != p_target_tle)) {
-      rem_ticks += p_tle->ticks;
-      p_tle = p_tle->p_next;
-    }
+  return (p_target_tle->expiry - p_timer_listq->now);
+}
 
-    /* if found target entry */
-    if ((p_tle != NULL) && (p_tle == p_target_tle)) {
-      rem_ticks += p_tle->ticks;
-    } else {
-      LOG(ERROR) << StringPrintf(
-                       "GKI_get_remaining_ticks: No timer entry in the list");
-      return (0);
+/*******************************************************************************
+**
+** Function         GKI_get_next_expiry
+**
+** Description      This function is called by an application that updates a
+**                  timer list on demand, to know when its first entry
+**                  expires.
+**
+** Parameters       p_timer_listq - (input) pointer to the timer list queue
+**                                          object
+**
+** Returns          -1 if no entry is running or expired
+**                  0 if an entry has expired
+**                  the number of units until the first expiry otherwise
+**
+*******************************************************************************/
+int32_t GKI_get_next_expiry(TIMER_LIST_Q* p_timer_listq) {
+  TIMER_LIST_ENT* p_tle;
+  uint32_t mask;
+  uint32_t delta;
+  uint32_t next = UINT32_MAX;
+  uint8_t level;
+  uint8_t slot;
+
+  if (p_timer_listq->num_expired) return (0);
+  if (!p_timer_listq->num_running) return (-1);
+
+  /* A higher level entry may expire before the lower level ones, the wheel
+   * only orders the level 0 slots */
+  for (level = 0; level < GKI_TIMER_WHEEL_LEVELS; level++) {
+    for (mask = p_timer_listq->slot_mask[level]; mask; mask &= mask - 1) {
+      slot = __builtin_ctz(mask);
+      for (p_tle = p_timer_listq->p_slot[level][slot]; p_tle != NULL;
+           p_tle = p_tle->p_next) {
+        delta = p_tle->expiry - p_timer_listq->now;
+        if (delta < next) next = delta;
+      }
     }
-  } else {
-    LOG(ERROR) << StringPrintf(
-                     "GKI_get_remaining_ticks: timer entry is not active");
   }
 
-  return (rem_ticks);
+  if (next > INT32_MAX) next = INT32_MAX;
+  return ((int32_t)next);
 }
 
 /*******************************************************************************
@@ -756,9 +997,9 @@ uint32_t GKI_get_remaining_ticks(TIMER_LIST_Q* p_timer_listq,
 **
 *******************************************************************************/
 void GKI_add_to_timer_list(TIMER_LIST_Q* p_timer_listq, TIMER_LIST_ENT* p_tle) {
-  uint32_t nr_ticks_total;
   uint8_t tt;
-  TIMER_LIST_ENT* p_temp;
+  int32_t ticks;
+
   if (p_tle == NULL || p_timer_listq == NULL) {
     DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
         "%s: invalid argument %p, %p****************************<<", __func__,
@@ -768,50 +1009,17 @@ void GKI_add_to_timer_list(TIMER_LIST_Q* p_timer_listq, TIMER_LIST_ENT* p_tle) {
 
   /* Only process valid tick values */
   if (p_tle->ticks >= 0) {
-    /* If this entry is the last in the list */
-    if (p_tle->ticks >= p_timer_listq->last_ticks) {
-      /* If this entry is the only entry in the list */
-      if (p_timer_listq->p_first == NULL)
-        p_timer_listq->p_first = p_tle;
-      else {
-        /* Insert the entry onto the end of the list */
-        if (p_timer_listq->p_last != NULL)
-          p_timer_listq->p_last->p_next = p_tle;
-
-        p_tle->p_prev = p_timer_listq->p_last;
-      }
-
-      p_tle->p_next = NULL;
-      p_timer_listq->p_last = p_tle;
-      nr_ticks_total = p_tle->ticks;
-      p_tle->ticks -= p_timer_listq->last_ticks;
-
-      p_timer_listq->last_ticks = nr_ticks_total;
-    } else /* This entry needs to be inserted before the last entry */
-    {
-      /* Find the entry that the new one needs to be inserted in front of */
-      p_temp = p_timer_listq->p_first;
-      while (p_tle->ticks > p_temp->ticks) {
-        /* Update the tick value if looking at an unexpired entry */
-        if (p_temp->ticks > 0) p_tle->ticks -= p_temp->ticks;
-
-        p_temp = p_temp->p_next;
-      }
-
-      /* The new entry is the first in the list */
-      if (p_temp == p_timer_listq->p_first) {
-        p_tle->p_next = p_timer_listq->p_first;
-        p_timer_listq->p_first->p_prev = p_tle;
-        p_timer_listq->p_first = p_tle;
-      } else {
-        p_temp->p_prev->p_next = p_tle;
-        p_tle->p_prev = p_temp->p_prev;
-        p_temp->p_prev = p_tle;
-        p_tle->p_next = p_temp;
-      }
-      p_temp->ticks -= p_tle->ticks;
+    /* Re-adding a running entry restarts it instead of corrupting the list */
+    if (p_tle->in_use) {
+      ticks = p_tle->ticks;
+      GKI_remove_from_timer_list(p_timer_listq, p_tle);
+      p_tle->ticks = ticks;
     }
 
+    p_tle->expiry = p_timer_listq->now + (uint32_t)p_tle->ticks;
+    gki_timer_list_place(p_timer_listq, p_tle);
+    gki_timer_list_set_first(p_timer_listq);
+
     p_tle->in_use = true;
 
     /* if we already add this timer queue to the array */
@@ -847,6 +1055,8 @@ void GKI_add_to_timer_list(TIMER_LIST_Q* p_timer_listq, TIMER_LIST_ENT* p_tle) {
 void GKI_remove_from_timer_list(TIMER_LIST_Q* p_timer_listq,
                                 TIMER_LIST_ENT* p_tle) {
   uint8_t tt;
+  uint8_t level;
+  uint8_t slot;
 
   /* Verify that the entry is valid */
   if (p_tle == NULL || p_tle->in_use == false ||
@@ -854,51 +1064,25 @@ void GKI_remove_from_timer_list(TIMER_LIST_Q* p_timer_listq,
     return;
   }
 
-  /* Add the ticks remaining in this timer (if any) to the next guy in the list.
-  ** Note: Expired timers have a tick value of '0'.
-  */
-  if (p_tle->p_next != NULL) {
-    p_tle->p_next->ticks += p_tle->ticks;
+  if (p_tle->slot == GKI_TIMER_SLOT_EXPIRED) {
+    gki_timer_list_unlink(&p_timer_listq->p_expired, p_tle);
+    p_timer_listq->num_expired--;
   } else {
-    p_timer_listq->last_ticks -= p_tle->ticks;
+    level = p_tle->slot / GKI_TIMER_WHEEL_SLOTS;
+    slot = p_tle->slot % GKI_TIMER_WHEEL_SLOTS;
+    gki_timer_list_unlink(&p_timer_listq->p_slot[level][slot], p_tle);
+    if (p_timer_listq->p_slot[level][slot] == NULL)
+      p_timer_listq->slot_mask[level] &= ~(1u << slot);
+    p_timer_listq->num_running--;
   }
 
-  /* Unlink timer from the list.
-  */
-  if (p_timer_listq->p_first == p_tle) {
-    p_timer_listq->p_first = p_tle->p_next;
-
-    if (p_timer_listq->p_first != NULL) p_timer_listq->p_first->p_prev = NULL;
-
-    if (p_timer_listq->p_last == p_tle) p_timer_listq->p_last = NULL;
-  } else {
-    if (p_timer_listq->p_last == p_tle) {
-      p_timer_listq->p_last = p_tle->p_prev;
+  if (p_timer_listq->p_first == p_tle) gki_timer_list_set_first(p_timer_listq);
 
-      if (p_timer_listq->p_last != NULL) p_timer_listq->p_last->p_next = NULL;
-    } else {
-      if (p_tle->p_next != NULL && p_tle->p_next->p_prev == p_tle)
-        p_tle->p_next->p_prev = p_tle->p_prev;
-      else {
-        /* Error case - chain messed up ?? */
-        return;
-      }
-
-      if (p_tle->p_prev != NULL && p_tle->p_prev->p_next == p_tle)
-        p_tle->p_prev->p_next = p_tle->p_next;
-      else {
-        /* Error case - chain messed up ?? */
-        return;
-      }
-    }
-  }
-
-  p_tle->p_next = p_tle->p_prev = NULL;
   p_tle->ticks = GKI_UNUSED_LIST_ENTRY;
   p_tle->in_use = false;
 
   /* if timer queue is empty */
-  if (p_timer_listq->p_first == NULL && p_timer_listq->p_last == NULL) {
+  if (p_timer_listq->p_first == NULL) {
     for (tt = 0; tt < GKI_MAX_TIMER_QUEUES; tt++) {
       if (gki_cb.com.timer_queues[tt] == p_timer_listq) {
         gki_cb.com.timer_queues[tt] = NULL;
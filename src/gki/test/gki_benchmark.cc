@@ -0,0 +1,107 @@
+#include <benchmark/benchmark.h>
+
+#include <pthread.h>
+#include <thread>
+
+#include "gki_int.h"
+
+bool nfc_debug_enabled = false;
+
+/* The benchmark runs without the power HAL */
+extern "C" int acquire_wake_lock(int, const char*) { return 0; }
+extern "C" int release_wake_lock(const char*) { return 0; }
+
+namespace {
+
+/* Task the benchmark thread is adopted as, so it can own a mailbox */
+const uint8_t kBenchTask = NFC_TASK;
+
+void gki_bench_init() {
+  static bool initialized = false;
+  if (initialized) return;
+  GKI_init();
+  initialized = true;
+}
+
+/* The task id lookup as it was before it was cached per thread */
+uint8_t get_taskid_scan() {
+  pthread_t thread_id = pthread_self();
+  for (int i = 0; i < GKI_MAX_TASKS; i++) {
+    if (gki_cb.os.thread_id[i] == thread_id) return (i);
+  }
+  return (-1);
+}
+
+void adopt_bench_thread() {
+  gki_bench_init();
+  gki_cb.os.thread_id[kBenchTask] = pthread_self();
+  gki_cb.com.OSRdyTbl[kBenchTask] = TASK_READY;
+}
+
+void BM_GetTaskIdScan(benchmark::State& state) {
+  adopt_bench_thread();
+  for (auto _ : state) benchmark::DoNotOptimize(get_taskid_scan());
+}
+BENCHMARK(BM_GetTaskIdScan);
+
+void BM_GetTaskId(benchmark::State& state) {
+  adopt_bench_thread();
+  for (auto _ : state) benchmark::DoNotOptimize(GKI_get_taskid());
+}
+BENCHMARK(BM_GetTaskId);
+
+/* Foreign threads used to scan the whole table on every call. They run on a
+ * fresh thread because the benchmark thread itself is adopted as a task. */
+void BM_GetTaskIdForeignScan(benchmark::State& state) {
+  gki_bench_init();
+  std::thread foreign([&state] {
+    for (auto _ : state) benchmark::DoNotOptimize(get_taskid_scan());
+  });
+  foreign.join();
+}
+BENCHMARK(BM_GetTaskIdForeignScan);
+
+void BM_GetTaskIdForeign(benchmark::State& state) {
+  gki_bench_init();
+  std::thread foreign([&state] {
+    GKI_register_thread();
+    for (auto _ : state) benchmark::DoNotOptimize(GKI_get_taskid());
+  });
+  foreign.join();
+}
+BENCHMARK(BM_GetTaskIdForeign);
+
+/* Round trip of one message through the mailbox of the calling task */
+void BM_SendReadMbox(benchmark::State& state) {
+  adopt_bench_thread();
+  for (auto _ : state) {
+    void* p_msg = GKI_getbuf(state.range(0));
+    GKI_send_msg(kBenchTask, TASK_MBOX_0, p_msg);
+    p_msg = GKI_read_mbox(TASK_MBOX_0);
+    GKI_freebuf(p_msg);
+  }
+}
+BENCHMARK(BM_SendReadMbox)->Arg(16)->Arg(256);
+
+/* Messages queued in a burst and then drained, like an NCI response train */
+void BM_SendReadMboxBurst(benchmark::State& state) {
+  void* p_msgs[32];
+
+  adopt_bench_thread();
+  for (auto _ : state) {
+    for (auto& p_msg : p_msgs) {
+      p_msg = GKI_getbuf(64);
+      GKI_send_msg(kBenchTask, TASK_MBOX_0, p_msg);
+    }
+    for (auto& p_msg : p_msgs) {
+      p_msg = GKI_read_mbox(TASK_MBOX_0);
+      GKI_freebuf(p_msg);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * 32);
+}
+BENCHMARK(BM_SendReadMboxBurst);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,285 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "gki_int.h"
+
+bool nfc_debug_enabled = false;
+
+/* The test runs without the power HAL */
+extern "C" int acquire_wake_lock(int, const char*) { return 0; }
+extern "C" int release_wake_lock(const char*) { return 0; }
+
+namespace {
+
+/* The delta-encoded timer list the wheel replaced, kept as the reference for
+ * the semantics the NFA/NFC timer code relies on */
+struct RefEnt {
+  RefEnt* p_next;
+  RefEnt* p_prev;
+  int32_t ticks;
+  bool in_use;
+};
+
+struct RefQ {
+  RefEnt* p_first;
+  RefEnt* p_last;
+  int32_t last_ticks;
+};
+
+void ref_update(RefQ* q, int32_t units) {
+  RefEnt* p = q->p_first;
+  int32_t rem = units;
+
+  while (p && p->ticks <= 0) p = p->p_next;
+  while (p && rem > 0) {
+    int32_t temp = p->ticks;
+    p->ticks -= rem;
+    if (p->ticks <= 0) p->ticks = 0;
+    rem -= temp;
+    p = p->p_next;
+  }
+  if (q->last_ticks > 0) {
+    q->last_ticks -= units;
+    if (q->last_ticks < 0) q->last_ticks = 0;
+  }
+}
+
+uint32_t ref_remaining(RefQ* q, RefEnt* t) {
+  uint32_t rem = 0;
+  for (RefEnt* p = q->p_first; p; p = p->p_next) {
+    rem += p->ticks;
+    if (p == t) return rem;
+  }
+  return 0;
+}
+
+void ref_add(RefQ* q, RefEnt* t) {
+  if (t->ticks < 0) return;
+  if (t->ticks >= q->last_ticks) {
+    if (q->p_first == NULL) {
+      q->p_first = t;
+    } else {
+      if (q->p_last) q->p_last->p_next = t;
+      t->p_prev = q->p_last;
+    }
+    t->p_next = NULL;
+    q->p_last = t;
+    int32_t total = t->ticks;
+    t->ticks -= q->last_ticks;
+    q->last_ticks = total;
+  } else {
+    RefEnt* p = q->p_first;
+    while (t->ticks > p->ticks) {
+      if (p->ticks > 0) t->ticks -= p->ticks;
+      p = p->p_next;
+    }
+    if (p == q->p_first) {
+      t->p_next = q->p_first;
+      q->p_first->p_prev = t;
+      q->p_first = t;
+    } else {
+      p->p_prev->p_next = t;
+      t->p_prev = p->p_prev;
+      p->p_prev = t;
+      t->p_next = p;
+    }
+    p->ticks -= t->ticks;
+  }
+  t->in_use = true;
+}
+
+void ref_remove(RefQ* q, RefEnt* t) {
+  if (!t->in_use || q->p_first == NULL) return;
+  if (t->p_next) {
+    t->p_next->ticks += t->ticks;
+  } else {
+    q->last_ticks -= t->ticks;
+  }
+  if (q->p_first == t) {
+    q->p_first = t->p_next;
+    if (q->p_first) q->p_first->p_prev = NULL;
+    if (q->p_last == t) q->p_last = NULL;
+  } else if (q->p_last == t) {
+    q->p_last = t->p_prev;
+    if (q->p_last) q->p_last->p_next = NULL;
+  } else {
+    t->p_next->p_prev = t->p_prev;
+    t->p_prev->p_next = t->p_next;
+  }
+  t->p_next = t->p_prev = NULL;
+  t->in_use = false;
+}
+
+class GkiTimerListTest : public ::testing::Test {
+ protected:
+  static const int kNumEntries = 48;
+
+  void SetUp() override {
+    GKI_init_timer_list(&q_);
+    memset(&ref_q_, 0, sizeof(ref_q_));
+    for (int i = 0; i < kNumEntries; i++) {
+      GKI_init_timer_list_entry(&tle_[i]);
+      tle_[i].param = i;
+      memset(&ref_[i], 0, sizeof(ref_[i]));
+    }
+  }
+
+  void TearDown() override {
+    for (int i = 0; i < kNumEntries; i++)
+      GKI_remove_from_timer_list(&q_, &tle_[i]);
+  }
+
+  void Add(int i, int32_t ticks) {
+    GKI_remove_from_timer_list(&q_, &tle_[i]);
+    ref_remove(&ref_q_, &ref_[i]);
+    tle_[i].ticks = ticks;
+    ref_[i].ticks = ticks;
+    GKI_add_to_timer_list(&q_, &tle_[i]);
+    ref_add(&ref_q_, &ref_[i]);
+  }
+
+  void Update(int32_t units) {
+    GKI_update_timer_list(&q_, units);
+    ref_update(&ref_q_, units);
+  }
+
+  void Remove(int i) {
+    GKI_remove_from_timer_list(&q_, &tle_[i]);
+    ref_remove(&ref_q_, &ref_[i]);
+  }
+
+  /* Removes the expired entries the way the NFC task does */
+  std::vector<int> Drain() {
+    std::vector<int> expired, ref_expired;
+
+    while (q_.p_first && q_.p_first->ticks <= 0) {
+      TIMER_LIST_ENT* p_tle = q_.p_first;
+      GKI_remove_from_timer_list(&q_, p_tle);
+      expired.push_back(p_tle->param);
+    }
+    while (ref_q_.p_first && ref_q_.p_first->ticks <= 0) {
+      RefEnt* t = ref_q_.p_first;
+      ref_remove(&ref_q_, t);
+      ref_expired.push_back(t - ref_);
+    }
+    std::sort(expired.begin(), expired.end());
+    std::sort(ref_expired.begin(), ref_expired.end());
+    EXPECT_EQ(ref_expired, expired);
+    return expired;
+  }
+
+  void ExpectSameState() {
+    ASSERT_EQ(ref_q_.p_first == NULL, q_.p_first == NULL);
+    if (q_.p_first) {
+      ASSERT_EQ(ref_q_.p_first->ticks <= 0, q_.p_first->ticks <= 0);
+    }
+    for (int i = 0; i < kNumEntries; i++) {
+      ASSERT_EQ(ref_[i].in_use, (bool)tle_[i].in_use) << "entry " << i;
+      if (ref_[i].in_use) {
+        ASSERT_EQ(ref_remaining(&ref_q_, &ref_[i]),
+                  GKI_get_remaining_ticks(&q_, &tle_[i]))
+            << "entry " << i;
+      }
+    }
+    ASSERT_EQ(ref_next_expiry(), GKI_get_next_expiry(&q_));
+  }
+
+  /* -1 if the list is empty, 0 if an entry has expired */
+  int32_t ref_next_expiry() {
+    int32_t next = -1;
+    for (RefEnt* p = ref_q_.p_first; p; p = p->p_next) {
+      int32_t rem = ref_remaining(&ref_q_, p);
+      if (next < 0 || rem < next) next = rem;
+    }
+    return next;
+  }
+
+  TIMER_LIST_Q q_;
+  TIMER_LIST_ENT tle_[kNumEntries];
+  RefQ ref_q_;
+  RefEnt ref_[kNumEntries];
+};
+
+TEST_F(GkiTimerListTest, test_zero_ticks_expire_at_once) {
+  Add(0, 0);
+  ASSERT_TRUE(q_.p_first != NULL);
+  EXPECT_EQ(0, q_.p_first->ticks);
+  EXPECT_EQ(std::vector<int>{0}, Drain());
+  EXPECT_TRUE(q_.p_first == NULL);
+}
+
+TEST_F(GkiTimerListTest, test_expiry_order) {
+  Add(0, 300);
+  Add(1, 5);
+  Add(2, 40);
+  Add(3, 2000);
+
+  std::vector<int> order;
+  for (int t = 0; t < 2000; t++) {
+    GKI_update_timer_list(&q_, 1);
+    while (q_.p_first && q_.p_first->ticks == 0) {
+      order.push_back(q_.p_first->param);
+      GKI_remove_from_timer_list(&q_, q_.p_first);
+    }
+  }
+  EXPECT_EQ((std::vector<int>{1, 2, 0, 3}), order);
+}
+
+TEST_F(GkiTimerListTest, test_beyond_wheel_range) {
+  const int32_t range =
+      1 << (GKI_TIMER_WHEEL_BITS * GKI_TIMER_WHEEL_LEVELS);
+
+  Add(0, 3 * range + 17);
+  EXPECT_EQ(3 * range + 17, GKI_get_next_expiry(&q_));
+  Update(3 * range + 16);
+  EXPECT_EQ(1u, GKI_get_remaining_ticks(&q_, &tle_[0]));
+  EXPECT_EQ(1, GKI_get_next_expiry(&q_));
+  EXPECT_TRUE(Drain().empty());
+  Update(1);
+  EXPECT_EQ(std::vector<int>{0}, Drain());
+}
+
+TEST_F(GkiTimerListTest, test_random_equivalence) {
+  std::mt19937 rng(0x4e4643);
+
+  for (int step = 0; step < 200000; step++) {
+    uint32_t op = rng() % 100;
+    int i = rng() % kNumEntries;
+
+    if (op < 45) {
+      int32_t ticks;
+      uint32_t kind = rng() % 100;
+      if (kind < 70)
+        ticks = rng() % 64;
+      else if (kind < 95)
+        ticks = rng() % 5000;
+      else if (kind < 99)
+        ticks = rng() % 200000;
+      else
+        ticks = rng() % (1 << 22);
+      Add(i, ticks);
+    } else if (op < 70) {
+      Remove(i);
+    } else if (op < 97) {
+      uint32_t kind = rng() % 100;
+      int32_t units;
+      if (kind < 90)
+        units = rng() % 40;
+      else if (kind < 99)
+        units = rng() % 3000;
+      else
+        units = rng() % 300000;
+      Update(units);
+      ASSERT_NO_FATAL_FAILURE(ExpectSameState());
+      Drain();
+    } else {
+      Drain();
+    }
+    ASSERT_NO_FATAL_FAILURE(ExpectSameState()) << "step " << step;
+  }
+}
+
+}  // namespace
@@ -34,12 +34,14 @@ typedef struct {
   pthread_t thread_id[GKI_MAX_TASKS];
   pthread_mutex_t thread_evt_mutex[GKI_MAX_TASKS];
   pthread_cond_t thread_evt_cond[GKI_MAX_TASKS];
+  int thread_evt_waiting[GKI_MAX_TASKS]; /* 1: task blocked in GKI_wait() */
   pthread_mutex_t thread_timeout_mutex[GKI_MAX_TASKS];
   pthread_cond_t thread_timeout_cond[GKI_MAX_TASKS];
-  int no_timer_suspend; /* 1: no suspend, 0 stop calling GKI_timer_update() */
-  pthread_mutex_t gki_timer_mutex;
-  pthread_cond_t gki_timer_cond;
+  int no_timer_suspend; /* GKI_TIMER_TICK_EXIT_COND ends the GKI_run() loop */
   int gki_timer_wake_lock_on;
+  uint64_t timer_base_ns;     /* time up to which OSTicks has been counted */
+  uint64_t timer_deadline_ns; /* expiry the timerfd is armed for, 0: none */
+  uint32_t foreign_thread_mask; /* ids in use by registered foreign threads */
 } tGKI_OS;
 
 /* condition to exit or continue GKI_run() timer loop */
@@ -48,6 +50,10 @@ typedef struct {
 #define GKI_TIMER_TICK_EXIT_COND 2
 
 extern void gki_system_tick_start_stop_cback(bool start);
+extern void gki_timer_sync(void);
+extern uint32_t gki_timer_elapsed(void);
+extern void gki_timer_rebase(void);
+extern void gki_timer_arm(void);
 
 /* Contains common control block as well as OS specific variables */
 typedef struct {
@@ -20,6 +20,8 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <pthread.h> /* must be 1st header defined  */
+#include <sys/timerfd.h>
+#include <time.h>
 
 #include <android-base/stringprintf.h>
 #include <base/logging.h>
@@ -52,10 +54,18 @@ tGKI_CB gki_cb;
 #define NANOSEC_PER_MILLISEC (1000000)
 #define NSEC_PER_SEC (1000 * NANOSEC_PER_MILLISEC)
 
-/* works only for 1ms to 1000ms heart beat ranges */
-#define LINUX_SEC (1000 / TICKS_PER_SEC)
+/* length of one GKI tick */
+#define GKI_TICK_NS ((uint64_t)NSEC_PER_SEC / TICKS_PER_SEC)
 // #define GKI_TICK_TIMER_DEBUG
 
+/* timerfd that drives GKI_timer_update() from GKI_run(), created once */
+static int gki_timer_fd = -1;
+
+#define WAKE_LOCK_ID "brcm_nfca"
+#define PARTIAL_WAKE_LOCK 1
+extern "C" int acquire_wake_lock(int lock, const char* id);
+extern "C" int release_wake_lock(const char* id);
+
 /* this kind of mutex go into tGKI_OS control block!!!! */
 /* static pthread_mutex_t GKI_sched_mutex; */
 /*static pthread_mutex_t thread_delay_mutex;
@@ -79,6 +89,23 @@ typedef struct {
 } gki_pthread_info_t;
 gki_pthread_info_t gki_pthread_info[GKI_MAX_TASKS];
 
+/* Task id of the calling thread, cached on first lookup */
+class GkiThreadId {
+ public:
+  ~GkiThreadId();
+  bool valid;      /* task_id holds the result of a lookup */
+  bool foreign;    /* task_id was handed out by GKI_register_thread() */
+  uint8_t task_id; /* GKI task id, registered id or -1 */
+};
+
+static thread_local GkiThreadId gki_thread_id;
+
+#if (GKI_MAX_TASKS >= GKI_FOREIGN_TASK_BASE ||                           \
+     GKI_FOREIGN_TASK_BASE + GKI_MAX_FOREIGN_THREADS > GKI_INVALID_TASK || \
+     GKI_MAX_FOREIGN_THREADS > 32)
+#error Too many GKI tasks and foreign threads
+#endif
+
 static struct tms buffer;
 
 /*******************************************************************************
@@ -99,17 +126,63 @@ void* gki_task_entry(void* params) {
       pthread_self(), p_pthread_info->pCond, p_pthread_info->pMutex);
 
   gki_cb.os.thread_id[p_pthread_info->task_id] = thread_id;
+  gki_thread_id.task_id = p_pthread_info->task_id;
+  gki_thread_id.valid = true;
   /* Call the actual thread entry point */
   (p_pthread_info->task_entry)(p_pthread_info->params);
 
   LOG(ERROR) << StringPrintf("gki_task task_id=%i terminating",
                              p_pthread_info->task_id);
   gki_cb.os.thread_id[p_pthread_info->task_id] = 0;
+  gki_thread_id.valid = false;
 
   return NULL;
 }
 /* end android */
 
+/*******************************************************************************
+**
+** Function         gki_timer_now_ns
+**
+** Description      Time base of the GKI timer service. CLOCK_BOOTTIME keeps
+**                  counting while the system is suspended, so timers that
+**                  were due during suspend expire right after resume.
+**
+** Returns          current time in ns
+**
+*******************************************************************************/
+static uint64_t gki_timer_now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_BOOTTIME, &ts);
+  return ((uint64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec);
+}
+
+/*******************************************************************************
+**
+** Function         gki_timer_create
+**
+** Description      Creates the timerfd of the GKI timer service. An alarm
+**                  timer is used if the process may set one (CAP_WAKE_ALARM),
+**                  as it wakes the system to expire the timers.
+**
+** Returns          void
+**
+*******************************************************************************/
+static void gki_timer_create(void) {
+  if (gki_timer_fd >= 0) return;
+
+#ifdef CLOCK_BOOTTIME_ALARM
+  gki_timer_fd = timerfd_create(CLOCK_BOOTTIME_ALARM, TFD_CLOEXEC);
+  if (gki_timer_fd >= 0) return;
+#endif
+  gki_timer_fd = timerfd_create(CLOCK_BOOTTIME, TFD_CLOEXEC);
+  if (gki_timer_fd < 0) {
+    LOG(ERROR) << StringPrintf("%s: timerfd_create failed, errno=%d", __func__,
+                               errno);
+  }
+}
+
 /*******************************************************************************
 **
 ** Function         GKI_init
@@ -138,6 +211,9 @@ void GKI_init(void) {
 
   gki_timers_init();
   gki_cb.com.OSTicks = (uint32_t)times(&buffer);
+  gki_timer_create();
+  gki_cb.os.timer_base_ns = gki_timer_now_ns();
+  gki_cb.os.timer_deadline_ns = 0;
 
   pthread_mutexattr_init(&attr);
 
@@ -154,8 +230,6 @@ void GKI_init(void) {
    * state.
    * this works too even if GKI_NO_TICK_STOP is defined in btld.txt */
   p_os->no_timer_suspend = GKI_TIMER_TICK_RUN_COND;
-  pthread_mutex_init(&p_os->gki_timer_mutex, NULL);
-  pthread_cond_init(&p_os->gki_timer_cond, NULL);
 #if (NXP_EXTNS == TRUE)
   pthread_mutexattr_destroy(&attr);
 #endif
@@ -299,15 +373,10 @@ uint8_t GKI_create_task(TASKPTR task_entry, uint8_t task_id, int8_t* taskname,
 ** Returns          void
 **
 *******************************************************************************/
-#define WAKE_LOCK_ID "brcm_nfca"
-#define PARTIAL_WAKE_LOCK 1
-extern "C" int acquire_wake_lock(int lock, const char* id);
-extern "C" int release_wake_lock(const char* id);
-
 void GKI_shutdown(void) {
   uint8_t task_id;
   volatile int* p_run_cond = &gki_cb.os.no_timer_suspend;
-  int oldCOnd = 0;
+  struct itimerspec its;
 #if (false == GKI_PTHREAD_JOINABLE)
   int i = 0;
 #else
@@ -321,9 +390,12 @@ void GKI_shutdown(void) {
       gki_cb.com.OSRdyTbl[task_id - 1] = TASK_DEAD;
       /* paranoi settings, make sure that we do not execute any mailbox events
        */
-      gki_cb.com.OSWaitEvt[task_id - 1] &=
-          ~(TASK_MBOX_0_EVT_MASK | TASK_MBOX_1_EVT_MASK | TASK_MBOX_2_EVT_MASK |
-            TASK_MBOX_3_EVT_MASK);
+      __atomic_fetch_and(&gki_cb.com.OSWaitEvt[task_id - 1],
+                         (uint16_t) ~(TASK_MBOX_0_EVT_MASK |
+                                      TASK_MBOX_1_EVT_MASK |
+                                      TASK_MBOX_2_EVT_MASK |
+                                      TASK_MBOX_3_EVT_MASK),
+                         __ATOMIC_SEQ_CST);
       GKI_send_event(task_id - 1, EVENT_MASK(GKI_SHUTDOWN_EVT));
 
       if (((task_id - 1) == BTU_TASK) && gki_cb.com.p_tick_cb &&
@@ -334,7 +406,9 @@ void GKI_shutdown(void) {
 
 #if (false == GKI_PTHREAD_JOINABLE)
       i = 0;
-      while ((gki_cb.com.OSWaitEvt[task_id - 1] != 0) && (++i < 15))
+      while ((__atomic_load_n(&gki_cb.com.OSWaitEvt[task_id - 1],
+                              __ATOMIC_SEQ_CST) != 0) &&
+             (++i < 15))
         usleep(2 * 1000);
 #else
       /* wait for proper Arnold Schwarzenegger task state */
@@ -368,57 +442,195 @@ void GKI_shutdown(void) {
     release_wake_lock(WAKE_LOCK_ID);
     gki_cb.os.gki_timer_wake_lock_on = 0;
   }
-  oldCOnd = *p_run_cond;
   *p_run_cond = GKI_TIMER_TICK_EXIT_COND;
-  if (oldCOnd == GKI_TIMER_TICK_STOP_COND)
-    pthread_cond_signal(&gki_cb.os.gki_timer_cond);
+
+  /* Let the timer service in GKI_run() see the exit condition */
+  memset(&its, 0, sizeof(its));
+  its.it_value.tv_nsec = 1;
+  if (gki_timer_fd >= 0) timerfd_settime(gki_timer_fd, 0, &its, NULL);
 }
 
 /*******************************************************************************
- **
- ** Function        GKI_run
- **
- ** Description     This function runs a task
- **
- ** Parameters:     start: true start system tick (again), false stop
- **
- ** Returns         void
- **
- ******************************************************************************/
-void gki_system_tick_start_stop_cback(bool start) {
-  tGKI_OS* p_os = &gki_cb.os;
-  volatile int* p_run_cond = &p_os->no_timer_suspend;
+**
+** Function         gki_timer_wake_lock
+**
+** Description      Takes or releases the wake lock of the timer service.
+**
+** Returns          void
+**
+*******************************************************************************/
+static void gki_timer_wake_lock(bool on) {
+  if (on == (gki_cb.os.gki_timer_wake_lock_on != 0)) return;
+
+  if (on) {
+    acquire_wake_lock(PARTIAL_WAKE_LOCK, WAKE_LOCK_ID);
+  } else {
+    release_wake_lock(WAKE_LOCK_ID);
+  }
+  gki_cb.os.gki_timer_wake_lock_on = on;
 #ifdef GKI_TICK_TIMER_DEBUG
-  static volatile int wake_lock_count;
+  DLOG_IF(INFO, nfc_debug_enabled)
+      << StringPrintf(">>> wake lock %s", on ? "ON" : "OFF");
 #endif
-  if (false == start) {
-    /* this can lead to a race condition. however as we only read this variable
-     * in the timer loop
-     * we should be fine with this approach. otherwise uncomment below mutexes.
-     */
-    /* GKI_disable(); */
-    *p_run_cond = GKI_TIMER_TICK_STOP_COND;
-/* GKI_enable(); */
+}
+
+/*******************************************************************************
+**
+** Function         gki_system_tick_start_stop_cback
+**
+** Description      Called by the common timer code when the first timer is
+**                  started or the last one has stopped.
+**
+** Parameters:      start: true start system tick (again), false stop
+**
+** Returns          void
+**
+*******************************************************************************/
+void gki_system_tick_start_stop_cback(bool start) {
+  if (start) {
+    /* The tick restarts from now, so the first timer gets its full length
+     * instead of expiring up to one tick early */
+    gki_cb.os.timer_base_ns = gki_timer_now_ns();
+  } else {
+    gki_timer_arm();
+    gki_timer_wake_lock(false);
+  }
 #ifdef GKI_TICK_TIMER_DEBUG
-    DLOG_IF(INFO, nfc_debug_enabled)
-        << StringPrintf(">>> STOP wake_lock_count:%d", --wake_lock_count);
+  DLOG_IF(INFO, nfc_debug_enabled)
+      << StringPrintf(">>> system tick %s", start ? "START" : "STOP");
 #endif
-    release_wake_lock(WAKE_LOCK_ID);
-    gki_cb.os.gki_timer_wake_lock_on = 0;
-  } else {
-    /* restart GKI_timer_update() loop */
-    acquire_wake_lock(PARTIAL_WAKE_LOCK, WAKE_LOCK_ID);
-    gki_cb.os.gki_timer_wake_lock_on = 1;
-    *p_run_cond = GKI_TIMER_TICK_RUN_COND;
-    pthread_mutex_lock(&p_os->gki_timer_mutex);
-    pthread_cond_signal(&p_os->gki_timer_cond);
-    pthread_mutex_unlock(&p_os->gki_timer_mutex);
+}
 
-#ifdef GKI_TICK_TIMER_DEBUG
-    DLOG_IF(INFO, nfc_debug_enabled)
-        << StringPrintf(">>> START wake_lock_count:%d", ++wake_lock_count);
+/*******************************************************************************
+**
+** Function         gki_timer_sync
+**
+** Description      Advances the GKI tick count to the current time and runs
+**                  the timers that have expired meanwhile. Only the timer
+**                  service in GKI_run() calls it, so that timer events and
+**                  callbacks come from the timer thread.
+**
+** Returns          void
+**
+*******************************************************************************/
+void gki_timer_sync(void) {
+  tGKI_OS* p_os = &gki_cb.os;
+  uint64_t now;
+  uint64_t ticks;
+
+  GKI_disable();
+  now = gki_timer_now_ns();
+  if (now > p_os->timer_base_ns) {
+    ticks = (now - p_os->timer_base_ns) / GKI_TICK_NS;
+    if (ticks > INT32_MAX) ticks = INT32_MAX;
+    p_os->timer_base_ns += ticks * GKI_TICK_NS;
+
+    if (gki_cb.com.system_tick_running || !gki_cb.com.p_tick_cb) {
+      if (ticks) GKI_timer_update((int32_t)ticks);
+    } else {
+      /* no timers to update, only keep GKI_get_tick_count() going */
+      gki_cb.com.OSTicks += (uint32_t)ticks;
+    }
+  }
+  GKI_enable();
+}
+
+/*******************************************************************************
+**
+** Function         gki_timer_elapsed
+**
+** Description      Ticks that have elapsed since the timer service last
+**                  advanced the tick count. Timers started now are relative
+**                  to the last update, so they are lengthened by this.
+**
+** Returns          elapsed ticks
+**
+*******************************************************************************/
+uint32_t gki_timer_elapsed(void) {
+  uint64_t now = gki_timer_now_ns();
+  uint64_t ticks = 0;
+
+  GKI_disable();
+  if (now > gki_cb.os.timer_base_ns)
+    ticks = (now - gki_cb.os.timer_base_ns) / GKI_TICK_NS;
+  GKI_enable();
+  if (ticks > INT32_MAX) ticks = INT32_MAX;
+  return (uint32_t)ticks;
+}
+
+/*******************************************************************************
+**
+** Function         gki_timer_rebase
+**
+** Description      Counts the elapsed ticks into the tick count without
+**                  running the timers. Only valid while no timer is pending,
+**                  e.g. before the first timer is started.
+**
+** Returns          void
+**
+*******************************************************************************/
+void gki_timer_rebase(void) {
+  uint32_t ticks;
+
+  GKI_disable();
+  ticks = gki_timer_elapsed();
+  gki_cb.com.OSTicks += ticks;
+  gki_cb.os.timer_base_ns += (uint64_t)ticks * GKI_TICK_NS;
+  GKI_enable();
+}
+
+/*******************************************************************************
+**
+** Function         gki_timer_arm
+**
+** Description      Arms the timerfd for the earliest GKI timer expiry, or
+**                  disarms it when no timer is pending. Called after timers
+**                  have been started, stopped or updated.
+**
+**                  The wake lock is only kept while the next deadline is
+**                  close or the timerfd cannot wake the system by itself.
+**
+** Returns          void
+**
+*******************************************************************************/
+void gki_timer_arm(void) {
+  tGKI_OS* p_os = &gki_cb.os;
+  tGKI_COM_CB* p_cb = &gki_cb.com;
+  struct itimerspec its;
+  uint64_t deadline = 0;
+  int32_t ticks;
+
+  GKI_disable();
+  /* OSNumOrigTicks is only 0 when no timer is pending */
+  ticks = INT32_MAX;
+  if (p_cb->OSNumOrigTicks) ticks = p_cb->OSTicksTilExp;
+#if (GKI_DELAY_STOP_SYS_TICK > 0)
+  if (p_cb->OSTicksTilStop && (int32_t)p_cb->OSTicksTilStop < ticks)
+    ticks = (int32_t)p_cb->OSTicksTilStop;
 #endif
+  if (ticks != INT32_MAX) {
+    if (ticks < 0) ticks = 0;
+    deadline = p_os->timer_base_ns + (uint64_t)ticks * GKI_TICK_NS;
+  }
+
+  if (deadline != p_os->timer_deadline_ns) {
+    p_os->timer_deadline_ns = deadline;
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec = deadline / NSEC_PER_SEC;
+    its.it_value.tv_nsec = deadline % NSEC_PER_SEC;
+    if ((gki_timer_fd >= 0) &&
+        (timerfd_settime(gki_timer_fd, TFD_TIMER_ABSTIME, &its, NULL) < 0)) {
+      LOG(ERROR) << StringPrintf("%s: timerfd_settime failed, errno=%d",
+                                 __func__, errno);
+    }
+  }
+
+  /* A far deadline does not hold the wake lock. Without an alarm timer it
+   * then runs late if the system suspends meanwhile. */
+  if (deadline) {
+    gki_timer_wake_lock(ticks < GKI_MS_TO_TICKS(GKI_TIMER_WAKE_LOCK_IDLE_MS));
   }
+  GKI_enable();
 }
 
 /*******************************************************************************
@@ -473,8 +685,6 @@ void timer_thread(signed long id) {
 *******************************************************************************/
 void GKI_run(__attribute__((unused)) void* p_task_id) {
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s enter", __func__);
-  struct timespec delay;
-  int err = 0;
 #if (NXP_EXTNS == TRUE)
   uint8_t rtask = 0;
   (void)p_task_id;
@@ -517,54 +727,49 @@ void GKI_run(__attribute__((unused)) void* p_task_id) {
 #if (NXP_EXTNS == TRUE)
   rtask = GKI_get_taskid();
 #endif
-  for (; GKI_TIMER_TICK_EXIT_COND != *p_run_cond;) {
-    do {
-      /* adjust hear bit tick in btld by changning TICKS_PER_SEC!!!!! this
-       * formula works only for
-       * 1-1000ms heart beat units! */
-      delay.tv_sec = LINUX_SEC / 1000;
-      delay.tv_nsec = 1000 * 1000 * (LINUX_SEC % 1000);
+  /* Tickless timer service: sleep until the earliest timer expiry instead of
+   * waking up on every tick */
+  while (GKI_TIMER_TICK_EXIT_COND != *p_run_cond) {
+    uint64_t expirations;
+
+    if (gki_timer_fd < 0) {
+      /* No timerfd, poll the timers as before */
+      struct timespec delay;
+      int err;
+
+      delay.tv_sec = GKI_TIMER_POLL_MS / 1000;
+      delay.tv_nsec = 1000 * 1000 * (GKI_TIMER_POLL_MS % 1000);
 
       /* [u]sleep can't be used because it uses SIGALRM */
       do {
         err = nanosleep(&delay, &delay);
       } while (err < 0 && errno == EINTR);
-
-      if (GKI_TIMER_TICK_RUN_COND != *p_run_cond) break;  // GKI has shutdown
-
-      /* the unit should be alsways 1 (1 tick). only if you vary for some reason
-       * heart beat tick
-       * e.g. power saving you may want to provide more ticks
-       */
-      GKI_timer_update(1);
-    } while (GKI_TIMER_TICK_RUN_COND == *p_run_cond);
-
-/* currently on reason to exit above loop is no_timer_suspend ==
- * GKI_TIMER_TICK_STOP_COND
- * block timer main thread till re-armed by  */
-#ifdef GKI_TICK_TIMER_DEBUG
-    DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(">>> SUSPENDED");
-#endif
-#if (NXP_EXTNS == TRUE)
-    if (gki_cb.com.OSRdyTbl[rtask] == TASK_DEAD) {
-      gki_cb.com.OSWaitEvt[rtask] = 0;
-      DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf
-              ("GKI TASK_DEAD received. exit thread %d...", rtask);
-      gki_cb.os.thread_id[rtask] = 0;
+    } else if (read(gki_timer_fd, &expirations, sizeof(expirations)) < 0) {
+      if (errno == EINTR) continue;
+      LOG(ERROR) << StringPrintf("%s: timerfd read failed, errno=%d",
+                                 __func__, errno);
+      break;
     }
-#endif
-    if (GKI_TIMER_TICK_EXIT_COND != *p_run_cond) {
-      pthread_mutex_lock(&gki_cb.os.gki_timer_mutex);
-      pthread_cond_wait(&gki_cb.os.gki_timer_cond, &gki_cb.os.gki_timer_mutex);
-      pthread_mutex_unlock(&gki_cb.os.gki_timer_mutex);
-    }
-/* potentially we need to adjust os gki_cb.com.OSTicks */
+    if (GKI_TIMER_TICK_EXIT_COND == *p_run_cond) break;  // GKI has shutdown
+
+    GKI_disable();
+    /* the timerfd is disarmed once it has fired */
+    gki_cb.os.timer_deadline_ns = 0;
+    gki_timer_wake_lock(true);
+    gki_timer_sync();
+    gki_timer_arm();
+    GKI_enable();
+  }
 
-#ifdef GKI_TICK_TIMER_DEBUG
+#if (NXP_EXTNS == TRUE)
+  if (gki_cb.com.OSRdyTbl[rtask] == TASK_DEAD) {
+    __atomic_store_n(&gki_cb.com.OSWaitEvt[rtask], 0, __ATOMIC_SEQ_CST);
     DLOG_IF(INFO, nfc_debug_enabled)
-        << StringPrintf(">>> RESTARTED run_cond: %d", *p_run_cond);
+        << StringPrintf("GKI TASK_DEAD received. exit thread %d...", rtask);
+    gki_cb.os.thread_id[rtask] = 0;
+    gki_thread_id.valid = false;
+  }
 #endif
-  } /* for */
 #endif
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s exit", __func__);
 }
@@ -640,79 +845,55 @@ uint16_t GKI_wait(uint16_t flag, uint32_t timeout) {
   }
   gki_cb.com.OSWaitForEvt[rtask] = flag;
 
-  /* protect OSWaitEvt[rtask] from modification from an other thread */
+  /* serialize with senders that found this task blocked */
   pthread_mutex_lock(&gki_cb.os.thread_evt_mutex[rtask]);
 
-#if 0 /* for clean scheduling we probably should always call \
-         pthread_cond_wait() */
-    /* Check if anything in any of the mailboxes. There is a potential race condition where OSTaskQFirst[rtask]
-     has been modified. however this should only result in addtional call to  pthread_cond_wait() but as
-     the cond is met, it will exit immediately (depending on schedulling) */
-    if (gki_cb.com.OSTaskQFirst[rtask][0])
-    gki_cb.com.OSWaitEvt[rtask] |= TASK_MBOX_0_EVT_MASK;
-    if (gki_cb.com.OSTaskQFirst[rtask][1])
-    gki_cb.com.OSWaitEvt[rtask] |= TASK_MBOX_1_EVT_MASK;
-    if (gki_cb.com.OSTaskQFirst[rtask][2])
-    gki_cb.com.OSWaitEvt[rtask] |= TASK_MBOX_2_EVT_MASK;
-    if (gki_cb.com.OSTaskQFirst[rtask][3])
-    gki_cb.com.OSWaitEvt[rtask] |= TASK_MBOX_3_EVT_MASK;
-#endif
-
-  if (!(gki_cb.com.OSWaitEvt[rtask] & flag)) {
-    if (timeout) {
-      //            timeout = GKI_MS_TO_TICKS(timeout);     /* convert from
-      //            milliseconds to ticks */
-
-      /* get current system time */
-      //            clock_gettime(CLOCK_MONOTONIC, &currSysTime);
-      //            abstime.tv_sec = currSysTime.time;
-      //            abstime.tv_nsec = NANOSEC_PER_MILLISEC *
-      //            currSysTime.millitm;
-
-
-      /* TODO: Need to check for the return status for ret_clk */
-      int ret_clk = clock_gettime(CLOCK_MONOTONIC, &abstime);
-      if (ret_clk == -1) {
-        LOG(ERROR) << StringPrintf("%s: clock_gettime failed\n", __func__);
-      }
-
-      /* add timeout */
-      sec = timeout / 1000;
-      nano_sec = (timeout % 1000) * NANOSEC_PER_MILLISEC;
-      abstime.tv_nsec += nano_sec;
-      if (abstime.tv_nsec > NSEC_PER_SEC) {
-        abstime.tv_sec += (abstime.tv_nsec / NSEC_PER_SEC);
-        abstime.tv_nsec = abstime.tv_nsec % NSEC_PER_SEC;
+  if (!(__atomic_load_n(&gki_cb.com.OSWaitEvt[rtask], __ATOMIC_SEQ_CST) &
+        flag)) {
+    /* Announce that we are about to block, then look again: a sender either
+     * sees the flag and signals under the mutex, or its event is seen here */
+    __atomic_store_n(&gki_cb.os.thread_evt_waiting[rtask], 1,
+                     __ATOMIC_SEQ_CST);
+
+    if (!(__atomic_load_n(&gki_cb.com.OSWaitEvt[rtask], __ATOMIC_SEQ_CST) &
+          flag)) {
+      if (timeout) {
+        /* TODO: Need to check for the return status for ret_clk */
+        int ret_clk = clock_gettime(CLOCK_MONOTONIC, &abstime);
+        if (ret_clk == -1) {
+          LOG(ERROR) << StringPrintf("%s: clock_gettime failed\n", __func__);
+        }
+
+        /* add timeout */
+        sec = timeout / 1000;
+        nano_sec = (timeout % 1000) * NANOSEC_PER_MILLISEC;
+        abstime.tv_nsec += nano_sec;
+        if (abstime.tv_nsec > NSEC_PER_SEC) {
+          abstime.tv_sec += (abstime.tv_nsec / NSEC_PER_SEC);
+          abstime.tv_nsec = abstime.tv_nsec % NSEC_PER_SEC;
+        }
+        abstime.tv_sec += sec;
+
+        pthread_cond_timedwait(&gki_cb.os.thread_evt_cond[rtask],
+                               &gki_cb.os.thread_evt_mutex[rtask], &abstime);
+
+      } else {
+        pthread_cond_wait(&gki_cb.os.thread_evt_cond[rtask],
+                          &gki_cb.os.thread_evt_mutex[rtask]);
       }
-      abstime.tv_sec += sec;
-
-      pthread_cond_timedwait(&gki_cb.os.thread_evt_cond[rtask],
-                             &gki_cb.os.thread_evt_mutex[rtask], &abstime);
-
-    } else {
-      pthread_cond_wait(&gki_cb.os.thread_evt_cond[rtask],
-                        &gki_cb.os.thread_evt_mutex[rtask]);
     }
 
-    /* TODO: check, this is probably neither not needed depending on
-     phtread_cond_wait() implementation,
-     e.g. it looks like it is implemented as a counter in which case multiple
-     cond_signal
-     should NOT be lost! */
-    // we are waking up after waiting for some events, so refresh variables
-    // no need to call GKI_disable() here as we know that we will have some
-    // events as we've been waking up after condition pending or timeout
-    if (gki_cb.com.OSTaskQFirst[rtask][0])
-      gki_cb.com.OSWaitEvt[rtask] |= TASK_MBOX_0_EVT_MASK;
-    if (gki_cb.com.OSTaskQFirst[rtask][1])
-      gki_cb.com.OSWaitEvt[rtask] |= TASK_MBOX_1_EVT_MASK;
-    if (gki_cb.com.OSTaskQFirst[rtask][2])
-      gki_cb.com.OSWaitEvt[rtask] |= TASK_MBOX_2_EVT_MASK;
-    if (gki_cb.com.OSTaskQFirst[rtask][3])
-      gki_cb.com.OSWaitEvt[rtask] |= TASK_MBOX_3_EVT_MASK;
+    /* Running again: senders no longer need to signal us */
+    __atomic_store_n(&gki_cb.os.thread_evt_waiting[rtask], 0,
+                     __ATOMIC_SEQ_CST);
+
+    /* we are waking up after waiting for some events, so refresh variables
+     * from the mailboxes in case a wakeup was coalesced */
+    __atomic_fetch_or(&gki_cb.com.OSWaitEvt[rtask], gki_mbox_pending(rtask),
+                      __ATOMIC_SEQ_CST);
 
     if (gki_cb.com.OSRdyTbl[rtask] == TASK_DEAD) {
-      gki_cb.com.OSWaitEvt[rtask] = 0;
+      __atomic_store_n(&gki_cb.com.OSWaitEvt[rtask], 0, __ATOMIC_SEQ_CST);
       /* unlock thread_evt_mutex as pthread_cond_wait() does auto lock when cond
        * is met */
       pthread_mutex_unlock(&gki_cb.os.thread_evt_mutex[rtask]);
@@ -720,6 +901,7 @@ uint16_t GKI_wait(uint16_t flag, uint32_t timeout) {
                                  rtask);
 
       gki_cb.os.thread_id[rtask] = 0;
+      gki_thread_id.valid = false;
       return (EVENT_MASK(GKI_SHUTDOWN_EVT));
     }
   }
@@ -727,11 +909,10 @@ uint16_t GKI_wait(uint16_t flag, uint32_t timeout) {
   /* Clear the wait for event mask */
   gki_cb.com.OSWaitForEvt[rtask] = 0;
 
-  /* Return only those bits which user wants... */
-  evt = gki_cb.com.OSWaitEvt[rtask] & flag;
-
-  /* Clear only those bits which user wants... */
-  gki_cb.com.OSWaitEvt[rtask] &= ~flag;
+  /* Return and clear only those bits which user wants... */
+  evt = __atomic_fetch_and(&gki_cb.com.OSWaitEvt[rtask], (uint16_t)~flag,
+                           __ATOMIC_SEQ_CST) &
+        flag;
 
   /* unlock thread_evt_mutex as pthread_cond_wait() does auto lock mutex when
    * cond is met */
@@ -802,15 +983,17 @@ void GKI_delay(uint32_t timeout) {
 uint8_t GKI_send_event(uint8_t task_id, uint16_t event) {
   /* use efficient coding to avoid pipeline stalls */
   if (task_id < GKI_MAX_TASKS) {
-    /* protect OSWaitEvt[task_id] from manipulation in GKI_wait() */
-    pthread_mutex_lock(&gki_cb.os.thread_evt_mutex[task_id]);
-
     /* Set the event bit */
-    gki_cb.com.OSWaitEvt[task_id] |= event;
-
-    pthread_cond_signal(&gki_cb.os.thread_evt_cond[task_id]);
-
-    pthread_mutex_unlock(&gki_cb.os.thread_evt_mutex[task_id]);
+    __atomic_fetch_or(&gki_cb.com.OSWaitEvt[task_id], event, __ATOMIC_SEQ_CST);
+
+    /* A running task picks the event up on its next GKI_wait(), only wake it
+     * up if it is blocked (or about to block) */
+    if (__atomic_load_n(&gki_cb.os.thread_evt_waiting[task_id],
+                        __ATOMIC_SEQ_CST)) {
+      pthread_mutex_lock(&gki_cb.os.thread_evt_mutex[task_id]);
+      pthread_cond_signal(&gki_cb.os.thread_evt_cond[task_id]);
+      pthread_mutex_unlock(&gki_cb.os.thread_evt_mutex[task_id]);
+    }
 
     return (GKI_SUCCESS);
   }
@@ -862,9 +1045,15 @@ uint8_t GKI_isend_event(uint8_t task_id, uint16_t event) {
 uint8_t GKI_get_taskid(void) {
   int i;
 
+  if (gki_thread_id.valid) return (gki_thread_id.task_id);
+
+  /* GKI tasks set their id when they start, so only threads that are not
+   * (yet) known end up scanning the table */
   pthread_t thread_id = pthread_self();
   for (i = 0; i < GKI_MAX_TASKS; i++) {
     if (gki_cb.os.thread_id[i] == thread_id) {
+      gki_thread_id.task_id = (uint8_t)i;
+      gki_thread_id.valid = true;
       return (i);
     }
   }
@@ -872,6 +1061,58 @@ uint8_t GKI_get_taskid(void) {
   return (-1);
 }
 
+/*******************************************************************************
+**
+** Function         GKI_register_thread
+**
+** Description      This function gives a thread that was not created by
+**                  GKI_create_task(), e.g. a HAL callback thread, a stable id
+**                  for the lifetime of the thread instead of -1. The id is
+**                  released automatically when the thread exits.
+**
+**                  Registered ids start at GKI_FOREIGN_TASK_BASE. They are
+**                  not task ids: the thread still cannot wait for events,
+**                  read a mailbox or run GKI timers.
+**
+** Returns          the id of the calling thread, -1 if all ids are in use
+**
+*******************************************************************************/
+uint8_t GKI_register_thread(void) {
+  uint8_t task_id = GKI_get_taskid();
+  uint8_t xx;
+
+  if (task_id < GKI_MAX_TASKS || gki_thread_id.foreign) return (task_id);
+
+  /* The slot mask is atomic so that a thread exiting after GKI_shutdown()
+   * does not need the GKI mutex to give its id back */
+  uint32_t mask = __atomic_load_n(&gki_cb.os.foreign_thread_mask,
+                                  __ATOMIC_RELAXED);
+  do {
+    for (xx = 0; xx < GKI_MAX_FOREIGN_THREADS; xx++) {
+      if (!(mask & (1u << xx))) break;
+    }
+    if (xx == GKI_MAX_FOREIGN_THREADS) {
+      LOG(ERROR) << StringPrintf("%s: no free id", __func__);
+      return (-1);
+    }
+  } while (!__atomic_compare_exchange_n(&gki_cb.os.foreign_thread_mask, &mask,
+                                        mask | (1u << xx), false,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+  gki_thread_id.task_id = (uint8_t)(GKI_FOREIGN_TASK_BASE + xx);
+  gki_thread_id.foreign = true;
+  gki_thread_id.valid = true;
+
+  return (gki_thread_id.task_id);
+}
+
+GkiThreadId::~GkiThreadId() {
+  if (!foreign) return;
+
+  __atomic_fetch_and(&gki_cb.os.foreign_thread_mask,
+                     ~(1u << (task_id - GKI_FOREIGN_TASK_BASE)), __ATOMIC_RELAXED);
+}
+
 /*******************************************************************************
 **
 ** Function         GKI_map_taskname
@@ -898,7 +1139,9 @@ int8_t* GKI_map_taskname(uint8_t task_id) {
         "GKI_map_taskname %d %s done", task_id, gki_cb.com.OSTName[task_id]);
     return (gki_cb.com.OSTName[task_id]);
   } else if (task_id == GKI_MAX_TASKS) {
-    return (gki_cb.com.OSTName[GKI_get_taskid()]);
+    task_id = GKI_get_taskid();
+    if (task_id < GKI_MAX_TASKS) return (gki_cb.com.OSTName[task_id]);
+    return (int8_t*)"BAD";
   } else {
     return (int8_t*)"BAD";
   }
@@ -18,7 +18,20 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
 
+/*******************************************************************************
+**
+** Function         crcChecksumUpdate
+**
+** Description      Continue a checksum with more data.
+**                  crc: checksum of the preceding data, 0 to start.
+**
+** Returns          2-byte checksum.
+**
+*******************************************************************************/
+unsigned short crcChecksumUpdate(unsigned short crc, const unsigned char* buffer,
+                                 size_t bufferLen);
 
 /*******************************************************************************
 **
@@ -133,6 +133,7 @@ class NfcAdaptation {
   tHAL_NFC_ENTRY mHalEntryFuncs;  // function pointers for HAL entry points
   static tHAL_NFC_CBACK* mHalCallback;
   static tHAL_NFC_DATA_CBACK* mHalDataCallback;
+  static tHAL_NFC_RX_CBACKS mHalRxCallbacks;
   static ThreadCondVar mHalOpenCompletedEvent;
   static ThreadCondVar mHalCloseCompletedEvent;
   static ThreadCondVar mHalIoctlEvent;
@@ -148,6 +149,9 @@ class NfcAdaptation {
 #endif
   static uint32_t NFCA_TASK(uint32_t arg);
   static uint32_t Thread(uint32_t arg);
+  static void StartConfigWatch();
+  static void StopConfigWatch();
+  static void* ConfigWatchThread(void* arg);
   void InitializeHalDeviceContext();
   static void HalDeviceContextCallback(nfc_event_t event,
                                        nfc_status_t event_status);
@@ -157,6 +161,7 @@ class NfcAdaptation {
   static void HalTerminate();
   static void HalOpen(tHAL_NFC_CBACK* p_hal_cback,
                       tHAL_NFC_DATA_CBACK* p_data_cback);
+  static void HalSetRxCallbacks(const tHAL_NFC_RX_CBACKS* p_rx_cbacks);
   static void HalClose();
   static void HalCoreInitialized(uint16_t data_len,
                                  uint8_t* p_core_init_rsp_params);
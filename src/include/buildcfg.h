@@ -58,7 +58,15 @@
 #define GKI_BUF4_MAX 30
 #endif
 
+#if (NXP_EXTNS == TRUE)
+/* 5 is the dedicated HAL receive pool, see NFC_RX_POOL_ID */
+#define GKI_BUF5_SIZE 660
+#define GKI_BUF5_MAX 32
+#define NFC_RX_POOL_ID GKI_POOL_ID_5
+#define NFC_RX_POOL_BUF_SIZE GKI_BUF5_SIZE
+#else
 #define GKI_BUF5_MAX 0
+#endif
 #define GKI_BUF6_MAX 0
 #define GKI_BUF7_MAX 0
 #define GKI_BUF8_MAX 0
@@ -68,7 +76,7 @@
 #define GKI_BUF0_MAX 40
 
 #if (NXP_EXTNS == TRUE)
-#define GKI_NUM_FIXED_BUF_POOLS 5
+#define GKI_NUM_FIXED_BUF_POOLS 6
 #else
 #define GKI_NUM_FIXED_BUF_POOLS 4
 #endif
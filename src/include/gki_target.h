@@ -113,6 +113,18 @@
 #define GKI_MAX_TASKS 15
 #endif
 
+/* The number of non-GKI threads (e.g. HAL callback threads) that can hold a
+ * registered id at the same time. */
+#ifndef GKI_MAX_FOREIGN_THREADS
+#define GKI_MAX_FOREIGN_THREADS 16
+#endif
+
+/* The first id of the non-GKI threads. It is kept apart from the task ids and
+ * from GKI_MAX_TASKS, which GKI_map_taskname() takes for the running task. */
+#ifndef GKI_FOREIGN_TASK_BASE
+#define GKI_FOREIGN_TASK_BASE 0x80
+#endif
+
 /******************************************************************************
 **
 ** Timer configuration
@@ -124,14 +136,39 @@
 #define GKI_NUM_TIMERS 3
 #endif
 
-/* A conversion value for translating ticks to calculate GKI timer.  */
+/* Timer lists are kept in a hierarchical wheel of GKI_TIMER_WHEEL_LEVELS
+ * levels with 2^GKI_TIMER_WHEEL_BITS slots each. Timeouts up to
+ * 2^(GKI_TIMER_WHEEL_BITS * GKI_TIMER_WHEEL_LEVELS) - 1 list units are placed
+ * directly, longer ones are re-placed when they reach the top level slot. */
+#ifndef GKI_TIMER_WHEEL_BITS
+#define GKI_TIMER_WHEEL_BITS 5
+#endif
+
+#ifndef GKI_TIMER_WHEEL_LEVELS
+#define GKI_TIMER_WHEEL_LEVELS 4
+#endif
+
+/* A conversion value for translating ticks to calculate GKI timer. The timer
+ * service only wakes up for expiries, so a fine tick costs nothing. */
 #ifndef TICKS_PER_SEC
-#define TICKS_PER_SEC 100
+#define TICKS_PER_SEC 1000
 #endif
 
 /* delay in ticks before stopping system tick. */
 #ifndef GKI_DELAY_STOP_SYS_TICK
-#define GKI_DELAY_STOP_SYS_TICK 10
+#define GKI_DELAY_STOP_SYS_TICK 100
+#endif
+
+/* If the next timer expiry is at least this many ms away, the timer service
+ * drops its wake lock until then. */
+#ifndef GKI_TIMER_WAKE_LOCK_IDLE_MS
+#define GKI_TIMER_WAKE_LOCK_IDLE_MS 100
+#endif
+
+/* Period in ms of the timer service when no timerfd can be created, as it
+ * then polls with nanosleep(). */
+#ifndef GKI_TIMER_POLL_MS
+#define GKI_TIMER_POLL_MS 10
 #endif
 
 /******************************************************************************
@@ -281,9 +318,35 @@ of order */
 #define GKI_BUF5_SIZE 748
 #endif
 
-/* The buffer corruption check flag. */
+/* The buffer corruption check flag. Only enabled on debug builds since it
+** touches the trailing magic word of every buffer on the hot path. */
 #ifndef GKI_ENABLE_BUF_CORRUPTION_CHECK
+#if !defined(NDEBUG)
 #define GKI_ENABLE_BUF_CORRUPTION_CHECK true
+#else
+#define GKI_ENABLE_BUF_CORRUPTION_CHECK false
+#endif
+#endif
+
+/* The number of free buffers each thread may keep per pool in its local
+** cache. 0 disables the per-thread buffer caches. */
+#ifndef GKI_BUF_CACHE_SIZE
+#define GKI_BUF_CACHE_SIZE 4
+#endif
+
+/* The number of buffers moved between a thread cache and its pool at once. */
+#ifndef GKI_BUF_CACHE_BATCH
+#define GKI_BUF_CACHE_BATCH 2
+#endif
+
+/* Pools holding fewer buffers than this are never cached per thread. */
+#ifndef GKI_BUF_CACHE_MIN_POOL
+#define GKI_BUF_CACHE_MIN_POOL 32
+#endif
+
+/* At most 1/GKI_BUF_CACHE_POOL_SHARE of a pool may sit in thread caches. */
+#ifndef GKI_BUF_CACHE_POOL_SHARE
+#define GKI_BUF_CACHE_POOL_SHARE 4
 #endif
 
 /* The GKI severe error macro. */
@@ -15,6 +15,9 @@
  */
 #pragma once
 
+#include <atomic>
+#include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -38,6 +41,14 @@
 #define NAME_DEFAULT_SYS_CODE_ROUTE "DEFAULT_SYS_CODE_ROUTE"
 #define NAME_AID_MATCHING_MODE "AID_MATCHING_MODE"
 #define NAME_OFFHOST_AID_ROUTE_PWR_STATE "OFFHOST_AID_ROUTE_PWR_STATE"
+#define NAME_NFCSNOOP_PAYLOAD_BUDGET "NFCSNOOP_PAYLOAD_BUDGET"
+#define NAME_NFCSNOOP_EXPORT_PATH "NFCSNOOP_EXPORT_PATH"
+#define NAME_NFCSNOOP_EXPORT_FILE_SIZE "NFCSNOOP_EXPORT_FILE_SIZE"
+#define NAME_NFCSNOOP_EXPORT_FILE_COUNT "NFCSNOOP_EXPORT_FILE_COUNT"
+#define NAME_NFC_CONFIG_HOT_RELOAD "NFC_CONFIG_HOT_RELOAD"
+#define NAME_NFA_MEM_ARENA_SIZE "NFA_MEM_ARENA_SIZE"
+#define NAME_AID_ROUTE_MAX_ENTRIES "AID_ROUTE_MAX_ENTRIES"
+#define NAME_AID_OVERFLOW_POLICY "AID_OVERFLOW_POLICY"
 /* Configs from vendor interface */
 #define NAME_NFA_POLL_BAIL_OUT_MODE "NFA_POLL_BAIL_OUT_MODE"
 #define NAME_NFA_PROPRIETARY_CFG "NFA_PROPRIETARY_CFG"
@@ -48,6 +59,7 @@
 #define NAME_DEFAULT_NFCF_ROUTE "DEFAULT_NFCF_ROUTE"
 #define NAME_OFF_HOST_ESE_PIPE_ID "OFF_HOST_ESE_PIPE_ID"
 #define NAME_OFF_HOST_SIM_PIPE_ID "OFF_HOST_SIM_PIPE_ID"
+#define NAME_NCI_CMD_PIPELINE_DEPTH "NCI_CMD_PIPELINE_DEPTH"
 #if (NXP_EXTNS == TRUE)
 #define NAME_DEFAULT_AID_ROUTE "DEFAULT_AID_ROUTE"
 #define NAME_DEFAULT_DESFIRE_ROUTE "DEFAULT_DESFIRE_ROUTE"
@@ -103,21 +115,61 @@
 #define NAME_NXPLOG_NCIR_LOGLEVEL "NXPLOG_NCIR_LOGLEVEL"
 #endif
 
+// References returned by getString() and getBytes() stay valid until clear():
+// a reload keeps the configs it replaces. The getters with a default value
+// return a copy, as the default may be a temporary.
 class NfcConfig {
  public:
   static bool hasKey(const std::string& key);
-  static std::string getString(const std::string& key);
+  static const std::string& getString(const std::string& key);
   static std::string getString(const std::string& key,
                                std::string default_value);
   static unsigned getUnsigned(const std::string& key);
   static unsigned getUnsigned(const std::string& key, unsigned default_value);
-  static std::vector<uint8_t> getBytes(const std::string& key);
+  static const std::vector<uint8_t>& getBytes(const std::string& key);
+
+  static bool hasKey(const ConfigKey& key);
+  static const std::string& getString(const ConfigKey& key);
+  static std::string getString(const ConfigKey& key,
+                               std::string default_value);
+  static unsigned getUnsigned(const ConfigKey& key);
+  static unsigned getUnsigned(const ConfigKey& key, unsigned default_value);
+  static const std::vector<uint8_t>& getBytes(const ConfigKey& key);
+
+  // Empties the configs and frees the ones a reload replaced. They are read
+  // again on the next access.
   static void clear();
 
+  // Reads the config files again and replaces the current configs if any
+  // value changed, returning the keys that changed. The vendor configs read
+  // at start are kept.
+  static bool reload(std::vector<std::string>* changed_keys);
+  // Config files a reload reads
+  static std::vector<std::string> getConfigPaths();
+
  private:
   void loadConfig();
+  bool readConfig(ConfigFile& config);
   static NfcConfig& getInstance();
+  static ConfigFile& getConfig();
   NfcConfig();
 
-  ConfigFile config_;
+  std::atomic<ConfigFile*> config_;
+  // The current config is the last one. The configs a reload replaced are
+  // kept until clear(), for the references the getters returned.
+  std::vector<std::unique_ptr<ConfigFile>> configs_;
+  std::map<std::string, ConfigValue> vendor_configs_;
 };
+
+/* Configs read on the discovery and routing paths, looked up through the slot
+ * cached in their key */
+extern ConfigKey KEY_UICC_LISTEN_TECH_MASK;
+#if (NXP_EXTNS == TRUE)
+extern ConfigKey KEY_NFA_DM_DISC_NTF_TIMEOUT;
+extern ConfigKey KEY_HOST_LISTEN_TECH_MASK;
+extern ConfigKey KEY_NXP_FWD_FUNCTIONALITY_ENABLE;
+extern ConfigKey KEY_NXP_ESE_LISTEN_TECH_MASK;
+extern ConfigKey KEY_P2P_LISTEN_TECH_MASK;
+extern ConfigKey KEY_DEFAULT_OFFHOST_ROUTE;
+extern ConfigKey KEY_NXP_DUAL_UICC_ENABLE;
+#endif
@@ -52,6 +52,17 @@ typedef void(tHAL_NFC_STATUS_CBACK)(tHAL_NFC_STATUS status);
 typedef void(tHAL_NFC_CBACK)(uint8_t event, tHAL_NFC_STATUS status);
 typedef void(tHAL_NFC_DATA_CBACK)(uint16_t data_len, uint8_t* p_data);
 
+/* Receive buffer callbacks. rx_lease returns where data_len bytes of the
+** next packet go (NULL to drop it) and the buffer holding them in *pp_buf;
+** rx_deliver hands the filled buffer back to the stack. */
+typedef uint8_t*(tHAL_NFC_RX_LEASE_CBACK)(uint16_t data_len, void** pp_buf);
+typedef void(tHAL_NFC_RX_DELIVER_CBACK)(void* p_buf);
+
+typedef struct {
+  tHAL_NFC_RX_LEASE_CBACK* rx_lease;
+  tHAL_NFC_RX_DELIVER_CBACK* rx_deliver;
+} tHAL_NFC_RX_CBACKS;
+
 /*******************************************************************************
 ** tHAL_NFC_ENTRY HAL entry-point lookup table
 *******************************************************************************/
@@ -68,6 +79,8 @@ typedef bool(tHAL_API_PREDISCOVER)(void);
 typedef void(tHAL_API_CONTROL_GRANTED)(void);
 typedef void(tHAL_API_POWER_CYCLE)(void);
 typedef uint8_t(tHAL_API_GET_MAX_NFCEE)(void);
+/* Receive buffer callbacks for the next open, in place of its data callback */
+typedef void(tHAL_API_SET_RX_CBACKS)(const tHAL_NFC_RX_CBACKS* p_rx_cbacks);
 #if (NXP_EXTNS == TRUE)
 typedef int(tHAL_API_IOCTL)(long arg, void* p_data);
 typedef int(tHAL_API_GET_FW_DWNLD_FLAG)(uint8_t* fwDnldRequest);
@@ -84,6 +97,7 @@ typedef struct {
   tHAL_API_CONTROL_GRANTED* control_granted;
   tHAL_API_POWER_CYCLE* power_cycle;
   tHAL_API_GET_MAX_NFCEE* get_max_ee;
+  tHAL_API_SET_RX_CBACKS* set_rx_cbacks;
 #if (NXP_EXTNS == TRUE)
   tHAL_API_IOCTL* ioctl;
   tHAL_API_GET_FW_DWNLD_FLAG* check_fw_dwnld_flag;
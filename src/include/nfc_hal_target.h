@@ -129,7 +129,7 @@
 
 /* Quick Timer */
 #ifndef QUICK_TIMER_TICKS_PER_SEC
-#define QUICK_TIMER_TICKS_PER_SEC 100 /* 10ms timer */
+#define QUICK_TIMER_TICKS_PER_SEC 1000 /* 1ms timer */
 #endif
 
 #ifndef NFC_HAL_SHARED_TRANSPORT_ENABLED
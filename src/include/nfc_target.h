@@ -123,6 +123,22 @@
 #define NFC_NCI_POOL_BUF_SIZE GKI_BUF2_SIZE
 #endif
 
+/* NCI packets received from the HAL. The adaptation layer copies them
+** straight into buffers leased from this pool. */
+#ifndef NFC_RX_POOL_ID
+#define NFC_RX_POOL_ID NFC_NCI_POOL_ID
+#endif
+
+#ifndef NFC_RX_POOL_BUF_SIZE
+#define NFC_RX_POOL_BUF_SIZE NFC_NCI_POOL_BUF_SIZE
+#endif
+
+/* Number of received data fragments chained on a connection before they are
+** merged into one buffer, bounding the buffers held by a long message. */
+#ifndef NFC_RAS_MAX_FRAGMENTS
+#define NFC_RAS_MAX_FRAGMENTS 8
+#endif
+
 /* Reader/Write commands (NCI data payload) */
 #ifndef NFC_RW_POOL_ID
 #define NFC_RW_POOL_ID GKI_POOL_ID_2
@@ -239,6 +255,19 @@
 #define NCI_MAX_CMD_WINDOW 1
 #endif
 
+/* Maximum number of CORE_SET_CONFIG/RF_SET_LISTEN_MODE_ROUTING commands sent
+ * ahead of the responses to the previous ones. The depth in use is read from
+ * NCI_CMD_PIPELINE_DEPTH in the config file, 1 (no pipelining) by default. */
+#ifndef NFC_MAX_CMD_PIPELINE
+#define NFC_MAX_CMD_PIPELINE 4
+#endif
+
+/* Number of times outstanding pipelined commands are sent again when the
+ * response to the oldest one times out, before starting the recovery */
+#ifndef NFC_CMD_PIPELINE_RETRIES
+#define NFC_CMD_PIPELINE_RETRIES 1
+#endif
+
 /* Define to true to include the NFCEE related functionalities */
 #ifndef NFC_NFCEE_INCLUDED
 #define NFC_NFCEE_INCLUDED true
@@ -368,7 +397,7 @@
 
 /* Quick Timer */
 #ifndef QUICK_TIMER_TICKS_PER_SEC
-#define QUICK_TIMER_TICKS_PER_SEC 100 /* 10ms timer */
+#define QUICK_TIMER_TICKS_PER_SEC 1000 /* 1ms timer */
 #endif
 
 /******************************************************************************
@@ -686,6 +715,16 @@
 #define NFA_EE_MAX_AID_ENTRIES (10)
 #endif
 
+/* AID entries the routing store of an ECB starts with. It doubles when full */
+#ifndef NFA_EE_AID_STORE_MIN_ENTRIES
+#define NFA_EE_AID_STORE_MIN_ENTRIES 8
+#endif
+
+/* Default cap on the AID entries kept per ECB, see AID_ROUTE_MAX_ENTRIES */
+#ifndef NFA_EE_AID_STORE_MAX_ENTRIES
+#define NFA_EE_AID_STORE_MAX_ENTRIES 255
+#endif
+
 #define NFA_EE_MAX_APDU_PATTERN_ENTRIES (5)
 /* Maximum number of callback functions can be registered through
  * NFA_EeRegister() */
@@ -707,13 +746,13 @@
     nfc_cb.p_hal->write((p)->len, (uint8_t*)((p) + 1) + (p)->offset); \
     GKI_freebuf(p);                                             \
   }
+/* Write without giving up the buffer, e.g. a fragment sent in place */
+#define HAL_RE_WRITE(p) \
+  { nfc_cb.p_hal->write(p->len, (uint8_t*)(p + 1) + p->offset); }
 #if (NXP_EXTNS == TRUE)
 /*Mem alloc with 8 byte alignment*/
 #define size_align(sz) ((((sz)-1) | 7) + 1)
 #define HAL_MALLOC(size) malloc(size_align((size)))
-
-#define HAL_RE_WRITE(p) \
-  { nfc_cb.p_hal->write(p->len, (uint8_t*)(p + 1) + p->offset); }
 #endif
 
 #ifdef NFC_HAL_SHARED_GKI
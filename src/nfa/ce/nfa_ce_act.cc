@@ -223,15 +223,17 @@ void nfa_ce_handle_t4t_evt(tCE_EVENT event, tCE_DATA* p_ce_data) {
 *******************************************************************************/
 void nfa_ce_handle_t4t_aid_evt(tCE_EVENT event, tCE_DATA* p_ce_data) {
   tNFA_CE_CB* p_cb = &nfa_ce_cb;
-  uint8_t listen_info_idx;
+  uint8_t listen_info_idx = NFA_CE_LISTEN_INFO_IDX_INVALID;
   tNFA_CONN_EVT_DATA conn_evt;
 
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("nfa_ce_handle_t4t_aid_evt: event 0x%x", event);
 
   /* Get listen_info for this aid callback */
-  for (listen_info_idx = 0; listen_info_idx < NFA_CE_LISTEN_INFO_IDX_INVALID;
-       listen_info_idx++) {
-    if ((p_cb->listen_info[listen_info_idx].flags &
+  if (p_ce_data->raw_frame.aid_handle <= CE_T4T_MAX_REG_AID) {
+    listen_info_idx =
+        p_cb->t4t_aid_listen_idx[p_ce_data->raw_frame.aid_handle];
+    if ((listen_info_idx < NFA_CE_LISTEN_INFO_IDX_INVALID) &&
+        (p_cb->listen_info[listen_info_idx].flags &
          NFA_CE_LISTEN_INFO_IN_USE) &&
         (p_cb->listen_info[listen_info_idx].flags &
          NFA_CE_LISTEN_INFO_T4T_AID) &&
@@ -240,7 +242,8 @@ void nfa_ce_handle_t4t_aid_evt(tCE_EVENT event, tCE_DATA* p_ce_data) {
       p_cb->idx_cur_active = listen_info_idx;
       p_cb->p_active_conn_cback =
           p_cb->listen_info[p_cb->idx_cur_active].p_conn_cback;
-      break;
+    } else {
+      listen_info_idx = NFA_CE_LISTEN_INFO_IDX_INVALID;
     }
   }
 
@@ -709,6 +712,9 @@ void nfa_ce_remove_listen_info_entry(uint8_t listen_info_idx, bool notify_app) {
            NFA_CE_LISTEN_INFO_T4T_AID) {
     /* Free t4t_aid_cback used by this AID */
     CE_T4tDeregisterAID(p_cb->listen_info[listen_info_idx].t4t_aid_handle);
+    p_cb->t4t_aid_listen_idx[p_cb->listen_info[listen_info_idx]
+                                 .t4t_aid_handle] =
+        NFA_CE_LISTEN_INFO_IDX_INVALID;
   }
 
   if (p_cb->listen_info[listen_info_idx].rf_disc_handle != NFA_HANDLE_INVALID) {
@@ -1404,6 +1410,9 @@ bool nfa_ce_api_reg_listen(tNFA_CE_MSG* p_ce_msg) {
   tNFA_CONN_EVT_DATA conn_evt;
   uint8_t i;
   uint8_t listen_info_idx = NFA_CE_LISTEN_INFO_IDX_INVALID;
+  /* CE T4T AIDs before the entry is added, to go back to on failure */
+  uint8_t aid_table[CE_T4T_AID_SAVE_SIZE];
+  uint16_t aid_table_len = 0;
 
 #if (NXP_EXTNS == TRUE)
    DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
@@ -1503,9 +1512,12 @@ bool nfa_ce_api_reg_listen(tNFA_CE_MSG* p_ce_msg) {
             p_ce_msg->reg_listen.p_conn_cback;
 
         /* Register this AID with CE_T4T */
-        p_cb->listen_info[listen_info_idx].t4t_aid_handle = CE_T4tRegisterAID(
-            p_ce_msg->reg_listen.aid_len, p_ce_msg->reg_listen.aid,
-            nfa_ce_handle_t4t_aid_evt);
+        aid_table_len = CE_T4tSaveAIDs(aid_table);
+        p_cb->listen_info[listen_info_idx].t4t_aid_handle =
+            CE_T4tRegisterAIDMatch(p_ce_msg->reg_listen.aid_len,
+                                   p_ce_msg->reg_listen.aid,
+                                   p_ce_msg->reg_listen.aid_match,
+                                   nfa_ce_handle_t4t_aid_evt);
         if (p_cb->listen_info[listen_info_idx].t4t_aid_handle ==
             CE_T4T_AID_HANDLE_INVALID) {
           LOG(ERROR) << StringPrintf("Unable to register AID");
@@ -1519,6 +1531,8 @@ bool nfa_ce_api_reg_listen(tNFA_CE_MSG* p_ce_msg) {
 
           return true;
         }
+        p_cb->t4t_aid_listen_idx[p_cb->listen_info[listen_info_idx]
+                                     .t4t_aid_handle] = listen_info_idx;
         if (p_cb->listen_info[listen_info_idx].t4t_aid_handle ==
             CE_T4T_WILDCARD_AID_HANDLE)
           nfa_ce_cb.idx_wild_card = listen_info_idx;
@@ -1612,6 +1626,15 @@ bool nfa_ce_api_reg_listen(tNFA_CE_MSG* p_ce_msg) {
   if (conn_evt.status != NFA_STATUS_OK) {
     LOG(ERROR) << StringPrintf(
         "nfa_ce_api_reg_listen: unable to register new listen params with DM");
+    if (p_cb->listen_info[listen_info_idx].flags & NFA_CE_LISTEN_INFO_T4T_AID) {
+      /* Drop the AID of the entry, the other AIDs keep their handles */
+      CE_T4tLoadAIDs(aid_table, aid_table_len);
+      p_cb->t4t_aid_listen_idx[p_cb->listen_info[listen_info_idx]
+                                   .t4t_aid_handle] =
+          NFA_CE_LISTEN_INFO_IDX_INVALID;
+      if (p_cb->idx_wild_card == listen_info_idx)
+        p_cb->idx_wild_card = NFA_CE_LISTEN_INFO_IDX_INVALID;
+    }
     p_cb->listen_info[listen_info_idx].flags = 0;
   }
 
@@ -413,15 +413,47 @@ tNFA_STATUS NFA_CeDeregisterFelicaSystemCodeOnDH(tNFA_HANDLE handle) {
 *******************************************************************************/
 tNFA_STATUS NFA_CeRegisterAidOnDH(uint8_t aid[NFC_MAX_AID_LEN], uint8_t aid_len,
                                   tNFA_CONN_CBACK* p_conn_cback) {
+  return NFA_CeRegisterAidMatchOnDH(aid, aid_len, NFA_CE_AID_MATCH_EXACT,
+                                    p_conn_cback);
+}
+
+/*******************************************************************************
+**
+** Function         NFA_CeRegisterAidMatchOnDH
+**
+** Description      Register listening callback for the specified ISODEP AID,
+**                  selected as given by match (NFA_CE_AID_MATCH_xxx).
+**                  NFA_CeRegisterAidOnDH registers with
+**                  NFA_CE_AID_MATCH_EXACT.
+**
+**                  The NFA_CE_REGISTERED_EVT reports the status of the
+**                  operation.
+**
+**                  When several AIDs match a SELECT, the one matching all of
+**                  the selected AID is used, otherwise the longest prefix.
+**
+** Note:            If RF discovery is started,
+**                  NFA_StopRfDiscovery()/NFA_RF_DISCOVERY_STOPPED_EVT should
+**                  happen before calling this function
+**
+** Returns:
+**                  NFA_STATUS_OK, if command accepted
+**                  NFA_STATUS_FAILED: otherwise
+**
+*******************************************************************************/
+tNFA_STATUS NFA_CeRegisterAidMatchOnDH(uint8_t aid[NFC_MAX_AID_LEN],
+                                       uint8_t aid_len, uint8_t match,
+                                       tNFA_CONN_CBACK* p_conn_cback) {
   tNFA_CE_MSG* p_msg;
 
   DLOG_IF(INFO, nfc_debug_enabled) << __func__;
 
 /* Validate parameters */
 #if (NXP_EXTNS == TRUE)
-  if ((p_conn_cback == NULL) || (aid_len > NFC_MAX_AID_LEN))
+  if ((p_conn_cback == NULL) || (aid_len > NFC_MAX_AID_LEN) ||
+      (match > NFA_CE_AID_MATCH_SUBSET))
 #else
-  if (p_conn_cback == NULL)
+  if ((p_conn_cback == NULL) || (match > NFA_CE_AID_MATCH_SUBSET))
 #endif
     return (NFA_STATUS_INVALID_PARAM);
 
@@ -434,6 +466,7 @@ tNFA_STATUS NFA_CeRegisterAidOnDH(uint8_t aid[NFC_MAX_AID_LEN], uint8_t aid_len,
     /* Listen info */
     memcpy(p_msg->reg_listen.aid, aid, aid_len);
     p_msg->reg_listen.aid_len = aid_len;
+    p_msg->reg_listen.aid_match = match;
 
     nfa_sys_sendmsg(p_msg);
 
@@ -51,6 +51,7 @@
 #include "nfa_rw_api.h"
 #include "nfa_p2p_int.h"
 #include "nci_hmsgs.h"
+#include "nfc_config.h"
 
 #if (NFC_NFCEE_INCLUDED == true)
 #include "hal_nxpese.h"
@@ -984,6 +985,92 @@ bool nfa_dm_act_send_raw_vs(tNFA_DM_MSG* p_data) {
   return false;
 }
 
+/* How a reload applies a changed config. The configs not listed are only read
+** when NFC is initialized. */
+#define NFA_DM_RELOAD_ON_USE 0x01  /* read every time it is used          */
+#define NFA_DM_RELOAD_DISC 0x02    /* read when RF discovery is started   */
+#define NFA_DM_RELOAD_ROUTING 0x04 /* read when routing table is built    */
+
+typedef struct {
+  const char* p_name;
+  uint8_t apply;
+} tNFA_DM_RELOAD_CFG;
+
+static const tNFA_DM_RELOAD_CFG nfa_dm_reload_cfg[] = {
+    {NAME_UICC_LISTEN_TECH_MASK, NFA_DM_RELOAD_DISC},
+#if (NXP_EXTNS == TRUE)
+    {NAME_HOST_LISTEN_TECH_MASK, NFA_DM_RELOAD_DISC},
+    {NAME_NXP_ESE_LISTEN_TECH_MASK, NFA_DM_RELOAD_DISC},
+    {NAME_P2P_LISTEN_TECH_MASK, NFA_DM_RELOAD_DISC},
+    {NAME_NXP_FWD_FUNCTIONALITY_ENABLE, NFA_DM_RELOAD_DISC},
+    {NAME_NFA_DM_DISC_NTF_TIMEOUT, NFA_DM_RELOAD_ON_USE},
+    {NAME_NXP_DUAL_UICC_ENABLE, NFA_DM_RELOAD_ON_USE},
+    {NAME_NXP_DEFAULT_NFCEE_TIMEOUT, NFA_DM_RELOAD_ON_USE},
+    {NAME_NXP_DEFAULT_NFCEE_DISC_TIMEOUT, NFA_DM_RELOAD_ON_USE},
+    {NAME_DEFAULT_OFFHOST_ROUTE, NFA_DM_RELOAD_ROUTING},
+#endif
+};
+
+/*******************************************************************************
+**
+** Function         nfa_dm_act_reload_config
+**
+** Description      Read the config files again and apply the changed configs
+**                  that are read after NFC is initialized
+**
+** Returns          true (message buffer to be freed by caller)
+**
+*******************************************************************************/
+bool nfa_dm_act_reload_config(__attribute__((unused)) tNFA_DM_MSG* p_data) {
+  std::vector<std::string> keys;
+  tNFA_DM_CBACK_DATA dm_cback_data;
+  uint8_t apply = 0;
+  size_t xx;
+
+  if (!NfcConfig::reload(&keys)) return (true);
+
+  dm_cback_data.config_reloaded.status = NFA_STATUS_OK;
+  dm_cback_data.config_reloaded.restart_required = false;
+  for (const std::string& key : keys) {
+    for (xx = 0; xx < sizeof(nfa_dm_reload_cfg) / sizeof(tNFA_DM_RELOAD_CFG);
+         xx++) {
+      if (key == nfa_dm_reload_cfg[xx].p_name) break;
+    }
+    if (xx < sizeof(nfa_dm_reload_cfg) / sizeof(tNFA_DM_RELOAD_CFG)) {
+      apply |= nfa_dm_reload_cfg[xx].apply;
+    } else {
+      LOG(WARNING) << StringPrintf("%s: %s changes on restart", __func__,
+                                   key.c_str());
+      dm_cback_data.config_reloaded.restart_required = true;
+    }
+  }
+
+  DLOG_IF(INFO, nfc_debug_enabled)
+      << StringPrintf("%s: apply:0x%02x", __func__, apply);
+
+  /* Everything is read again by NFA_Enable, nothing to apply until then */
+  if (!nfa_dm_is_active()) {
+    dm_cback_data.config_reloaded.restart_required = false;
+  } else {
+    /* Restarting discovery sends the listen configs again with
+    ** nfa_dm_check_set_config(). An activated link is left alone, the configs
+    ** are used from the next time discovery is started. */
+    if ((apply & NFA_DM_RELOAD_DISC) &&
+        (nfa_dm_cb.disc_cb.disc_state == NFA_DM_RFST_DISCOVERY) &&
+        (!(nfa_dm_cb.disc_cb.disc_flags & NFA_DM_DISC_FLAGS_W4_RSP))) {
+      nfa_dm_rf_deactivate(NFA_DEACTIVATE_TYPE_IDLE);
+    }
+#if (NFC_NFCEE_INCLUDED == true)
+    if (apply & NFA_DM_RELOAD_ROUTING) nfa_ee_config_reloaded();
+#endif
+  }
+
+  if (nfa_dm_cb.p_dm_cback)
+    (*nfa_dm_cb.p_dm_cback)(NFA_DM_CONFIG_RELOADED_EVT, &dm_cback_data);
+
+  return (true);
+}
+
 /*******************************************************************************
 **
 ** Function         nfa_dm_start_polling
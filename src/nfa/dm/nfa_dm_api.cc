@@ -375,6 +375,36 @@ tNFA_STATUS NFA_SetTransitConfig(std::string config) {
   }
   return (NFA_STATUS_FAILED);
 }
+/*******************************************************************************
+**
+** Function         NFA_ReloadConfig
+**
+** Description      Read the config files again and apply the configs that
+**                  changed. If any config changed, an
+**                  NFA_DM_CONFIG_RELOADED_EVT is reported in the tNFA_DM_CBACK
+**                  callback.
+**
+** Returns          NFA_STATUS_OK if successfully initiated
+**                  NFA_STATUS_FAILED otherwise
+**
+*******************************************************************************/
+tNFA_STATUS NFA_ReloadConfig(void) {
+  NFC_HDR* p_msg;
+
+  DLOG_IF(INFO, nfc_debug_enabled) << __func__;
+
+  p_msg = (NFC_HDR*)GKI_getbuf(NFC_HDR_SIZE);
+  if (p_msg != NULL) {
+    p_msg->event = NFA_DM_API_RELOAD_CONFIG_EVT;
+
+    nfa_sys_sendmsg(p_msg);
+
+    return (NFA_STATUS_OK);
+  }
+
+  return (NFA_STATUS_FAILED);
+}
+
 /*******************************************************************************
 **
 ** Function         NFA_RequestExclusiveRfControl
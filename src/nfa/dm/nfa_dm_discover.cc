@@ -111,7 +111,8 @@ uint8_t T2T_SLP_REQ[] ={0x50,0x00};
 int getListenTechValue(int listenTechMask);
 #define P2P_RESUME_POLL_TIMEOUT 16 /*mili second timeout value*/
 static uint16_t P2P_PRIO_LOGIC_DEACT_NTF_TIMEOUT =
-    200; /* timeout value 2 sec waiting for deactivate ntf */
+    (2000 * QUICK_TIMER_TICKS_PER_SEC) /
+    1000; /* timeout value 2 sec waiting for deactivate ntf */
 #endif
 
 #if (NXP_EXTNS == TRUE)
@@ -341,14 +342,14 @@ static uint8_t nfa_dm_get_sak(tNFA_DM_DISC_TECH_PROTO_MASK tech_proto_mask) {
   uint8_t tech_list = 0;
   uint8_t hostListenMask = 0x00, fwdEnable = 0x00;
 
-  if (NfcConfig::hasKey(NAME_HOST_LISTEN_TECH_MASK)) {
-    hostListenMask = NfcConfig::getUnsigned(NAME_HOST_LISTEN_TECH_MASK);
+  if (NfcConfig::hasKey(KEY_HOST_LISTEN_TECH_MASK)) {
+    hostListenMask = NfcConfig::getUnsigned(KEY_HOST_LISTEN_TECH_MASK);
     DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s : HOST_LISTEN_TECH_MASK = 0x%x;", __func__,
                     hostListenMask);
   }
 
-  if (NfcConfig::hasKey(NAME_NXP_FWD_FUNCTIONALITY_ENABLE)) {
-    fwdEnable = NfcConfig::getUnsigned(NAME_NXP_FWD_FUNCTIONALITY_ENABLE);
+  if (NfcConfig::hasKey(KEY_NXP_FWD_FUNCTIONALITY_ENABLE)) {
+    fwdEnable = NfcConfig::getUnsigned(KEY_NXP_FWD_FUNCTIONALITY_ENABLE);
     DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s:NXP_FWD_FUNCTIONALITY_ENABLE=0x0%x;", __func__,
                     fwdEnable);
   }
@@ -398,8 +399,8 @@ static tNFA_STATUS nfa_dm_set_listen_mode_set_configs(
 
    DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s : tech_proto_mask = 0x%08X", __func__, tech_proto_mask);
 
-  if (NfcConfig::hasKey(NAME_HOST_LISTEN_TECH_MASK)) {
-    hostListenMask = NfcConfig::getUnsigned(NAME_HOST_LISTEN_TECH_MASK);
+  if (NfcConfig::hasKey(KEY_HOST_LISTEN_TECH_MASK)) {
+    hostListenMask = NfcConfig::getUnsigned(KEY_HOST_LISTEN_TECH_MASK);
     DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s : HOST_LISTEN_TECH_MASK = 0x0%lu;", __func__,
                     hostListenMask);
   }
@@ -1137,8 +1138,8 @@ static tNFC_STATUS nfa_dm_send_deactivate_cmd(tNFC_DEACT_TYPE deactivate_type) {
             "Reading NAME_NFA_DM_DISC_NTF_TIMEOUT val   "
             "nfc_cb.num_disc_maps = %d",
             nfc_cb.num_disc_maps);
-        if (NfcConfig::hasKey(NAME_NFA_DM_DISC_NTF_TIMEOUT)) {
-            num = NfcConfig::getUnsigned(NAME_NFA_DM_DISC_NTF_TIMEOUT);
+        if (NfcConfig::hasKey(KEY_NFA_DM_DISC_NTF_TIMEOUT)) {
+            num = NfcConfig::getUnsigned(KEY_NFA_DM_DISC_NTF_TIMEOUT);
             num *= 1000;
           } else {
           num = NFA_DM_DISC_TIMEOUT_W4_DEACT_NTF;
@@ -1330,26 +1331,26 @@ void nfa_dm_start_rf_discover(void) {
                      dm_disc_mask);
 
 #if (NXP_EXTNS == TRUE)
-    fwdEnable = NfcConfig::getUnsigned(NAME_NXP_FWD_FUNCTIONALITY_ENABLE,0x01);
+    fwdEnable = NfcConfig::getUnsigned(KEY_NXP_FWD_FUNCTIONALITY_ENABLE,0x01);
     DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s:NXP_FWD_FUNCTIONALITY_ENABLE=0x0%x;", __func__,
                     fwdEnable);
-    if (NfcConfig::hasKey(NAME_HOST_LISTEN_TECH_MASK)) {
-      hostListenMask = NfcConfig::getUnsigned(NAME_HOST_LISTEN_TECH_MASK);
+    if (NfcConfig::hasKey(KEY_HOST_LISTEN_TECH_MASK)) {
+      hostListenMask = NfcConfig::getUnsigned(KEY_HOST_LISTEN_TECH_MASK);
       DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s:HOST_LISTEN_TECH_MASK = 0x0%X;", __func__,
                       hostListenMask);
     }
-    if (NfcConfig::hasKey(NAME_UICC_LISTEN_TECH_MASK)) {
-      uiccListenMask = NfcConfig::getUnsigned(NAME_UICC_LISTEN_TECH_MASK);
+    if (NfcConfig::hasKey(KEY_UICC_LISTEN_TECH_MASK)) {
+      uiccListenMask = NfcConfig::getUnsigned(KEY_UICC_LISTEN_TECH_MASK);
       DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s:UICC_LISTEN_TECH_MASK = 0x0%X;", __func__,
                        uiccListenMask);
     }
-    if (NfcConfig::hasKey(NAME_NXP_ESE_LISTEN_TECH_MASK)) {
-      eseListenMask = NfcConfig::getUnsigned(NAME_NXP_ESE_LISTEN_TECH_MASK);
+    if (NfcConfig::hasKey(KEY_NXP_ESE_LISTEN_TECH_MASK)) {
+      eseListenMask = NfcConfig::getUnsigned(KEY_NXP_ESE_LISTEN_TECH_MASK);
       DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s:NXP_ESE_LISTEN_TECH_MASK = 0x0%X;", __func__,
                         eseListenMask);
     }
-    if (NfcConfig::hasKey(NAME_P2P_LISTEN_TECH_MASK)) {
-      p2pListenMask = NfcConfig::getUnsigned(NAME_P2P_LISTEN_TECH_MASK);
+    if (NfcConfig::hasKey(KEY_P2P_LISTEN_TECH_MASK)) {
+      p2pListenMask = NfcConfig::getUnsigned(KEY_P2P_LISTEN_TECH_MASK);
       DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s:P2P_LISTEN_TECH_MASK = 0x0%X;", __func__,
                        p2pListenMask);
     }
@@ -109,7 +109,8 @@ const tNFA_DM_ACTION nfa_dm_action[] = {
     nfa_dm_act_send_vsc,             /* NFA_DM_API_SEND_VSC_EVT              */
     nfa_dm_act_disable_timeout,      /* NFA_DM_TIMEOUT_DISABLE_EVT           */
     nfa_dm_set_power_sub_state,      /* NFA_DM_API_SET_POWER_SUB_STATE_EVT   */
-    nfa_dm_act_send_raw_vs           /* NFA_DM_API_SEND_RAW_VS_EVT           */
+    nfa_dm_act_send_raw_vs,          /* NFA_DM_API_SEND_RAW_VS_EVT           */
+    nfa_dm_act_reload_config         /* NFA_DM_API_RELOAD_CONFIG_EVT         */
 };
 
 /*****************************************************************************
@@ -621,6 +622,9 @@ static std::string nfa_dm_evt_2_str(uint16_t event) {
 
     case NFA_DM_SET_TRANSIT_CONFIG:
       return "NFA_DM_SET_TRANSIT_CONFIG";
+
+    case NFA_DM_API_RELOAD_CONFIG_EVT:
+      return "NFA_DM_API_RELOAD_CONFIG_EVT";
   }
 
   return "Unknown or Vendor Specific";
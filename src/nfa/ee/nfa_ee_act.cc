@@ -41,6 +41,8 @@
  *
  ******************************************************************************/
 #include <string.h>
+#include <algorithm>
+#include <vector>
 
 #include <android-base/stringprintf.h>
 #include <base/logging.h>
@@ -48,6 +50,7 @@
 #include "nfa_api.h"
 #include "nfa_dm_int.h"
 #include "nfa_ee_int.h"
+#include "nfa_mem_co.h"
 #include "nci_hmsgs.h"
 #if (NXP_EXTNS == TRUE)
 #include "nfa_hci_int.h"
@@ -76,41 +79,6 @@ const uint8_t nfa_ee_tech_list[NFA_EE_NUM_TECH] = {
 
 /* the following 2 tables convert the protocol mask in API and control block to
  * the command for NFCC */
-static void add_route_tech_proto_tlv(uint8_t** pp, uint8_t tlv_type,
-                                     uint8_t nfcee_id, uint8_t pwr_cfg,
-                                     uint8_t tech_proto) {
-  *(*pp)++ = tlv_type;
-  *(*pp)++ = 3;
-  *(*pp)++ = nfcee_id;
-  *(*pp)++ = pwr_cfg;
-  *(*pp)++ = tech_proto;
-}
-
-static void add_route_aid_tlv(uint8_t** pp, uint8_t* pa, uint8_t nfcee_id,
-                              uint8_t pwr_cfg, uint8_t tag) {
-  pa++;                /* EMV tag */
-  uint8_t len = *pa++; /* aid_len */
-  *(*pp)++ = tag;
-  *(*pp)++ = len + 2;
-  *(*pp)++ = nfcee_id;
-  *(*pp)++ = pwr_cfg;
-  /* copy the AID */
-  memcpy(*pp, pa, len);
-  *pp += len;
-}
-
-static void add_route_sys_code_tlv(uint8_t** p_buff, uint8_t* p_sys_code_cfg,
-                                   uint8_t sys_code_rt_loc,
-                                   uint8_t sys_code_pwr_cfg) {
-  *(*p_buff)++ = NFC_ROUTE_TAG_SYSCODE | nfa_ee_cb.route_block_control;
-  *(*p_buff)++ = NFA_EE_SYSTEM_CODE_LEN + 2;
-  *(*p_buff)++ = sys_code_rt_loc;
-  *(*p_buff)++ = sys_code_pwr_cfg;
-  /* copy the system code */
-  memcpy(*p_buff, p_sys_code_cfg, NFA_EE_SYSTEM_CODE_LEN);
-  *p_buff += NFA_EE_SYSTEM_CODE_LEN;
-}
-
 const uint8_t nfa_ee_proto_mask_list[NFA_EE_NUM_PROTO] = {
     NFA_PROTOCOL_MASK_T1T, NFA_PROTOCOL_MASK_T2T, NFA_PROTOCOL_MASK_T3T,
     NFA_PROTOCOL_MASK_ISO_DEP, NFA_PROTOCOL_MASK_NFC_DEP
@@ -129,21 +97,6 @@ const uint8_t nfa_ee_proto_list[NFA_EE_NUM_PROTO] = {
 #endif
 };
 
-#if (NXP_EXTNS == TRUE)
-static uint8_t* proto_route_buff;
-static uint8_t* tech_route_buff;
-static uint8_t* proto_pp;
-static uint8_t* tech_pp;
-static uint8_t proto_tlv_ctr;
-static uint8_t tech_tlv_ctr;
-/* Ex: num of proto= 6, proto_mask =5 and num of EEs 4, total  size = (6x5x4) */
-#define NFA_EE_PROTO_BUFF_SIZE \
-  (NFA_EE_NUM_PROTO * NFA_EE_PROTO_ROUTE_ENTRY_SIZE * NFA_EE_MAX_EE_SUPPORTED)
-/* Ex: num of tech =3 , tech_mask =5 and num of EEs 4, total  size = (3x5x4) */
-#define NFA_EE_TECH_BUFF_SIZE \
-  (NFA_EE_NUM_TECH * NFA_EE_TECH_ROUTE_ENTRY_SIZE * NFA_EE_MAX_EE_SUPPORTED)
-#endif /* - Routing entries optimization */
-
 #if (NXP_EXTNS == TRUE)
 uint8_t NFA_REMOVE_ALL_AID[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
 uint8_t NFA_REMOVE_ALL_APDU[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xEF};
@@ -156,10 +109,44 @@ static uint16_t max_aid_config_length;
 static uint16_t max_aid_entries;
 #endif
 
+/* The AID index hashes the AID bytes to the ECB and the entry that hold the
+ * AID, so that adding or removing an AID does not compare it with every entry
+ * of every ECB. Slots do not keep the AID; a match is confirmed against
+ * aid_cfg[]. The index is rebuilt from the ECBs on the first lookup after
+ * nfa_ee_cb.aid_idx_valid is cleared. */
+#define NFA_EE_AID_IDX_FREE 0xFF
+#define NFA_EE_AID_IDX_MIN_SIZE 64
+
+typedef struct {
+  uint32_t hash;
+  uint16_t offset; /* offset of the AID entry in aid_cfg[] */
+  uint8_t ecb_idx; /* index in nfa_ee_cb.ecb[], or NFA_EE_AID_IDX_FREE */
+  uint8_t entry;   /* index of the AID entry in the ECB */
+} tNFA_EE_AID_IDX_SLOT;
+
+static std::vector<tNFA_EE_AID_IDX_SLOT> nfa_ee_aid_idx;
+static size_t nfa_ee_aid_idx_count;
+
+/* The AID entries of an ECB live in one block of nfa_mem_co_alloc, see
+ * nfa_ee_aid_store_carve. It holds aid_sel_seq, the uint8_t arrays from
+ * aid_len to aid_fit_len, and room in aid_cfg for the tag, length and AID of
+ * every entry. */
+#define NFA_EE_AID_STORE_ARRAYS 7
+#define NFA_EE_AID_STORE_CFG_LEN (NFA_MAX_AID_LEN + 2)
+
+/* The listen mode routing table is compiled into the RF_SET_LISTEN_MODE_ROUTING
+ * commands that would carry it, each stored as more, num_tlv, length and the
+ * TLVs. The commands last accepted by the NFCC are kept, so that a table that
+ * did not change is not sent again. */
+static std::vector<uint8_t> nfa_ee_lmrt_compiled;
+static std::vector<uint8_t> nfa_ee_lmrt_sent;
+static std::vector<uint8_t> nfa_ee_lmrt_acked;
+static bool nfa_ee_lmrt_sent_failed;
+
 static void nfa_ee_report_discover_req_evt(void);
 static void nfa_ee_build_discover_req_evt(tNFA_EE_DISCOVER_REQ* p_evt_data);
-void nfa_ee_check_set_routing(uint16_t new_size, int* p_max_len, uint8_t* p,
-                              int* p_cur_offset);
+static bool nfa_ee_lmrt_compile(void);
+static bool nfa_ee_lmrt_changed(void);
 /*******************************************************************************
 **
 ** Function         nfa_ee_trace_aid
@@ -243,57 +230,13 @@ static void nfa_ee_trace_apdu(std::string p_str, tNFA_EE_API_ADD_APDU* p_apdu) {
 **
 *******************************************************************************/
 static void nfa_ee_update_route_size(tNFA_EE_ECB* p_cb) {
-  int xx;
-  uint8_t power_cfg = 0;
-
-  p_cb->size_mask = 0;
-  /* add the Technology based routing */
-  for (xx = 0; xx < NFA_EE_NUM_TECH; xx++) {
-    power_cfg = 0;
-    if (p_cb->tech_switch_on & nfa_ee_tech_mask_list[xx])
-      power_cfg |= NCI_ROUTE_PWR_STATE_ON;
-    if (p_cb->tech_switch_off & nfa_ee_tech_mask_list[xx])
-      power_cfg |= NCI_ROUTE_PWR_STATE_SWITCH_OFF;
-    if (p_cb->tech_battery_off & nfa_ee_tech_mask_list[xx])
-      power_cfg |= NCI_ROUTE_PWR_STATE_BATT_OFF;
-    if ((power_cfg & NCI_ROUTE_PWR_STATE_ON) &&
-        (NFC_GetNCIVersion() == NCI_VERSION_2_0)) {
-      if (p_cb->tech_screen_lock & nfa_ee_tech_mask_list[xx])
-        power_cfg |= NCI_ROUTE_PWR_STATE_SCREEN_ON_LOCK();
-      if (p_cb->tech_screen_off & nfa_ee_tech_mask_list[xx])
-        power_cfg |= NCI_ROUTE_PWR_STATE_SCREEN_OFF_UNLOCK();
-      if (p_cb->tech_screen_off_lock & nfa_ee_tech_mask_list[xx])
-        power_cfg |= NCI_ROUTE_PWR_STATE_SCREEN_OFF_LOCK();
-    }
-    if (power_cfg) {
-      /* 5 = 1 (tag) + 1 (len) + 1(nfcee_id) + 1(power cfg) + 1 (techonogy) */
-      p_cb->size_mask += 5;
-    }
-  }
-
-  /* add the Protocol based routing */
-  for (xx = 0; xx < NFA_EE_NUM_PROTO; xx++) {
-    power_cfg = 0;
-    if (p_cb->proto_switch_on & nfa_ee_proto_mask_list[xx])
-      power_cfg |= NCI_ROUTE_PWR_STATE_ON;
-    if (p_cb->proto_switch_off & nfa_ee_proto_mask_list[xx])
-      power_cfg |= NCI_ROUTE_PWR_STATE_SWITCH_OFF;
-    if (p_cb->proto_battery_off & nfa_ee_proto_mask_list[xx])
-      power_cfg |= NCI_ROUTE_PWR_STATE_BATT_OFF;
-    if ((power_cfg & NCI_ROUTE_PWR_STATE_ON) &&
-        (NFC_GetNCIVersion() == NCI_VERSION_2_0)) {
-      if (p_cb->proto_screen_lock & nfa_ee_proto_mask_list[xx])
-        power_cfg |= NCI_ROUTE_PWR_STATE_SCREEN_ON_LOCK();
-      if (p_cb->proto_screen_off & nfa_ee_proto_mask_list[xx])
-        power_cfg |= NCI_ROUTE_PWR_STATE_SCREEN_OFF_UNLOCK();
-      if (p_cb->proto_screen_off_lock & nfa_ee_proto_mask_list[xx])
-        power_cfg |= NCI_ROUTE_PWR_STATE_SCREEN_OFF_LOCK();
-    }
-    if (power_cfg) {
-      /* 5 = 1 (tag) + 1 (len) + 1(nfcee_id) + 1(power cfg) + 1 (protocol) */
-      p_cb->size_mask += 5;
-    }
-  }
+  p_cb->size_mask =
+      nfa_ee_lmrt_mask_size(p_cb->tech_switch_on | p_cb->tech_switch_off |
+                                p_cb->tech_battery_off,
+                            nfa_ee_tech_mask_list, NFA_EE_NUM_TECH) +
+      nfa_ee_lmrt_mask_size(p_cb->proto_switch_on | p_cb->proto_switch_off |
+                                p_cb->proto_battery_off,
+                            nfa_ee_proto_mask_list, NFA_EE_NUM_PROTO);
    DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("nfa_ee_update_route_size nfcee_id:0x%x size_mask:%d",
                    p_cb->nfcee_id, p_cb->size_mask);
 }
@@ -353,10 +296,13 @@ static void nfa_ee_update_route_aid_size(tNFA_EE_ECB* p_cb) {
     start_offset = 0;
     for (xx = 0; xx < p_cb->aid_entries; xx++) {
       /* add one AID entry */
-      if (p_cb->aid_rt_info[xx] & NFA_EE_AE_ROUTE) {
+      if ((p_cb->aid_rt_info[xx] & NFA_EE_AE_ROUTE) &&
+          !(p_cb->aid_rt_info[xx] & NFA_EE_AE_OVERFLOW)) {
         pa = &p_cb->aid_cfg[start_offset];
         pa++;        /* EMV tag */
         len = *pa++; /* aid_len */
+        if (p_cb->aid_rt_info[xx] & NFA_EE_AE_PREFIX)
+          len = p_cb->aid_fit_len[xx];
         /* 4 = 1 (tag) + 1 (len) + 1(nfcee_id) + 1(power cfg) */
         p_cb->size_aid += 4;
         p_cb->size_aid += len;
@@ -394,6 +340,22 @@ static void nfa_ee_update_route_sys_code_size(tNFA_EE_ECB* p_cb) {
       p_cb->nfcee_id, p_cb->size_sys_code);
 }
 
+/*******************************************************************************
+**
+** Function         nfa_ee_ecb_in_lmrt
+**
+** Description      Check if the routes of the given ECB go in the listen mode
+**                  routing table: the DH, and the active NFCEEs discovered
+**
+** Returns          true, if they do
+**
+*******************************************************************************/
+static bool nfa_ee_ecb_in_lmrt(tNFA_EE_ECB* p_cb) {
+  return (p_cb == &nfa_ee_cb.ecb[NFA_EE_CB_4_DH]) ||
+         ((p_cb < &nfa_ee_cb.ecb[nfa_ee_cb.cur_ee]) &&
+          (p_cb->ee_status == NFC_NFCEE_STATUS_ACTIVE));
+}
+
 /*******************************************************************************
 **
 ** Function         nfa_ee_total_lmrt_size
@@ -404,33 +366,45 @@ static void nfa_ee_update_route_sys_code_size(tNFA_EE_ECB* p_cb) {
 **
 *******************************************************************************/
 static uint16_t nfa_ee_total_lmrt_size(void) {
-  int xx;
-  uint16_t lmrt_size = 0;
-  tNFA_EE_ECB* p_cb;
+  tNFA_EE_LMRT_SIZE sizes[NFA_EE_NUM_ECBS];
+  int num_sizes = 0;
 
-  p_cb = &nfa_ee_cb.ecb[NFA_EE_CB_4_DH];
-  lmrt_size += p_cb->size_mask;
-  lmrt_size += p_cb->size_aid;
-  lmrt_size += p_cb->size_apdu;
-  lmrt_size += p_cb->size_sys_code;
-  p_cb = &nfa_ee_cb.ecb[nfa_ee_cb.cur_ee - 1];
-  for (xx = 0; xx < nfa_ee_cb.cur_ee; xx++, p_cb--) {
-    if (p_cb->ee_status == NFC_NFCEE_STATUS_ACTIVE) {
-      lmrt_size += p_cb->size_mask;
-      lmrt_size += p_cb->size_aid;
-      lmrt_size += p_cb->size_apdu;
-      lmrt_size += p_cb->size_sys_code;
+  for (int xx = 0; xx < NFA_EE_NUM_ECBS; xx++) {
+    tNFA_EE_ECB* p_cb = &nfa_ee_cb.ecb[xx];
+    if (nfa_ee_ecb_in_lmrt(p_cb)) {
+      sizes[num_sizes++] = {p_cb->size_mask, p_cb->size_aid, p_cb->size_apdu,
+                            p_cb->size_sys_code};
     }
   }
-  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("nfa_ee_total_lmrt_size size:%d", lmrt_size);
-  return lmrt_size;
+  return nfa_ee_lmrt_total_size(sizes, num_sizes);
 }
 
-static void nfa_ee_add_tech_route_to_ecb(tNFA_EE_ECB* p_cb, uint8_t* pp,
-                                         uint8_t* p, uint8_t* ps,
-                                         int* p_cur_offset) {
-  uint8_t num_tlv = *ps;
+/*******************************************************************************
+**
+** Function         nfa_ee_add_route
+**
+** Description      Append one entry to the routes of the table being compiled
+**
+** Returns          void
+**
+*******************************************************************************/
+static void nfa_ee_add_route(std::vector<tNFA_EE_LMRT_ROUTE>* p_routes,
+                             uint8_t order, uint8_t tag, uint8_t nfcee_id,
+                             uint8_t pwr_cfg, const uint8_t* p_val,
+                             uint8_t len) {
+  tNFA_EE_LMRT_ROUTE route;
+
+  route.order = order;
+  route.tag = tag;
+  route.nfcee_id = nfcee_id;
+  route.pwr_cfg = pwr_cfg;
+  route.len = len;
+  route.p_val = p_val;
+  p_routes->push_back(route);
+}
 
+static void nfa_ee_add_tech_route_to_ecb(
+    tNFA_EE_ECB* p_cb, std::vector<tNFA_EE_LMRT_ROUTE>* p_routes) {
   /* add the Technology based routing */
   for (int xx = 0; xx < NFA_EE_NUM_TECH; xx++) {
     uint8_t power_cfg = 0;
@@ -449,24 +423,18 @@ static void nfa_ee_add_tech_route_to_ecb(tNFA_EE_ECB* p_cb, uint8_t* pp,
           power_cfg |= NCI_ROUTE_PWR_STATE_SCREEN_OFF_LOCK();
        }
     if (power_cfg) {
-      add_route_tech_proto_tlv(&pp, NFC_ROUTE_TAG_TECH, p_cb->nfcee_id,
-                               power_cfg, nfa_ee_tech_list[xx]);
-      num_tlv++;
+      nfa_ee_add_route(p_routes, NCI_ROUTE_ORDER_TECHNOLOGY,
+                       NFC_ROUTE_TAG_TECH, p_cb->nfcee_id, power_cfg,
+                       &nfa_ee_tech_list[xx], 1);
       if (power_cfg != NCI_ROUTE_PWR_STATE_ON)
         nfa_ee_cb.ee_cfged |= NFA_EE_CFGED_OFF_ROUTING;
     }
   }
-
-  /* update the num_tlv and current offset */
-  uint8_t entry_size = (uint8_t)(pp - p);
-  *p_cur_offset += entry_size;
-  *ps = num_tlv;
 }
 
-static void nfa_ee_add_proto_route_to_ecb(tNFA_EE_ECB* p_cb, uint8_t* pp,
-                                          uint8_t* p, uint8_t* ps,
-                                          int* p_cur_offset) {
-  uint8_t num_tlv = *ps;
+static void nfa_ee_add_proto_route_to_ecb(
+    tNFA_EE_ECB* p_cb, std::vector<tNFA_EE_LMRT_ROUTE>* p_routes) {
+  static const uint8_t nfc_dep = NFC_PROTOCOL_NFC_DEP;
 
   /* add the Protocol based routing */
   for (int xx = 0; xx < NFA_EE_NUM_PROTO; xx++) {
@@ -516,9 +484,8 @@ static void nfa_ee_add_proto_route_to_ecb(tNFA_EE_ECB* p_cb, uint8_t* pp,
         proto_tag = NFC_ROUTE_TAG_PROTO;
       }
 
-      add_route_tech_proto_tlv(&pp, proto_tag, p_cb->nfcee_id, power_cfg,
-                               nfa_ee_proto_list[xx]);
-      num_tlv++;
+      nfa_ee_add_route(p_routes, NCI_ROUTE_ORDER_PROTOCOL, proto_tag,
+                       p_cb->nfcee_id, power_cfg, &nfa_ee_proto_list[xx], 1);
       if (power_cfg != NCI_ROUTE_PWR_STATE_ON)
         nfa_ee_cb.ee_cfged |= NFA_EE_CFGED_OFF_ROUTING;
     }
@@ -526,34 +493,24 @@ static void nfa_ee_add_proto_route_to_ecb(tNFA_EE_ECB* p_cb, uint8_t* pp,
 
   /* add NFC-DEP routing to HOST */
   if (p_cb->nfcee_id == NFC_DH_ID) {
-    add_route_tech_proto_tlv(&pp, NFC_ROUTE_TAG_PROTO, NFC_DH_ID,
-                             NCI_ROUTE_PWR_STATE_ON, NFC_PROTOCOL_NFC_DEP);
-
-    num_tlv++;
+    nfa_ee_add_route(p_routes, NCI_ROUTE_ORDER_PROTOCOL, NFC_ROUTE_TAG_PROTO,
+                     NFC_DH_ID, NCI_ROUTE_PWR_STATE_ON, &nfc_dep, 1);
     DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s - NFC DEP added for DH!!!", __func__);
   }
-  /* update the num_tlv and current offset */
-  uint8_t entry_size = (uint8_t)(pp - p);
-  *p_cur_offset += entry_size;
-  *ps = num_tlv;
 }
 
-static void nfa_ee_add_aid_route_to_ecb(tNFA_EE_ECB* p_cb, uint8_t* pp,
-                                        uint8_t* p, uint8_t* ps,
-                                        int* p_cur_offset, int* p_max_len) {
-  uint8_t num_tlv = *ps;
-
+static void nfa_ee_add_aid_route_to_ecb(
+    tNFA_EE_ECB* p_cb, std::vector<tNFA_EE_LMRT_ROUTE>* p_routes) {
   /* add the AID routing */
   if (p_cb->aid_entries) {
     int start_offset = 0;
     for (int xx = 0; xx < p_cb->aid_entries; xx++) {
-      /* remember the beginning of this AID routing entry, just in case we
-       * need to put it in next command */
       uint8_t route_qual = 0;
-      uint8_t* p_start = pp;
       /* add one AID entry */
-      if (p_cb->aid_rt_info[xx] & NFA_EE_AE_ROUTE) {
+      if ((p_cb->aid_rt_info[xx] & NFA_EE_AE_ROUTE) &&
+          !(p_cb->aid_rt_info[xx] & NFA_EE_AE_OVERFLOW)) {
         uint8_t* pa = &p_cb->aid_cfg[start_offset];
+        uint8_t aid_len = pa[1];
 
          DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s -  p_cb->aid_info%x", __func__,
                          p_cb->aid_info[xx]);
@@ -567,106 +524,55 @@ static void nfa_ee_add_aid_route_to_ecb(tNFA_EE_ECB* p_cb, uint8_t* pp,
                            p_cb->aid_info[xx] & NCI_ROUTE_QUAL_SHORT_SELECT);
           route_qual |= NCI_ROUTE_QUAL_SHORT_SELECT;
         }
+        if (p_cb->aid_rt_info[xx] & NFA_EE_AE_PREFIX) {
+          /* the AID overflow policy collapsed other AIDs into this prefix */
+          aid_len = p_cb->aid_fit_len[xx];
+          route_qual |= NCI_ROUTE_QUAL_LONG_SELECT;
+        }
 
         uint8_t tag =
             NFC_ROUTE_TAG_AID | nfa_ee_cb.route_block_control | route_qual;
 #if(NXP_EXTNS == TRUE)
             if(nfa_ee_is_active(p_cb->aid_rt_loc[xx]|NFA_HANDLE_GROUP_EE)) {
-                add_route_aid_tlv(&pp, pa, p_cb->aid_rt_loc[xx], p_cb->aid_pwr_cfg[xx], tag);
-                num_tlv++;
+                nfa_ee_add_route(p_routes, NCI_ROUTE_ORDER_AID, tag,
+                                 p_cb->aid_rt_loc[xx], p_cb->aid_pwr_cfg[xx],
+                                 pa + 2, aid_len);
             } else {
                  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s -  ignoring route loc%x", __func__,p_cb->aid_rt_loc[xx]);
             }
 #else
-        add_route_aid_tlv(&pp, pa, p_cb->nfcee_id, p_cb->aid_pwr_cfg[xx], tag);
+        nfa_ee_add_route(p_routes, NCI_ROUTE_ORDER_AID, tag, p_cb->nfcee_id,
+                         p_cb->aid_pwr_cfg[xx], pa + 2, aid_len);
 #endif
       }
       start_offset += p_cb->aid_len[xx];
-      uint8_t new_size = (uint8_t)(pp - p_start);
-      nfa_ee_check_set_routing(new_size, p_max_len, ps, p_cur_offset);
-      if (*ps == 0
-#if(NXP_EXTNS == TRUE)
-          && (num_tlv > 0x00)
-#endif
-         ) {
-        /* just sent routing command, update local */
-        *ps = 1;
-        num_tlv = *ps;
-        *p_cur_offset = new_size;
-        pp = ps + 1;
-        p = pp;
-        memcpy(p, p_start, new_size);
-        pp += new_size;
-      } else {
-        /* add the new entry */
-        *ps = num_tlv;
-        *p_cur_offset += new_size;
-      }
     }
   } else {
     DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s - No AID entries available", __func__);
   }
 }
-static void nfa_ee_add_apdu_route_to_ecb(tNFA_EE_ECB* p_cb, uint8_t* pp,
-                                        uint8_t* p, uint8_t* ps,
-                                        int* p_cur_offset, int* p_max_len) {
-    uint8_t num_tlv = *ps, len;
-    uint16_t tlv_size;
-    tlv_size = (uint8_t)*p_cur_offset;
-    int start_offset, xx;
-    uint8_t  *pa;
-    uint8_t* p_start;
-    uint8_t new_size;
-    uint8_t max_tlv;
-
-    /* add the AID routing */
-          if (p_cb->apdu_pattern_entries) {
-            start_offset = 0;
-            for (xx = 0; xx < p_cb->apdu_pattern_entries; xx++) {
-                p_start = pp;
-                /* add one APDU entry */
-                if (p_cb->apdu_rt_info[xx] & NFA_EE_AE_ROUTE) {
-                    num_tlv++;
-                    pa = &p_cb->apdu_cfg[start_offset];
-                    pa++;        /* EMV tag */
-                    len = *pa++; /* apdu_len */
-                    *pp++ = NFC_ROUTE_TAG_APDU;
-                    *pp++ = len + 2;
-                    *pp++ = (p_cb->apdu_rt_info[xx] >> NFA_EE_APDU_ROUTE_MASK);
-                    DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("nfa_ee_route_add_one_ecb_by_route_order p_cb->apdu_rt_info[xx] %x", p_cb->apdu_rt_info[xx]);
-                    *pp++ = p_cb->apdu_pwr_cfg[xx];
-                    /* copy the APDU */
-                    memcpy(pp, pa, len);
-                    pp += len;
-                }
-                start_offset += p_cb->apdu_len[xx];
-                new_size = (uint8_t)(pp - p_start);
-                DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("nfa_ee_route_add_one_ecb_by_route_order --before num_tlv:- %d", num_tlv);
-                DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("nfa_ee_route_add_one_ecb_by_route_order --before new_size:- %d",new_size);
-                nfa_ee_check_set_routing(new_size, p_max_len, ps, p_cur_offset);
-                if (*ps == 0) {
-                  /* just sent routing command, update local */
-                  *ps = 1;
-                   num_tlv = *ps;
-                   *p_cur_offset = new_size;
-                   pp = ps + 1;
-                   p = pp;
-                   tlv_size = (uint8_t)*p_cur_offset;
-                   max_tlv = (uint8_t)((*p_max_len > NFA_EE_ROUT_MAX_TLV_SIZE)
-                                        ? NFA_EE_ROUT_MAX_TLV_SIZE
-                                        : *p_max_len);
-                   memcpy(p, p_start, new_size);
-                   pp += new_size;
-                   } else {
-                    /* add the new entry */
-                     *ps = num_tlv;
-                     *p_cur_offset += new_size;
-                }
-            }
-            DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("nfa_ee_route_add_one_ecb_by_route_order --num_tlv:- %d", num_tlv);
-            DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("nfa_ee_route_add_one_ecb_by_route_order --new_size:- %d",new_size);
-          }
+
+static void nfa_ee_add_apdu_route_to_ecb(
+    tNFA_EE_ECB* p_cb, std::vector<tNFA_EE_LMRT_ROUTE>* p_routes) {
+  /* add the APDU pattern routing */
+  if (p_cb->apdu_pattern_entries) {
+    int start_offset = 0;
+    for (int xx = 0; xx < p_cb->apdu_pattern_entries; xx++) {
+      /* add one APDU entry */
+      if (p_cb->apdu_rt_info[xx] & NFA_EE_AE_ROUTE) {
+        uint8_t* pa = &p_cb->apdu_cfg[start_offset];
+        DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
+            "%s p_cb->apdu_rt_info[xx] %x", __func__, p_cb->apdu_rt_info[xx]);
+        /* pa[0] is the EMV tag, pa[1] the length of the APDU pattern */
+        nfa_ee_add_route(p_routes, NCI_ROUTE_ORDER_PATTERN, NFC_ROUTE_TAG_APDU,
+                         (p_cb->apdu_rt_info[xx] >> NFA_EE_APDU_ROUTE_MASK),
+                         p_cb->apdu_pwr_cfg[xx], pa + 2, pa[1]);
+      }
+      start_offset += p_cb->apdu_len[xx];
+    }
+  }
 }
+
 /*******************************************************************************
 **
 ** Function         nfa_ee_conn_cback
@@ -697,27 +603,22 @@ static void nfa_ee_conn_cback(uint8_t conn_id, tNFC_CONN_EVT event,
   nfa_ee_evt_hdlr(&nfa_ee_msg.conn.hdr);
 }
 
-__attribute__((unused)) static void nfa_ee_add_sys_code_route_to_ecb(tNFA_EE_ECB* p_cb, uint8_t* pp,
-                                             uint8_t* p, uint8_t* p_buff,
-                                             int* p_cur_offset,
-                                             int* p_max_len) {
-  uint8_t num_tlv = *p_buff;
-
+static void nfa_ee_add_sys_code_route_to_ecb(
+    tNFA_EE_ECB* p_cb, std::vector<tNFA_EE_LMRT_ROUTE>* p_routes) {
   /* add the SC routing */
   if (p_cb->sys_code_cfg_entries) {
     int start_offset = 0;
     for (int xx = 0; xx < p_cb->sys_code_cfg_entries; xx++) {
-      /* remember the beginning of this SC routing entry, just in case we
-       * need to put it in next command */
-      uint8_t* p_start = pp;
       /* add one SC entry */
       if (p_cb->sys_code_rt_loc_vs_info[xx] & NFA_EE_AE_ROUTE) {
         uint8_t* p_sys_code_cfg = &p_cb->sys_code_cfg[start_offset];
         if (nfa_ee_is_active(p_cb->sys_code_rt_loc[xx] | NFA_HANDLE_GROUP_EE)) {
-          add_route_sys_code_tlv(&pp, p_sys_code_cfg, p_cb->sys_code_rt_loc[xx],
-                                 p_cb->sys_code_pwr_cfg[xx]);
+          nfa_ee_add_route(p_routes, NCI_ROUTE_ORDER_SYS_CODE,
+                           NFC_ROUTE_TAG_SYSCODE | nfa_ee_cb.route_block_control,
+                           p_cb->sys_code_rt_loc[xx],
+                           p_cb->sys_code_pwr_cfg[xx], p_sys_code_cfg,
+                           NFA_EE_SYSTEM_CODE_LEN);
           p_cb->ecb_flags |= NFA_EE_ECB_FLAGS_ROUTING;
-          num_tlv++;
         } else {
           DLOG_IF(INFO, nfc_debug_enabled)
               << StringPrintf("%s -  ignoring route loc%x", __func__,
@@ -725,25 +626,7 @@ __attribute__((unused)) static void nfa_ee_add_sys_code_route_to_ecb(tNFA_EE_ECB
         }
       }
       start_offset += NFA_EE_SYSTEM_CODE_LEN;
-      uint8_t new_size = (uint8_t)(pp - p_start);
-      nfa_ee_check_set_routing(new_size, p_max_len, p_buff, p_cur_offset);
-      if (*p_buff == 0 && (num_tlv > 0x00)) {
-        /* just sent routing command, update local */
-        *p_buff = 1;
-        num_tlv = *p_buff;
-        *p_cur_offset = new_size;
-        pp = p_buff + 1;
-        p = pp;
-        memcpy(p, p_start, new_size);
-        pp += new_size;
-      } else {
-        /* add the new entry */
-        *p_buff = num_tlv;
-        *p_cur_offset += new_size;
-      }
     }
-    DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
-        "nfa_ee_route_add_one_ecb_by_route_order --num_tlv:- %d", num_tlv);
   } else {
     DLOG_IF(INFO, nfc_debug_enabled)
         << StringPrintf("%s - No SC entries available", __func__);
@@ -762,6 +645,7 @@ __attribute__((unused)) static void nfa_ee_add_sys_code_route_to_ecb(tNFA_EE_ECB
 int nfa_ee_find_total_aid_len(tNFA_EE_ECB* p_cb, int start_entry) {
   int len = 0, xx;
 
+  if (start_entry == 0) return p_cb->aid_cfg_len;
   if (p_cb->aid_entries > start_entry) {
     for (xx = start_entry; xx < p_cb->aid_entries; xx++) {
       len += p_cb->aid_len[xx];
@@ -876,47 +760,470 @@ int nfa_all_ee_find_total_sys_code_len() {
   return total_len;
 }
 
+/*******************************************************************************
+**
+** Function         nfa_ee_aid_hash
+**
+** Description      Hash the AID bytes for the AID index
+**
+** Returns          the hash
+**
+*******************************************************************************/
+static uint32_t nfa_ee_aid_hash(uint8_t aid_len, const uint8_t* p_aid) {
+  uint32_t hash = 2166136261u ^ aid_len;
+
+  for (int xx = 0; xx < aid_len; xx++) {
+    hash ^= p_aid[xx];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/*******************************************************************************
+**
+** Function         nfa_ee_aid_idx_insert
+**
+** Description      Add a slot for the AID entry at offset in aid_cfg[] of the
+**                  given ECB, growing the index to stay at most half full
+**
+** Returns          void
+**
+*******************************************************************************/
+static void nfa_ee_aid_idx_insert(uint32_t hash, uint8_t ecb_idx, uint8_t entry,
+                                  uint16_t offset) {
+  if ((nfa_ee_aid_idx_count + 1) * 2 > nfa_ee_aid_idx.size()) {
+    std::vector<tNFA_EE_AID_IDX_SLOT> old_idx;
+    tNFA_EE_AID_IDX_SLOT free_slot = {0, 0, NFA_EE_AID_IDX_FREE, 0};
+
+    old_idx.swap(nfa_ee_aid_idx);
+    nfa_ee_aid_idx.assign(
+        std::max<size_t>(NFA_EE_AID_IDX_MIN_SIZE, old_idx.size() * 2),
+        free_slot);
+    nfa_ee_aid_idx_count = 0;
+    for (const tNFA_EE_AID_IDX_SLOT& slot : old_idx) {
+      if (slot.ecb_idx != NFA_EE_AID_IDX_FREE)
+        nfa_ee_aid_idx_insert(slot.hash, slot.ecb_idx, slot.entry, slot.offset);
+    }
+  }
+
+  size_t mask = nfa_ee_aid_idx.size() - 1;
+  size_t xx = hash & mask;
+  while (nfa_ee_aid_idx[xx].ecb_idx != NFA_EE_AID_IDX_FREE) xx = (xx + 1) & mask;
+  nfa_ee_aid_idx[xx] = {hash, offset, ecb_idx, entry};
+  nfa_ee_aid_idx_count++;
+}
+
+/*******************************************************************************
+**
+** Function         nfa_ee_aid_idx_build
+**
+** Description      Index the AID entries of all the ECBs and recount the used
+**                  part of their aid_cfg[]
+**
+** Returns          void
+**
+*******************************************************************************/
+static void nfa_ee_aid_idx_build(void) {
+  nfa_ee_aid_idx.clear();
+  nfa_ee_aid_idx_count = 0;
+
+  for (int xx = 0; xx < NFA_EE_NUM_ECBS; xx++) {
+    tNFA_EE_ECB* p_ecb = &nfa_ee_cb.ecb[xx];
+    uint16_t offset = 0;
+    for (int yy = 0; yy < p_ecb->aid_entries; yy++) {
+      nfa_ee_aid_idx_insert(nfa_ee_aid_hash(p_ecb->aid_cfg[offset + 1],
+                                            &p_ecb->aid_cfg[offset + 2]),
+                            xx, yy, offset);
+      offset += p_ecb->aid_len[yy];
+    }
+    p_ecb->aid_cfg_len = offset;
+  }
+  nfa_ee_cb.aid_idx_valid = true;
+  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
+      "%s: %zu AIDs in %zu slots", __func__, nfa_ee_aid_idx_count,
+      nfa_ee_aid_idx.size());
+}
+
+/*******************************************************************************
+**
+** Function         nfa_ee_aid_idx_add
+**
+** Description      Index the AID entry just added to the given ECB
+**
+** Returns          void
+**
+*******************************************************************************/
+static void nfa_ee_aid_idx_add(tNFA_EE_ECB* p_cb, int entry, int offset) {
+  if (!nfa_ee_cb.aid_idx_valid) return;
+
+  nfa_ee_aid_idx_insert(
+      nfa_ee_aid_hash(p_cb->aid_cfg[offset + 1], &p_cb->aid_cfg[offset + 2]),
+      (uint8_t)(p_cb - nfa_ee_cb.ecb), entry, offset);
+}
+
+/*******************************************************************************
+**
+** Function         nfa_ee_aid_idx_remove
+**
+** Description      Drop the AID entry about to be removed from the given ECB
+**                  from the index, and move the slots of the entries after it
+**                  to where the removal shifts them
+**
+** Returns          void
+**
+*******************************************************************************/
+static void nfa_ee_aid_idx_remove(tNFA_EE_ECB* p_cb, int entry, int offset) {
+  if (!nfa_ee_cb.aid_idx_valid) return;
+
+  uint8_t ecb_idx = (uint8_t)(p_cb - nfa_ee_cb.ecb);
+  uint8_t len = p_cb->aid_len[entry];
+  uint32_t hash =
+      nfa_ee_aid_hash(p_cb->aid_cfg[offset + 1], &p_cb->aid_cfg[offset + 2]);
+  size_t mask = nfa_ee_aid_idx.size() - 1;
+  size_t xx = hash & mask;
+
+  while ((nfa_ee_aid_idx[xx].ecb_idx != ecb_idx) ||
+         (nfa_ee_aid_idx[xx].entry != entry)) {
+    if (nfa_ee_aid_idx[xx].ecb_idx == NFA_EE_AID_IDX_FREE) {
+      /* the ECBs changed without the index knowing */
+      nfa_ee_cb.aid_idx_valid = false;
+      return;
+    }
+    xx = (xx + 1) & mask;
+  }
+
+  /* Free the slot, and move back the slots after it that can no longer be
+   * reached from their home slot */
+  nfa_ee_aid_idx[xx].ecb_idx = NFA_EE_AID_IDX_FREE;
+  nfa_ee_aid_idx_count--;
+  for (size_t yy = (xx + 1) & mask;
+       nfa_ee_aid_idx[yy].ecb_idx != NFA_EE_AID_IDX_FREE;
+       yy = (yy + 1) & mask) {
+    size_t home = nfa_ee_aid_idx[yy].hash & mask;
+    if (((yy - home) & mask) >= ((yy - xx) & mask)) {
+      nfa_ee_aid_idx[xx] = nfa_ee_aid_idx[yy];
+      nfa_ee_aid_idx[yy].ecb_idx = NFA_EE_AID_IDX_FREE;
+      xx = yy;
+    }
+  }
+
+  for (tNFA_EE_AID_IDX_SLOT& slot : nfa_ee_aid_idx) {
+    if ((slot.ecb_idx == ecb_idx) && (slot.entry > entry)) {
+      slot.entry--;
+      slot.offset -= len;
+    }
+  }
+}
+
+/*******************************************************************************
+**
+** Function         nfa_ee_aid_store_carve
+**
+** Description      Point the AID arrays of the given ECB into p_store, which
+**                  holds cap entries: aid_sel_seq first to keep it aligned,
+**                  then NFA_EE_AID_STORE_ARRAYS uint8_t arrays from aid_len
+**                  on, then aid_cfg
+**
+** Returns          void
+**
+*******************************************************************************/
+static void nfa_ee_aid_store_carve(tNFA_EE_ECB* p_cb, uint8_t* p_store,
+                                   int cap) {
+  p_cb->p_aid_store = p_store;
+  p_cb->aid_entries_cap = (uint16_t)cap;
+  p_cb->aid_sel_seq = (uint32_t*)p_store;
+  p_store += cap * sizeof(uint32_t);
+  p_cb->aid_len = p_store;
+  p_cb->aid_pwr_cfg = p_store + cap;
+  p_cb->aid_rt_info = p_store + 2 * cap;
+  p_cb->aid_rt_loc = p_store + 3 * cap;
+  p_cb->aid_info = p_store + 4 * cap;
+  p_cb->aid_prio = p_store + 5 * cap;
+  p_cb->aid_fit_len = p_store + 6 * cap;
+  p_cb->aid_cfg = p_store + NFA_EE_AID_STORE_ARRAYS * cap;
+}
+
+/*******************************************************************************
+**
+** Function         nfa_ee_aid_store_reserve
+**
+** Description      Make the AID arrays of the given ECB hold at least the
+**                  given number of entries, moving them to a larger block if
+**                  needed
+**
+** Returns          true, if the arrays can hold the entries
+**
+*******************************************************************************/
+static bool nfa_ee_aid_store_reserve(tNFA_EE_ECB* p_cb, int entries) {
+  if (entries <= p_cb->aid_entries_cap) return true;
+  if (entries > nfa_ee_cb.aid_store_max) {
+    LOG(ERROR) << StringPrintf("%s: AID_ROUTE_MAX_ENTRIES:%d reached",
+                               __func__, nfa_ee_cb.aid_store_max);
+    return false;
+  }
+
+  int cap = std::max(entries, p_cb->aid_entries_cap * 2);
+  cap = std::max(cap, NFA_EE_AID_STORE_MIN_ENTRIES);
+  if (cap > nfa_ee_cb.aid_store_max) cap = nfa_ee_cb.aid_store_max;
+
+  uint8_t* p_store = (uint8_t*)nfa_mem_co_alloc(
+      cap * (sizeof(uint32_t) + NFA_EE_AID_STORE_ARRAYS +
+             NFA_EE_AID_STORE_CFG_LEN));
+  if (p_store == NULL) {
+    LOG(ERROR) << StringPrintf("%s: no memory for %d AIDs", __func__, cap);
+    return false;
+  }
+
+  uint8_t* p_old = p_cb->p_aid_store;
+  int old_cap = p_cb->aid_entries_cap;
+  nfa_ee_aid_store_carve(p_cb, p_store, cap);
+  if (p_old != NULL) {
+    uint8_t* p_old_arrays = p_old + old_cap * sizeof(uint32_t);
+    memcpy(p_cb->aid_sel_seq, p_old, p_cb->aid_entries * sizeof(uint32_t));
+    for (int xx = 0; xx < NFA_EE_AID_STORE_ARRAYS; xx++) {
+      memcpy(p_cb->aid_len + xx * cap, p_old_arrays + xx * old_cap,
+             p_cb->aid_entries);
+    }
+    memcpy(p_cb->aid_cfg, p_old_arrays + NFA_EE_AID_STORE_ARRAYS * old_cap,
+           p_cb->aid_cfg_len);
+    nfa_mem_co_free(p_old);
+  }
+  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
+      "%s: nfcee_id:0x%x cap:%d", __func__, p_cb->nfcee_id, cap);
+  return true;
+}
+
+/*******************************************************************************
+**
+** Function         nfa_ee_aid_store_detach
+**
+** Description      Forget the AID entries of the given ECB without freeing
+**                  them, when another ECB took them over
+**
+** Returns          void
+**
+*******************************************************************************/
+static void nfa_ee_aid_store_detach(tNFA_EE_ECB* p_cb) {
+  p_cb->p_aid_store = NULL;
+  p_cb->aid_entries_cap = 0;
+  p_cb->aid_sel_seq = NULL;
+  p_cb->aid_len = NULL;
+  p_cb->aid_pwr_cfg = NULL;
+  p_cb->aid_rt_info = NULL;
+  p_cb->aid_rt_loc = NULL;
+  p_cb->aid_info = NULL;
+  p_cb->aid_prio = NULL;
+  p_cb->aid_fit_len = NULL;
+  p_cb->aid_cfg = NULL;
+  p_cb->aid_entries = 0;
+  p_cb->aid_cfg_len = 0;
+  p_cb->size_aid = 0;
+}
+
+/*******************************************************************************
+**
+** Function         nfa_ee_aid_store_free
+**
+** Description      Remove all the AID entries of the given ECB and free the
+**                  memory that held them
+**
+** Returns          void
+**
+*******************************************************************************/
+void nfa_ee_aid_store_free(tNFA_EE_ECB* p_cb) {
+  if (p_cb->p_aid_store != NULL) nfa_mem_co_free(p_cb->p_aid_store);
+  nfa_ee_aid_store_detach(p_cb);
+  nfa_ee_cb.aid_idx_valid = false;
+}
+
+/* A routed AID entry, as seen by the AID overflow policy */
+typedef struct {
+  tNFA_EE_ECB* p_cb;
+  uint8_t* p_aid; /* the AID in aid_cfg[] */
+  uint8_t aid_len;
+  uint8_t entry;
+} tNFA_EE_AID_FIT;
+
+/*******************************************************************************
+**
+** Function         nfa_ee_aid_route
+**
+** Description      Find the route of an AID entry for nfa_ee_lmrt_aid_collapse
+**
+** Returns          the same value for AID entries that could share one routing
+**                  entry: the same ECB, route, power state and qualifiers
+**
+*******************************************************************************/
+static uint32_t nfa_ee_aid_route(const tNFA_EE_AID_FIT& aid) {
+  return ((uint32_t)(aid.p_cb - nfa_ee_cb.ecb) << 24) |
+         (aid.p_cb->aid_rt_loc[aid.entry] << 16) |
+         (aid.p_cb->aid_pwr_cfg[aid.entry] << 8) | aid.p_cb->aid_info[aid.entry];
+}
+
+/*******************************************************************************
+**
+** Function         nfa_ee_aid_fit_lmrt
+**
+** Description      Apply nfa_ee_cb.aid_overflow_policy: when the routed AIDs
+**                  do not all fit the listen mode routing table, choose the
+**                  ones that go in it and mark the others NFA_EE_AE_OVERFLOW.
+**                  size_aid of the ECBs is updated to match.
+**
+** Returns          void
+**
+*******************************************************************************/
+static void nfa_ee_aid_fit_lmrt(void) {
+  std::vector<tNFA_EE_AID_FIT> aids;
+  int aid_size = 0;
+
+  for (int xx = 0; xx < NFA_EE_NUM_ECBS; xx++) {
+    tNFA_EE_ECB* p_cb = &nfa_ee_cb.ecb[xx];
+    bool in_lmrt = nfa_ee_ecb_in_lmrt(p_cb);
+    uint16_t offset = 0;
+    for (int yy = 0; yy < p_cb->aid_entries; yy++) {
+      p_cb->aid_rt_info[yy] &= ~(NFA_EE_AE_OVERFLOW | NFA_EE_AE_PREFIX);
+      p_cb->aid_fit_len[yy] = 0;
+      if (in_lmrt && (p_cb->aid_rt_info[yy] & NFA_EE_AE_ROUTE)) {
+        uint8_t len = p_cb->aid_cfg[offset + 1];
+        aids.push_back({p_cb, &p_cb->aid_cfg[offset + 2], len, (uint8_t)yy});
+        aid_size += 4 + len;
+      }
+      offset += p_cb->aid_len[yy];
+    }
+    nfa_ee_update_route_aid_size(p_cb);
+  }
+  if ((nfa_ee_cb.aid_overflow_policy == NFA_EE_AID_OVERFLOW_REJECT) ||
+      aids.empty())
+    return;
+
+  /* the NFC-DEP route to DH is always added, but not in size_mask */
+  int budget = NFC_GetLmrtSize() - (nfa_ee_total_lmrt_size() - aid_size) -
+               NFA_EE_LMRT_TLV_SIZE(1);
+  if (aid_size <= budget) return;
+
+  std::vector<tNFA_EE_LMRT_AID_GROUP> groups;
+  if (nfa_ee_cb.aid_overflow_policy == NFA_EE_AID_OVERFLOW_PREFIX) {
+    std::vector<tNFA_EE_LMRT_AID> routed;
+    for (size_t xx = 0; xx < aids.size(); xx++)
+      routed.push_back({nfa_ee_aid_route(aids[xx]), aids[xx].p_aid,
+                        aids[xx].aid_len, (uint16_t)xx});
+    aid_size -= nfa_ee_lmrt_aid_collapse(routed, NFA_MIN_AID_LEN,
+                                         aid_size - budget, &groups);
+    /* the groups are runs of the AIDs in the order they were sorted in */
+    std::vector<tNFA_EE_AID_FIT> sorted;
+    for (const tNFA_EE_LMRT_AID& aid : routed) sorted.push_back(aids[aid.id]);
+    aids.swap(sorted);
+  } else {
+    for (size_t xx = 0; xx < aids.size(); xx++)
+      groups.push_back({(int)xx, (int)xx, aids[xx].aid_len});
+  }
+
+  /* Rank the groups by their best member; the member added first carries
+   * the group. Ties go to the group whose carrier was added first. */
+  bool lru = (nfa_ee_cb.aid_overflow_policy == NFA_EE_AID_OVERFLOW_LRU);
+  std::vector<uint32_t> rank(groups.size());
+  std::vector<int> lead(groups.size());
+  std::vector<int> order(groups.size());
+  for (size_t xx = 0; xx < groups.size(); xx++) {
+    const tNFA_EE_LMRT_AID_GROUP& group = groups[xx];
+    uint32_t best = 0;
+    lead[xx] = group.first;
+    for (int yy = group.first; yy <= group.last; yy++) {
+      const tNFA_EE_AID_FIT& aid = aids[yy];
+      best = std::max<uint32_t>(best, lru ? aid.p_cb->aid_sel_seq[aid.entry]
+                                          : aid.p_cb->aid_prio[aid.entry]);
+      if (aid.entry < aids[lead[xx]].entry) lead[xx] = yy;
+    }
+    rank[xx] = best;
+    order[xx] = (int)xx;
+  }
+  std::sort(order.begin(), order.end(), [&](int a, int b) {
+    if (rank[a] != rank[b]) return rank[a] > rank[b];
+    const tNFA_EE_AID_FIT& la = aids[lead[a]];
+    const tNFA_EE_AID_FIT& lb = aids[lead[b]];
+    if (la.p_cb != lb.p_cb) return la.p_cb < lb.p_cb;
+    return la.entry < lb.entry;
+  });
+
+  /* Keep the groups that still fit, in rank order */
+  int used = 0, dropped = 0;
+  for (int xx : order) {
+    const tNFA_EE_LMRT_AID_GROUP& group = groups[xx];
+    /* 4 = 1 (tag) + 1 (len) + 1(nfcee_id) + 1(power cfg) */
+    bool fits = (used + 4 + group.len <= budget);
+    if (fits) used += 4 + group.len;
+    for (int yy = group.first; yy <= group.last; yy++) {
+      const tNFA_EE_AID_FIT& aid = aids[yy];
+      if (fits && (yy == lead[xx])) {
+        if (group.first != group.last) {
+          aid.p_cb->aid_rt_info[aid.entry] |= NFA_EE_AE_PREFIX;
+          aid.p_cb->aid_fit_len[aid.entry] = group.len;
+        }
+      } else {
+        aid.p_cb->aid_rt_info[aid.entry] |= NFA_EE_AE_OVERFLOW;
+        if (!fits) dropped++;
+      }
+    }
+  }
+  for (int xx = 0; xx < NFA_EE_NUM_ECBS; xx++)
+    nfa_ee_update_route_aid_size(&nfa_ee_cb.ecb[xx]);
+
+  LOG(WARNING) << StringPrintf(
+      "%s: %zu AIDs in %d bytes for %d bytes, %d AIDs not routed", __func__,
+      aids.size(), aid_size, budget, dropped);
+}
+
 /*******************************************************************************
 **
 ** Function         nfa_ee_find_aid_offset
 **
 ** Description      Given the AID, find the associated tNFA_EE_ECB and the
 **                  offset in aid_cfg[]. *p_entry is the index.
+**                  The DH ECB is searched first, then the ECBs of the
+**                  discovered NFCEEs in order.
 **
 ** Returns          void
 **
 *******************************************************************************/
 tNFA_EE_ECB* nfa_ee_find_aid_offset(uint8_t aid_len, uint8_t* p_aid,
                                     int* p_offset, int* p_entry) {
-  int xx, yy, aid_len_offset, offset;
-  tNFA_EE_ECB* p_ret = NULL, *p_ecb;
+  const tNFA_EE_AID_IDX_SLOT* p_found = NULL;
+  int found_order = 0;
+
+  if (!nfa_ee_cb.aid_idx_valid) nfa_ee_aid_idx_build();
+  if (nfa_ee_aid_idx.empty()) return NULL;
+
+  uint32_t hash = nfa_ee_aid_hash(aid_len, p_aid);
+  size_t mask = nfa_ee_aid_idx.size() - 1;
+  for (size_t xx = hash & mask;
+       nfa_ee_aid_idx[xx].ecb_idx != NFA_EE_AID_IDX_FREE;
+       xx = (xx + 1) & mask) {
+    const tNFA_EE_AID_IDX_SLOT* p_slot = &nfa_ee_aid_idx[xx];
+    if (p_slot->hash != hash) continue;
+
+    int order;
+    if (p_slot->ecb_idx == NFA_EE_CB_4_DH)
+      order = 0;
+    else if (p_slot->ecb_idx < nfa_ee_cb.cur_ee)
+      order = p_slot->ecb_idx + 1;
+    else
+      continue;
 
-  p_ecb = &nfa_ee_cb.ecb[NFA_EE_CB_4_DH];
-  aid_len_offset = 1; /* skip the tag */
-  for (yy = 0; yy <= nfa_ee_cb.cur_ee; yy++) {
-    if (p_ecb->aid_entries) {
-      offset = 0;
-      for (xx = 0; xx < p_ecb->aid_entries; xx++) {
-        if ((p_ecb->aid_cfg[offset + aid_len_offset] == aid_len) &&
-            (memcmp(&p_ecb->aid_cfg[offset + aid_len_offset + 1], p_aid,
-                    aid_len) == 0)) {
-          p_ret = p_ecb;
-          if (p_offset) *p_offset = offset;
-          if (p_entry) *p_entry = xx;
-          break;
-        }
-        offset += p_ecb->aid_len[xx];
-      }
+    const uint8_t* p_cfg = &nfa_ee_cb.ecb[p_slot->ecb_idx].aid_cfg[p_slot->offset];
+    if ((p_cfg[1] != aid_len) || (memcmp(&p_cfg[2], p_aid, aid_len) != 0))
+      continue;
 
-      if (p_ret) {
-        /* found the entry already */
-        break;
-      }
+    if ((p_found == NULL) || (order < found_order) ||
+        ((order == found_order) && (p_slot->entry < p_found->entry))) {
+      p_found = p_slot;
+      found_order = order;
     }
-    p_ecb = &nfa_ee_cb.ecb[yy];
   }
 
-  return p_ret;
+  if (p_found == NULL) return NULL;
+  if (p_offset) *p_offset = p_found->offset;
+  if (p_entry) *p_entry = p_found->entry;
+  return &nfa_ee_cb.ecb[p_found->ecb_idx];
 }
 
 /*******************************************************************************
@@ -1042,6 +1349,23 @@ void nfa_ee_start_timer(void) {
                         NFA_EE_ROUT_TIMEOUT_VAL);
 }
 
+/*******************************************************************************
+**
+** Function         nfa_ee_config_reloaded
+**
+** Description      Build the routing table again after a config it depends on
+**                  was reloaded
+**
+** Returns          void
+**
+*******************************************************************************/
+void nfa_ee_config_reloaded(void) {
+  if (nfa_ee_cb.em_state != NFA_EE_EM_STATE_INIT_DONE) return;
+
+  nfa_ee_cb.ee_cfg_sts |= NFA_EE_STS_CHANGED_ROUTING;
+  nfa_ee_start_timer();
+}
+
 /*******************************************************************************
 **
 ** Function         nfa_ee_get_num_nfcee_configured
@@ -1223,40 +1547,6 @@ void nfa_ee_api_register(tNFA_EE_MSG* p_data) {
               "max_routing_table_size = %d max_aid_config_length: %d and "
               "max_aid_entries: %d",
               max_routing_table_size, max_aid_config_length, max_aid_entries);
-      /* Dynamic ecb allocation based on max aid entry calculated from max. routing
-       * table size( from core_init rsp )*/
-      for (xx = 0; xx < NFA_EE_NUM_ECBS; xx++) {
-          nfa_ee_cb.ecb[xx].aid_len = (uint8_t*) GKI_getbuf(max_aid_entries);
-          nfa_ee_cb.ecb[xx].aid_pwr_cfg = (uint8_t*) GKI_getbuf(max_aid_entries);
-          nfa_ee_cb.ecb[xx].aid_rt_info = (uint8_t*) GKI_getbuf(max_aid_entries);
-          nfa_ee_cb.ecb[xx].aid_rt_loc = (uint8_t*) GKI_getbuf(max_aid_entries);
-          nfa_ee_cb.ecb[xx].aid_info    = (uint8_t*) GKI_getbuf(max_aid_entries);
-          nfa_ee_cb.ecb[xx].aid_cfg = (uint8_t*) GKI_getbuf(max_aid_config_length);
-          if ((NULL != nfa_ee_cb.ecb[xx].aid_len) &&
-                  (NULL != nfa_ee_cb.ecb[xx].aid_pwr_cfg) &&
-                  (NULL != nfa_ee_cb.ecb[xx].aid_rt_info) &&
-                  (NULL != nfa_ee_cb.ecb[xx].aid_rt_loc) &&
-                  (NULL != nfa_ee_cb.ecb[xx].aid_info) &&
-                  (NULL != nfa_ee_cb.ecb[xx].aid_cfg)) {
-              memset(nfa_ee_cb.ecb[xx].aid_len, 0, max_aid_entries);
-              memset(nfa_ee_cb.ecb[xx].aid_pwr_cfg, 0, max_aid_entries);
-              memset(nfa_ee_cb.ecb[xx].aid_rt_info, 0, max_aid_entries);
-              memset(nfa_ee_cb.ecb[xx].aid_rt_loc, 0, max_aid_entries);
-              memset(nfa_ee_cb.ecb[xx].aid_info, 0, max_aid_entries);
-              memset(nfa_ee_cb.ecb[xx].aid_cfg, 0, max_aid_config_length);
-          } else {
-              LOG(ERROR) << StringPrintf("GKI_getbuf allocation for ECB failed !");
-          }
-      }
-  }
-  else {
-      for (xx = 0; xx < NFA_EE_NUM_ECBS; xx++) {
-          nfa_ee_cb.ecb[xx].aid_len = nfa_ee_cb.ecb[xx].aid_len_stat;
-          nfa_ee_cb.ecb[xx].aid_pwr_cfg = nfa_ee_cb.ecb[xx].aid_pwr_cfg_stat;
-          nfa_ee_cb.ecb[xx].aid_rt_info = nfa_ee_cb.ecb[xx].aid_rt_info_stat;
-          nfa_ee_cb.ecb[xx].aid_rt_loc = nfa_ee_cb.ecb[xx].aid_rt_loc_stat;
-          nfa_ee_cb.ecb[xx].aid_cfg = nfa_ee_cb.ecb[xx].aid_cfg_stat;
-      }
   }
 #endif
 
@@ -1279,27 +1569,10 @@ void nfa_ee_api_register(tNFA_EE_MSG* p_data) {
 *******************************************************************************/
 void nfa_ee_api_deregister(tNFA_EE_MSG* p_data) {
   tNFA_EE_CBACK* p_cback = NULL;
-#if (NXP_EXTNS == TRUE)
-  int index = p_data->deregister.index, xx = 0;
-#else
   int index = p_data->deregister.index;
-#endif
   tNFA_EE_CBACK_DATA evt_data = {0};
 
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("nfa_ee_api_deregister");
-#if (NXP_EXTNS == TRUE)
-  if((nfcFL.chipType != pn547C2) &&
-          (nfcFL.nfcMwFL._NFC_NXP_AID_MAX_SIZE_DYN == true)) {
-      for (xx = 0; xx < NFA_EE_NUM_ECBS; xx++) {
-          GKI_freebuf(nfa_ee_cb.ecb[xx].aid_len);
-          GKI_freebuf(nfa_ee_cb.ecb[xx].aid_pwr_cfg);
-          GKI_freebuf(nfa_ee_cb.ecb[xx].aid_rt_info);
-          GKI_freebuf(nfa_ee_cb.ecb[xx].aid_rt_loc);
-          GKI_freebuf(nfa_ee_cb.ecb[xx].aid_info);
-          GKI_freebuf(nfa_ee_cb.ecb[xx].aid_cfg);
-      }
-  }
-#endif
   p_cback = nfa_ee_cb.p_ee_cback[index];
   nfa_ee_cb.p_ee_cback[index] = NULL;
   if (p_cback) (*p_cback)(NFA_EE_DEREGISTER_EVT, &evt_data);
@@ -1529,6 +1802,10 @@ void nfa_ee_api_add_aid(tNFA_EE_MSG* p_data) {
   tNFA_EE_CBACK_DATA evt_data = {0};
   int offset = 0, entry = 0;
   uint16_t new_size;
+  /* unless AIDs that overflow are rejected, the overflow policy picks the
+   * ones routed when the table is sent to NFCC */
+  bool fit_lmrt =
+      (nfa_ee_cb.aid_overflow_policy == NFA_EE_AID_OVERFLOW_REJECT);
 
   nfa_ee_trace_aid("nfa_ee_api_add_aid", p_cb->nfcee_id, p_add->aid_len,
                    p_add->p_aid);
@@ -1552,7 +1829,7 @@ void nfa_ee_api_add_aid(tNFA_EE_MSG* p_data) {
       p_cb->aid_rt_info[entry] |= NFA_EE_AE_ROUTE;
       p_cb->aid_info[entry] = p_add->aidInfo;
       new_size = nfa_ee_total_lmrt_size();
-      if (new_size > NFC_GetLmrtSize()) {
+      if (fit_lmrt && (new_size > NFC_GetLmrtSize())) {
         DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("Exceed LMRT size:%d (add ROUTE)", new_size);
         evt_data.status = NFA_STATUS_BUFFER_FULL;
         p_cb->aid_rt_info[entry] &= ~NFA_EE_AE_ROUTE;
@@ -1590,13 +1867,13 @@ void nfa_ee_api_add_aid(tNFA_EE_MSG* p_data) {
         aid_config_length_max = NFA_EE_MAX_AID_CFG_LEN_STAT;
         aid_entries_max = nfcFL.nfcMwFL._NFA_EE_MAX_AID_ENTRIES;
     }
-    if ((len_needed + len) >
+    if (fit_lmrt && ((len_needed + len) >
 #if (NXP_EXTNS == TRUE)
     aid_config_length_max
 #else
     NFA_EE_MAX_AID_CFG_LEN
 #endif
-        ) {
+        )) {
 #if (NXP_EXTNS == TRUE)
       LOG(ERROR) << StringPrintf(
           "Exceed capacity: (len_needed:%d + len:%d) > "
@@ -1611,16 +1888,24 @@ void nfa_ee_api_add_aid(tNFA_EE_MSG* p_data) {
       evt_data.status = NFA_STATUS_BUFFER_FULL;
     }
 #if (NXP_EXTNS == TRUE)
-    else if (dh_ecb->aid_entries < aid_entries_max)
+    else if (!fit_lmrt || (dh_ecb->aid_entries < aid_entries_max))
 #else
-    else if (p_cb->aid_entries < NFA_EE_MAX_AID_ENTRIES)
+    else if (!fit_lmrt || (p_cb->aid_entries < NFA_EE_MAX_AID_ENTRIES))
 #endif
     {
       /* 4 = 1 (tag) + 1 (len) + 1(nfcee_id) + 1(power cfg) */
       new_size = nfa_ee_total_lmrt_size() + 4 + p_add->aid_len;
-      if (new_size > NFC_GetLmrtSize()) {
+      if (fit_lmrt && (new_size > NFC_GetLmrtSize())) {
         DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("Exceed LMRT size:%d", new_size);
         evt_data.status = NFA_STATUS_BUFFER_FULL;
+      }
+#if (NXP_EXTNS == TRUE)
+      else if (!nfa_ee_aid_store_reserve(dh_ecb, dh_ecb->aid_entries + 1))
+#else
+      else if (!nfa_ee_aid_store_reserve(p_cb, p_cb->aid_entries + 1))
+#endif
+      {
+        evt_data.status = NFA_STATUS_BUFFER_FULL;
       } else {
 /* add AID */
 #if (NXP_EXTNS == TRUE)
@@ -1630,11 +1915,15 @@ void nfa_ee_api_add_aid(tNFA_EE_MSG* p_data) {
         dh_ecb->aid_rt_info[dh_ecb->aid_entries] = NFA_EE_AE_ROUTE;
         dh_ecb->aid_rt_loc[dh_ecb->aid_entries] = p_cb->nfcee_id;
         dh_ecb->aid_info[dh_ecb->aid_entries] = p_add->aidInfo;
+        dh_ecb->aid_prio[dh_ecb->aid_entries] = NFA_EE_AID_PRIO_DEFAULT;
+        dh_ecb->aid_sel_seq[dh_ecb->aid_entries] = ++nfa_ee_cb.aid_sel_seq;
         p = dh_ecb->aid_cfg + len;
 #else
         p_cb->aid_pwr_cfg[p_cb->aid_entries] = p_add->power_state;
         p_cb->aid_info[p_cb->aid_entries] = p_add->aidInfo;
         p_cb->aid_rt_info[p_cb->aid_entries] = NFA_EE_AE_ROUTE;
+        p_cb->aid_prio[p_cb->aid_entries] = NFA_EE_AID_PRIO_DEFAULT;
+        p_cb->aid_sel_seq[p_cb->aid_entries] = ++nfa_ee_cb.aid_sel_seq;
         p = p_cb->aid_cfg + len;
 #endif
         p_start = p;
@@ -1644,9 +1933,13 @@ void nfa_ee_api_add_aid(tNFA_EE_MSG* p_data) {
         p += p_add->aid_len;
 
 #if (NXP_EXTNS == TRUE)
-        dh_ecb->aid_len[dh_ecb->aid_entries++] = (uint8_t)(p - p_start);
+        dh_ecb->aid_len[dh_ecb->aid_entries] = (uint8_t)(p - p_start);
+        dh_ecb->aid_cfg_len += (uint8_t)(p - p_start);
+        nfa_ee_aid_idx_add(dh_ecb, dh_ecb->aid_entries++, len);
 #else
-        p_cb->aid_len[p_cb->aid_entries++] = (uint8_t)(p - p_start);
+        p_cb->aid_len[p_cb->aid_entries] = (uint8_t)(p - p_start);
+        p_cb->aid_cfg_len += (uint8_t)(p - p_start);
+        nfa_ee_aid_idx_add(p_cb, p_cb->aid_entries++, len);
 #endif
       }
     } else {
@@ -1660,7 +1953,7 @@ void nfa_ee_api_add_aid(tNFA_EE_MSG* p_data) {
     /* mark AID changed */
     p_cb->ecb_flags |= NFA_EE_ECB_FLAGS_AID;
     nfa_ee_cb.ee_cfged |= nfa_ee_ecb_to_mask(p_cb);
-    nfa_ee_update_route_aid_size(p_cb);
+    nfa_ee_aid_fit_lmrt();
     nfa_ee_start_timer();
   }
    DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("status:%d ee_cfged:0x%02x ", evt_data.status,
@@ -1702,12 +1995,12 @@ void nfa_ee_api_remove_aid(tNFA_EE_MSG* p_data) {
       p_cb->ecb_flags |= NFA_EE_ECB_FLAGS_VS;
 
     /* remove the aid */
+    len = p_cb->aid_len[entry];
+    nfa_ee_aid_idx_remove(p_cb, entry, offset);
     if ((entry + 1) < p_cb->aid_entries) {
       /* not the last entry, move the aid entries in control block */
       /* Find the total len from the next entry to the last one */
-      rest_len = nfa_ee_find_total_aid_len(p_cb, entry + 1);
-
-      len = p_cb->aid_len[entry];
+      rest_len = p_cb->aid_cfg_len - offset - len;
        DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("nfa_ee_api_remove_aid len:%d, rest_len:%d", len,
                        rest_len);
       GKI_shiftup(&p_cb->aid_cfg[offset], &p_cb->aid_cfg[offset + len],
@@ -1724,11 +2017,16 @@ void nfa_ee_api_remove_aid(tNFA_EE_MSG* p_data) {
       GKI_shiftup(&p_cb->aid_rt_loc[entry], &p_cb->aid_rt_loc[entry + 1],
                   rest_len);
 #endif
+      GKI_shiftup(&p_cb->aid_prio[entry], &p_cb->aid_prio[entry + 1],
+                  rest_len);
+      memmove(&p_cb->aid_sel_seq[entry], &p_cb->aid_sel_seq[entry + 1],
+              rest_len * sizeof(uint32_t));
     }
     /* else the last entry, just reduce the aid_entries by 1 */
     p_cb->aid_entries--;
+    p_cb->aid_cfg_len -= len;
     nfa_ee_cb.ee_cfged |= nfa_ee_ecb_to_mask(p_cb);
-    nfa_ee_update_route_aid_size(p_cb);
+    nfa_ee_aid_fit_lmrt();
     nfa_ee_start_timer();
     /* report NFA_EE_REMOVE_AID_EVT to the callback associated the NFCEE */
     p_cback = p_cb->p_ee_cback;
@@ -1740,57 +2038,17 @@ void nfa_ee_api_remove_aid(tNFA_EE_MSG* p_data) {
     uint32_t xx;
     tNFA_EE_ECB* p_cb = nfa_ee_cb.ecb;
     for (xx = 0; xx < nfcFL.nfccFL._NFA_EE_MAX_EE_SUPPORTED; xx++, p_cb++) {
-#if (NXP_EXTNS == TRUE)
-        if((nfcFL.chipType != pn547C2) &&
-                (nfcFL.nfcMwFL._NFC_NXP_AID_MAX_SIZE_DYN == true)) {
-            memset(&p_cb->aid_cfg[0], 0x00, max_aid_config_length);
-            memset(&p_cb->aid_len[0], 0x00, max_aid_entries);
-            memset(&p_cb->aid_pwr_cfg[0], 0x00, max_aid_entries);
-            memset(&p_cb->aid_info[0], 0x00, max_aid_entries);
-            memset(&p_cb->aid_rt_info[0], 0x00, max_aid_entries);
-        }
-        else {
-            memset(&p_cb->aid_cfg[0], 0x00, sizeof(p_cb->aid_cfg));
-            memset(&p_cb->aid_len[0], 0x00, NFA_EE_MAX_AID_ENTRIES);
-            memset(&p_cb->aid_pwr_cfg[0], 0x00, NFA_EE_MAX_AID_ENTRIES);
-            memset(&p_cb->aid_rt_info[0], 0x00, NFA_EE_MAX_AID_ENTRIES);
-        }
-#else
-        memset(&p_cb->aid_cfg[0], 0x00, sizeof(p_cb->aid_cfg));
-        memset(&p_cb->aid_len[0], 0x00, NFA_EE_MAX_AID_ENTRIES);
-        memset(&p_cb->aid_pwr_cfg[0], 0x00, NFA_EE_MAX_AID_ENTRIES);
-        memset(&p_cb->aid_rt_info[0], 0x00, NFA_EE_MAX_AID_ENTRIES);
-        memset(&p_cb->aid_info[0], 0x00, NFA_EE_MAX_AID_ENTRIES);
-#endif
         p_cb->aid_entries = 0;
+        p_cb->aid_cfg_len = 0;
         nfa_ee_cb.ee_cfged |= nfa_ee_ecb_to_mask(p_cb);
     }
 
     tNFA_EE_ECB* p_ecb = &nfa_ee_cb.ecb[NFA_EE_CB_4_DH];
 
-#if (NXP_EXTNS == TRUE)
-    if((nfcFL.chipType != pn547C2) &&
-            (nfcFL.nfcMwFL._NFC_NXP_AID_MAX_SIZE_DYN == true)) {
-        memset(&p_ecb->aid_cfg[0], 0x00, max_aid_config_length);
-        memset(&p_ecb->aid_len[0], 0x00, max_aid_entries);
-        memset(&p_ecb->aid_pwr_cfg[0], 0x00, max_aid_entries);
-        memset(&p_ecb->aid_info[0], 0x00, max_aid_entries);
-        memset(&p_ecb->aid_rt_info[0], 0x00, max_aid_entries);
-    }
-    else {
-        memset(&p_ecb->aid_cfg[0], 0x00, sizeof(p_ecb->aid_cfg));
-        memset(&p_ecb->aid_len[0], 0x00, NFA_EE_MAX_AID_ENTRIES);
-        memset(&p_ecb->aid_pwr_cfg[0], 0x00, NFA_EE_MAX_AID_ENTRIES);
-        memset(&p_ecb->aid_rt_info[0], 0x00, NFA_EE_MAX_AID_ENTRIES);
-    }
-#else
-    memset(&p_ecb->aid_cfg[0], 0x00, sizeof(p_ecb->aid_cfg));
-    memset(&p_ecb->aid_len[0], 0x00, NFA_EE_MAX_AID_ENTRIES);
-    memset(&p_ecb->aid_pwr_cfg[0], 0x00, NFA_EE_MAX_AID_ENTRIES);
-    memset(&p_ecb->aid_rt_info[0], 0x00, NFA_EE_MAX_AID_ENTRIES);
-    memset(&p_ecb->aid_info[0], 0x00, NFA_EE_MAX_AID_ENTRIES);
-#endif
     p_ecb->aid_entries = 0;
+    p_ecb->aid_cfg_len = 0;
+    nfa_ee_cb.aid_idx_valid = false;
+    nfa_ee_aid_fit_lmrt();
     p_cb->ecb_flags |= NFA_EE_ECB_FLAGS_AID;
     nfa_ee_cb.ee_cfged |= nfa_ee_ecb_to_mask(p_ecb);
   }
@@ -1803,6 +2061,47 @@ void nfa_ee_api_remove_aid(tNFA_EE_MSG* p_data) {
   nfa_ee_report_event(p_cback, NFA_EE_REMOVE_AID_EVT, &evt_data);
 }
 
+/*******************************************************************************
+**
+** Function         nfa_ee_api_set_aid_prio
+**
+** Description      process set the priority of an AID routing configuration
+**                  from user. The priority decides the AIDs routed when they
+**                  do not all fit the listen mode routing table.
+**
+** Returns          void
+**
+*******************************************************************************/
+void nfa_ee_api_set_aid_prio(tNFA_EE_MSG* p_data) {
+  tNFA_EE_API_SET_AID_PRIO* p_prio = &p_data->set_aid_prio;
+  tNFA_EE_ECB* p_cb;
+  tNFA_EE_CBACK_DATA evt_data = {0};
+  int offset = 0, entry = 0;
+  tNFA_EE_CBACK* p_cback = NULL;
+
+  nfa_ee_trace_aid("nfa_ee_api_set_aid_prio", 0, p_prio->aid_len,
+                   p_prio->p_aid);
+  p_cb = nfa_ee_find_aid_offset(p_prio->aid_len, p_prio->p_aid, &offset,
+                                &entry);
+  if (p_cb) {
+    if (p_cb->aid_prio[entry] != p_prio->priority) {
+      p_cb->aid_prio[entry] = p_prio->priority;
+      if (nfa_ee_cb.aid_overflow_policy != NFA_EE_AID_OVERFLOW_REJECT) {
+        p_cb->ecb_flags |= NFA_EE_ECB_FLAGS_AID;
+        nfa_ee_cb.ee_cfged |= nfa_ee_ecb_to_mask(p_cb);
+        nfa_ee_aid_fit_lmrt();
+        nfa_ee_start_timer();
+      }
+    }
+    p_cback = p_cb->p_ee_cback;
+  } else {
+    LOG(ERROR) << StringPrintf(
+        "nfa_ee_api_set_aid_prio The AID entry is not in the database");
+    evt_data.status = NFA_STATUS_INVALID_PARAM;
+  }
+  nfa_ee_report_event(p_cback, NFA_EE_SET_AID_PRIO_EVT, &evt_data);
+}
+
 /*******************************************************************************
 **
 ** Function         nfa_ee_api_add_apdu
@@ -2489,8 +2788,12 @@ static void nfa_ee_remove_pending(void) {
       }
 
       if (p_cb_n <= p_cb_end) {
+        /* p_cb takes over the AID entries of p_cb_n */
+        nfa_ee_aid_store_free(p_cb);
         memcpy(p_cb, p_cb_n, sizeof(tNFA_EE_ECB));
+        nfa_ee_aid_store_detach(p_cb_n);
         p_cb_n->nfcee_id = NFA_EE_INVALID;
+        nfa_ee_cb.aid_idx_valid = false;
       }
       p_cb++;
       p_cb_n++;
@@ -2993,6 +3296,8 @@ void nfa_ee_nci_mode_set_rsp(tNFA_EE_MSG* p_data) {
       p_cb->proto_switch_on = p_cb->proto_switch_off = p_cb->proto_battery_off =
           0;
       p_cb->apdu_pattern_entries = p_cb->aid_entries = 0;
+      p_cb->aid_cfg_len = 0;
+      nfa_ee_cb.aid_idx_valid = false;
 #endif
 #if (NXP_EXTNS == TRUE)
       if (p_cb->ee_status != NFC_NFCEE_STATUS_REMOVED)
@@ -3085,7 +3390,17 @@ void nfa_ee_nci_wait_rsp(tNFA_EE_MSG* p_data) {
       "nfa_ee_nci_wait_rsp() ee_wait_evt:0x%x wait_rsp:%d p_rsp->opcode : %d",
       nfa_ee_cb.ee_wait_evt, nfa_ee_cb.wait_rsp, p_rsp->opcode);
   if (nfa_ee_cb.wait_rsp) {
-    if (p_rsp->opcode == NCI_MSG_RF_SET_ROUTING) nfa_ee_cb.wait_rsp--;
+    if (p_rsp->opcode == NCI_MSG_RF_SET_ROUTING) {
+      nfa_ee_cb.wait_rsp--;
+      if (((tNFC_RESPONSE*)p_rsp->p_data)->status != NFC_STATUS_OK)
+        nfa_ee_lmrt_sent_failed = true;
+      if ((nfa_ee_cb.wait_rsp == 0) && !nfa_ee_lmrt_sent.empty()) {
+        /* remember the table the NFCC has now */
+        nfa_ee_cb.lmrt_acked_valid = !nfa_ee_lmrt_sent_failed;
+        nfa_ee_lmrt_acked.swap(nfa_ee_lmrt_sent);
+        nfa_ee_lmrt_sent.clear();
+      }
+    }
   }
   nfa_ee_report_update_evt();
 }
@@ -3199,6 +3514,14 @@ void nfa_ee_nci_action_ntf(tNFA_EE_MSG* p_data) {
     nfa_ee_ce_p61_active = 0x01;
   }
 #endif
+  if (evt_data.trigger == NFC_EE_TRIG_SELECT) {
+    /* remember the AID as used for NFA_EE_AID_OVERFLOW_LRU */
+    int offset, entry;
+    tNFA_EE_ECB* p_cb =
+        nfa_ee_find_aid_offset(p_cbk->act_data.param.aid.len_aid,
+                               p_cbk->act_data.param.aid.aid, &offset, &entry);
+    if (p_cb) p_cb->aid_sel_seq[entry] = ++nfa_ee_cb.aid_sel_seq;
+  }
   tNFA_EE_CBACK_DATA nfa_ee_cback_data;
   nfa_ee_cback_data.action = evt_data;
   nfa_ee_report_event(NULL, NFA_EE_ACTION_EVT, &nfa_ee_cback_data);
@@ -3420,121 +3743,46 @@ void nfa_ee_get_tech_route(uint8_t power_state, uint8_t* p_handles) {
 
 /*******************************************************************************
 **
-** Function         nfa_ee_check_set_routing
+** Function         nfa_ee_route_add_one_ecb_by_route_order
 **
-** Description      If the new size exceeds the capacity of next block,
-**                  send the routing command now and reset the related
-**                  parameters.
+** Description      Add the routing entries of one type for NFCEE/DH to the
+**                  routes of the table being compiled
 **
 ** Returns          void
 **
 *******************************************************************************/
-void nfa_ee_check_set_routing(uint16_t new_size, int* p_max_len, uint8_t* p,
-                              int* p_cur_offset) {
-  uint8_t max_tlv = (uint8_t)((*p_max_len > NFA_EE_ROUT_MAX_TLV_SIZE)
-                                  ? NFA_EE_ROUT_MAX_TLV_SIZE
-                                  : *p_max_len);
-
-  if (new_size + *p_cur_offset > max_tlv) {
-    if (NFC_SetRouting(true, *p, *p_cur_offset, p + 1) == NFA_STATUS_OK) {
-      nfa_ee_cb.wait_rsp++;
-    }
-    /* after the routing command is sent, re-use the same buffer to send the
-     * next routing command.
-     * reset the related parameters */
-    if (*p_max_len > *p_cur_offset)
-      *p_max_len -= *p_cur_offset; /* the max is reduced */
-    else
-      *p_max_len = 0;
-    *p_cur_offset = 0; /* nothing is in queue any more */
-    *p = 0;            /* num_tlv=0 */
-  }
-}
-
-/*******************************************************************************
-**
-** Function         nfa_ee_route_add_one_ecb_order
-**
-** Description      Add the routing entries for NFCEE/DH in order defined
-**
-** Returns          NFA_STATUS_OK, if ok to continue
-**
-*******************************************************************************/
-void nfa_ee_route_add_one_ecb_by_route_order(tNFA_EE_ECB* p_cb, int rout_type,
-                                             int* p_max_len, bool more,
-                                             uint8_t* ps, int* p_cur_offset) {
-  nfa_ee_check_set_routing(p_cb->size_mask, p_max_len, ps, p_cur_offset);
-
-  /* use the first byte of the buffer (ps) to keep the num_tlv */
-  uint8_t num_tlv = *ps;
-   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
-      "%s - max_len:%d, cur_offset:%d, more:%d, num_tlv:%d,rout_type:- %d",
-      __func__, *p_max_len, *p_cur_offset, more, num_tlv, rout_type);
-  uint8_t* pp = ps + 1 + *p_cur_offset;
-  uint8_t* p = pp;
-  uint16_t tlv_size = (uint8_t)*p_cur_offset;
+void nfa_ee_route_add_one_ecb_by_route_order(
+    tNFA_EE_ECB* p_cb, int rout_type,
+    std::vector<tNFA_EE_LMRT_ROUTE>* p_routes) {
+  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
+      "%s - nfcee_id:0x%x rout_type:%d routes:%zu", __func__, p_cb->nfcee_id,
+      rout_type, p_routes->size());
 
   switch (rout_type) {
     case NCI_ROUTE_ORDER_TECHNOLOGY: {
-      nfa_ee_add_tech_route_to_ecb(p_cb, pp, p, ps, p_cur_offset);
+      nfa_ee_add_tech_route_to_ecb(p_cb, p_routes);
     } break;
 
     case NCI_ROUTE_ORDER_PROTOCOL: {
-      nfa_ee_add_proto_route_to_ecb(p_cb, pp, p, ps, p_cur_offset);
+      nfa_ee_add_proto_route_to_ecb(p_cb, p_routes);
     } break;
     case NCI_ROUTE_ORDER_AID: {
-      nfa_ee_add_aid_route_to_ecb(p_cb, pp, p, ps, p_cur_offset, p_max_len);
+      nfa_ee_add_aid_route_to_ecb(p_cb, p_routes);
     } break;
     case NCI_ROUTE_ORDER_PATTERN: {
-        nfa_ee_add_apdu_route_to_ecb(p_cb, pp, p, ps, p_cur_offset, p_max_len);
+      nfa_ee_add_apdu_route_to_ecb(p_cb, p_routes);
     } break;
     case NCI_ROUTE_ORDER_SYS_CODE: {
-      nfa_ee_add_sys_code_route_to_ecb(p_cb, pp, p, ps, p_cur_offset,
-                                       p_max_len);
+      nfa_ee_add_sys_code_route_to_ecb(p_cb, p_routes);
     } break;
     default: {
        DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s -  Route type - NA:- %d", __func__, rout_type);
     }
   }
 
-  /* update the total number of entries */
-  num_tlv = *ps;
-
-  tlv_size = nfa_ee_total_lmrt_size();
-  if (tlv_size) {
-    nfa_ee_cb.ee_cfged |= nfa_ee_ecb_to_mask(p_cb);
-  }
   if (p_cb->ecb_flags & NFA_EE_ECB_FLAGS_ROUTING) {
     nfa_ee_cb.ee_cfg_sts |= NFA_EE_STS_CHANGED_ROUTING;
   }
-   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("ee_cfg_sts:0x%02x lmrt_size:%d", nfa_ee_cb.ee_cfg_sts,
-                   tlv_size);
-
-  if (more == false) {
-    /* last entry. update routing table now */
-    if (nfa_ee_cb.ee_cfg_sts & NFA_EE_STS_CHANGED_ROUTING) {
-      if (tlv_size) {
-        nfa_ee_cb.ee_cfg_sts |= NFA_EE_STS_PREV_ROUTING;
-      } else {
-        nfa_ee_cb.ee_cfg_sts &= ~NFA_EE_STS_PREV_ROUTING;
-      }
-       DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s : set routing num_tlv:%d tlv_size:%d", __func__,
-                       num_tlv, tlv_size);
-      if (NFC_SetRouting(more, num_tlv, (uint8_t)(*p_cur_offset), ps + 1) ==
-          NFA_STATUS_OK) {
-        nfa_ee_cb.wait_rsp++;
-      }
-    } else if (nfa_ee_cb.ee_cfg_sts & NFA_EE_STS_PREV_ROUTING) {
-      if (tlv_size == 0) {
-        nfa_ee_cb.ee_cfg_sts &= ~NFA_EE_STS_PREV_ROUTING;
-        /* indicated routing is configured to NFCC */
-        nfa_ee_cb.ee_cfg_sts |= NFA_EE_STS_CHANGED_ROUTING;
-        if (NFC_SetRouting(more, 0, 0, ps + 1) == NFA_STATUS_OK) {
-          nfa_ee_cb.wait_rsp++;
-        }
-      }
-    }
-  }
 }
 
 /*******************************************************************************
@@ -3617,10 +3865,15 @@ void nfa_ee_rout_timeout(__attribute__((unused)) tNFA_EE_MSG* p_data) {
 
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("nfa_ee_rout_timeout()");
   if (nfa_ee_need_recfg()) {
-    /* Send deactivated to idle command if already not sent */
-    if (nfa_dm_cb.disc_cb.disc_state != NFA_DM_RFST_IDLE)
-      nci_snd_deactivate_cmd(NFC_DEACTIVATE_TYPE_IDLE);
+    /* Discovery only needs to stop if the NFCC gets a different table */
+    if (nfa_ee_lmrt_compile() && nfa_ee_lmrt_changed()) {
+      /* Send deactivated to idle command if already not sent */
+      if (nfa_dm_cb.disc_cb.disc_state != NFA_DM_RFST_IDLE)
+        nci_snd_deactivate_cmd(NFC_DEACTIVATE_TYPE_IDLE);
+    }
     nfa_ee_update_rout();
+    /* in case the table was not sent in this state */
+    nfa_ee_cb.lmrt_compiled = false;
   }
 
   if (nfa_ee_cb.wait_rsp) nfa_ee_cb.ee_wait_evt |= NFA_EE_WAIT_UPDATE_RSP;
@@ -3654,79 +3907,28 @@ void nfa_ee_discv_timeout(__attribute__((unused)) tNFA_EE_MSG* p_data) {
 
 /*******************************************************************************
 **
-** Function         nfa_ee_lmrt_to_nfcc
+** Function         nfa_ee_lmrt_compile
 **
-** Description      This function would set the listen mode routing table
-**                  to NFCC.
+** Description      This function would build the listen mode routing table
+**                  from the ECBs, into the commands that set it to NFCC.
 **
-** Returns          void
+** Returns          true, if the table is compiled
 **
 *******************************************************************************/
-void nfa_ee_lmrt_to_nfcc(__attribute__((unused)) tNFA_EE_MSG* p_data) {
+static bool nfa_ee_lmrt_compile(void) {
   int xx;
   tNFA_EE_ECB* p_cb;
-  uint8_t* p = NULL;
-  bool more = true;
   bool check = true;
   uint8_t last_active = NFA_EE_INVALID;
-  int max_len;
-  tNFA_STATUS status = NFA_STATUS_FAILED;
-  int cur_offset;
-  uint8_t max_tlv;
+  tNFA_STATUS status = NFA_STATUS_OK;
+  uint16_t tlv_size;
+  std::vector<tNFA_EE_LMRT_ROUTE> routes;
 #if (NXP_EXTNS == TRUE)
   tNFA_EE_CBACK_DATA evt_data = {0};
 #endif
 
-#if (NXP_EXTNS == TRUE)
-  if((nfcFL.chipType != pn547C2) &&
-          (nfcFL.nfcMwFL._NFC_NXP_AID_MAX_SIZE_DYN == true)) {
-      DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("max supported routing table size: %d",
-              max_routing_table_size);
-      /* update routing table: DH and the activated NFCEEs */
-      p = (uint8_t*)GKI_getbuf(max_routing_table_size);
-  }
-  else {
-      p = (uint8_t*)GKI_getbuf(NFA_EE_ROUT_BUF_SIZE_STAT);
-  }
-#else
-  /* update routing table: DH and the activated NFCEEs */
-  p = (uint8_t*)GKI_getbuf(NFA_EE_ROUT_BUF_SIZE);
-#endif
-
-  if (p == NULL) {
-    LOG(ERROR) << StringPrintf("nfa_ee_lmrt_to_nfcc() no buffer to send routing info.");
-#if (NXP_EXTNS == TRUE)
-    evt_data.status = status;
-    nfa_ee_report_event(NULL, NFA_EE_NO_MEM_ERR_EVT,
-                        (tNFA_EE_CBACK_DATA*)&evt_data);
-#else
-    tNFA_EE_CBACK_DATA nfa_ee_cback_data;
-    nfa_ee_cback_data.status = status;
-    nfa_ee_report_event(NULL, NFA_EE_NO_MEM_ERR_EVT, &nfa_ee_cback_data);
-#endif
-    return;
-  }
-
-#if ((NXP_EXTNS == TRUE) && (NFC_NXP_LISTEN_ROUTE_TBL_OPTIMIZATION == TRUE))
-  proto_route_buff = (uint8_t*)GKI_getbuf(
-      NFA_EE_PROTO_BUFF_SIZE); /* Temporary buffer to store proto route
-                                  entries */
-  tech_route_buff = (uint8_t*)GKI_getbuf(
-      NFA_EE_TECH_BUFF_SIZE); /* Temporary buffer to store tech route entries */
-
-  if (proto_route_buff == NULL || tech_route_buff == NULL) {
-    LOG(ERROR) << StringPrintf(
-        "nfa_ee_lmrt_to_nfcc() no temp buffer to send routing info.");
-    evt_data.status = status;
-    nfa_ee_report_event(NULL, NFA_EE_NO_MEM_ERR_EVT,
-                        (tNFA_EE_CBACK_DATA*)&evt_data);
-    return;
-  }
-  proto_tlv_ctr = 0;
-  tech_tlv_ctr = 0;
-  proto_pp = proto_route_buff;
-  tech_pp = tech_route_buff;
-#endif /* - Routing entries optimization */
+  /* the NFCEEs that are active may have changed the room left for AIDs */
+  nfa_ee_aid_fit_lmrt();
 
   /* find the last active NFCEE. */
   p_cb = &nfa_ee_cb.ecb[nfa_ee_cb.cur_ee - 1];
@@ -3747,13 +3949,7 @@ void nfa_ee_lmrt_to_nfcc(__attribute__((unused)) tNFA_EE_MSG* p_data) {
   }
 #endif
 
-  max_len = NFC_GetLmrtSize();
-  max_tlv =
-      (uint8_t)((max_len > NFA_EE_ROUT_MAX_TLV_SIZE) ? NFA_EE_ROUT_MAX_TLV_SIZE
-                                                     : max_len);
-  cur_offset = 0;
-  /* use the first byte of the buffer (p) to keep the num_tlv */
-  *p = 0;
+  tlv_size = nfa_ee_total_lmrt_size();
   for (int rt = NCI_ROUTE_ORDER_AID; rt <= NCI_ROUTE_ORDER_TECHNOLOGY; rt++) {
     /* add the routing entries for NFCEEs */
     p_cb = &nfa_ee_cb.ecb[0];
@@ -3761,15 +3957,41 @@ void nfa_ee_lmrt_to_nfcc(__attribute__((unused)) tNFA_EE_MSG* p_data) {
     for (xx = 0; (xx < nfa_ee_cb.cur_ee) && check; xx++, p_cb++) {
       if (p_cb->ee_status == NFC_NFCEE_STATUS_ACTIVE) {
         DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s --add the routing for NFCEEs!!", __func__);
-        nfa_ee_route_add_one_ecb_by_route_order(p_cb, rt, &max_len, more, p,
-                                                &cur_offset);
+        nfa_ee_route_add_one_ecb_by_route_order(p_cb, rt, &routes);
+        if (tlv_size) nfa_ee_cb.ee_cfged |= nfa_ee_ecb_to_mask(p_cb);
       }
     }
-    if (rt == NCI_ROUTE_ORDER_TECHNOLOGY) more = false;
     /* add the routing entries for DH */
     DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s --add the routing for DH!!", __func__);
-    nfa_ee_route_add_one_ecb_by_route_order(&nfa_ee_cb.ecb[NFA_EE_CB_4_DH], rt,
-                                            &max_len, more, p, &cur_offset);
+    p_cb = &nfa_ee_cb.ecb[NFA_EE_CB_4_DH];
+    nfa_ee_route_add_one_ecb_by_route_order(p_cb, rt, &routes);
+    if (tlv_size) nfa_ee_cb.ee_cfged |= nfa_ee_ecb_to_mask(p_cb);
+  }
+  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
+      "ee_cfg_sts:0x%02x lmrt_size:%d routes:%zu", nfa_ee_cb.ee_cfg_sts,
+      tlv_size, routes.size());
+
+  nfa_ee_lmrt_compiled.clear();
+  if (nfa_ee_cb.ee_cfg_sts & NFA_EE_STS_CHANGED_ROUTING) {
+    if (tlv_size) {
+      nfa_ee_cb.ee_cfg_sts |= NFA_EE_STS_PREV_ROUTING;
+    } else {
+      nfa_ee_cb.ee_cfg_sts &= ~NFA_EE_STS_PREV_ROUTING;
+    }
+    if (!nfa_ee_lmrt_build(routes, NFC_GetLmrtSize(), &nfa_ee_lmrt_compiled)) {
+      LOG(ERROR) << StringPrintf(
+          "%s: the routing table does not fit in %d bytes", __func__,
+          NFC_GetLmrtSize());
+      status = NFA_STATUS_FAILED;
+    }
+  } else if (nfa_ee_cb.ee_cfg_sts & NFA_EE_STS_PREV_ROUTING) {
+    if (tlv_size == 0) {
+      nfa_ee_cb.ee_cfg_sts &= ~NFA_EE_STS_PREV_ROUTING;
+      /* indicated routing is configured to NFCC */
+      nfa_ee_cb.ee_cfg_sts |= NFA_EE_STS_CHANGED_ROUTING;
+      routes.clear();
+      nfa_ee_lmrt_build(routes, NFC_GetLmrtSize(), &nfa_ee_lmrt_compiled);
+    }
   }
 #if (NXP_EXTNS == TRUE)
   nfa_ee_cb.ee_flags &= ~NFA_EE_FLAG_CFG_NFC_DEP;
@@ -3780,15 +4002,81 @@ void nfa_ee_lmrt_to_nfcc(__attribute__((unused)) tNFA_EE_MSG* p_data) {
   }
 #endif
 
-  GKI_freebuf(p);
-#if ((NXP_EXTNS == TRUE) && (NFC_NXP_LISTEN_ROUTE_TBL_OPTIMIZATION == TRUE))
-  GKI_freebuf(proto_route_buff);
-  GKI_freebuf(tech_route_buff);
-  proto_tlv_ctr = 0;
-  tech_tlv_ctr = 0;
-  proto_pp = 0;
-  tech_pp = 0;
-#endif /* - Routing entries optimization */
+  nfa_ee_cb.lmrt_compiled = true;
+  return true;
+}
+
+/*******************************************************************************
+**
+** Function         nfa_ee_lmrt_changed
+**
+** Description      Check if the compiled listen mode routing table differs
+**                  from the one the NFCC last accepted
+**
+** Returns          true, if the table needs to be sent to NFCC
+**
+*******************************************************************************/
+static bool nfa_ee_lmrt_changed(void) {
+  if (nfa_ee_lmrt_compiled.empty()) return false;
+  return !nfa_ee_cb.lmrt_acked_valid ||
+         (nfa_ee_lmrt_compiled != nfa_ee_lmrt_acked);
+}
+
+/*******************************************************************************
+**
+** Function         nfa_ee_lmrt_reset
+**
+** Description      Forget the listen mode routing table the NFCC accepted.
+**                  Called when the NFCC is reset or NFA EE starts or stops,
+**                  as the NFCC then has no routing and the next update must
+**                  send the whole table.
+**
+** Returns          void
+**
+*******************************************************************************/
+void nfa_ee_lmrt_reset(void) {
+  nfa_ee_cb.lmrt_acked_valid = false;
+  nfa_ee_lmrt_acked.clear();
+  /* responses to commands sent before the reset do not make it valid */
+  nfa_ee_lmrt_sent.clear();
+  nfa_ee_lmrt_sent_failed = true;
+}
+
+/*******************************************************************************
+**
+** Function         nfa_ee_lmrt_to_nfcc
+**
+** Description      This function would set the listen mode routing table
+**                  to NFCC, unless the NFCC already has the same table.
+**
+** Returns          void
+**
+*******************************************************************************/
+void nfa_ee_lmrt_to_nfcc(__attribute__((unused)) tNFA_EE_MSG* p_data) {
+  if (!nfa_ee_cb.lmrt_compiled && !nfa_ee_lmrt_compile()) return;
+  nfa_ee_cb.lmrt_compiled = false;
+
+  if (!nfa_ee_lmrt_changed()) {
+    DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
+        "%s: %zu bytes of routing unchanged", __func__,
+        nfa_ee_lmrt_compiled.size());
+    return;
+  }
+
+  /* The NFCC replaces its whole table, there is no partial update. Until it
+   * accepts all the commands, its table is unknown. */
+  nfa_ee_cb.lmrt_acked_valid = false;
+  nfa_ee_lmrt_sent_failed = false;
+  nfa_ee_lmrt_sent.swap(nfa_ee_lmrt_compiled);
+  nfa_ee_lmrt_compiled.clear();
+  for (size_t xx = 0; xx < nfa_ee_lmrt_sent.size();) {
+    uint8_t* p = &nfa_ee_lmrt_sent[xx];
+    if (NFC_SetRouting(p[0], p[1], p[2], p + 3) == NFA_STATUS_OK)
+      nfa_ee_cb.wait_rsp++;
+    else
+      nfa_ee_lmrt_sent_failed = true;
+    xx += 3 + p[2];
+  }
 }
 
 /*******************************************************************************
@@ -3806,61 +4094,21 @@ void find_and_resolve_tech_conflict() {
     if(nfcFL.chipType == pn547C2) {
         DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: chipType : pn547C2. Returning", __func__);
     }
-  int yy, xx;
+  int xx;
   tNFA_EE_ECB* p_cb = nfa_ee_cb.ecb;
-  uint8_t techA_found = 0, techF_found = 0;
-  uint8_t techA_ee = 0, techF_ee = 0;
   unsigned long preferred_se = 0x01;
-  bool conflict = false;
-  uint8_t tech_to_rm, ee_from_rm;
+  std::vector<tNFA_EE_LMRT_TECH> techs;
 
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s:Enter", __func__);
 
-  // Finding the Technology and nfcee_id supported
-  for (yy = 0; yy < nfcFL.nfccFL._NFA_EE_MAX_EE_SUPPORTED; yy++, p_cb++) {
-    for (xx = 0; xx < 3; xx++) {
-      if ((p_cb->tech_switch_on & nfa_ee_tech_mask_list[xx]) ==
-          NFA_TECHNOLOGY_MASK_A) {
-        techA_found |= NFA_TECHNOLOGY_MASK_A;
-        techA_ee = p_cb->nfcee_id;
-      }
-      if ((p_cb->tech_switch_off & nfa_ee_tech_mask_list[xx]) ==
-          NFA_TECHNOLOGY_MASK_A) {
-        techA_found |= NFA_TECHNOLOGY_MASK_A;
-        techA_ee = p_cb->nfcee_id;
-      }
-      if ((p_cb->tech_battery_off & nfa_ee_tech_mask_list[xx]) ==
-          NFA_TECHNOLOGY_MASK_A) {
-        techA_found |= NFA_TECHNOLOGY_MASK_A;
-        techA_ee = p_cb->nfcee_id;
-      }
-      if ((p_cb->tech_switch_on & nfa_ee_tech_mask_list[xx]) ==
-          NFA_TECHNOLOGY_MASK_F) {
-        techF_found |= NFA_TECHNOLOGY_MASK_F;
-        techF_ee = p_cb->nfcee_id;
-      }
-      if ((p_cb->tech_switch_off & nfa_ee_tech_mask_list[xx]) ==
-          NFA_TECHNOLOGY_MASK_F) {
-        techF_found |= NFA_TECHNOLOGY_MASK_F;
-        techF_ee = p_cb->nfcee_id;
-      }
-      if ((p_cb->tech_battery_off & nfa_ee_tech_mask_list[xx]) ==
-          NFA_TECHNOLOGY_MASK_F) {
-        techF_found |= NFA_TECHNOLOGY_MASK_F;
-        techF_ee = p_cb->nfcee_id;
-      }
-    }
+  for (xx = 0; xx < nfcFL.nfccFL._NFA_EE_MAX_EE_SUPPORTED; xx++, p_cb++) {
+    techs.push_back({p_cb->nfcee_id, p_cb->tech_switch_on,
+                     p_cb->tech_switch_off, p_cb->tech_battery_off});
   }
 
-   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
-      "%s:p_cb->nfcee_id=0x%x,p_cb->tech_switch_on= "
-      "0x%x,p_cb->tech_switch_off= 0x%x,p_cb->tech_battery_off= 0x%x",
-      __func__, p_cb->nfcee_id, p_cb->tech_switch_on, p_cb->tech_switch_off,
-      p_cb->tech_battery_off);
-
   // Preferred SE Selected.
-  if (NfcConfig::hasKey(NAME_DEFAULT_OFFHOST_ROUTE)) {
-    preferred_se = NfcConfig::getUnsigned(NAME_DEFAULT_OFFHOST_ROUTE);
+  if (NfcConfig::hasKey(KEY_DEFAULT_OFFHOST_ROUTE)) {
+    preferred_se = NfcConfig::getUnsigned(KEY_DEFAULT_OFFHOST_ROUTE);
     DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s:NXP_DEFAULT_OFFHOST_ROUTE=0x0%lu;", __func__,
                      preferred_se);
     if (preferred_se == 0x01)
@@ -3868,44 +4116,18 @@ void find_and_resolve_tech_conflict() {
     else if (preferred_se == 0x02)
       preferred_se = 0x02;  // UICC
   }
-   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s:techF_found=0x%x,techF_ee= 0x%x;", __func__, techF_found,
-                   techF_ee);
-   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s:techA_found=0x%x,techA_ee= 0x%x;", __func__, techA_found,
-                   techA_ee);
-
-  if (techA_found == NFA_TECHNOLOGY_MASK_A &&
-      techF_found == NFA_TECHNOLOGY_MASK_F) {
-    if (techA_ee != 0x00 && techF_ee != 0x00) {
-      // Conflict occurs when techF and techA on Different SE.
-      if (techA_ee != techF_ee) conflict = true;
-    }
-  }
 
-  if (conflict == true) {
+  // Conflict occurs when techF and techA on Different SE.
+  if (nfa_ee_lmrt_tech_conflict(techs.data(), techs.size(),
+                                NFA_TECHNOLOGY_MASK_A, NFA_TECHNOLOGY_MASK_F,
+                                (uint8_t)preferred_se)) {
     DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("Conflict true");
 
-    if (techF_ee == preferred_se) {
-      tech_to_rm = NFA_TECHNOLOGY_MASK_A;
-      ee_from_rm = techA_ee;
-    } else {
-      tech_to_rm = NFA_TECHNOLOGY_MASK_F;
-      ee_from_rm = techF_ee;
-    }
-
     p_cb = nfa_ee_cb.ecb;
-    for (yy = 0; yy < nfcFL.nfccFL._NFA_EE_MAX_EE_SUPPORTED; yy++, p_cb++) {
-      if (p_cb->nfcee_id == ee_from_rm) {
-        for (xx = 0; xx < 3; xx++) {
-          if (((p_cb->tech_switch_on & nfa_ee_tech_mask_list[xx]) ==
-               tech_to_rm))
-            p_cb->tech_switch_on &= ~tech_to_rm;
-          if ((p_cb->tech_switch_off & nfa_ee_tech_mask_list[xx]) == tech_to_rm)
-            p_cb->tech_switch_off &= ~tech_to_rm;
-          if ((p_cb->tech_battery_off & nfa_ee_tech_mask_list[xx]) ==
-              tech_to_rm)
-            p_cb->tech_battery_off &= ~tech_to_rm;
-        }
-      }
+    for (xx = 0; xx < nfcFL.nfccFL._NFA_EE_MAX_EE_SUPPORTED; xx++, p_cb++) {
+      p_cb->tech_switch_on = techs[xx].switch_on;
+      p_cb->tech_switch_off = techs[xx].switch_off;
+      p_cb->tech_battery_off = techs[xx].battery_off;
     }
     DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s:Exit", __func__);
   }
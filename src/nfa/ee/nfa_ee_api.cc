@@ -833,6 +833,54 @@ tNFA_STATUS NFA_EeRemoveAidRouting(uint8_t aid_len, uint8_t* p_aid) {
   return status;
 }
 
+/*******************************************************************************
+**
+** Function         NFA_EeSetAidRoutingPriority
+**
+** Description      This function is called to set the priority of the given
+**                  AID entry. When the AID entries do not all fit the listen
+**                  mode routing table and AID_OVERFLOW_POLICY is priority or
+**                  prefix, the entries with the higher priority are routed
+**                  first. The status of this operation is reported as the
+**                  NFA_EE_SET_AID_PRIO_EVT.
+**
+** Note:            NFA_EeUpdateNow() should be called after last NFA-EE
+**                  function to change the listen mode routing is called.
+**
+** Returns          NFA_STATUS_OK if successfully initiated
+**                  NFA_STATUS_FAILED otherwise
+**                  NFA_STATUS_INVALID_PARAM If bad parameter
+**
+*******************************************************************************/
+tNFA_STATUS NFA_EeSetAidRoutingPriority(uint8_t aid_len, uint8_t* p_aid,
+                                        uint8_t priority) {
+  tNFA_EE_API_SET_AID_PRIO* p_msg;
+  tNFA_STATUS status = NFA_STATUS_FAILED;
+  uint16_t size = sizeof(tNFA_EE_API_SET_AID_PRIO) + aid_len;
+
+  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s: priority:%d", __func__,
+                                                   priority);
+  if ((aid_len == 0) || (p_aid == NULL) || (aid_len > NFA_MAX_AID_LEN)) {
+    LOG(ERROR) << StringPrintf("Bad AID");
+    status = NFA_STATUS_INVALID_PARAM;
+  } else {
+    p_msg = (tNFA_EE_API_SET_AID_PRIO*)GKI_getbuf(size);
+    if (p_msg != NULL) {
+      p_msg->hdr.event = NFA_EE_API_SET_AID_PRIO_EVT;
+      p_msg->aid_len = aid_len;
+      p_msg->priority = priority;
+      p_msg->p_aid = (uint8_t*)(p_msg + 1);
+      memcpy(p_msg->p_aid, p_aid, aid_len);
+
+      nfa_sys_sendmsg(p_msg);
+
+      status = NFA_STATUS_OK;
+    }
+  }
+
+  return status;
+}
+
 /*******************************************************************************
 **
 ** Function         NFA_EeRemoveApduPatternRouting
@@ -0,0 +1,476 @@
+/******************************************************************************
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/******************************************************************************
+ *
+ *  This file contains the listen mode routing table compiler for NFA-EE
+ *
+ ******************************************************************************/
+#include <string.h>
+#include <algorithm>
+
+#include <android-base/stringprintf.h>
+#include <base/logging.h>
+
+#include "nfa_ee_lmrt.h"
+
+using android::base::StringPrintf;
+
+extern bool nfc_debug_enabled;
+
+/*******************************************************************************
+**
+** Function         nfa_ee_lmrt_tag_order
+**
+** Description      Find where a routing entry type goes in the table
+**
+** Returns          NCI_ROUTE_ORDER_xxx, or 0 for an unknown type
+**
+*******************************************************************************/
+static uint8_t nfa_ee_lmrt_tag_order(uint8_t tag) {
+  switch (tag & NFA_EE_LMRT_TAG_MASK) {
+    case NCI_ROUTE_TAG_AID:
+      return NCI_ROUTE_ORDER_AID;
+    case NCI_ROUTE_TAG_APDU:
+      return NCI_ROUTE_ORDER_PATTERN;
+    case NCI_ROUTE_TAG_SYSCODE:
+      return NCI_ROUTE_ORDER_SYS_CODE;
+    case NCI_ROUTE_TAG_PROTO:
+      return NCI_ROUTE_ORDER_PROTOCOL;
+    case NCI_ROUTE_TAG_TECH:
+      return NCI_ROUTE_ORDER_TECHNOLOGY;
+  }
+  return 0;
+}
+
+/*******************************************************************************
+**
+** Function         nfa_ee_lmrt_add_cmd
+**
+** Description      Move the pending command to the compiled commands
+**
+** Returns          void
+**
+*******************************************************************************/
+static void nfa_ee_lmrt_add_cmd(tNFA_EE_LMRT* p_lmrt, bool more) {
+  std::vector<uint8_t>* p_cmds = p_lmrt->p_cmds;
+
+  p_cmds->push_back(more);
+  p_cmds->push_back(p_lmrt->num_tlv);
+  p_cmds->push_back(p_lmrt->cmd_len);
+  p_cmds->insert(p_cmds->end(), p_lmrt->cmd, p_lmrt->cmd + p_lmrt->cmd_len);
+  p_lmrt->num_tlv = 0;
+  p_lmrt->cmd_len = 0;
+}
+
+/*******************************************************************************
+**
+** Function         nfa_ee_lmrt_init
+**
+** Description      Start compiling a routing table of at most lmrt_size bytes
+**                  into p_cmds, which is cleared
+**
+** Returns          void
+**
+*******************************************************************************/
+void nfa_ee_lmrt_init(tNFA_EE_LMRT* p_lmrt, uint16_t lmrt_size,
+                      std::vector<uint8_t>* p_cmds) {
+  p_lmrt->p_cmds = p_cmds;
+  p_lmrt->room = lmrt_size;
+  p_lmrt->size = 0;
+  p_lmrt->dropped = 0;
+  p_lmrt->num_tlv = 0;
+  p_lmrt->cmd_len = 0;
+  p_cmds->clear();
+}
+
+/*******************************************************************************
+**
+** Function         nfa_ee_lmrt_add
+**
+** Description      Add one route to the table. A command is closed when the
+**                  route does not fit in it any more.
+**
+** Returns          false, if the table has no room left for the route
+**
+*******************************************************************************/
+bool nfa_ee_lmrt_add(tNFA_EE_LMRT* p_lmrt, const tNFA_EE_LMRT_ROUTE* p_route) {
+  uint16_t tlv_size = NFA_EE_LMRT_TLV_SIZE(p_route->len);
+
+  if ((tlv_size > p_lmrt->room) || (tlv_size > NFA_EE_ROUT_MAX_TLV_SIZE)) {
+    LOG(ERROR) << StringPrintf(
+        "nfa_ee_lmrt_add no room for tag:0x%02x nfcee_id:0x%02x len:%d "
+        "(room:%d)",
+        p_route->tag, p_route->nfcee_id, p_route->len, p_lmrt->room);
+    p_lmrt->dropped++;
+    return false;
+  }
+  if (p_lmrt->cmd_len + tlv_size > NFA_EE_ROUT_MAX_TLV_SIZE)
+    nfa_ee_lmrt_add_cmd(p_lmrt, true);
+
+  uint8_t* p = &p_lmrt->cmd[p_lmrt->cmd_len];
+  *p++ = p_route->tag;
+  *p++ = p_route->len + 2;
+  *p++ = p_route->nfcee_id;
+  *p++ = p_route->pwr_cfg;
+  memcpy(p, p_route->p_val, p_route->len);
+
+  p_lmrt->cmd_len += tlv_size;
+  p_lmrt->num_tlv++;
+  p_lmrt->room -= tlv_size;
+  p_lmrt->size += tlv_size;
+  return true;
+}
+
+/*******************************************************************************
+**
+** Function         nfa_ee_lmrt_finish
+**
+** Description      Close the last command of the table. An empty table is one
+**                  command without TLVs, which clears the table in the NFCC.
+**
+** Returns          void
+**
+*******************************************************************************/
+void nfa_ee_lmrt_finish(tNFA_EE_LMRT* p_lmrt) {
+  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
+      "nfa_ee_lmrt_finish size:%d num_tlv:%d dropped:%d", p_lmrt->size,
+      p_lmrt->num_tlv, p_lmrt->dropped);
+  nfa_ee_lmrt_add_cmd(p_lmrt, false);
+}
+
+/*******************************************************************************
+**
+** Function         nfa_ee_lmrt_build
+**
+** Description      Compile the routes in the order of the routing table:
+**                  AID, APDU pattern, system code, protocol and technology.
+**                  Routes of the same order keep the order they are given in.
+**
+** Returns          false, if some routes did not fit in lmrt_size
+**
+*******************************************************************************/
+bool nfa_ee_lmrt_build(std::vector<tNFA_EE_LMRT_ROUTE>& routes,
+                       uint16_t lmrt_size, std::vector<uint8_t>* p_cmds) {
+  tNFA_EE_LMRT lmrt;
+
+  std::stable_sort(routes.begin(), routes.end(),
+                   [](const tNFA_EE_LMRT_ROUTE& a,
+                      const tNFA_EE_LMRT_ROUTE& b) {
+                     return a.order < b.order;
+                   });
+  nfa_ee_lmrt_init(&lmrt, lmrt_size, p_cmds);
+  for (const tNFA_EE_LMRT_ROUTE& route : routes) nfa_ee_lmrt_add(&lmrt, &route);
+  nfa_ee_lmrt_finish(&lmrt);
+  return lmrt.dropped == 0;
+}
+
+/*******************************************************************************
+**
+** Function         nfa_ee_lmrt_parse
+**
+** Description      Check compiled commands the way the NFCC takes them: every
+**                  command but the last has more set, the number of TLVs and
+**                  lengths match, the entries are in routing table order and
+**                  the table fits in lmrt_size. The routes found are added to
+**                  p_routes if it is not NULL, pointing into cmds.
+**
+** Returns          true, if the commands are valid
+**
+*******************************************************************************/
+bool nfa_ee_lmrt_parse(const std::vector<uint8_t>& cmds, uint16_t lmrt_size,
+                       std::vector<tNFA_EE_LMRT_ROUTE>* p_routes) {
+  size_t xx = 0, size = 0;
+  uint8_t last_order = 0;
+  bool more = true;
+
+  while (xx < cmds.size()) {
+    if (!more || (cmds.size() - xx < 3)) {
+      LOG(ERROR) << StringPrintf("nfa_ee_lmrt_parse bad command at %zu", xx);
+      return false;
+    }
+    const uint8_t* p_cmd = &cmds[xx];
+    uint8_t num_tlv = p_cmd[1];
+    uint8_t cmd_len = p_cmd[2];
+    more = p_cmd[0];
+    if ((p_cmd[0] > 1) || (cmd_len > NFA_EE_ROUT_MAX_TLV_SIZE) ||
+        (cmds.size() - xx - 3 < cmd_len)) {
+      LOG(ERROR) << StringPrintf(
+          "nfa_ee_lmrt_parse bad header at %zu more:%d len:%d", xx, p_cmd[0],
+          cmd_len);
+      return false;
+    }
+
+    const uint8_t* p = p_cmd + 3;
+    const uint8_t* p_end = p + cmd_len;
+    for (; num_tlv > 0; num_tlv--) {
+      if ((p_end - p < 4) || (p[1] < 2) || (p_end - p - 2 < p[1])) {
+        LOG(ERROR) << StringPrintf("nfa_ee_lmrt_parse bad TLV at %zu",
+                                   (size_t)(p - cmds.data()));
+        return false;
+      }
+      tNFA_EE_LMRT_ROUTE route;
+      route.tag = p[0];
+      route.len = p[1] - 2;
+      route.nfcee_id = p[2];
+      route.pwr_cfg = p[3];
+      route.p_val = p + 4;
+      route.order = nfa_ee_lmrt_tag_order(route.tag);
+      if ((route.order == 0) || (route.order < last_order)) {
+        LOG(ERROR) << StringPrintf(
+            "nfa_ee_lmrt_parse tag:0x%02x out of order at %zu", route.tag,
+            (size_t)(p - cmds.data()));
+        return false;
+      }
+      last_order = route.order;
+      if (p_routes) p_routes->push_back(route);
+      p += NFA_EE_LMRT_TLV_SIZE(route.len);
+    }
+    if (p != p_end) {
+      LOG(ERROR) << StringPrintf(
+          "nfa_ee_lmrt_parse %d bytes after the TLVs at %zu",
+          (int)(p_end - p), xx);
+      return false;
+    }
+    size += cmd_len;
+    xx += 3 + cmd_len;
+  }
+  if (more && !cmds.empty()) {
+    LOG(ERROR) << StringPrintf("nfa_ee_lmrt_parse the last command has more");
+    return false;
+  }
+  if (size > lmrt_size) {
+    LOG(ERROR) << StringPrintf("nfa_ee_lmrt_parse %zu bytes for %d", size,
+                               lmrt_size);
+    return false;
+  }
+  return true;
+}
+
+/*******************************************************************************
+**
+** Function         nfa_ee_lmrt_mask_size
+**
+** Description      Find the bytes the technology or protocol routes of one
+**                  NFCEE take. routed is the technologies or protocols routed
+**                  in any power state, p_mask_list the ones the NFCC can route.
+**
+** Returns          the size of the routes
+**
+*******************************************************************************/
+uint16_t nfa_ee_lmrt_mask_size(uint8_t routed, const uint8_t* p_mask_list,
+                               int num_masks) {
+  uint16_t size = 0;
+
+  /* the screen states only qualify a route that is there when on */
+  for (int xx = 0; xx < num_masks; xx++) {
+    /* the value is the technology or protocol */
+    if (routed & p_mask_list[xx]) size += NFA_EE_LMRT_TLV_SIZE(1);
+  }
+  return size;
+}
+
+/*******************************************************************************
+**
+** Function         nfa_ee_lmrt_total_size
+**
+** Description      Add up the routes of the DH and of the NFCEEs that go in
+**                  the routing table
+**
+** Returns          the size of the routing table
+**
+*******************************************************************************/
+uint16_t nfa_ee_lmrt_total_size(const tNFA_EE_LMRT_SIZE* p_sizes,
+                                int num_sizes) {
+  uint16_t lmrt_size = 0;
+
+  for (int xx = 0; xx < num_sizes; xx++) {
+    lmrt_size += p_sizes[xx].size_mask;
+    lmrt_size += p_sizes[xx].size_aid;
+    lmrt_size += p_sizes[xx].size_apdu;
+    lmrt_size += p_sizes[xx].size_sys_code;
+  }
+  DLOG_IF(INFO, nfc_debug_enabled)
+      << StringPrintf("nfa_ee_lmrt_total_size size:%d", lmrt_size);
+  return lmrt_size;
+}
+
+/*******************************************************************************
+**
+** Function         nfa_ee_lmrt_tech_conflict
+**
+** Description      The NFCC routes tech and other_tech to one NFCEE. If the
+**                  last NFCEEs found with each are different, remove other_tech
+**                  from its NFCEE, unless that one is preferred_id: then tech
+**                  is removed from its NFCEE.
+**
+** Returns          true, if a technology was removed
+**
+*******************************************************************************/
+bool nfa_ee_lmrt_tech_conflict(tNFA_EE_LMRT_TECH* p_techs, int num_techs,
+                               uint8_t tech, uint8_t other_tech,
+                               uint8_t preferred_id) {
+  bool tech_found = false, other_found = false;
+  uint8_t tech_ee = 0, other_ee = 0;
+  uint8_t tech_to_rm, ee_from_rm;
+
+  for (int xx = 0; xx < num_techs; xx++) {
+    const tNFA_EE_LMRT_TECH& ee = p_techs[xx];
+    uint8_t routed = ee.switch_on | ee.switch_off | ee.battery_off;
+    if (routed & tech) {
+      tech_found = true;
+      tech_ee = ee.nfcee_id;
+    }
+    if (routed & other_tech) {
+      other_found = true;
+      other_ee = ee.nfcee_id;
+    }
+  }
+  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
+      "nfa_ee_lmrt_tech_conflict tech:0x%x ee:0x%x other:0x%x ee:0x%x", tech,
+      tech_ee, other_tech, other_ee);
+
+  /* the NFCC sorts it out when either goes to the DH */
+  if (!tech_found || !other_found || (tech_ee == 0x00) ||
+      (other_ee == 0x00) || (tech_ee == other_ee))
+    return false;
+
+  if (other_ee == preferred_id) {
+    tech_to_rm = tech;
+    ee_from_rm = tech_ee;
+  } else {
+    tech_to_rm = other_tech;
+    ee_from_rm = other_ee;
+  }
+  for (int xx = 0; xx < num_techs; xx++) {
+    tNFA_EE_LMRT_TECH& ee = p_techs[xx];
+    if (ee.nfcee_id == ee_from_rm) {
+      ee.switch_on &= ~tech_to_rm;
+      ee.switch_off &= ~tech_to_rm;
+      ee.battery_off &= ~tech_to_rm;
+    }
+  }
+  return true;
+}
+
+/*******************************************************************************
+**
+** Function         nfa_ee_lmrt_aid_covered
+**
+** Description      Check if an AID of another route than the given one starts
+**                  with the len bytes at p_prefix
+**
+** Returns          true, if the prefix would take such an AID
+**
+*******************************************************************************/
+static bool nfa_ee_lmrt_aid_covered(const std::vector<tNFA_EE_LMRT_AID>& aids,
+                                    uint32_t route, const uint8_t* p_prefix,
+                                    uint8_t len) {
+  for (const tNFA_EE_LMRT_AID& aid : aids) {
+    if ((aid.route != route) && (aid.aid_len >= len) &&
+        !memcmp(aid.p_aid, p_prefix, len))
+      return true;
+  }
+  return false;
+}
+
+/*******************************************************************************
+**
+** Function         nfa_ee_lmrt_aid_merge_len
+**
+** Description      Find the prefix groups xx and xx + 1 can be merged into
+**
+** Returns          its length, or 0 if they cannot be merged
+**
+*******************************************************************************/
+static uint8_t nfa_ee_lmrt_aid_merge_len(
+    const std::vector<tNFA_EE_LMRT_AID>& aids,
+    const std::vector<tNFA_EE_LMRT_AID_GROUP>& groups, size_t xx,
+    uint8_t min_len) {
+  const tNFA_EE_LMRT_AID& a = aids[groups[xx].last];
+  const tNFA_EE_LMRT_AID& b = aids[groups[xx + 1].first];
+  if (a.route != b.route) return 0;
+
+  uint8_t len = std::min(groups[xx].len, groups[xx + 1].len);
+  uint8_t common = 0;
+  while ((common < len) && (a.p_aid[common] == b.p_aid[common])) common++;
+  /* a shorter prefix covers all that this one does, so the groups can never
+   * be merged once this one is refused */
+  if ((common < min_len) ||
+      nfa_ee_lmrt_aid_covered(aids, a.route, a.p_aid, common))
+    return 0;
+  return common;
+}
+
+/*******************************************************************************
+**
+** Function         nfa_ee_lmrt_aid_collapse
+**
+** Description      Sort the AIDs by route, then by AID, and merge neighbouring
+**                  groups of the same route into their longest common prefix
+**                  of at least min_len bytes, longest prefix first, until
+**                  over bytes are saved or nothing else can be merged. A
+**                  prefix that also covers an AID of another route is never
+**                  used, whether that AID ends up in the table or not.
+**
+** Returns          the number of bytes saved. *p_groups is set to the groups.
+**
+*******************************************************************************/
+int nfa_ee_lmrt_aid_collapse(std::vector<tNFA_EE_LMRT_AID>& aids,
+                             uint8_t min_len, int over,
+                             std::vector<tNFA_EE_LMRT_AID_GROUP>* p_groups) {
+  std::vector<tNFA_EE_LMRT_AID_GROUP>& groups = *p_groups;
+  int saved = 0;
+
+  std::sort(aids.begin(), aids.end(),
+            [](const tNFA_EE_LMRT_AID& a, const tNFA_EE_LMRT_AID& b) {
+              if (a.route != b.route) return a.route < b.route;
+              int cmp = memcmp(a.p_aid, b.p_aid, std::min(a.aid_len, b.aid_len));
+              return (cmp < 0) || ((cmp == 0) && (a.aid_len < b.aid_len));
+            });
+  groups.clear();
+  for (size_t xx = 0; xx < aids.size(); xx++)
+    groups.push_back({(int)xx, (int)xx, aids[xx].aid_len});
+  if (groups.size() < 2) return 0;
+
+  /* merge_len[xx]: the prefix groups xx and xx + 1 would be merged into */
+  std::vector<uint8_t> merge_len(groups.size() - 1);
+  for (size_t xx = 0; xx < merge_len.size(); xx++)
+    merge_len[xx] = nfa_ee_lmrt_aid_merge_len(aids, groups, xx, min_len);
+
+  while (saved < over) {
+    size_t best = merge_len.size();
+    for (size_t xx = 0; xx < merge_len.size(); xx++) {
+      if ((merge_len[xx] != 0) &&
+          ((best == merge_len.size()) || (merge_len[xx] > merge_len[best])))
+        best = xx;
+    }
+    if (best == merge_len.size()) break;
+
+    saved += NFA_EE_LMRT_TLV_SIZE(groups[best].len) + groups[best + 1].len -
+             merge_len[best];
+    groups[best].last = groups[best + 1].last;
+    groups[best].len = merge_len[best];
+    groups.erase(groups.begin() + best + 1);
+    merge_len.erase(merge_len.begin() + best);
+    if (best > 0)
+      merge_len[best - 1] =
+          nfa_ee_lmrt_aid_merge_len(aids, groups, best - 1, min_len);
+    if (best < merge_len.size())
+      merge_len[best] = nfa_ee_lmrt_aid_merge_len(aids, groups, best, min_len);
+  }
+  return saved;
+}
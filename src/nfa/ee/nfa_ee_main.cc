@@ -109,7 +109,8 @@ const tNFA_EE_SM_ACT nfa_ee_actions[] = {
     nfa_ee_lmrt_to_nfcc,      /* NFA_EE_CFG_TO_NFCC_EVT       */
     nfa_ee_api_add_apdu,       /* NFA_EE_API_ADD_AID_EVT       */
     nfa_ee_api_remove_apdu,    /* NFA_EE_API_REMOVE_AID_EVT    */
-    nfa_ee_nci_nfcee_status_ntf        /*NFA_EE_NCI_NFCEE_STATUS_NTF_EVT*/
+    nfa_ee_nci_nfcee_status_ntf,       /*NFA_EE_NCI_NFCEE_STATUS_NTF_EVT*/
+    nfa_ee_api_set_aid_prio    /* NFA_EE_API_SET_AID_PRIO_EVT  */
 };
 
 /*******************************************************************************
@@ -127,6 +128,10 @@ void nfa_ee_init(void) {
 
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("nfa_ee_init ()");
 
+  /* NFA_EE_HCI_Control runs this again: free the AIDs of the last run */
+  for (xx = 0; xx < NFA_EE_NUM_ECBS; xx++)
+    nfa_ee_aid_store_free(&nfa_ee_cb.ecb[xx]);
+
   /* initialize control block */
   memset(&nfa_ee_cb, 0, sizeof(tNFA_EE_CB));
   for (xx = 0; xx < NFA_EE_MAX_EE_SUPPORTED; xx++) {
@@ -158,6 +163,8 @@ void nfa_ee_sys_enable(void) {
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s", __func__);
 
   nfa_ee_cb.route_block_control = 0x00;
+  /* The NFCC is reset on enable */
+  nfa_ee_lmrt_reset();
 
   if (NfcConfig::hasKey(NAME_NXP_PROP_BLACKLIST_ROUTING)) {
     unsigned retlen = NfcConfig::getUnsigned(NAME_NXP_PROP_BLACKLIST_ROUTING);
@@ -177,6 +184,19 @@ void nfa_ee_sys_enable(void) {
     DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
         "nfa_ee_cb.route_block_control=0x%x", nfa_ee_cb.route_block_control);
   }
+
+  nfa_ee_cb.aid_overflow_policy = (uint8_t)NfcConfig::getUnsigned(
+      NAME_AID_OVERFLOW_POLICY, NFA_EE_AID_OVERFLOW_REJECT);
+  if (nfa_ee_cb.aid_overflow_policy > NFA_EE_AID_OVERFLOW_PREFIX) {
+    LOG(ERROR) << StringPrintf("%s: unknown AID_OVERFLOW_POLICY %d", __func__,
+                               nfa_ee_cb.aid_overflow_policy);
+    nfa_ee_cb.aid_overflow_policy = NFA_EE_AID_OVERFLOW_REJECT;
+  }
+  /* aid_entries counts the entries of an ECB in a uint8_t */
+  unsigned aid_store_max = NfcConfig::getUnsigned(
+      NAME_AID_ROUTE_MAX_ENTRIES, NFA_EE_AID_STORE_MAX_ENTRIES);
+  nfa_ee_cb.aid_store_max =
+      (aid_store_max > UINT8_MAX) ? UINT8_MAX : (uint16_t)aid_store_max;
 #if (NXP_EXTNS == TRUE)
   nfa_ee_get_num_nfcee_configured(nfa_ee_read_num_nfcee_config_cb);
 #endif
@@ -269,6 +289,8 @@ void nfa_ee_proc_nfcc_power_mode(uint8_t nfcc_power_mode) {
 
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("nfa_ee_proc_nfcc_power_mode (): nfcc_power_mode=%d",
                    nfcc_power_mode);
+  /* The NFCC lost its routing table, whether it restarted or went off */
+  nfa_ee_lmrt_reset();
   /* if NFCC power state is change to full power */
   if (nfcc_power_mode == NFA_DM_PWR_MODE_FULL) {
     if (nfa_ee_max_ee_cfg) {
@@ -515,6 +537,7 @@ void nfa_ee_sys_disable(void) {
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("nfa_ee_sys_disable ()");
 
   nfa_ee_cb.em_state = NFA_EE_EM_STATE_DISABLED;
+  nfa_ee_lmrt_reset();
   /* report NFA_EE_DEREGISTER_EVT to all registered to EE */
   for (xx = 0; xx < NFA_EE_MAX_CBACKS; xx++) {
     if (nfa_ee_cb.p_ee_cback[xx]) {
@@ -668,6 +691,8 @@ static std::string nfa_ee_sm_evt_2_str(uint16_t event) {
       return "API_ADD_AID";
     case NFA_EE_API_REMOVE_AID_EVT:
       return "API_REMOVE_AID";
+    case NFA_EE_API_SET_AID_PRIO_EVT:
+      return "API_SET_AID_PRIO";
     case NFA_EE_API_ADD_SYSCODE_EVT:
       return "NFA_EE_API_ADD_SYSCODE_EVT";
     case NFA_EE_API_REMOVE_SYSCODE_EVT:
@@ -0,0 +1,85 @@
+#include <benchmark/benchmark.h>
+
+#include <random>
+#include <vector>
+
+#include "nfa_ee_lmrt.h"
+
+bool nfc_debug_enabled = false;
+
+namespace {
+
+const uint16_t kLmrtSize = 0xFFFF;
+
+/* A terminal configuration: state.range(0) AIDs spread over a few NFCEEs,
+ * followed by the usual protocol and technology routes */
+struct LmrtConfig {
+  std::vector<std::vector<uint8_t>> vals;
+  std::vector<tNFA_EE_LMRT_ROUTE> routes;
+
+  explicit LmrtConfig(int num_aids) {
+    std::mt19937 rng(num_aids);
+    const uint8_t nfcee_ids[] = {0x00, 0x02, 0xC0};
+
+    for (int xx = 0; xx < num_aids; xx++) {
+      std::vector<uint8_t> aid(5 + rng() % 12);
+      for (auto& b : aid) b = rng();
+      vals.push_back(aid);
+    }
+    for (int xx = 0; xx < num_aids; xx++) {
+      tNFA_EE_LMRT_ROUTE route = {NCI_ROUTE_ORDER_AID,
+                                  NCI_ROUTE_TAG_AID,
+                                  nfcee_ids[rng() % 3],
+                                  NCI_ROUTE_PWR_STATE_ON,
+                                  (uint8_t)vals[xx].size(),
+                                  vals[xx].data()};
+      routes.push_back(route);
+    }
+    static const uint8_t protos[] = {0x04, 0x05};
+    static const uint8_t techs[] = {0x00, 0x01, 0x02};
+    for (const uint8_t& proto : protos) {
+      tNFA_EE_LMRT_ROUTE route = {NCI_ROUTE_ORDER_PROTOCOL, NCI_ROUTE_TAG_PROTO,
+                                  0x00, NCI_ROUTE_PWR_STATE_ON, 1, &proto};
+      routes.push_back(route);
+    }
+    for (const uint8_t& tech : techs) {
+      tNFA_EE_LMRT_ROUTE route = {NCI_ROUTE_ORDER_TECHNOLOGY,
+                                  NCI_ROUTE_TAG_TECH, 0x02,
+                                  NCI_ROUTE_PWR_STATE_ON, 1, &tech};
+      routes.push_back(route);
+    }
+  }
+};
+
+void BM_LmrtBuild(benchmark::State& state) {
+  LmrtConfig config(state.range(0));
+  std::vector<uint8_t> cmds;
+
+  for (auto _ : state) {
+    std::vector<tNFA_EE_LMRT_ROUTE> routes = config.routes;
+    nfa_ee_lmrt_build(routes, kLmrtSize, &cmds);
+    benchmark::DoNotOptimize(cmds.data());
+  }
+  state.SetItemsProcessed(state.iterations() * config.routes.size());
+  state.SetBytesProcessed(state.iterations() * cmds.size());
+}
+BENCHMARK(BM_LmrtBuild)->Arg(16)->Arg(64)->Arg(256)->Arg(1024);
+
+void BM_LmrtParse(benchmark::State& state) {
+  LmrtConfig config(state.range(0));
+  std::vector<uint8_t> cmds;
+  std::vector<tNFA_EE_LMRT_ROUTE> parsed;
+
+  nfa_ee_lmrt_build(config.routes, kLmrtSize, &cmds);
+  for (auto _ : state) {
+    parsed.clear();
+    benchmark::DoNotOptimize(nfa_ee_lmrt_parse(cmds, kLmrtSize, &parsed));
+  }
+  state.SetItemsProcessed(state.iterations() * config.routes.size());
+  state.SetBytesProcessed(state.iterations() * cmds.size());
+}
+BENCHMARK(BM_LmrtParse)->Arg(16)->Arg(64)->Arg(256)->Arg(1024);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,438 @@
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+#include "nfa_ee_lmrt.h"
+
+bool nfc_debug_enabled = false;
+
+namespace {
+
+const uint16_t kLmrtSize = 720;
+
+/* Routes with their values, as the NFA-EE control blocks would hold them */
+class LmrtSet {
+ public:
+  void Add(uint8_t order, uint8_t tag, uint8_t nfcee_id, uint8_t pwr_cfg,
+           std::vector<uint8_t> val) {
+    vals_.push_back(val);
+    tNFA_EE_LMRT_ROUTE route = {order, tag, nfcee_id, pwr_cfg,
+                                (uint8_t)val.size(), nullptr};
+    routes_.push_back(route);
+  }
+  void Aid(uint8_t nfcee_id, std::vector<uint8_t> aid) {
+    Add(NCI_ROUTE_ORDER_AID, NCI_ROUTE_TAG_AID, nfcee_id,
+        NCI_ROUTE_PWR_STATE_ON, aid);
+  }
+  void Tech(uint8_t nfcee_id, uint8_t tech) {
+    Add(NCI_ROUTE_ORDER_TECHNOLOGY, NCI_ROUTE_TAG_TECH, nfcee_id,
+        NCI_ROUTE_PWR_STATE_ON, {tech});
+  }
+  void Proto(uint8_t nfcee_id, uint8_t proto) {
+    Add(NCI_ROUTE_ORDER_PROTOCOL, NCI_ROUTE_TAG_PROTO, nfcee_id,
+        NCI_ROUTE_PWR_STATE_ON, {proto});
+  }
+
+  /* The routes, pointing to the values kept here */
+  std::vector<tNFA_EE_LMRT_ROUTE> Routes() {
+    for (size_t xx = 0; xx < routes_.size(); xx++)
+      routes_[xx].p_val = vals_[xx].data();
+    return routes_;
+  }
+
+ private:
+  std::vector<std::vector<uint8_t>> vals_;
+  std::vector<tNFA_EE_LMRT_ROUTE> routes_;
+};
+
+std::vector<uint8_t> Val(const tNFA_EE_LMRT_ROUTE& route) {
+  return std::vector<uint8_t>(route.p_val, route.p_val + route.len);
+}
+
+void ExpectSameRoute(const tNFA_EE_LMRT_ROUTE& expected,
+                     const tNFA_EE_LMRT_ROUTE& actual) {
+  EXPECT_EQ(expected.order, actual.order);
+  EXPECT_EQ(expected.tag, actual.tag);
+  EXPECT_EQ(expected.nfcee_id, actual.nfcee_id);
+  EXPECT_EQ(expected.pwr_cfg, actual.pwr_cfg);
+  EXPECT_EQ(Val(expected), Val(actual));
+}
+
+/* The header of every command in cmds */
+std::vector<const uint8_t*> Commands(const std::vector<uint8_t>& cmds) {
+  std::vector<const uint8_t*> heads;
+  for (size_t xx = 0; xx < cmds.size(); xx += 3 + cmds[xx + 2])
+    heads.push_back(&cmds[xx]);
+  return heads;
+}
+
+TEST(NfaEeLmrtTest, test_empty_table) {
+  std::vector<tNFA_EE_LMRT_ROUTE> routes;
+  std::vector<uint8_t> cmds = {1, 2, 3};
+
+  EXPECT_TRUE(nfa_ee_lmrt_build(routes, kLmrtSize, &cmds));
+  EXPECT_EQ((std::vector<uint8_t>{0, 0, 0}), cmds);
+  EXPECT_TRUE(nfa_ee_lmrt_parse(cmds, kLmrtSize, nullptr));
+}
+
+TEST(NfaEeLmrtTest, test_table_order) {
+  LmrtSet set;
+  set.Tech(0x02, 0x00);
+  set.Proto(0x00, 0x04);
+  set.Aid(0x02, {0xA0, 0x00, 0x00, 0x00, 0x03});
+  set.Add(NCI_ROUTE_ORDER_SYS_CODE, NCI_ROUTE_TAG_SYSCODE, 0x00,
+          NCI_ROUTE_PWR_STATE_ON, {0x12, 0xFC});
+  set.Aid(0x00, {0xA0, 0x00, 0x00, 0x00, 0x04});
+  set.Add(NCI_ROUTE_ORDER_PATTERN, NCI_ROUTE_TAG_APDU, 0xC0,
+          NCI_ROUTE_PWR_STATE_ON, {0x00, 0xA4, 0xFF, 0xFF});
+  set.Proto(0x02, 0x05);
+
+  std::vector<tNFA_EE_LMRT_ROUTE> routes = set.Routes();
+  std::vector<uint8_t> cmds;
+  ASSERT_TRUE(nfa_ee_lmrt_build(routes, kLmrtSize, &cmds));
+
+  std::vector<tNFA_EE_LMRT_ROUTE> parsed;
+  ASSERT_TRUE(nfa_ee_lmrt_parse(cmds, kLmrtSize, &parsed));
+  ASSERT_EQ(7u, parsed.size());
+  std::vector<tNFA_EE_LMRT_ROUTE> given = set.Routes();
+  int expected[] = {2, 4, 5, 3, 1, 6, 0};
+  for (int xx = 0; xx < 7; xx++)
+    ExpectSameRoute(given[expected[xx]], parsed[xx]);
+}
+
+TEST(NfaEeLmrtTest, test_chunking) {
+  LmrtSet set;
+  /* 20 bytes a TLV, 12 of them to a command */
+  for (int xx = 0; xx < 30; xx++) {
+    std::vector<uint8_t> aid(16, 0xA0);
+    aid[15] = xx;
+    set.Aid(0x00, aid);
+  }
+  std::vector<tNFA_EE_LMRT_ROUTE> routes = set.Routes();
+  std::vector<uint8_t> cmds;
+  ASSERT_TRUE(nfa_ee_lmrt_build(routes, kLmrtSize, &cmds));
+
+  std::vector<const uint8_t*> heads = Commands(cmds);
+  ASSERT_EQ(3u, heads.size());
+  EXPECT_EQ((std::vector<uint8_t>{1, 12, 240}),
+            std::vector<uint8_t>(heads[0], heads[0] + 3));
+  EXPECT_EQ((std::vector<uint8_t>{1, 12, 240}),
+            std::vector<uint8_t>(heads[1], heads[1] + 3));
+  EXPECT_EQ((std::vector<uint8_t>{0, 6, 120}),
+            std::vector<uint8_t>(heads[2], heads[2] + 3));
+  EXPECT_TRUE(nfa_ee_lmrt_parse(cmds, 600, nullptr));
+  EXPECT_FALSE(nfa_ee_lmrt_parse(cmds, 599, nullptr));
+}
+
+TEST(NfaEeLmrtTest, test_size_limit) {
+  LmrtSet set;
+  set.Aid(0x02, std::vector<uint8_t>(16, 0xA1));
+  set.Aid(0x02, std::vector<uint8_t>(16, 0xA2));
+  set.Tech(0x02, 0x00);
+
+  /* the second AID does not fit, the technology still does */
+  std::vector<tNFA_EE_LMRT_ROUTE> routes = set.Routes();
+  std::vector<uint8_t> cmds;
+  EXPECT_FALSE(nfa_ee_lmrt_build(routes, 30, &cmds));
+
+  std::vector<tNFA_EE_LMRT_ROUTE> parsed;
+  ASSERT_TRUE(nfa_ee_lmrt_parse(cmds, 30, &parsed));
+  ASSERT_EQ(2u, parsed.size());
+  ExpectSameRoute(routes[0], parsed[0]);
+  ExpectSameRoute(routes[2], parsed[1]);
+}
+
+TEST(NfaEeLmrtTest, test_parse_rejects_bad_commands) {
+  const uint8_t tech[] = {0x00, 0x03, 0x02, 0x01, 0x00};
+  const uint8_t aid[] = {0x02, 0x07, 0x02, 0x01, 0xA0, 0x00, 0x00, 0x00, 0x03};
+  auto cmd = [](bool more, uint8_t num_tlv, std::vector<uint8_t> tlvs) {
+    std::vector<uint8_t> cmd = {more, num_tlv, (uint8_t)tlvs.size()};
+    cmd.insert(cmd.end(), tlvs.begin(), tlvs.end());
+    return cmd;
+  };
+  std::vector<uint8_t> v_tech(tech, tech + sizeof(tech));
+  std::vector<uint8_t> v_aid(aid, aid + sizeof(aid));
+  std::vector<uint8_t> both = v_aid;
+  both.insert(both.end(), v_tech.begin(), v_tech.end());
+  std::vector<uint8_t> reversed = v_tech;
+  reversed.insert(reversed.end(), v_aid.begin(), v_aid.end());
+
+  EXPECT_TRUE(nfa_ee_lmrt_parse(cmd(false, 2, both), kLmrtSize, nullptr));
+  /* the last command has more set */
+  EXPECT_FALSE(nfa_ee_lmrt_parse(cmd(true, 2, both), kLmrtSize, nullptr));
+  /* a command after the last one */
+  std::vector<uint8_t> two = cmd(false, 1, v_aid);
+  std::vector<uint8_t> next = cmd(false, 1, v_tech);
+  two.insert(two.end(), next.begin(), next.end());
+  EXPECT_FALSE(nfa_ee_lmrt_parse(two, kLmrtSize, nullptr));
+  two[0] = 1;
+  EXPECT_TRUE(nfa_ee_lmrt_parse(two, kLmrtSize, nullptr));
+  /* the number of TLVs does not match */
+  EXPECT_FALSE(nfa_ee_lmrt_parse(cmd(false, 1, both), kLmrtSize, nullptr));
+  EXPECT_FALSE(nfa_ee_lmrt_parse(cmd(false, 3, both), kLmrtSize, nullptr));
+  /* technology routes go after the AIDs */
+  EXPECT_FALSE(nfa_ee_lmrt_parse(cmd(false, 2, reversed), kLmrtSize, nullptr));
+  /* the command is cut short */
+  std::vector<uint8_t> cut = cmd(false, 2, both);
+  cut.pop_back();
+  EXPECT_FALSE(nfa_ee_lmrt_parse(cut, kLmrtSize, nullptr));
+  /* the table is larger than the NFCC takes */
+  EXPECT_FALSE(nfa_ee_lmrt_parse(cmd(false, 2, both), 13, nullptr));
+}
+
+/* AIDs for nfa_ee_lmrt_aid_collapse, with their routes */
+class AidSet {
+ public:
+  void Add(uint32_t route, std::vector<uint8_t> aid) {
+    aids_.push_back(aid);
+    routes_.push_back(route);
+  }
+  std::vector<tNFA_EE_LMRT_AID> Aids() {
+    std::vector<tNFA_EE_LMRT_AID> aids;
+    for (size_t xx = 0; xx < aids_.size(); xx++)
+      aids.push_back({routes_[xx], aids_[xx].data(), (uint8_t)aids_[xx].size(),
+                      (uint16_t)xx});
+    return aids;
+  }
+
+ private:
+  std::vector<std::vector<uint8_t>> aids_;
+  std::vector<uint32_t> routes_;
+};
+
+/* The ids of the AIDs of each group, and the length of its prefix */
+std::vector<std::pair<std::vector<uint16_t>, uint8_t>> Groups(
+    const std::vector<tNFA_EE_LMRT_AID>& aids,
+    const std::vector<tNFA_EE_LMRT_AID_GROUP>& groups) {
+  std::vector<std::pair<std::vector<uint16_t>, uint8_t>> ids;
+  for (const tNFA_EE_LMRT_AID_GROUP& group : groups) {
+    std::vector<uint16_t> members;
+    for (int xx = group.first; xx <= group.last; xx++)
+      members.push_back(aids[xx].id);
+    ids.push_back({members, group.len});
+  }
+  return ids;
+}
+
+TEST(NfaEeLmrtTest, test_aid_collapse) {
+  AidSet set;
+  set.Add(1, {0xA0, 0x00, 0x00, 0x00, 0x03, 0x10, 0x10});
+  set.Add(2, {0xA0, 0x00, 0x00, 0x00, 0x04, 0x10, 0x10});
+  set.Add(1, {0xA0, 0x00, 0x00, 0x00, 0x03, 0x20, 0x10});
+  set.Add(1, {0xA0, 0x00, 0x00, 0x00, 0x03, 0x10, 0x20});
+  std::vector<tNFA_EE_LMRT_AID> aids = set.Aids();
+  std::vector<tNFA_EE_LMRT_AID_GROUP> groups;
+
+  /* 0 and 3 share 6 bytes: 11 + 11 bytes become 10 */
+  EXPECT_EQ(12, nfa_ee_lmrt_aid_collapse(aids, 5, 1, &groups));
+  EXPECT_EQ((std::vector<std::pair<std::vector<uint16_t>, uint8_t>>{
+                {{0, 3}, 6}, {{2}, 7}, {{1}, 7}}),
+            Groups(aids, groups));
+
+  /* then 2 joins them on the RID: 10 + 11 bytes become 9 */
+  aids = set.Aids();
+  EXPECT_EQ(24, nfa_ee_lmrt_aid_collapse(aids, 5, 13, &groups));
+  EXPECT_EQ((std::vector<std::pair<std::vector<uint16_t>, uint8_t>>{
+                {{0, 3, 2}, 5}, {{1}, 7}}),
+            Groups(aids, groups));
+
+  /* nothing is merged below min_len */
+  aids = set.Aids();
+  EXPECT_EQ(12, nfa_ee_lmrt_aid_collapse(aids, 6, 100, &groups));
+  EXPECT_EQ(3u, groups.size());
+}
+
+TEST(NfaEeLmrtTest, test_aid_collapse_keeps_other_routes) {
+  AidSet set;
+  set.Add(1, {0xA0, 0x00, 0x00, 0x00, 0x03, 0x10, 0x10});
+  set.Add(1, {0xA0, 0x00, 0x00, 0x00, 0x03, 0x10, 0x30});
+  set.Add(1, {0xA0, 0x00, 0x00, 0x00, 0x03, 0x20, 0x10});
+  /* another route under the prefix of the AIDs above, but not under the
+   * prefix of the first two only */
+  set.Add(2, {0xA0, 0x00, 0x00, 0x00, 0x03, 0x18, 0x00});
+  /* another route that is shorter than their prefix */
+  set.Add(3, {0xA0, 0x00, 0x00, 0x00});
+  std::vector<tNFA_EE_LMRT_AID> aids = set.Aids();
+  std::vector<tNFA_EE_LMRT_AID_GROUP> groups;
+
+  EXPECT_EQ(12, nfa_ee_lmrt_aid_collapse(aids, 5, 100, &groups));
+  EXPECT_EQ((std::vector<std::pair<std::vector<uint16_t>, uint8_t>>{
+                {{0, 1}, 6}, {{2}, 7}, {{3}, 7}, {{4}, 4}}),
+            Groups(aids, groups));
+
+  /* an AID of the same route, but with other qualifiers, is another route */
+  AidSet exact;
+  exact.Add(0x0100, {0xA0, 0x00, 0x00, 0x00, 0x03, 0x10});
+  exact.Add(0x0100, {0xA0, 0x00, 0x00, 0x00, 0x03, 0x20});
+  exact.Add(0x0110, {0xA0, 0x00, 0x00, 0x00, 0x03});
+  aids = exact.Aids();
+  EXPECT_EQ(0, nfa_ee_lmrt_aid_collapse(aids, 5, 100, &groups));
+  EXPECT_EQ(3u, groups.size());
+}
+
+TEST(NfaEeLmrtTest, test_overflow_skips_routes) {
+  LmrtSet set;
+  set.Tech(0x02, 0x00);
+  set.Aid(0x02, {0xA0, 0x00, 0x00, 0x00, 0x03, 0x10, 0x10, 0x01, 0x02, 0x03,
+                 0x04, 0x05});
+  set.Aid(0x00, std::vector<uint8_t>(16, 0xA1));
+  set.Proto(0x00, 0x04);
+  set.Aid(0xC0, {0xA0, 0x00, 0x00, 0x00, 0x04});
+
+  /* 16 bytes for the first AID leave 19, too few for the second one, then 9
+   * for the last AID, 5 for the protocol and 5 for the technology */
+  std::vector<tNFA_EE_LMRT_ROUTE> routes = set.Routes();
+  std::vector<uint8_t> cmds;
+  EXPECT_FALSE(nfa_ee_lmrt_build(routes, 35, &cmds));
+  EXPECT_EQ((std::vector<uint8_t>{
+                0x00, 4,    35,   0x02, 14,   0x02, 0x01, 0xA0, 0x00,
+                0x00, 0x00, 0x03, 0x10, 0x10, 0x01, 0x02, 0x03, 0x04,
+                0x05, 0x02, 7,    0xC0, 0x01, 0xA0, 0x00, 0x00, 0x00,
+                0x04, 0x01, 3,    0x00, 0x01, 0x04, 0x00, 3,    0x02,
+                0x01, 0x00}),
+            cmds);
+
+  /* one byte less and the technology is dropped too */
+  routes = set.Routes();
+  EXPECT_FALSE(nfa_ee_lmrt_build(routes, 34, &cmds));
+  EXPECT_EQ((std::vector<uint8_t>{
+                0x00, 3,    30,   0x02, 14,   0x02, 0x01, 0xA0, 0x00,
+                0x00, 0x00, 0x03, 0x10, 0x10, 0x01, 0x02, 0x03, 0x04,
+                0x05, 0x02, 7,    0xC0, 0x01, 0xA0, 0x00, 0x00, 0x00,
+                0x04, 0x01, 3,    0x00, 0x01, 0x04}),
+            cmds);
+
+  /* with room for all of them, the second AID goes in its place */
+  routes = set.Routes();
+  EXPECT_TRUE(nfa_ee_lmrt_build(routes, 55, &cmds));
+  std::vector<tNFA_EE_LMRT_ROUTE> parsed;
+  ASSERT_TRUE(nfa_ee_lmrt_parse(cmds, 55, &parsed));
+  std::vector<tNFA_EE_LMRT_ROUTE> given = set.Routes();
+  ASSERT_EQ(5u, parsed.size());
+  int expected[] = {1, 2, 4, 3, 0};
+  for (int xx = 0; xx < 5; xx++)
+    ExpectSameRoute(given[expected[xx]], parsed[xx]);
+}
+
+TEST(NfaEeLmrtTest, test_mask_size) {
+  const uint8_t masks[] = {0x01, 0x02, 0x04};
+
+  EXPECT_EQ(0, nfa_ee_lmrt_mask_size(0x00, masks, 3));
+  EXPECT_EQ(10, nfa_ee_lmrt_mask_size(0x05, masks, 3));
+  EXPECT_EQ(15, nfa_ee_lmrt_mask_size(0x07, masks, 3));
+  /* what the NFCC cannot route takes no room */
+  EXPECT_EQ(5, nfa_ee_lmrt_mask_size(0x18 | 0x02, masks, 3));
+  EXPECT_EQ(0, nfa_ee_lmrt_mask_size(0x04, masks, 2));
+}
+
+TEST(NfaEeLmrtTest, test_total_size) {
+  const tNFA_EE_LMRT_SIZE sizes[] = {{5, 20, 0, 6}, {10, 0, 8, 0}, {0, 0, 0, 0}};
+
+  EXPECT_EQ(0, nfa_ee_lmrt_total_size(sizes, 0));
+  EXPECT_EQ(31, nfa_ee_lmrt_total_size(sizes, 1));
+  EXPECT_EQ(49, nfa_ee_lmrt_total_size(sizes, 3));
+}
+
+TEST(NfaEeLmrtTest, test_tech_conflict) {
+  const uint8_t kA = 0x01, kB = 0x02, kF = 0x04;
+
+  /* A and F on two NFCEEs: F goes, unless its NFCEE is the preferred one */
+  tNFA_EE_LMRT_TECH techs[] = {{0xC0, kA | kB, kA, 0x00},
+                               {0x02, kF, kF, kF}};
+  EXPECT_TRUE(nfa_ee_lmrt_tech_conflict(techs, 2, kA, kF, 0xC0));
+  EXPECT_EQ(kA | kB, techs[0].switch_on);
+  EXPECT_EQ(kA, techs[0].switch_off);
+  EXPECT_EQ(0x00, techs[1].switch_on | techs[1].switch_off |
+                      techs[1].battery_off);
+
+  tNFA_EE_LMRT_TECH preferred[] = {{0xC0, kA | kB, kA, 0x00},
+                                   {0x02, kF, kF, kF}};
+  EXPECT_TRUE(nfa_ee_lmrt_tech_conflict(preferred, 2, kA, kF, 0x02));
+  EXPECT_EQ(kB, preferred[0].switch_on);
+  EXPECT_EQ(0x00, preferred[0].switch_off);
+  EXPECT_EQ(kF, preferred[1].switch_on);
+  EXPECT_EQ(kF, preferred[1].battery_off);
+
+  /* no conflict: the DH takes one of them, or one NFCEE takes both */
+  tNFA_EE_LMRT_TECH dh[] = {{0x00, kA, 0x00, 0x00}, {0x02, kF, 0x00, 0x00}};
+  EXPECT_FALSE(nfa_ee_lmrt_tech_conflict(dh, 2, kA, kF, 0xC0));
+  EXPECT_EQ(kF, dh[1].switch_on);
+  tNFA_EE_LMRT_TECH one[] = {{0x02, kA, 0x00, 0x00}, {0x02, 0x00, kF, 0x00}};
+  EXPECT_FALSE(nfa_ee_lmrt_tech_conflict(one, 2, kA, kF, 0xC0));
+  tNFA_EE_LMRT_TECH only_a[] = {{0xC0, kA, 0x00, 0x00}, {0x02, kB, 0x00, 0x00}};
+  EXPECT_FALSE(nfa_ee_lmrt_tech_conflict(only_a, 2, kA, kF, 0xC0));
+
+  /* the last NFCEE with a technology is the one it is routed to */
+  tNFA_EE_LMRT_TECH last[] = {{0xC0, kF, 0x00, 0x00},
+                              {0x02, kA, 0x00, 0x00},
+                              {0x03, kF, 0x00, 0x00}};
+  EXPECT_TRUE(nfa_ee_lmrt_tech_conflict(last, 3, kA, kF, 0xC0));
+  EXPECT_EQ(kF, last[0].switch_on);
+  EXPECT_EQ(0x00, last[2].switch_on);
+}
+
+TEST(NfaEeLmrtTest, test_random_configurations) {
+  std::mt19937 rng(0x4c4d5254);
+  const uint8_t nfcee_ids[] = {0x00, 0x02, 0x03, 0xC0};
+
+  for (int config = 0; config < 5000; config++) {
+    LmrtSet set;
+    int num_aids = rng() % 80;
+    for (int xx = 0; xx < num_aids; xx++) {
+      std::vector<uint8_t> aid(5 + rng() % 12);
+      for (auto& b : aid) b = rng();
+      uint8_t tag = NCI_ROUTE_TAG_AID;
+      if (rng() % 4 == 0) tag |= NCI_ROUTE_QUAL_LONG_SELECT;
+      set.Add(NCI_ROUTE_ORDER_AID, tag, nfcee_ids[rng() % 4], rng() % 0x40,
+              aid);
+    }
+    for (int xx = rng() % 4; xx > 0; xx--) {
+      std::vector<uint8_t> pattern(2 * (1 + rng() % 20));
+      for (auto& b : pattern) b = rng();
+      set.Add(NCI_ROUTE_ORDER_PATTERN, NCI_ROUTE_TAG_APDU,
+              nfcee_ids[rng() % 4], NCI_ROUTE_PWR_STATE_ON, pattern);
+    }
+    for (int xx = rng() % 4; xx > 0; xx--) {
+      set.Add(NCI_ROUTE_ORDER_SYS_CODE, NCI_ROUTE_TAG_SYSCODE,
+              nfcee_ids[rng() % 4], NCI_ROUTE_PWR_STATE_ON,
+              {(uint8_t)rng(), (uint8_t)rng()});
+    }
+    for (int xx = rng() % 7; xx > 0; xx--) set.Proto(nfcee_ids[rng() % 4], xx);
+    for (int xx = rng() % 4; xx > 0; xx--)
+      set.Tech(nfcee_ids[rng() % 4], xx - 1);
+
+    uint16_t lmrt_size = (rng() % 2) ? kLmrtSize : 64 + rng() % 900;
+    std::vector<tNFA_EE_LMRT_ROUTE> routes = set.Routes();
+    std::vector<uint8_t> cmds;
+    bool fits = nfa_ee_lmrt_build(routes, lmrt_size, &cmds);
+
+    std::vector<tNFA_EE_LMRT_ROUTE> parsed;
+    ASSERT_TRUE(nfa_ee_lmrt_parse(cmds, lmrt_size, &parsed))
+        << "config " << config;
+    EXPECT_EQ(fits, parsed.size() == routes.size()) << "config " << config;
+
+    /* nfa_ee_lmrt_build sorted routes in table order; the table keeps some
+     * of them, in that order */
+    size_t yy = 0;
+    for (size_t xx = 0; xx < parsed.size(); xx++, yy++) {
+      while ((yy < routes.size()) &&
+             ((routes[yy].tag != parsed[xx].tag) ||
+              (routes[yy].nfcee_id != parsed[xx].nfcee_id) ||
+              (routes[yy].pwr_cfg != parsed[xx].pwr_cfg) ||
+              (Val(routes[yy]) != Val(parsed[xx]))))
+        yy++;
+      ASSERT_LT(yy, routes.size()) << "config " << config << " route " << xx;
+    }
+
+    /* a command is only closed when the next TLV does not fit in it */
+    std::vector<const uint8_t*> heads = Commands(cmds);
+    for (size_t xx = 0; xx + 1 < heads.size(); xx++) {
+      const uint8_t* p_next = heads[xx + 1] + 3;
+      ASSERT_GT(heads[xx][2] + 2 + p_next[1], NFA_EE_ROUT_MAX_TLV_SIZE)
+          << "config " << config << " command " << xx;
+    }
+  }
+}
+
+}  // namespace
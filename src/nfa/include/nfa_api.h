@@ -193,6 +193,8 @@ typedef uint8_t tNFA_PROTOCOL_MASK;
 #define NFA_DM_NFCC_TRANSPORT_ERR_EVT 7
 /* Result of NFA_SetPowerSubStateForScreenState */
 #define NFA_DM_SET_POWER_SUB_STATE_EVT 11
+/* Configs changed by NFA_ReloadConfig */
+#define NFA_DM_CONFIG_RELOADED_EVT 15
 #if (NXP_EXTNS == TRUE)
 /* Collision event in case of EMV-CO Profile (Nxp)*/
 #define NFA_DM_EMVCO_PCD_COLLISION_EVT 8
@@ -295,6 +297,13 @@ typedef struct {
   uint8_t power_state; /* current screen/power state */
 } tNFA_DM_POWER_STATE;
 
+/* Data for NFA_DM_CONFIG_RELOADED_EVT */
+typedef struct {
+  tNFA_STATUS status; /* NFA_STATUS_OK if successful  */
+  /* true if a changed config is only read when NFC is initialized */
+  bool restart_required;
+} tNFA_DM_CONFIG_RELOADED;
+
 /* Union of all DM callback structures */
 typedef union {
   tNFA_STATUS status;         /* NFA_DM_ENABLE_EVT        */
@@ -308,6 +317,7 @@ typedef union {
   tNFA_DM_RF_FIELD rf_field;          /* NFA_DM_RF_FIELD_EVT      */
   void* p_vs_evt_data;                /* Vendor-specific evt data */
   tNFA_DM_POWER_STATE power_sub_state; /* power sub state */
+  tNFA_DM_CONFIG_RELOADED config_reloaded; /* NFA_DM_CONFIG_RELOADED_EVT */
 } tNFA_DM_CBACK_DATA;
 
 /* NFA_DM callback */
@@ -921,6 +931,23 @@ extern tNFA_STATUS NFA_GetConfig(uint8_t num_ids, tNFA_PMID* p_param_ids);
 *******************************************************************************/
 extern tNFA_STATUS NFA_SetTransitConfig(std::string config);
 
+/*******************************************************************************
+**
+** Function         NFA_ReloadConfig
+**
+** Description      Read the config files again and apply the configs that
+**                  changed. Configs read during RF discovery or when building
+**                  the listen mode routing table are applied at once, the
+**                  others need NFC to be initialized again. If any config
+**                  changed, an NFA_DM_CONFIG_RELOADED_EVT is reported in the
+**                  tNFA_DM_CBACK callback.
+**
+** Returns          NFA_STATUS_OK if successfully initiated
+**                  NFA_STATUS_FAILED otherwise
+**
+*******************************************************************************/
+extern tNFA_STATUS NFA_ReloadConfig(void);
+
 /*******************************************************************************
 **
 ** Function         NFA_RequestExclusiveRfControl
@@ -50,6 +50,11 @@
 **  Constants and data types
 *****************************************************************************/
 
+/* How an AID registered with NFA_CeRegisterAidMatchOnDH is selected */
+#define NFA_CE_AID_MATCH_EXACT 0x00  /* the AID                         */
+#define NFA_CE_AID_MATCH_PREFIX 0x01 /* any AID starting with the AID   */
+#define NFA_CE_AID_MATCH_SUBSET 0x02 /* any AID the AID starts with     */
+
 /*****************************************************************************
 **  External Function Declarations
 *****************************************************************************/
@@ -229,6 +234,34 @@ extern tNFA_STATUS NFA_CeRegisterAidOnDH(uint8_t aid[NFC_MAX_AID_LEN],
                                          uint8_t aid_len,
                                          tNFA_CONN_CBACK* p_conn_cback);
 
+/*******************************************************************************
+**
+** Function         NFA_CeRegisterAidMatchOnDH
+**
+** Description      Register listening callback for the specified ISODEP AID,
+**                  selected as given by match (NFA_CE_AID_MATCH_xxx).
+**                  NFA_CeRegisterAidOnDH registers with
+**                  NFA_CE_AID_MATCH_EXACT.
+**
+**                  The NFA_CE_REGISTERED_EVT reports the status of the
+**                  operation.
+**
+**                  When several AIDs match a SELECT, the one matching all of
+**                  the selected AID is used, otherwise the longest prefix.
+**
+** Note:            If RF discovery is started,
+**                  NFA_StopRfDiscovery()/NFA_RF_DISCOVERY_STOPPED_EVT should
+**                  happen before calling this function
+**
+** Returns:
+**                  NFA_STATUS_OK, if command accepted
+**                  NFA_STATUS_FAILED: otherwise
+**
+*******************************************************************************/
+extern tNFA_STATUS NFA_CeRegisterAidMatchOnDH(uint8_t aid[NFC_MAX_AID_LEN],
+                                              uint8_t aid_len, uint8_t match,
+                                              tNFA_CONN_CBACK* p_conn_cback);
+
 /*******************************************************************************
 **
 ** Function         NFA_CeDeregisterAidOnDH
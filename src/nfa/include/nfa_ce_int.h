@@ -109,6 +109,7 @@ typedef struct {
   /* For registering Type-4 */
   uint8_t aid[NFC_MAX_AID_LEN]; /* AID to listen for (For type-4 only)  */
   uint8_t aid_len;              /* AID length                           */
+  uint8_t aid_match;            /* NFA_CE_AID_MATCH_xxx                 */
 
   /* For registering UICC */
   tNFA_HANDLE ee_handle;
@@ -207,6 +208,8 @@ typedef struct {
       listen_info[NFA_CE_LISTEN_INFO_MAX]; /* listen info table */
   uint8_t idx_cur_active; /* listen_info index for currently activated CE */
   uint8_t idx_wild_card;  /* listen_info index for T4T wild card CE */
+  /* listen_info index for each T4T AID handle (from CE_T4tRegisterAID) */
+  uint8_t t4t_aid_listen_idx[CE_T4T_MAX_REG_AID + 1];
 
   tNFA_DM_DISC_TECH_PROTO_MASK
       isodep_disc_mask; /* the technology/protocol mask for ISO-DEP */
@@ -87,6 +87,7 @@ enum {
   NFA_DM_TIMEOUT_DISABLE_EVT,
   NFA_DM_API_SET_POWER_SUB_STATE_EVT,
   NFA_DM_API_SEND_RAW_VS_EVT,
+  NFA_DM_API_RELOAD_CONFIG_EVT,
   NFA_DM_MAX_EVT
 };
 
@@ -603,6 +604,7 @@ void nfa_dm_notify_activation_status(tNFA_STATUS status,
                                      tNFA_TAG_PARAMS* p_params);
 
 bool nfa_dm_act_send_raw_vs(tNFA_DM_MSG* p_data);
+bool nfa_dm_act_reload_config(tNFA_DM_MSG* p_data);
 
 void nfa_dm_disable_complete(void);
 
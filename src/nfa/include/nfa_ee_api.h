@@ -98,7 +98,8 @@ enum {
   NFA_EE_PWR_LINK_CTRL_EVT, /* NFCEE Pwr and link cotnrol command Evt */
 #endif
   NFA_EE_ADD_APDU_EVT,  /* The status for adding an APDU pattern to a routing table entry*/
-  NFA_EE_REMOVE_APDU_EVT /* The status for removing an APDU pattern from a routing table */
+  NFA_EE_REMOVE_APDU_EVT, /* The status for removing an APDU pattern from a routing table */
+  NFA_EE_SET_AID_PRIO_EVT /* The status for setting the priority of an AID */
 };
 typedef uint8_t tNFA_EE_EVT;
 
@@ -498,6 +499,29 @@ extern tNFA_STATUS NFA_EeAddAidRouting(tNFA_HANDLE ee_handle, uint8_t aid_len,
 *******************************************************************************/
 extern tNFA_STATUS NFA_EeRemoveAidRouting(uint8_t aid_len, uint8_t* p_aid);
 
+/*******************************************************************************
+**
+** Function         NFA_EeSetAidRoutingPriority
+**
+** Description      This function is called to set the priority of the given
+**                  AID entry. When the AID entries do not all fit the listen
+**                  mode routing table and AID_OVERFLOW_POLICY is priority or
+**                  prefix, the entries with the higher priority are routed
+**                  first. The status of this operation is reported as the
+**                  NFA_EE_SET_AID_PRIO_EVT.
+**
+** Note:            NFA_EeUpdateNow() should be called after last NFA-EE
+**                  function to change the listen mode routing is called.
+**
+** Returns          NFA_STATUS_OK if successfully initiated
+**                  NFA_STATUS_FAILED otherwise
+**                  NFA_STATUS_INVALID_PARAM If bad parameter
+**
+*******************************************************************************/
+extern tNFA_STATUS NFA_EeSetAidRoutingPriority(uint8_t aid_len,
+                                               uint8_t* p_aid,
+                                               uint8_t priority);
+
 /*******************************************************************************
 **
 ** Function         NFA_EeAddApduPatternRouting
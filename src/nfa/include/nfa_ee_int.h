@@ -44,6 +44,7 @@
 #define NFA_EE_INT_H
 #include "nfc_api.h"
 #include "nfa_ee_api.h"
+#include "nfa_ee_lmrt.h"
 #include "nfa_sys.h"
 
 /*****************************************************************************
@@ -101,6 +102,7 @@ enum {
   NFA_EE_API_ADD_APDU_EVT,
   NFA_EE_API_REMOVE_APDU_EVT,
   NFA_EE_NCI_NFCEE_STATUS_NTF_EVT,
+  NFA_EE_API_SET_AID_PRIO_EVT,
   NFA_EE_MAX_EVT
 };
 
@@ -108,6 +110,22 @@ typedef uint16_t tNFA_EE_INT_EVT;
 /* for listen mode routing table*/
 #define NFA_EE_AE_ROUTE 0x80
 #define NFA_EE_AE_VS 0x40
+/* left out of the routing table by the AID overflow policy */
+#define NFA_EE_AE_OVERFLOW 0x20
+/* routed as the prefix of aid_fit_len bytes standing for a group of AIDs */
+#define NFA_EE_AE_PREFIX 0x10
+
+/* What to do with the AIDs that do not fit the listen mode routing table,
+ * see AID_OVERFLOW_POLICY */
+enum {
+  NFA_EE_AID_OVERFLOW_REJECT,   /* fail the NFA_EeAddAidRouting that overflows */
+  NFA_EE_AID_OVERFLOW_PRIORITY, /* route the highest aid_prio first */
+  NFA_EE_AID_OVERFLOW_LRU,      /* route the most recently selected first */
+  NFA_EE_AID_OVERFLOW_PREFIX    /* collapse AIDs to prefixes, then priority */
+};
+
+/* aid_prio of the AIDs NFA_EeSetAidRoutingPriority has not been called for */
+#define NFA_EE_AID_PRIO_DEFAULT 0x80
 
 /* NFA EE Management state */
 enum {
@@ -136,8 +154,6 @@ typedef uint8_t tNFA_EE_CONN_ST;
 #define NFA_EE_ROUT_BUF_SIZE 540
 #endif
 
-#define NFA_EE_ROUT_MAX_TLV_SIZE 0xFD
-
 #if (NXP_EXTNS == TRUE)
 #define NFA_EE_NUM_PROTO 6
 #else
@@ -272,32 +288,20 @@ typedef struct {
  * The first T is always NFA_EE_AID_CFG_TAG_NAME, the L is the actual AID length
  * the aid_len is the total length of all the TLVs associated with this AID
  * entry
+ * The per entry arrays and aid_cfg are carved from p_aid_store, which is
+ * allocated on the first AID and grows with the number of entries
  */
-#if (NXP_EXTNS == TRUE)
-  uint8_t* aid_len;     /* the actual lengths in aid_cfg */
-  uint8_t* aid_pwr_cfg; /* power configuration of this AID entry */
-  uint8_t* aid_rt_info; /* route/vs info for this AID entry */
-  uint8_t* aid_rt_loc;  /* route location info for this AID entry */
-  uint8_t* aid_cfg;     /* routing entries based on AID */
-  uint8_t* aid_info;    /* AID info prefix/subset routing */
-  uint8_t aid_rt_loc_stat[NFA_EE_MAX_AID_ENTRIES]; /* route location info for this
-                                                    AID entry */
-  uint8_t aid_len_stat[NFA_EE_MAX_AID_ENTRIES]; /* the actual lengths in aid_cfg */
-  uint8_t aid_pwr_cfg_stat[NFA_EE_MAX_AID_ENTRIES]; /* power configuration of this
-                                                     AID entry */
-  uint8_t aid_rt_info_stat[NFA_EE_MAX_AID_ENTRIES]; /* route/vs info for this AID
-                                                     entry */
-  uint8_t aid_cfg_stat[NFA_EE_MAX_AID_CFG_LEN];     /* routing entries based on AID */
-#else
-  uint8_t aid_len[NFA_EE_MAX_AID_ENTRIES]; /* the actual lengths in aid_cfg */
-  uint8_t aid_pwr_cfg[NFA_EE_MAX_AID_ENTRIES]; /* power configuration of this
-                                                  AID entry */
-  uint8_t aid_rt_info[NFA_EE_MAX_AID_ENTRIES]; /* route/vs info for this AID
-                                                  entry */
-  uint8_t aid_cfg[NFA_EE_MAX_AID_CFG_LEN];     /* routing entries based on AID */
-  uint8_t aid_info[NFA_EE_MAX_AID_ENTRIES]; /* route/vs info for this AID
-                                                  entry */
-#endif
+  uint8_t* p_aid_store;    /* the block the AID arrays live in */
+  uint16_t aid_entries_cap; /* the entries the AID arrays can hold */
+  uint32_t* aid_sel_seq; /* nfa_ee_cb.aid_sel_seq when last selected */
+  uint8_t* aid_len;      /* the actual lengths in aid_cfg */
+  uint8_t* aid_pwr_cfg;  /* power configuration of this AID entry */
+  uint8_t* aid_rt_info;  /* route/vs info for this AID entry */
+  uint8_t* aid_rt_loc;   /* route location info for this AID entry */
+  uint8_t* aid_info;     /* AID info prefix/subset routing */
+  uint8_t* aid_prio;     /* overflow priority of this AID entry */
+  uint8_t* aid_fit_len;  /* AID bytes routed if NFA_EE_AE_PREFIX is set */
+  uint8_t* aid_cfg;      /* routing entries based on AID */
   /*System Code Based Routing Variables*/
   uint8_t sys_code_cfg[NFA_EE_MAX_SYSTEM_CODE_ENTRIES * NFA_EE_SYSTEM_CODE_LEN];
   uint8_t sys_code_pwr_cfg[NFA_EE_MAX_SYSTEM_CODE_ENTRIES];
@@ -307,6 +311,7 @@ typedef struct {
   uint8_t sys_code_cfg_entries;
   uint16_t size_sys_code; /* The size for system code routing */
   uint8_t aid_entries;
+  uint16_t aid_cfg_len; /* the total of aid_len[], the used part of aid_cfg */
   uint8_t nfcee_id;      /* ID for this NFCEE */
   uint8_t ee_status;     /* The NFCEE status */
   uint8_t ee_old_status; /* The NFCEE status before going to low power mode */
@@ -409,6 +414,14 @@ typedef struct {
   uint8_t* p_aid;
 } tNFA_EE_API_REMOVE_AID;
 
+/* data type for NFA_EE_API_SET_AID_PRIO_EVT */
+typedef struct {
+  NFC_HDR hdr;
+  uint8_t aid_len;
+  uint8_t* p_aid;
+  uint8_t priority;
+} tNFA_EE_API_SET_AID_PRIO;
+
 /* data type for NFA_EE_API_ADD_APDU_EVT */
 typedef struct {
   NFC_HDR hdr;
@@ -554,6 +567,7 @@ typedef union {
   tNFA_EE_API_SET_PROTO_CFG set_proto;
   tNFA_EE_API_ADD_AID add_aid;
   tNFA_EE_API_REMOVE_AID rm_aid;
+  tNFA_EE_API_SET_AID_PRIO set_aid_prio;
   tNFA_EE_API_ADD_SYSCODE add_syscode;
   tNFA_EE_API_REMOVE_SYSCODE rm_syscode;
   tNFA_EE_API_ADD_APDU add_apdu;
@@ -664,15 +678,14 @@ typedef struct {
   uint8_t nfcee_id;
   uint8_t mode;
   uint8_t route_block_control; /* controls route block feature   */
+  bool aid_idx_valid;          /* the AID index matches the ECBs  */
+  bool lmrt_compiled;          /* the routing table is compiled   */
+  bool lmrt_acked_valid;       /* the NFCC has the acked table    */
+  uint8_t aid_overflow_policy; /* NFA_EE_AID_OVERFLOW_*          */
+  uint16_t aid_store_max;      /* cap on the AID entries per ECB  */
+  uint32_t aid_sel_seq;        /* count of the AID selections     */
 } tNFA_EE_CB;
 
-/* Order of Routing entries in Routing Table */
-#define NCI_ROUTE_ORDER_AID 0x01        /* AID routing order */
-#define NCI_ROUTE_ORDER_PATTERN 0x02    /* Pattern routing order*/
-#define NCI_ROUTE_ORDER_SYS_CODE 0x03   /* System Code routing order*/
-#define NCI_ROUTE_ORDER_PROTOCOL 0x04   /* Protocol routing order*/
-#define NCI_ROUTE_ORDER_TECHNOLOGY 0x05 /* Technology routing order*/
-
 /*****************************************************************************
 **  External variables
 *****************************************************************************/
@@ -723,6 +736,7 @@ void nfa_ee_api_set_tech_cfg(tNFA_EE_MSG* p_data);
 void nfa_ee_api_set_proto_cfg(tNFA_EE_MSG* p_data);
 void nfa_ee_api_add_aid(tNFA_EE_MSG* p_data);
 void nfa_ee_api_remove_aid(tNFA_EE_MSG* p_data);
+void nfa_ee_api_set_aid_prio(tNFA_EE_MSG* p_data);
 void nfa_ee_api_add_sys_code(tNFA_EE_MSG* p_data);
 void nfa_ee_api_remove_sys_code(tNFA_EE_MSG* p_data);
 void nfa_ee_api_lmrt_size(tNFA_EE_MSG* p_data);
@@ -751,6 +765,8 @@ void nfa_ee_nci_disc_req_ntf(tNFA_EE_MSG* p_data);
 void nfa_ee_rout_timeout(tNFA_EE_MSG* p_data);
 void nfa_ee_discv_timeout(tNFA_EE_MSG* p_data);
 void nfa_ee_lmrt_to_nfcc(tNFA_EE_MSG* p_data);
+void nfa_ee_lmrt_reset(void);
+void nfa_ee_aid_store_free(tNFA_EE_ECB* p_cb);
 void nfa_ee_update_rout(void);
 void nfa_ee_report_event(tNFA_EE_CBACK* p_cback, tNFA_EE_EVT event,
                          tNFA_EE_CBACK_DATA* p_data);
@@ -760,6 +776,7 @@ tNFA_EE_ECB* nfa_ee_find_sys_code_offset(uint16_t sys_code, int* p_offset,
                                          int* p_entry);
 int nfa_ee_find_total_aid_len(tNFA_EE_ECB* p_cb, int start_entry);
 void nfa_ee_start_timer(void);
+void nfa_ee_config_reloaded(void);
 void nfa_ee_reg_cback_enable_done(tNFA_EE_ENABLE_DONE_CBACK* p_cback);
 void nfa_ee_report_update_evt(void);
 void find_and_resolve_tech_conflict();
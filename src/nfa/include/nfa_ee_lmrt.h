@@ -0,0 +1,235 @@
+/******************************************************************************
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/******************************************************************************
+ *
+ *  This is the interface of the listen mode routing table (LMRT) compiler.
+ *  It turns a list of routes into the RF_SET_LISTEN_MODE_ROUTING commands
+ *  that carry them, and checks such commands the way the NFCC takes them.
+ *  It does not use the NFA-EE control blocks, so that routing configurations
+ *  can be built and checked on a host.
+ *
+ ******************************************************************************/
+#ifndef NFA_EE_LMRT_H
+#define NFA_EE_LMRT_H
+
+#include <vector>
+
+#include "nci_defs.h"
+
+/* Order of Routing entries in Routing Table */
+#define NCI_ROUTE_ORDER_AID 0x01        /* AID routing order */
+#define NCI_ROUTE_ORDER_PATTERN 0x02    /* Pattern routing order*/
+#define NCI_ROUTE_ORDER_SYS_CODE 0x03   /* System Code routing order*/
+#define NCI_ROUTE_ORDER_PROTOCOL 0x04   /* Protocol routing order*/
+#define NCI_ROUTE_ORDER_TECHNOLOGY 0x05 /* Technology routing order*/
+
+/* The TLVs one RF_SET_LISTEN_MODE_ROUTING command can carry, after the more
+ * and number of entries bytes */
+#define NFA_EE_ROUT_MAX_TLV_SIZE 0xFD
+
+/* The tag bits of a routing entry type, without the qualifiers */
+#define NFA_EE_LMRT_TAG_MASK 0x0F
+
+/* 4 = 1 (tag) + 1 (len) + 1(nfcee_id) + 1(power cfg) */
+#define NFA_EE_LMRT_TLV_SIZE(val_len) (4 + (val_len))
+
+/* One entry of the listen mode routing table */
+typedef struct {
+  uint8_t order;        /* NCI_ROUTE_ORDER_xxx                  */
+  uint8_t tag;          /* NCI_ROUTE_TAG_xxx and qualifiers     */
+  uint8_t nfcee_id;     /* route location                       */
+  uint8_t pwr_cfg;      /* NCI_ROUTE_PWR_STATE_xxx              */
+  uint8_t len;          /* length of the value                  */
+  const uint8_t* p_val; /* technology, protocol, AID, pattern.. */
+} tNFA_EE_LMRT_ROUTE;
+
+/* The commands are stored one after the other as more, num_tlv, length of
+ * the TLVs and the TLVs, ready for NFC_SetRouting */
+typedef struct {
+  std::vector<uint8_t>* p_cmds;          /* the compiled commands        */
+  uint16_t room;                          /* bytes the NFCC can still take */
+  uint16_t size;                          /* bytes of TLVs added          */
+  uint16_t dropped;                       /* routes that did not fit      */
+  uint8_t num_tlv;                        /* TLVs in the pending command  */
+  uint8_t cmd_len;                        /* bytes in the pending command */
+  uint8_t cmd[NFA_EE_ROUT_MAX_TLV_SIZE];  /* TLVs of the pending command  */
+} tNFA_EE_LMRT;
+
+/* Bytes of routing table the routes of the DH or of an NFCEE take */
+typedef struct {
+  uint16_t size_mask;     /* technology and protocol routes */
+  uint16_t size_aid;      /* AID routes                     */
+  uint16_t size_apdu;     /* APDU pattern routes            */
+  uint16_t size_sys_code; /* system code routes             */
+} tNFA_EE_LMRT_SIZE;
+
+/* The technologies routed to an NFCEE in each power state, as masks */
+typedef struct {
+  uint8_t nfcee_id;
+  uint8_t switch_on;
+  uint8_t switch_off;
+  uint8_t battery_off;
+} tNFA_EE_LMRT_TECH;
+
+/* A routed AID, as the AID overflow policy sees it */
+typedef struct {
+  uint32_t route;       /* AIDs of the same route can share one entry */
+  const uint8_t* p_aid;
+  uint8_t aid_len;
+  uint16_t id;          /* index of the AID for the caller            */
+} tNFA_EE_LMRT_AID;
+
+/* AIDs routed as one entry of their first len bytes. Groups are runs of the
+ * sorted tNFA_EE_LMRT_AID list. */
+typedef struct {
+  int first;
+  int last;
+  uint8_t len;
+} tNFA_EE_LMRT_AID_GROUP;
+
+/*******************************************************************************
+**
+** Function         nfa_ee_lmrt_init
+**
+** Description      Start compiling a routing table of at most lmrt_size bytes
+**                  into p_cmds, which is cleared
+**
+** Returns          void
+**
+*******************************************************************************/
+extern void nfa_ee_lmrt_init(tNFA_EE_LMRT* p_lmrt, uint16_t lmrt_size,
+                             std::vector<uint8_t>* p_cmds);
+
+/*******************************************************************************
+**
+** Function         nfa_ee_lmrt_add
+**
+** Description      Add one route to the table. A command is closed when the
+**                  route does not fit in it any more.
+**
+** Returns          false, if the table has no room left for the route
+**
+*******************************************************************************/
+extern bool nfa_ee_lmrt_add(tNFA_EE_LMRT* p_lmrt,
+                            const tNFA_EE_LMRT_ROUTE* p_route);
+
+/*******************************************************************************
+**
+** Function         nfa_ee_lmrt_finish
+**
+** Description      Close the last command of the table. An empty table is one
+**                  command without TLVs, which clears the table in the NFCC.
+**
+** Returns          void
+**
+*******************************************************************************/
+extern void nfa_ee_lmrt_finish(tNFA_EE_LMRT* p_lmrt);
+
+/*******************************************************************************
+**
+** Function         nfa_ee_lmrt_build
+**
+** Description      Compile the routes in the order of the routing table:
+**                  AID, APDU pattern, system code, protocol and technology.
+**                  Routes of the same order keep the order they are given in.
+**
+** Returns          false, if some routes did not fit in lmrt_size
+**
+*******************************************************************************/
+extern bool nfa_ee_lmrt_build(std::vector<tNFA_EE_LMRT_ROUTE>& routes,
+                              uint16_t lmrt_size,
+                              std::vector<uint8_t>* p_cmds);
+
+/*******************************************************************************
+**
+** Function         nfa_ee_lmrt_parse
+**
+** Description      Check compiled commands the way the NFCC takes them: every
+**                  command but the last has more set, the number of TLVs and
+**                  lengths match, the entries are in routing table order and
+**                  the table fits in lmrt_size. The routes found are added to
+**                  p_routes if it is not NULL, pointing into cmds.
+**
+** Returns          true, if the commands are valid
+**
+*******************************************************************************/
+extern bool nfa_ee_lmrt_parse(const std::vector<uint8_t>& cmds,
+                              uint16_t lmrt_size,
+                              std::vector<tNFA_EE_LMRT_ROUTE>* p_routes);
+
+/*******************************************************************************
+**
+** Function         nfa_ee_lmrt_mask_size
+**
+** Description      Find the bytes the technology or protocol routes of one
+**                  NFCEE take. routed is the technologies or protocols routed
+**                  in any power state, p_mask_list the ones the NFCC can route.
+**
+** Returns          the size of the routes
+**
+*******************************************************************************/
+extern uint16_t nfa_ee_lmrt_mask_size(uint8_t routed, const uint8_t* p_mask_list,
+                                      int num_masks);
+
+/*******************************************************************************
+**
+** Function         nfa_ee_lmrt_total_size
+**
+** Description      Add up the routes of the DH and of the NFCEEs that go in
+**                  the routing table
+**
+** Returns          the size of the routing table
+**
+*******************************************************************************/
+extern uint16_t nfa_ee_lmrt_total_size(const tNFA_EE_LMRT_SIZE* p_sizes,
+                                       int num_sizes);
+
+/*******************************************************************************
+**
+** Function         nfa_ee_lmrt_tech_conflict
+**
+** Description      The NFCC routes tech and other_tech to one NFCEE. If the
+**                  last NFCEEs found with each are different, remove other_tech
+**                  from its NFCEE, unless that one is preferred_id: then tech
+**                  is removed from its NFCEE.
+**
+** Returns          true, if a technology was removed
+**
+*******************************************************************************/
+extern bool nfa_ee_lmrt_tech_conflict(tNFA_EE_LMRT_TECH* p_techs,
+                                      int num_techs, uint8_t tech,
+                                      uint8_t other_tech, uint8_t preferred_id);
+
+/*******************************************************************************
+**
+** Function         nfa_ee_lmrt_aid_collapse
+**
+** Description      Sort the AIDs by route, then by AID, and merge neighbouring
+**                  groups of the same route into their longest common prefix
+**                  of at least min_len bytes, longest prefix first, until
+**                  over bytes are saved or nothing else can be merged. A
+**                  prefix that also covers an AID of another route is never
+**                  used, whether that AID ends up in the table or not.
+**
+** Returns          the number of bytes saved. *p_groups is set to the groups.
+**
+*******************************************************************************/
+extern int nfa_ee_lmrt_aid_collapse(std::vector<tNFA_EE_LMRT_AID>& aids,
+                                    uint8_t min_len, int over,
+                                    std::vector<tNFA_EE_LMRT_AID_GROUP>* p_groups);
+
+#endif /* NFA_EE_LMRT_H */
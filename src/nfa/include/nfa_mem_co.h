@@ -34,6 +34,18 @@
 **  External Function Declarations
 *****************************************************************************/
 
+/*******************************************************************************
+**
+** Function         nfa_mem_co_init
+**
+** Description      prepare the memory pool, before any buffer is allocated
+**
+** Returns:
+**                  Nothing
+**
+*******************************************************************************/
+extern void nfa_mem_co_init(void);
+
 /*******************************************************************************
 **
 ** Function         nfa_mem_co_alloc
@@ -59,5 +71,17 @@ extern void* nfa_mem_co_alloc(uint32_t num_bytes);
 *******************************************************************************/
 extern void nfa_mem_co_free(void* p_buf);
 
+/*******************************************************************************
+**
+** Function         nfa_mem_co_dump
+**
+** Description      write the usage statistics of the memory pool to fd
+**
+** Returns:
+**                  Nothing
+**
+*******************************************************************************/
+extern void nfa_mem_co_dump(int fd);
+
 
 #endif /* NFA_MEM_CO_H */
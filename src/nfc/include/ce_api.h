@@ -30,6 +30,7 @@
 #include "nfc_types.h"
 #include <stdbool.h>
 #include "tags_defs.h"
+#include "ce_t4t_aid.h"
 
 #define CE_T3T_FIRST_EVT 0x60
 #define CE_T4T_FIRST_EVT 0x80
@@ -168,6 +169,32 @@ extern tNFC_STATUS CE_T4tSetLocalNDEFMsg(bool read_only, uint16_t ndef_msg_max,
 extern tCE_T4T_AID_HANDLE CE_T4tRegisterAID(uint8_t aid_len, uint8_t* p_aid,
                                             tCE_CBACK* p_cback);
 
+/*******************************************************************************
+**
+** Function         CE_T4tRegisterAIDMatch
+**
+** Description      Register AID in CE T4T, selected as given by match
+**
+**                  aid_len: length of AID (up to NFC_MAX_AID_LEN)
+**                  p_aid:   AID
+**                  match:   CE_T4T_AID_MATCH_EXACT, the AID is selected
+**                           CE_T4T_AID_MATCH_PREFIX, an AID starting with
+**                           the AID is selected
+**                           CE_T4T_AID_MATCH_SUBSET, an AID the AID starts
+**                           with is selected
+**                  p_cback: Raw frame will be forwarded with CE_RAW_FRAME_EVT
+**
+**                  When several AIDs match a SELECT, the one matching all of
+**                  the selected AID is used, otherwise the longest prefix.
+**
+** Returns          tCE_T4T_AID_HANDLE if successful,
+**                  CE_T4T_AID_HANDLE_INVALID otherwisse
+**
+*******************************************************************************/
+extern tCE_T4T_AID_HANDLE CE_T4tRegisterAIDMatch(uint8_t aid_len,
+                                                 uint8_t* p_aid, uint8_t match,
+                                                 tCE_CBACK* p_cback);
+
 /*******************************************************************************
 **
 ** Function         CE_T4tDeregisterAID
@@ -182,6 +209,34 @@ extern tCE_T4T_AID_HANDLE CE_T4tRegisterAID(uint8_t aid_len, uint8_t* p_aid,
 *******************************************************************************/
 extern void CE_T4tDeregisterAID(tCE_T4T_AID_HANDLE aid_handle);
 
+/* Bytes CE_T4tSaveAIDs() may write */
+#define CE_T4T_AID_SAVE_SIZE CE_T4T_AID_TABLE_SIZE(CE_T4T_MAX_REG_AID + 1)
+
+/*******************************************************************************
+**
+** Function         CE_T4tSaveAIDs
+**
+** Description      Copy the registered AIDs to p_table, of at least
+**                  CE_T4T_AID_SAVE_SIZE bytes, in their serialized form
+**
+** Returns          the number of bytes copied
+**
+*******************************************************************************/
+extern uint16_t CE_T4tSaveAIDs(uint8_t* p_table);
+
+/*******************************************************************************
+**
+** Function         CE_T4tLoadAIDs
+**
+** Description      Go back to the AIDs saved by CE_T4tSaveAIDs, without
+**                  sorting them again. The AIDs registered since are
+**                  deregistered. The saved AIDs must all be still registered.
+**
+** Returns          false, if the table is not valid. The AIDs are then kept.
+**
+*******************************************************************************/
+extern bool CE_T4tLoadAIDs(const uint8_t* p_table, uint16_t table_len);
+
 /*******************************************************************************
 **
 ** Function         CE_SendRawFrame
@@ -83,6 +83,7 @@ typedef struct {
 typedef struct {
   uint8_t aid_len;
   uint8_t aid[NFC_MAX_AID_LEN];
+  uint8_t match; /* CE_T4T_AID_MATCH_xxx */
   tCE_CBACK* p_cback;
 } tCE_T4T_REG_AID; /* registered AID table */
 
@@ -114,6 +115,11 @@ typedef struct {
   tCE_CBACK* p_wildcard_aid_cback; /* registered wildcard AID callback */
   tCE_T4T_REG_AID reg_aid[CE_T4T_MAX_REG_AID]; /* registered AID table */
   uint8_t selected_aid_idx;
+
+  /* registered AIDs and wildcard AID sorted for SELECT */
+  tCE_T4T_AID_INDEX aid_index;
+  uint8_t aid_table[CE_T4T_AID_TABLE_SIZE(CE_T4T_MAX_REG_AID + 1)];
+  uint16_t aid_offset[CE_T4T_MAX_REG_AID + 1];
 } tCE_T4T_MEM;
 
 /* CE memory control blocks */
@@ -141,11 +147,11 @@ typedef struct {
   (NFC_CE_POOL_BUF_SIZE - NFC_HDR_SIZE - NCI_MSG_OFFSET_SIZE - \
    NCI_DATA_HDR_SIZE - T4T_RSP_STATUS_WORDS_SIZE)
 
-/* Max data size using a single UpdateBinary. 6 bytes are for CLA, INS, P1, P2,
- * Lc */
+/* Max data size using a single UpdateBinary. 7 bytes are for CLA, INS, P1, P2,
+ * extended Lc */
 #define CE_T4T_MAX_LC                                        \
   (NFC_CE_POOL_BUF_SIZE - NFC_HDR_SIZE - NCI_DATA_HDR_SIZE - \
-   T4T_CMD_MAX_HDR_SIZE)
+   T4T_CMD_MAX_EXT_HDR_SIZE)
 
 /*****************************************************************************
 **  EXTERNAL FUNCTION DECLARATIONS
@@ -161,6 +167,7 @@ tNFC_STATUS ce_select_t3t(uint16_t system_code,
                           uint8_t nfcid2[NCI_RF_F_UID_LEN]);
 
 /* ce_t4t internal functions */
+extern void ce_t4t_init(void);
 extern tNFC_STATUS ce_select_t4t(void);
 extern void ce_t4t_process_timeout(TIMER_LIST_ENT* p_tle);
 
@@ -0,0 +1,145 @@
+/******************************************************************************
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/******************************************************************************
+ *
+ *  This is the interface of the AID index CE T4T uses to find the
+ *  application of a SELECT by AID. The index is a table of records sorted by
+ *  AID, which is also its serialized form: it can be copied out and loaded
+ *  back without sorting again. It does not use the CE control block, so that
+ *  it can be built and checked on a host.
+ *
+ ******************************************************************************/
+#ifndef CE_T4T_AID_H
+#define CE_T4T_AID_H
+
+#include "nci_defs.h"
+
+/* How a registered AID matches the AID of a SELECT command */
+/* the selected AID is the registered AID          */
+#define CE_T4T_AID_MATCH_EXACT 0x00
+/* the selected AID starts with the registered AID */
+#define CE_T4T_AID_MATCH_PREFIX 0x01
+/* the registered AID starts with the selected AID */
+#define CE_T4T_AID_MATCH_SUBSET 0x02
+
+/* No registered AID matches */
+#define CE_T4T_AID_INDEX_NONE 0xFF
+
+/* A record is the AID length, the match, the handle and the AID */
+#define CE_T4T_AID_REC_LEN 0
+#define CE_T4T_AID_REC_MATCH 1
+#define CE_T4T_AID_REC_HANDLE 2
+#define CE_T4T_AID_REC_HDR_LEN 3
+#define CE_T4T_AID_REC_MAX_LEN (CE_T4T_AID_REC_HDR_LEN + NCI_MAX_AID_LEN)
+
+/* Bytes of table for max_aids records */
+#define CE_T4T_AID_TABLE_SIZE(max_aids) ((max_aids)*CE_T4T_AID_REC_MAX_LEN)
+
+typedef struct {
+  uint8_t* p_table;     /* records sorted by AID, then by match     */
+  uint16_t* p_offset;   /* offset of each record in p_table         */
+  uint16_t max_aids;    /* records p_table and p_offset have room for */
+  uint16_t num_aids;    /* records in the table                     */
+  uint16_t table_len;   /* bytes of records in the table            */
+  uint16_t num_subset;  /* CE_T4T_AID_MATCH_SUBSET records          */
+  uint32_t prefix_lens; /* bit n set: a n bytes prefix is registered */
+} tCE_T4T_AID_INDEX;
+
+/*******************************************************************************
+**
+** Function         ce_t4t_aid_index_init
+**
+** Description      Start an empty index in the given storage: p_table of
+**                  CE_T4T_AID_TABLE_SIZE(max_aids) bytes and p_offset of
+**                  max_aids entries
+**
+** Returns          void
+**
+*******************************************************************************/
+extern void ce_t4t_aid_index_init(tCE_T4T_AID_INDEX* p_idx, uint8_t* p_table,
+                                  uint16_t* p_offset, uint16_t max_aids);
+
+/*******************************************************************************
+**
+** Function         ce_t4t_aid_index_add
+**
+** Description      Add an AID of up to NCI_MAX_AID_LEN bytes with its match
+**                  and handle. An AID of 0 bytes with CE_T4T_AID_MATCH_PREFIX
+**                  matches any SELECT.
+**
+** Returns          false, if the AID is already in the index with this match,
+**                  or the index is full
+**
+*******************************************************************************/
+extern bool ce_t4t_aid_index_add(tCE_T4T_AID_INDEX* p_idx, uint8_t aid_len,
+                                 const uint8_t* p_aid, uint8_t match,
+                                 uint8_t handle);
+
+/*******************************************************************************
+**
+** Function         ce_t4t_aid_index_remove
+**
+** Description      Remove an AID registered with this match
+**
+** Returns          false, if the AID is not in the index
+**
+*******************************************************************************/
+extern bool ce_t4t_aid_index_remove(tCE_T4T_AID_INDEX* p_idx, uint8_t aid_len,
+                                    const uint8_t* p_aid, uint8_t match);
+
+/*******************************************************************************
+**
+** Function         ce_t4t_aid_index_find
+**
+** Description      Find an AID registered with this match
+**
+** Returns          its handle, or CE_T4T_AID_INDEX_NONE
+**
+*******************************************************************************/
+extern uint8_t ce_t4t_aid_index_find(const tCE_T4T_AID_INDEX* p_idx,
+                                     uint8_t aid_len, const uint8_t* p_aid,
+                                     uint8_t match);
+
+/*******************************************************************************
+**
+** Function         ce_t4t_aid_index_lookup
+**
+** Description      Find the registered AID that matches most of the selected
+**                  AID: an AID matching all of it (exact first, then the
+**                  first subset in AID order), otherwise the longest prefix.
+**
+** Returns          its handle, or CE_T4T_AID_INDEX_NONE
+**
+*******************************************************************************/
+extern uint8_t ce_t4t_aid_index_lookup(const tCE_T4T_AID_INDEX* p_idx,
+                                       uint8_t aid_len, const uint8_t* p_aid);
+
+/*******************************************************************************
+**
+** Function         ce_t4t_aid_index_load
+**
+** Description      Replace the index with a table taken from p_idx->p_table
+**                  of another index. The records are checked to be valid
+**                  and sorted, so that the index is rebuilt in one pass.
+**
+** Returns          false, if the table is not valid. The index is then empty.
+**
+*******************************************************************************/
+extern bool ce_t4t_aid_index_load(tCE_T4T_AID_INDEX* p_idx,
+                                  const uint8_t* p_table, uint16_t table_len);
+
+#endif /* CE_T4T_AID_H */
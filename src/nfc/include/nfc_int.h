@@ -204,8 +204,7 @@ typedef struct {
 #define NFC_RECEIVE_MSGS_OFFSET (10)
 
 #define NFC_SAVED_HDR_SIZE (2)
-/* data Reassembly error (in NFC_HDR.layer_specific) */
-#define NFC_RAS_TOO_BIG 0x08
+/* data Reassembly (in NFC_HDR.layer_specific) */
 #define NFC_RAS_FRAGMENTED 0x01
 
 /* NCI command buffer contains a VSC (in NFC_HDR.layer_specific) */
@@ -227,6 +226,13 @@ typedef struct {
 } i2c_data;
 
 /* NFC control blocks */
+/* NCI command waiting for its response while pipelining */
+typedef struct {
+  NFC_HDR* p_buf;      /* copy of the command, to send it again */
+  uint32_t sent_ticks; /* GKI tick count when it was last sent */
+  uint8_t retries;     /* number of times it has been sent again */
+} tNFC_CMD_SLOT;
+
 typedef struct {
   uint16_t flags; /* NFC control block flags - NFC_FL_* */
   tNFC_CONN_CB conn_cb[NCI_MAX_CONN_CBS];
@@ -264,6 +270,7 @@ typedef struct {
   /* NFC_TASK timer management */
   TIMER_LIST_Q timer_queue; /* 1-sec timer event queue */
   TIMER_LIST_Q quick_timer_queue;
+  uint32_t quick_timer_tick; /* GKI tick count of quick_timer_queue's time */
 
   TIMER_LIST_ENT deactivate_timer; /* Timer to wait for deactivation */
   TIMER_LIST_ENT mode_set_ntf_timer; /* Timer to wait for deactivation */
@@ -294,6 +301,10 @@ typedef struct {
 
   uint8_t nci_cmd_window; /* Number of commands the controller can accecpt
                              without waiting for response */
+  uint8_t cmd_pipeline_depth; /* commands allowed to wait for a response */
+  uint8_t cmd_slot_first;     /* oldest of the commands in cmd_slot */
+  uint8_t num_cmd_slots;      /* commands in cmd_slot */
+  tNFC_CMD_SLOT cmd_slot[NFC_MAX_CMD_PIPELINE]; /* pipelined commands */
 
   NFC_HDR* p_nci_init_rsp; /* holding INIT_RSP until receiving
                               HAL_NFC_POST_INIT_CPLT_EVT */
@@ -314,7 +325,10 @@ typedef struct {
   bool bIsDwpResPending;
   bool bIssueModeSetCmd;
   bool bBlkPwrlinkAndModeSetCmd;
-  NFC_HDR* temp_data;
+  NFC_HDR* temp_data;       /* buffer of the last DWP packet, for retransmit */
+  uint16_t temp_data_offset; /* where the packet is in temp_data */
+  uint16_t temp_data_len;
+  bool temp_data_queued; /* temp_data is still in tx_q, not owned by nfc_cb */
   bool isLowRam;
 #endif
   uint8_t nci_version;     /* NCI version used for NCI communication*/
@@ -376,6 +390,7 @@ extern void nfc_modeset_ntf_timeout(void);
 extern void nfc_ncif_credit_ntf_timeout(void);
 extern bool nfc_ncif_process_event(NFC_HDR* p_msg);
 extern void nfc_ncif_check_cmd_queue(NFC_HDR* p_buf);
+extern void nfc_ncif_flush_cmd_slots(bool requeue);
 extern void nfc_ncif_send_cmd(NFC_HDR* p_buf);
 extern void nfc_ncif_proc_discover_ntf(uint8_t* p, uint16_t plen);
 extern void nfc_ncif_rf_management_status(tNFC_DISCOVER_EVT event,
@@ -403,6 +418,7 @@ extern void nfc_ncif_proc_data(NFC_HDR* p_msg);
 #if (NXP_EXTNS == TRUE)
 extern tNFC_STATUS nfc_ncif_store_FWVersion(uint8_t* p_buf);
 extern uint8_t nfc_ncif_retransmit_data(tNFC_CONN_CB* p_cb, NFC_HDR* p_data);
+extern void nfc_ncif_release_dwp_packet(tNFC_CONN_CB* p_cb);
 extern tNFC_STATUS nfc_ncif_set_MaxRoutingTableSize(uint8_t* p_buf);
 extern void nfc_ncif_empty_cmd_queue();
 extern void nfc_ncif_proc_rf_wtx_ntf(uint8_t* p, uint16_t plen);
@@ -382,6 +382,8 @@ typedef uint8_t tT3T_POLL_RC;
  */
 #define T4T_CMD_MIN_HDR_SIZE 4 /* CLA, INS, P1, P2 */
 #define T4T_CMD_MAX_HDR_SIZE 5 /* CLA, INS, P1, P2, Lc */
+/* CLA, INS, P1, P2, extended Lc (00 and 2 bytes) */
+#define T4T_CMD_MAX_EXT_HDR_SIZE 7
 
 #define T4T_VERSION_2_0 0x20 /* version 2.0 */
 #define T4T_VERSION_1_0 0x10 /* version 1.0 */
@@ -407,6 +409,9 @@ typedef uint8_t tT3T_POLL_RC;
 #define T4T_MAX_LENGTH_LE 0xFF
 /* Max number of bytes written to NDEF file in UpdateBinary Command */
 #define T4T_MAX_LENGTH_LC 0xFF
+/* Number of bytes asked by Le of 00 in short APDU and 0000 in extended APDU */
+#define T4T_SHORT_LE_ALL 0x100
+#define T4T_EXT_LE_ALL 0x10000
 
 #define T4T_RSP_STATUS_WORDS_SIZE 0x02
 
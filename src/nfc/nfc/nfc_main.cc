@@ -62,6 +62,7 @@
 #include "nfa_sys.h"
 #include "hal_nxpese.h"
 #include <config.h>
+#include "nfc_config.h"
 #if (NFC_RW_ONLY == FALSE)
 
 #include "llcp_int.h"
@@ -633,6 +634,7 @@ void nfc_main_flush_cmd_queue(void) {
   nfc_stop_timer(&nfc_cb.nci_wait_rsp_timer);
 
   /* dequeue and free buffer */
+  nfc_ncif_flush_cmd_slots(false);
   while ((p_msg = (NFC_HDR*)GKI_dequeue(&nfc_cb.nci_cmd_xmit_q)) != NULL) {
     GKI_freebuf(p_msg);
   }
@@ -743,39 +745,106 @@ static void nfc_main_hal_cback(uint8_t event, tHAL_NFC_STATUS status) {
 
 /*******************************************************************************
 **
-** Function         nfc_main_hal_data_cback
+** Function         nfc_main_hal_rx_lease
 **
-** Description      HAL data event handler
+** Description      Lease a receive buffer for a NCI packet of data_len bytes
+**                  from the HAL. The caller copies the packet to the returned
+**                  location and passes *pp_buf to nfc_main_hal_rx_deliver.
 **
-** Returns          void
+** Returns          Where the packet goes, or NULL if it is to be dropped
 **
 *******************************************************************************/
-static void nfc_main_hal_data_cback(uint16_t data_len, uint8_t* p_data) {
+static uint8_t* nfc_main_hal_rx_lease(uint16_t data_len, void** pp_buf) {
   NFC_HDR* p_msg;
 
   /* ignore all data while shutting down NFCC */
   if (nfc_cb.nfc_state == NFC_STATE_W4_HAL_CLOSE) {
+    return NULL;
+  }
+
+  if (data_len >
+      NFC_RX_POOL_BUF_SIZE - NFC_HDR_SIZE - NFC_RECEIVE_MSGS_OFFSET) {
+    LOG(ERROR) << StringPrintf("nfc_main_hal_rx_lease (): len %d too long",
+                               data_len);
+    return NULL;
+  }
+
+  p_msg = (NFC_HDR*)GKI_getpoolbuf(NFC_RX_POOL_ID);
+  if (p_msg == NULL) {
+    LOG(ERROR) << StringPrintf("nfc_main_hal_rx_lease (): No buffer");
+    return NULL;
+  }
+
+  /* Initialize NFC_HDR */
+  p_msg->len = data_len;
+  p_msg->event = BT_EVT_TO_NFC_NCI;
+  p_msg->offset = NFC_RECEIVE_MSGS_OFFSET;
+  p_msg->layer_specific = 0;
+
+  *pp_buf = p_msg;
+  return (uint8_t*)(p_msg + 1) + p_msg->offset;
+}
+
+/*******************************************************************************
+**
+** Function         nfc_main_hal_rx_deliver
+**
+** Description      Pass a receive buffer filled by the HAL client to NFC task
+**
+** Returns          void
+**
+*******************************************************************************/
+static void nfc_main_hal_rx_deliver(void* p_buf) {
+  /* the HAL may have been closed while the buffer was being filled */
+  if (nfc_cb.nfc_state == NFC_STATE_W4_HAL_CLOSE) {
+    GKI_freebuf(p_buf);
     return;
   }
 
-  if (p_data) {
-    p_msg = (NFC_HDR*)GKI_getpoolbuf(NFC_NCI_POOL_ID);
-    if (p_msg != NULL) {
-      /* Initialize NFC_HDR */
-      p_msg->len = data_len;
-      p_msg->event = BT_EVT_TO_NFC_NCI;
-      p_msg->offset = NFC_RECEIVE_MSGS_OFFSET;
+  GKI_send_msg(NFC_TASK, NFC_MBOX_ID, p_buf);
+}
 
-      /* no need to check length, it always less than pool size */
-      memcpy((uint8_t*)(p_msg + 1) + p_msg->offset, p_data, p_msg->len);
+/*******************************************************************************
+**
+** Function         nfc_main_hal_data_cback
+**
+** Description      HAL data event handler, for HAL entries without receive
+**                  buffer support
+**
+** Returns          void
+**
+*******************************************************************************/
+static void nfc_main_hal_data_cback(uint16_t data_len, uint8_t* p_data) {
+  uint8_t* p;
+  void* p_buf;
 
-      GKI_send_msg(NFC_TASK, NFC_MBOX_ID, p_msg);
-    } else {
-      LOG(ERROR) << StringPrintf("nfc_main_hal_data_cback (): No buffer");
+  if (p_data) {
+    p = nfc_main_hal_rx_lease(data_len, &p_buf);
+    if (p != NULL) {
+      memcpy(p, p_data, data_len);
+      nfc_main_hal_rx_deliver(p_buf);
     }
   }
 }
 
+/*******************************************************************************
+**
+** Function         nfc_main_hal_open
+**
+** Description      Open HAL transport, receiving NCI packets straight into
+**                  NFC_RX_POOL_ID buffers if the HAL entry supports it
+**
+** Returns          void
+**
+*******************************************************************************/
+static void nfc_main_hal_open(void) {
+  static const tHAL_NFC_RX_CBACKS rx_cbacks = {nfc_main_hal_rx_lease,
+                                               nfc_main_hal_rx_deliver};
+
+  if (nfc_cb.p_hal->set_rx_cbacks) nfc_cb.p_hal->set_rx_cbacks(&rx_cbacks);
+  nfc_cb.p_hal->open(nfc_main_hal_cback, nfc_main_hal_data_cback);
+}
+
 /*******************************************************************************
 **
 ** Function         NFC_Enable
@@ -817,7 +886,7 @@ tNFC_STATUS NFC_Enable(tNFC_RESPONSE_CBACK* p_cback) {
     nfc_cb.p_hal->ioctl(HAL_NFC_IOCTL_SET_BOOT_MODE, (void*)&inpOutData);
   }
 #endif
-  nfc_cb.p_hal->open(nfc_main_hal_cback, nfc_main_hal_data_cback);
+  nfc_main_hal_open();
   return (NFC_STATUS_OK);
 }
 
@@ -882,6 +951,7 @@ void NFC_Init(tHAL_NFC_ENTRY* p_hal_entry_tbl)
 #endif
 {
   int xx;
+  unsigned depth;
 
   /* Clear nfc control block */
   memset(&nfc_cb, 0, sizeof(tNFC_CB));
@@ -900,6 +970,11 @@ void NFC_Init(tHAL_NFC_ENTRY* p_hal_entry_tbl)
   nfc_cb.nfc_state = NFC_STATE_NONE;
   nfc_cb.nci_cmd_window = NCI_MAX_CMD_WINDOW;
   nfc_cb.nci_wait_rsp_tout = NFC_CMD_CMPL_TIMEOUT;
+  /* NFCCs are only known to accept one command at a time, unless the config
+   * says otherwise */
+  depth = NfcConfig::getUnsigned(NAME_NCI_CMD_PIPELINE_DEPTH, 1);
+  nfc_cb.cmd_pipeline_depth =
+      (uint8_t)((depth > NFC_MAX_CMD_PIPELINE) ? NFC_MAX_CMD_PIPELINE : depth);
 
   if(nfcFL.chipType != pn547C2) {
   nfc_cb.p_disc_maps = nfc_interface_mapping;
@@ -918,6 +993,7 @@ void NFC_Init(tHAL_NFC_ENTRY* p_hal_entry_tbl)
   nfc_cb.bRetransmitDwpPacket = false;
   nfc_cb.bIsCreditNtfRcvd = false;
   nfc_cb.temp_data = NULL;
+  nfc_cb.temp_data_queued = false;
   nfc_cb.bSetmodeOnReq = false;
   nfc_cb.bIsDwpResPending = false;
   nfc_cb.bIssueModeSetCmd = false;
@@ -1325,6 +1401,9 @@ tNFC_STATUS NFC_FlushData(uint8_t conn_id) {
 
   if (p_cb) {
     status = NFC_STATUS_OK;
+#if (NXP_EXTNS == TRUE)
+    nfc_ncif_release_dwp_packet(p_cb);
+#endif
     while ((p_buf = GKI_dequeue(&p_cb->tx_q)) != NULL) GKI_freebuf(p_buf);
   }
 
@@ -1506,7 +1585,7 @@ tNFC_STATUS NFC_SetPowerOffSleep(bool enable) {
 
     /* open transport */
     nfc_set_state(NFC_STATE_W4_HAL_OPEN);
-    nfc_cb.p_hal->open(nfc_main_hal_cback, nfc_main_hal_data_cback);
+    nfc_main_hal_open();
 
     return NFC_STATUS_OK;
   } else if ((enable == true) && (nfc_cb.nfc_state == NFC_STATE_IDLE)) {
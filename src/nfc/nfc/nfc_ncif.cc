@@ -62,6 +62,7 @@
 #include "nfa_ce_int.h"
 #include "nfa_sys.h"
 #include "nfa_dm_int.h"
+#include "nfa_ee_int.h"
 #include "nfa_hci_int.h"
 #include <nfc_config.h>
 #endif
@@ -80,7 +81,6 @@ static tNFC_FW_VERSION nfc_fw_version;
 #if (NXP_EXTNS == TRUE)
 #define NFC_NCI_WAIT_DATA_NTF_TOUT 2
 #define NFC_NCI_RFFIELD_EVT_TIMEOUT 2
-uint8_t temp_buff[660];
 #endif
 #define NFC_PB_ATTRIB_REQ_FIXED_BYTES 1
 #define NFC_LB_ATTRIB_REQ_FIXED_BYTES 8
@@ -156,6 +156,257 @@ uint8_t nfc_hal_nfcc_get_reset_info(void) {
   return core_status;
 }
 
+/*******************************************************************************
+**
+** Function         nfc_ncif_save_cmd
+**
+** Description      Save the NCI command now waiting for its response, to
+**                  double check the response and for the recovery
+**
+** Returns          void
+**
+*******************************************************************************/
+static void nfc_ncif_save_cmd(NFC_HDR* p_buf) {
+  uint8_t* ps;
+
+#if (NXP_EXTNS == TRUE)
+  /*save the message header to double check the response */
+  ps = (uint8_t*)(p_buf + 1) + p_buf->offset;
+  /*save command HEADER(GID+OID) only*/
+  memcpy(nfc_cb.last_hdr, ps, NFC_SAVED_HDR_SIZE);
+  /*save command length only*/
+  nfc_cb.cmd_size = *(ps + NFC_SAVED_HDR_SIZE);
+  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s : cmd_size:%d", __func__, nfc_cb.cmd_size);
+  if ((nfc_cb.last_hdr[0] == 0x20 &&
+       (nfc_cb.last_hdr[1] == 0x02 || nfc_cb.last_hdr[1] == 0x03)) ||
+      (nfc_cb.last_hdr[0] == 0x2F && nfc_cb.last_hdr[1] == 0x15) ||
+      (nfc_cb.last_hdr[0] == 0x21 && nfc_cb.last_hdr[1] == 0x01) ||
+      (nfc_cb.last_hdr[0] == 0x21 && nfc_cb.last_hdr[1] == 0x06)) {
+    if (nfc_cb.last_cmd_buf != NULL) {
+      GKI_freebuf(nfc_cb.last_cmd_buf);  // ======> Free before allocation
+    }
+    nfc_cb.last_cmd_buf = (uint8_t*)GKI_getbuf(nfc_cb.cmd_size + 1);
+    if (nfc_cb.last_cmd_buf != NULL) {
+      /*save command data including length and excluding header*/
+      memcpy(nfc_cb.last_cmd_buf, ps + NFC_SAVED_HDR_SIZE,
+             (nfc_cb.cmd_size + 1));
+      memcpy(nfc_cb.last_cmd, ps + NCI_MSG_HDR_SIZE, NFC_SAVED_CMD_SIZE);
+    } else {
+      DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("NULL buffer nfc_cb.last_cmd_buf");
+    }
+  } else {
+    memcpy(nfc_cb.last_cmd, ps + NCI_MSG_HDR_SIZE, NFC_SAVED_CMD_SIZE);
+  }
+#else
+  /* save the message header to double check the response */
+  ps = (uint8_t*)(p_buf + 1) + p_buf->offset;
+  memcpy(nfc_cb.last_hdr, ps, NFC_SAVED_HDR_SIZE);
+  memcpy(nfc_cb.last_cmd, ps + NCI_MSG_HDR_SIZE, NFC_SAVED_CMD_SIZE);
+#endif
+}
+
+/*******************************************************************************
+**
+** Function         nfc_ncif_is_pipelined_cmd
+**
+** Description      Check if the NCI command may be sent while the responses to
+**                  earlier ones are still pending: CORE_SET_CONFIG and
+**                  RF_SET_LISTEN_MODE_ROUTING
+**
+** Returns          true if the command may be pipelined
+**
+*******************************************************************************/
+static bool nfc_ncif_is_pipelined_cmd(NFC_HDR* p_buf) {
+  uint8_t* ps = (uint8_t*)(p_buf + 1) + p_buf->offset;
+  uint8_t gid = ps[0] & NCI_GID_MASK;
+  uint8_t oid = ps[1] & NCI_OID_MASK;
+
+  return (((gid == NCI_GID_CORE) && (oid == NCI_MSG_CORE_SET_CONFIG)) ||
+          ((gid == NCI_GID_RF_MANAGE) && (oid == NCI_MSG_RF_SET_ROUTING)));
+}
+
+/*******************************************************************************
+**
+** Function         nfc_ncif_add_cmd_slot
+**
+** Description      Keep a copy of a NCI command about to be sent until its
+**                  response is received
+**
+** Returns          true if the command is kept
+**
+*******************************************************************************/
+static bool nfc_ncif_add_cmd_slot(NFC_HDR* p_buf) {
+  tNFC_CMD_SLOT* p_slot;
+  NFC_HDR* p_copy;
+  uint16_t size = NFC_HDR_SIZE + p_buf->offset + p_buf->len;
+
+  if (nfc_cb.num_cmd_slots >= NFC_MAX_CMD_PIPELINE) return false;
+
+  p_copy = (NFC_HDR*)GKI_getbuf(size);
+  if (p_copy == NULL) {
+    LOG(ERROR) << StringPrintf("nfc_ncif_add_cmd_slot (): No buffer");
+    return false;
+  }
+  memcpy(p_copy, p_buf, size);
+
+  p_slot = &nfc_cb.cmd_slot[(nfc_cb.cmd_slot_first + nfc_cb.num_cmd_slots) %
+                            NFC_MAX_CMD_PIPELINE];
+  p_slot->p_buf = p_copy;
+  p_slot->sent_ticks = GKI_get_tick_count();
+  p_slot->retries = 0;
+  nfc_cb.num_cmd_slots++;
+  return true;
+}
+
+/*******************************************************************************
+**
+** Function         nfc_ncif_can_pipeline_cmd
+**
+** Description      Check if the NCI command can be sent now, while the
+**                  response to the previous command is still pending
+**
+** Returns          true if the command can be sent
+**
+*******************************************************************************/
+static bool nfc_ncif_can_pipeline_cmd(NFC_HDR* p_buf) {
+  /* the outstanding commands must all be pipelined ones */
+  if ((nfc_cb.num_cmd_slots == 0) ||
+      (nfc_cb.num_cmd_slots >= nfc_cb.cmd_pipeline_depth)) {
+    return false;
+  }
+  /* the window is shared with data when fragmenting on I2C, and it is owned
+   * by the HAL while it has control */
+  if ((get_i2c_fragmentation_enabled() == I2C_FRAGMENATATION_ENABLED) ||
+      (nfc_cb.flags & (NFC_FL_CONTROL_REQUESTED | NFC_FL_CONTROL_GRANTED))) {
+    return false;
+  }
+  return ((p_buf->layer_specific == 0) && nfc_ncif_is_pipelined_cmd(p_buf));
+}
+
+/*******************************************************************************
+**
+** Function         nfc_ncif_send_pipelined_cmds
+**
+** Description      Send the commands at the head of the command queue that
+**                  can be pipelined behind the outstanding ones
+**
+** Returns          void
+**
+*******************************************************************************/
+static void nfc_ncif_send_pipelined_cmds(void) {
+  NFC_HDR* p_buf;
+
+  while (((p_buf = (NFC_HDR*)GKI_getfirst(&nfc_cb.nci_cmd_xmit_q)) != NULL) &&
+         nfc_ncif_can_pipeline_cmd(p_buf)) {
+    if (!nfc_ncif_add_cmd_slot(p_buf)) break;
+
+    p_buf = (NFC_HDR*)GKI_dequeue(&nfc_cb.nci_cmd_xmit_q);
+    DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
+        "nfc_ncif_send_pipelined_cmds: %d outstanding", nfc_cb.num_cmd_slots);
+    HAL_WRITE(p_buf);
+  }
+}
+
+/*******************************************************************************
+**
+** Function         nfc_ncif_next_cmd_slot
+**
+** Description      Release the command whose response has been received. If
+**                  pipelined commands are still outstanding, the oldest one
+**                  becomes the command waiting for its response, with what
+**                  is left of its own timeout.
+**
+** Returns          true if a pipelined command is still outstanding
+**
+*******************************************************************************/
+static bool nfc_ncif_next_cmd_slot(void) {
+  tNFC_CMD_SLOT* p_slot;
+  uint32_t elapsed_ms, tout_ms;
+
+  if (nfc_cb.num_cmd_slots == 0) return false;
+
+  GKI_freebuf(nfc_cb.cmd_slot[nfc_cb.cmd_slot_first].p_buf);
+  nfc_cb.cmd_slot_first = (nfc_cb.cmd_slot_first + 1) % NFC_MAX_CMD_PIPELINE;
+  nfc_cb.num_cmd_slots--;
+  if (nfc_cb.num_cmd_slots == 0) return false;
+
+  p_slot = &nfc_cb.cmd_slot[nfc_cb.cmd_slot_first];
+  nfc_ncif_save_cmd(p_slot->p_buf);
+
+  elapsed_ms = GKI_TICKS_TO_MS(GKI_get_tick_count() - p_slot->sent_ticks);
+  tout_ms = nfc_cb.nci_wait_rsp_tout * 1000;
+  nfc_start_timer(&nfc_cb.nci_wait_rsp_timer, (uint16_t)(NFC_TTYPE_NCI_WAIT_RSP),
+                  (elapsed_ms < tout_ms) ? (tout_ms - elapsed_ms + 999) / 1000
+                                         : 1);
+  return true;
+}
+
+/*******************************************************************************
+**
+** Function         nfc_ncif_retransmit_cmd_slots
+**
+** Description      Send the outstanding pipelined commands again, in order,
+**                  after the response to the oldest one timed out
+**
+** Returns          true if the commands were sent again
+**
+*******************************************************************************/
+static bool nfc_ncif_retransmit_cmd_slots(void) {
+  tNFC_CMD_SLOT* p_slot;
+  int xx;
+
+  if ((nfc_cb.num_cmd_slots == 0) ||
+      (nfc_cb.cmd_slot[nfc_cb.cmd_slot_first].retries >=
+       NFC_CMD_PIPELINE_RETRIES)) {
+    return false;
+  }
+
+  LOG(ERROR) << StringPrintf("nfc_ncif_retransmit_cmd_slots: %d commands",
+                             nfc_cb.num_cmd_slots);
+  for (xx = 0; xx < nfc_cb.num_cmd_slots; xx++) {
+    p_slot = &nfc_cb.cmd_slot[(nfc_cb.cmd_slot_first + xx) %
+                              NFC_MAX_CMD_PIPELINE];
+    nfcsnoop_capture(p_slot->p_buf, false);
+    HAL_RE_WRITE(p_slot->p_buf);
+    p_slot->sent_ticks = GKI_get_tick_count();
+    p_slot->retries++;
+  }
+  nfc_start_timer(&nfc_cb.nci_wait_rsp_timer, (uint16_t)(NFC_TTYPE_NCI_WAIT_RSP),
+                  nfc_cb.nci_wait_rsp_tout);
+  return true;
+}
+
+/*******************************************************************************
+**
+** Function         nfc_ncif_flush_cmd_slots
+**
+** Description      Forget the outstanding pipelined commands. If requeue is
+**                  set, the ones behind the oldest are put back at the head
+**                  of the command queue, to be sent once the window reopens.
+**
+** Returns          void
+**
+*******************************************************************************/
+void nfc_ncif_flush_cmd_slots(bool requeue) {
+  tNFC_CMD_SLOT* p_slot;
+
+  while (nfc_cb.num_cmd_slots > 1) {
+    nfc_cb.num_cmd_slots--;
+    p_slot = &nfc_cb.cmd_slot[(nfc_cb.cmd_slot_first + nfc_cb.num_cmd_slots) %
+                              NFC_MAX_CMD_PIPELINE];
+    if (requeue) {
+      GKI_enqueue_head(&nfc_cb.nci_cmd_xmit_q, p_slot->p_buf);
+    } else {
+      GKI_freebuf(p_slot->p_buf);
+    }
+  }
+  if (nfc_cb.num_cmd_slots) {
+    GKI_freebuf(nfc_cb.cmd_slot[nfc_cb.cmd_slot_first].p_buf);
+    nfc_cb.num_cmd_slots = 0;
+  }
+  nfc_cb.cmd_slot_first = 0;
+}
+
 /*******************************************************************************
 **
 ** Function         nfc_ncif_update_window
@@ -178,7 +429,9 @@ void nfc_ncif_update_window(void) {
   nfc_stop_timer(&nfc_cb.nci_wait_rsp_timer);
 
   nfc_cb.p_vsc_cback = NULL;
-  nfc_cb.nci_cmd_window++;
+  if (!nfc_ncif_next_cmd_slot()) {
+    nfc_cb.nci_cmd_window++;
+  }
 
   /* Check if there were any commands waiting to be sent */
   nfc_ncif_check_cmd_queue(NULL);
@@ -211,6 +464,13 @@ void nfc_ncif_update_data_queue(void) {
 void nfc_ncif_cmd_timeout(void) {
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("nfc_ncif_cmd_timeout(): enter");
 
+  if (nfc_ncif_retransmit_cmd_slots()) {
+    return;
+  }
+  /* only the oldest pipelined command is restored by the recovery, send the
+   * others again afterwards */
+  nfc_ncif_flush_cmd_slots(true);
+
 #if (NXP_EXTNS == TRUE)
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("Start Middleware Recovery Procedure");
   {
@@ -463,9 +723,15 @@ uint8_t nfc_ncif_retransmit_data(tNFC_CONN_CB* p_cb, NFC_HDR* p_data) {
     LOG(ERROR) << StringPrintf("nfc_ncif_retransmit_data: p_data is NULL");
     return NCI_STATUS_FAILED;
   }
+  /* a fragment is only valid while its buffer heads the tx queue */
+  if (nfc_cb.temp_data_queued && (GKI_getfirst(&p_cb->tx_q) != p_data)) {
+    LOG(ERROR) << StringPrintf("nfc_ncif_retransmit_data: fragment flushed");
+    return NCI_STATUS_FAILED;
+  }
   if (p_cb->num_buff != NFC_CONN_NO_FC) p_cb->num_buff--;
 
-  HAL_RE_WRITE(p_data);
+  nfc_cb.p_hal->write(nfc_cb.temp_data_len,
+                      (uint8_t*)(p_data + 1) + nfc_cb.temp_data_offset);
   if (p_cb->conn_id == NFC_NFCEE_CONN_ID) {
     // Start waiting for credit ntf
     nfc_cb.bIsCreditNtfRcvd = false;
@@ -475,6 +741,49 @@ uint8_t nfc_ncif_retransmit_data(tNFC_CONN_CB* p_cb, NFC_HDR* p_data) {
   }
   return NCI_STATUS_OK;
 }
+
+/*******************************************************************************
+**
+** Function         nfc_ncif_hold_dwp_packet
+**
+** Description      Keep the packet just sent on the wired mode NFCEE
+**                  connection for nfc_ncif_retransmit_data(). A packet of its
+**                  own buffer is taken over, a fragment stays in the tx queue.
+**
+** Returns          void
+**
+*******************************************************************************/
+static void nfc_ncif_hold_dwp_packet(NFC_HDR* p_buf, uint16_t offset,
+                                     uint16_t len, bool queued) {
+  if ((nfc_cb.temp_data != NULL) && (!nfc_cb.temp_data_queued) &&
+      (nfc_cb.temp_data != p_buf)) {
+    GKI_freebuf(nfc_cb.temp_data);
+  }
+  nfc_cb.temp_data = p_buf;
+  nfc_cb.temp_data_offset = offset;
+  nfc_cb.temp_data_len = len;
+  nfc_cb.temp_data_queued = queued;
+}
+
+/*******************************************************************************
+**
+** Function         nfc_ncif_release_dwp_packet
+**
+** Description      Drop the packet kept for retransmission when the tx queue
+**                  of the NFCEE connection is flushed
+**
+** Returns          void
+**
+*******************************************************************************/
+void nfc_ncif_release_dwp_packet(tNFC_CONN_CB* p_cb) {
+  if ((p_cb == NULL) || (p_cb->conn_id != NFC_NFCEE_CONN_ID)) return;
+
+  if ((nfc_cb.temp_data != NULL) && (!nfc_cb.temp_data_queued)) {
+    GKI_freebuf(nfc_cb.temp_data);
+  }
+  nfc_cb.temp_data = NULL;
+  nfc_cb.temp_data_queued = false;
+}
 #endif
 /*******************************************************************************
 **
@@ -489,15 +798,15 @@ uint8_t nfc_ncif_retransmit_data(tNFC_CONN_CB* p_cb, NFC_HDR* p_data) {
 *******************************************************************************/
 uint8_t nfc_ncif_send_data(tNFC_CONN_CB* p_cb, NFC_HDR* p_data) {
   uint8_t* pp;
-  uint8_t* ps;
   uint8_t ulen = NCI_MAX_PAYLOAD_SIZE;
+  uint16_t remaining = 0;
   NFC_HDR* p;
   uint8_t pbf = 1;
   uint8_t buffer_size = p_cb->buff_size;
   uint8_t hdr0 = p_cb->conn_id;
   bool fragmented = false;
+  bool keep = false;
 #if (NXP_EXTNS == TRUE)
-  uint8_t* pTemp;
   if (core_reset_init_num_buff == true) {
     LOG(ERROR) << StringPrintf("Reinitializing the num_buff");
 
@@ -560,59 +869,58 @@ uint8_t nfc_ncif_send_data(tNFC_CONN_CB* p_cb, NFC_HDR* p_data) {
       ulen = (uint8_t)(p_data->len);
       fragmented = false;
     } else {
+      pbf = 1;
       fragmented = true;
       ulen = buffer_size;
     }
 
+    /* build NCI Data packet header in place, ahead of the ulen bytes to send.
+     * For all but the first fragment it overwrites the tail of the previous
+     * fragment, which has already been written to the HAL. */
+    p_data->offset -= NCI_DATA_HDR_SIZE;
+    pp = (uint8_t*)(p_data + 1) + p_data->offset;
+    NCI_DATA_PBLD_HDR(pp, pbf, hdr0, ulen);
+    if (p_cb->num_buff != NFC_CONN_NO_FC) p_cb->num_buff--;
+
     if (!fragmented) {
-      /* if data packet is not fragmented, use the original buffer */
-      p = p_data;
-      p_data = (NFC_HDR*)GKI_dequeue(&p_cb->tx_q);
+      /* the last fragment goes out in the original buffer */
+      p = (NFC_HDR*)GKI_dequeue(&p_cb->tx_q);
+      p->event = BT_EVT_TO_NFC_NCI;
+      p->layer_specific = pbf;
+      p->len += NCI_DATA_HDR_SIZE;
     } else {
-      /* the data packet is too big and need to be fragmented
-       * prepare a new GKI buffer
-       * (even the last fragment to avoid issues) */
-      p = NCI_GET_CMD_BUF(ulen);
-      if (p == NULL)
-        return (NCI_STATUS_BUFFER_FULL);
-
-      p->len = ulen;
-      p->offset = NCI_MSG_OFFSET_SIZE + NCI_DATA_HDR_SIZE + 1;
-
-      if (p->len) {
-        pp = (uint8_t*)(p + 1) + p->offset;
-        ps = (uint8_t*)(p_data + 1) + p_data->offset;
-        memcpy(pp, ps, ulen);
-      }
-      /* adjust the NFC_HDR on the old fragment */
-      p_data->len -= ulen;
-      p_data->offset += ulen;
+      /* send a window of the original buffer without copying it */
+      p = p_data;
+      remaining = p->len - ulen;
+      p->len = ulen + NCI_DATA_HDR_SIZE;
     }
 
-    p->event = BT_EVT_TO_NFC_NCI;
-    p->layer_specific = pbf;
-    p->len += NCI_DATA_HDR_SIZE;
-    p->offset -= NCI_DATA_HDR_SIZE;
-    pp = (uint8_t*)(p + 1) + p->offset;
-    /* build NCI Data packet header */
-    NCI_DATA_PBLD_HDR(pp, pbf, hdr0, ulen);
-    if (p_cb->num_buff != NFC_CONN_NO_FC) p_cb->num_buff--;
-
+    nfcsnoop_capture(p, false);
 #if (NXP_EXTNS == TRUE)
     if ((nfcFL.eseFL._ESE_DUAL_MODE_PRIO_SCHEME ==
             nfcFL.eseFL._ESE_WIRED_MODE_RESUME) &&
             (p_cb->conn_id == NFC_NFCEE_CONN_ID)) {
-        nfc_cb.temp_data = (NFC_HDR*)temp_buff;
-        nfc_cb.temp_data->offset = p->offset;
-        pTemp = (uint8_t*)(nfc_cb.temp_data + 1) + nfc_cb.temp_data->offset;
-        nfc_cb.temp_data->len = p->len;
-        memcpy(pTemp, ((uint8_t*)(p + 1) + p->offset), p->len);
+        /* keep the packet for retransmission instead of a copy of it */
+        nfc_ncif_hold_dwp_packet(p, p->offset, p->len, fragmented);
+        keep = true;
     }
 #endif
 
     /* send to HAL */
-    HAL_WRITE(p);
-    nfcsnoop_capture(p, false);
+    if (fragmented || keep) {
+      HAL_RE_WRITE(p);
+    } else {
+      HAL_WRITE(p);
+    }
+
+    if (fragmented) {
+      /* adjust the NFC_HDR to the rest of the data */
+      p_data->offset += p_data->len;
+      p_data->len = remaining;
+    } else {
+      /* check if there are more data to send */
+      p_data = (NFC_HDR*)GKI_getfirst(&p_cb->tx_q);
+    }
 #if (NXP_EXTNS == TRUE)
     /* start NFC data ntf timeout timer */
     if (get_i2c_fragmentation_enabled() == I2C_FRAGMENATATION_ENABLED) {
@@ -627,10 +935,6 @@ uint8_t nfc_ncif_send_data(tNFC_CONN_CB* p_cb, NFC_HDR* p_data) {
                       (uint16_t)(NFC_TTYPE_NCI_WAIT_DATA_NTF),
                       NFC_NCI_WAIT_DATA_NTF_TOUT);
     }
-    if (!fragmented) {
-      /* check if there are more data to send */
-      p_data = (NFC_HDR*)GKI_getfirst(&p_cb->tx_q);
-    }
 #endif
   }
 
@@ -650,7 +954,10 @@ void nfc_ncif_empty_cmd_queue() {
 
 /*Function to empty data queue.*/
 void nfc_ncif_empty_data_queue() {
-  NFC_HDR* p_data = (NFC_HDR*)GKI_dequeue(&p_cb_stored->tx_q);
+  NFC_HDR* p_data;
+
+  nfc_ncif_release_dwp_packet(p_cb_stored);
+  p_data = (NFC_HDR*)GKI_dequeue(&p_cb_stored->tx_q);
 
   while (p_data) {
     GKI_freebuf(p_data);
@@ -694,39 +1001,14 @@ void nfc_ncif_check_cmd_queue(NFC_HDR* p_buf) {
     if (p_buf) {
 #if (NXP_EXTNS == TRUE)
       DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("nfc_ncif_check_cmd_queue : Writing to HAL...");
-      /*save the message header to double check the response */
-      ps = (uint8_t*)(p_buf + 1) + p_buf->offset;
-      /*save command HEADER(GID+OID) only*/
-      memcpy(nfc_cb.last_hdr, ps, NFC_SAVED_HDR_SIZE);
-      /*save command length only*/
-      nfc_cb.cmd_size = *(ps + NFC_SAVED_HDR_SIZE);
-      DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("%s : cmd_size:%d", __func__, nfc_cb.cmd_size);
-      if ((nfc_cb.last_hdr[0] == 0x20 &&
-           (nfc_cb.last_hdr[1] == 0x02 || nfc_cb.last_hdr[1] == 0x03)) ||
-          (nfc_cb.last_hdr[0] == 0x2F && nfc_cb.last_hdr[1] == 0x15) ||
-          (nfc_cb.last_hdr[0] == 0x21 && nfc_cb.last_hdr[1] == 0x01) ||
-          (nfc_cb.last_hdr[0] == 0x21 && nfc_cb.last_hdr[1] == 0x06)) {
-        if (nfc_cb.last_cmd_buf != NULL) {
-          GKI_freebuf(nfc_cb.last_cmd_buf);  // ======> Free before allocation
-        }
-        nfc_cb.last_cmd_buf = (uint8_t*)GKI_getbuf(nfc_cb.cmd_size + 1);
-        if (nfc_cb.last_cmd_buf != NULL) {
-          /*save command data including length and excluding header*/
-          memcpy(nfc_cb.last_cmd_buf, ps + NFC_SAVED_HDR_SIZE,
-                 (nfc_cb.cmd_size + 1));
-          memcpy(nfc_cb.last_cmd, ps + NCI_MSG_HDR_SIZE, NFC_SAVED_CMD_SIZE);
-        } else {
-          DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("NULL buffer nfc_cb.last_cmd_buf");
-        }
-      } else {
-        memcpy(nfc_cb.last_cmd, ps + NCI_MSG_HDR_SIZE, NFC_SAVED_CMD_SIZE);
-      }
-#else
-      /* save the message header to double check the response */
-      ps = (uint8_t*)(p_buf + 1) + p_buf->offset;
-      memcpy(nfc_cb.last_hdr, ps, NFC_SAVED_HDR_SIZE);
-      memcpy(nfc_cb.last_cmd, ps + NCI_MSG_HDR_SIZE, NFC_SAVED_CMD_SIZE);
 #endif
+      nfc_ncif_save_cmd(p_buf);
+      if ((nfc_cb.cmd_pipeline_depth > 1) &&
+          (p_buf->layer_specific == 0) &&
+          nfc_ncif_is_pipelined_cmd(p_buf)) {
+        /* later commands may be pipelined behind this one */
+        nfc_ncif_add_cmd_slot(p_buf);
+      }
       if (p_buf->layer_specific == NFC_WAIT_RSP_VSC) {
         /* save the callback for NCI VSCs)  */
         nfc_cb.p_vsc_cback = (void*)((tNFC_NCI_VS_MSG*)p_buf)->p_cback;
@@ -757,6 +1039,11 @@ void nfc_ncif_check_cmd_queue(NFC_HDR* p_buf) {
     }
   }
 
+  if (nfc_cb.nci_cmd_window == 0) {
+    /* send what can be pipelined behind the pending command */
+    nfc_ncif_send_pipelined_cmds();
+  }
+
   if (nfc_cb.nci_cmd_window == NCI_MAX_CMD_WINDOW) {
     /* the command queue must be empty now */
     if (nfc_cb.flags & NFC_FL_CONTROL_REQUESTED) {
@@ -2275,6 +2562,8 @@ void nfc_ncif_proc_reset_rsp(uint8_t* p, bool is_ntf) {
   uint8_t* p_len = p - 1;
   uint8_t status = *p++;
   uint8_t wait_for_ntf = FALSE;
+  /* Whatever triggered it, a reset clears the routing table of the NFCC */
+  nfa_ee_lmrt_reset();
   if (is_ntf) {
 #if (NXP_EXTNS == TRUE)
       if(nfcFL.nfccFL._NFCC_FORCE_NCI1_0_INIT) {
@@ -2756,6 +3045,100 @@ void nfc_ncif_proc_t3t_polling_ntf(uint8_t* p, uint16_t plen) {
   rw_t3t_handle_nci_poll_ntf(status, num_responses, (uint8_t)plen, p);
 }
 
+/*******************************************************************************
+**
+** Function         nfc_ncif_linearize_data
+**
+** Description      Merge the chain of fragments at the head of the rx queue of
+**                  the given connection into one buffer.
+**                  A complete message is merged and dequeued. Once a chain is
+**                  longer than NFC_RAS_MAX_FRAGMENTS, it is merged in place
+**                  to release the fragment buffers. A message too big for one
+**                  buffer is dequeued a buffer at a time, still marked as
+**                  fragmented.
+**
+** Returns          The buffer to report, or NULL to wait for more fragments
+**
+*******************************************************************************/
+static NFC_HDR* nfc_ncif_linearize_data(tNFC_CONN_CB* p_cb) {
+  NFC_HDR* p_first = (NFC_HDR*)GKI_getfirst(&p_cb->rx_q);
+  NFC_HDR* p_frag = p_first;
+  NFC_HDR* p_msg;
+  uint8_t* pd;
+  uint32_t total = p_first->len;
+  uint32_t max_len =
+      GKI_MAX_BUF_SIZE - NFC_HDR_SIZE - (uint32_t)p_first->offset;
+  int num_frags = 1;
+  bool complete = false, full = false;
+
+  /* find how much of the chain fits in one buffer */
+  while ((p_frag->layer_specific & NFC_RAS_FRAGMENTED) &&
+         ((p_frag = (NFC_HDR*)GKI_getnext(p_frag)) != NULL)) {
+    if (total + p_frag->len - NCI_MSG_HDR_SIZE > max_len) {
+      full = true;
+      break;
+    }
+    total += p_frag->len - NCI_MSG_HDR_SIZE;
+    num_frags++;
+    if (!(p_frag->layer_specific & NFC_RAS_FRAGMENTED)) complete = true;
+  }
+
+  if (!complete && !full && (num_frags <= NFC_RAS_MAX_FRAGMENTS)) {
+    /* wait for the rest of the message */
+    return NULL;
+  }
+
+  if (total <= GKI_get_buf_size(p_first) - NFC_HDR_SIZE - p_first->offset) {
+    /* the first buffer has room for the rest (e.g. it is already merged) */
+    p_msg = p_first;
+  } else {
+    if (complete || full) {
+      p_msg = (NFC_HDR*)GKI_getbuf(
+          (uint16_t)(NFC_HDR_SIZE + p_first->offset + total));
+    } else {
+      /* leave room for the fragments still to come */
+      p_msg = (NFC_HDR*)GKI_getpoolbuf(GKI_MAX_BUF_SIZE_POOL_ID);
+    }
+    if (p_msg == NULL) {
+      LOG(ERROR) << StringPrintf("nfc_ncif_linearize_data (): No buffer");
+      /* report the fragments one at a time */
+      return (NFC_HDR*)GKI_dequeue(&p_cb->rx_q);
+    }
+
+    /* copy the first fragment, with its NCI header */
+    memcpy(p_msg, p_first, NFC_HDR_SIZE);
+    memcpy((uint8_t*)(p_msg + 1) + p_msg->offset,
+           (uint8_t*)(p_first + 1) + p_first->offset, p_first->len);
+
+    /* place the new buffer in the queue instead */
+    GKI_freebuf(GKI_dequeue(&p_cb->rx_q));
+    GKI_enqueue_head(&p_cb->rx_q, p_msg);
+  }
+
+  /* append the payload of the other fragments. Do not need to update pbf and
+   * len in NCI header. They are stripped off at NFC_DATA_CEVT and len may
+   * exceed 255 */
+  pd = (uint8_t*)(p_msg + 1) + p_msg->offset + p_msg->len;
+  while (--num_frags > 0) {
+    p_frag = (NFC_HDR*)GKI_getnext(p_msg);
+    GKI_remove_from_queue(&p_cb->rx_q, p_frag);
+    memcpy(pd, (uint8_t*)(p_frag + 1) + p_frag->offset + NCI_MSG_HDR_SIZE,
+           p_frag->len - NCI_MSG_HDR_SIZE);
+    pd += p_frag->len - NCI_MSG_HDR_SIZE;
+    p_msg->len += p_frag->len - NCI_MSG_HDR_SIZE;
+    p_msg->layer_specific = p_frag->layer_specific;
+    GKI_freebuf(p_frag);
+  }
+  DLOG_IF(INFO, nfc_debug_enabled)
+      << StringPrintf("nfc_ncif_linearize_data len:%d", p_msg->len);
+
+  if (!complete && !full) {
+    /* keep chaining the rest behind the merged buffer */
+    return NULL;
+  }
+  return (NFC_HDR*)GKI_dequeue(&p_cb->rx_q);
+}
+
 /*******************************************************************************
 **
 ** Function         nfc_data_event
@@ -2773,23 +3156,22 @@ void nfc_data_event(tNFC_CONN_CB* p_cb) {
 
   if (p_cb->p_cback) {
     while ((p_evt = (NFC_HDR*)GKI_getfirst(&p_cb->rx_q)) != NULL) {
-      if (p_evt->layer_specific & NFC_RAS_FRAGMENTED) {
-        /* Not the last fragment */
-        if (!(p_evt->layer_specific & NFC_RAS_TOO_BIG)) {
-          /* buffer can hold more */
-          if ((p_cb->conn_id != NFC_RF_CONN_ID) || (nfc_cb.reassembly)) {
-            /* If not rf connection or If rf connection and reassembly
-             * requested,
-             * try to Reassemble next packet */
-            break;
-          }
+      if ((p_evt->layer_specific & NFC_RAS_FRAGMENTED) &&
+          ((p_cb->conn_id != NFC_RF_CONN_ID) || (nfc_cb.reassembly))) {
+        /* Not the last fragment.
+         * If not rf connection or If rf connection and reassembly
+         * requested, wait for the rest of the chain. The consumers parse a
+         * header at the start of the message (HCP, C-APDU, T3T) or a status
+         * at its end (R-APDU SW, T1T/T2T/T3T/T5T status), so the chain is
+         * merged here. In raw frame mode reassembly is requested again on the
+         * first fragment, NFA_DATA_EVT has no continuation status for the
+         * application. */
+        p_evt = nfc_ncif_linearize_data(p_cb);
+        if (p_evt == NULL) {
+          break;
         }
-      }
-
-      p_evt = (NFC_HDR*)GKI_dequeue(&p_cb->rx_q);
-
-      if (p_evt == NULL) {
-        break;
+      } else {
+        p_evt = (NFC_HDR*)GKI_dequeue(&p_cb->rx_q);
       }
       /* report data event */
       p_evt->offset += NCI_MSG_HDR_SIZE;
@@ -2868,9 +3250,6 @@ void nfc_ncif_proc_data(NFC_HDR* p_msg) {
   tNFC_CONN_CB* p_cb;
   uint8_t pbf;
   NFC_HDR* p_last;
-  uint8_t* ps, *pd;
-  uint16_t size;
-  NFC_HDR* p_max = NULL;
   uint16_t len;
 
   pp = (uint8_t*)(p_msg + 1) + p_msg->offset;
@@ -2895,69 +3274,18 @@ void nfc_ncif_proc_data(NFC_HDR* p_msg) {
       p_msg->layer_specific = NFC_RAS_FRAGMENTED;
     }
     p_last = (NFC_HDR*)GKI_getlast(&p_cb->rx_q);
-    if (p_last && (p_last->layer_specific & NFC_RAS_FRAGMENTED)) {
-      /* last data buffer is not last fragment, append this new packet to the
-       * last */
-      size = GKI_get_buf_size(p_last);
-      if (size < (NFC_HDR_SIZE + p_last->len + p_last->offset + len)) {
-        /* the current size of p_last is not big enough to hold the new
-         * fragment, p_msg */
-        if (size != GKI_MAX_BUF_SIZE) {
-          /* try the biggest GKI pool */
-          p_max = (NFC_HDR*)GKI_getpoolbuf(GKI_MAX_BUF_SIZE_POOL_ID);
-          if (p_max) {
-            /* copy the content of last buffer to the new buffer */
-            memcpy(p_max, p_last, NFC_HDR_SIZE);
-            pd = (uint8_t*)(p_max + 1) + p_max->offset;
-            ps = (uint8_t*)(p_last + 1) + p_last->offset;
-            memcpy(pd, ps, p_last->len);
-
-            /* place the new buffer in the queue instead */
-            GKI_remove_from_queue(&p_cb->rx_q, p_last);
-            GKI_freebuf(p_last);
-            GKI_enqueue(&p_cb->rx_q, p_max);
-            p_last = p_max;
-          }
-        }
-        if (p_max == NULL) {
-          /* Biggest GKI Pool not available (or)
-           * Biggest available GKI Pool is not big enough to hold the new
-           * fragment, p_msg */
-          p_last->layer_specific |= NFC_RAS_TOO_BIG;
-        }
-      }
-
-      ps = (uint8_t*)(p_msg + 1) + p_msg->offset + NCI_MSG_HDR_SIZE;
-      len = p_msg->len - NCI_MSG_HDR_SIZE;
-
-      if (!(p_last->layer_specific & NFC_RAS_TOO_BIG)) {
-        pd = (uint8_t*)(p_last + 1) + p_last->offset + p_last->len;
-        memcpy(pd, ps, len);
-        p_last->len += len;
-        /* do not need to update pbf and len in NCI header.
-         * They are stripped off at NFC_DATA_CEVT and len may exceed 255 */
-        DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("nfc_ncif_proc_data len:%d", p_last->len);
-        p_last->layer_specific = p_msg->layer_specific;
-        GKI_freebuf(p_msg);
-        nfc_data_event(p_cb);
-      } else {
-        /* Not enough memory to add new buffer
-         * Send data already in queue first with status Continue */
-        nfc_data_event(p_cb);
-        /* now enqueue the new buffer to the rx queue */
-        GKI_enqueue(&p_cb->rx_q, p_msg);
-      }
-    } else {
-      /* if this is the first fragment on RF link */
-      if ((p_msg->layer_specific & NFC_RAS_FRAGMENTED) &&
-          (p_cb->conn_id == NFC_RF_CONN_ID) && (p_cb->p_cback)) {
-        /* Indicate upper layer that local device started receiving data */
-        (*p_cb->p_cback)(p_cb->conn_id, NFC_DATA_START_CEVT, NULL);
-      }
-      /* enqueue the new buffer to the rx queue */
-      GKI_enqueue(&p_cb->rx_q, p_msg);
-      nfc_data_event(p_cb);
+    /* if this is the first fragment on RF link */
+    if ((p_msg->layer_specific & NFC_RAS_FRAGMENTED) &&
+        !(p_last && (p_last->layer_specific & NFC_RAS_FRAGMENTED)) &&
+        (p_cb->conn_id == NFC_RF_CONN_ID) && (p_cb->p_cback)) {
+      /* Indicate upper layer that local device started receiving data */
+      (*p_cb->p_cback)(p_cb->conn_id, NFC_DATA_START_CEVT, NULL);
     }
+    /* enqueue the new buffer to the rx queue. A fragment is chained behind
+     * the previous ones as it is and only copied once the message is
+     * complete, see nfc_ncif_linearize_data() */
+    GKI_enqueue(&p_cb->rx_q, p_msg);
+    nfc_data_event(p_cb);
     return;
   }
   GKI_freebuf(p_msg);
@@ -3235,8 +3563,8 @@ void uicc_eeprom_get_config(uint8_t* config_resp) {
   uint8_t config_status = NCI_STATUS_FAILED;
   uint8_t retry_count = 0;
 
-  if (NfcConfig::hasKey(NAME_NXP_DUAL_UICC_ENABLE)) {
-    uicc_mode = NfcConfig::getUnsigned(NAME_NXP_DUAL_UICC_ENABLE);
+  if (NfcConfig::hasKey(KEY_NXP_DUAL_UICC_ENABLE)) {
+    uicc_mode = NfcConfig::getUnsigned(KEY_NXP_DUAL_UICC_ENABLE);
     DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("NXP_DUAL_UICC_ENABLE : 0x%02x", uicc_mode);
   } else {
     uicc_mode = 0x00;
@@ -3283,8 +3611,8 @@ void uicc_eeprom_set_config(uint8_t* config_rsp) {
   uint8_t config_status = NCI_STATUS_FAILED;
   uint8_t retry_count = 0;
 
-  if (NfcConfig::hasKey(NAME_NXP_DUAL_UICC_ENABLE)) {
-    uicc_mode = NfcConfig::getUnsigned(NAME_NXP_DUAL_UICC_ENABLE);
+  if (NfcConfig::hasKey(KEY_NXP_DUAL_UICC_ENABLE)) {
+    uicc_mode = NfcConfig::getUnsigned(KEY_NXP_DUAL_UICC_ENABLE);
     DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("NXP_DUAL_UICC_ENABLE : 0x%02x", uicc_mode);
   } else {
     uicc_mode = 0x00;
@@ -212,6 +212,75 @@ void nfc_stop_timer(TIMER_LIST_ENT* p_tle) {
   }
 }
 
+/* GKI ticks per quick timer tick */
+#define NFC_QUICK_TIMER_GKI_TICKS \
+  (GKI_SECS_TO_TICKS(1) / QUICK_TIMER_TICKS_PER_SEC)
+
+#if (TICKS_PER_SEC < QUICK_TIMER_TICKS_PER_SEC) || \
+    (TICKS_PER_SEC % QUICK_TIMER_TICKS_PER_SEC != 0)
+#error "QUICK_TIMER_TICKS_PER_SEC must divide TICKS_PER_SEC"
+#endif
+
+/*******************************************************************************
+**
+** Function         nfc_sync_quick_timer
+**
+** Description      Advances the quick timer list to the current time. The
+**                  list is not updated every quick timer tick, only when its
+**                  GKI timer expires or an entry is started.
+**
+** Returns          void
+**
+*******************************************************************************/
+static void nfc_sync_quick_timer(void) {
+  uint32_t now = GKI_get_tick_count();
+  uint32_t units;
+
+  if (nfc_cb.quick_timer_queue.p_first == NULL) {
+    nfc_cb.quick_timer_tick = now;
+    return;
+  }
+
+  units = (now - nfc_cb.quick_timer_tick) / NFC_QUICK_TIMER_GKI_TICKS;
+  if (units > INT32_MAX) units = INT32_MAX;
+  nfc_cb.quick_timer_tick += units * NFC_QUICK_TIMER_GKI_TICKS;
+  GKI_update_timer_list(&nfc_cb.quick_timer_queue, (int32_t)units);
+}
+
+/*******************************************************************************
+**
+** Function         nfc_arm_quick_timer
+**
+** Description      Starts the GKI quick timer for the first expiry of the
+**                  quick timer list, or stops it if the list is empty. The
+**                  timer is one-shot, so the NFC task does not wake up every
+**                  quick timer tick.
+**
+** Returns          void
+**
+*******************************************************************************/
+static void nfc_arm_quick_timer(void) {
+  int32_t units = GKI_get_next_expiry(&nfc_cb.quick_timer_queue);
+  uint32_t elapsed;
+  uint32_t ticks;
+
+  if (units < 0) {
+    GKI_stop_timer(NFC_QUICK_TIMER_ID);
+    return;
+  }
+
+  /* part of a quick timer tick may have gone since the list time */
+  elapsed = GKI_get_tick_count() - nfc_cb.quick_timer_tick;
+  ticks = (uint32_t)units * NFC_QUICK_TIMER_GKI_TICKS;
+  if (ticks > elapsed)
+    ticks -= elapsed;
+  else
+    ticks = 1;
+  if (ticks > INT32_MAX) ticks = INT32_MAX;
+
+  GKI_start_timer(NFC_QUICK_TIMER_ID, (int32_t)ticks, false);
+}
+
 /*******************************************************************************
 **
 ** Function         nfc_start_quick_timer
@@ -229,30 +298,39 @@ void nfc_start_quick_timer(TIMER_LIST_ENT* p_tle, uint16_t type,
                            uint32_t timeout) {
   NFC_HDR* p_msg;
 
-  /* if timer list is currently empty, start periodic GKI timer */
-  if (nfc_cb.quick_timer_queue.p_first == NULL) {
-    /* if timer starts on other than NFC task (scritp wrapper) */
-    if (GKI_get_taskid() != NFC_TASK) {
-      /* post event to start timer in NFC task */
-      p_msg = (NFC_HDR*)GKI_getbuf(NFC_HDR_SIZE);
-      if (p_msg != NULL) {
-        p_msg->event = BT_EVT_TO_START_QUICK_TIMER;
-        GKI_send_msg(NFC_TASK, NFC_MBOX_ID, p_msg);
-      }
-    } else {
-      /* Quick-timer is required for LLCP */
-      GKI_start_timer(NFC_QUICK_TIMER_ID,
-                      ((GKI_SECS_TO_TICKS(1) / QUICK_TIMER_TICKS_PER_SEC)),
-                      true);
+  /* if timer starts on other than NFC task (scritp wrapper) */
+  if (GKI_get_taskid() != NFC_TASK) {
+    /* the list is only updated in NFC task, its time restarts when empty */
+    if (nfc_cb.quick_timer_queue.p_first == NULL)
+      nfc_cb.quick_timer_tick = GKI_get_tick_count();
+
+    GKI_remove_from_timer_list(&nfc_cb.quick_timer_queue, p_tle);
+
+    p_tle->event = type;
+    p_tle->ticks = timeout; /* Save the number of ticks for the timer */
+
+    GKI_add_to_timer_list(&nfc_cb.quick_timer_queue, p_tle);
+
+    /* post event to arm the timer in NFC task */
+    p_msg = (NFC_HDR*)GKI_getbuf(NFC_HDR_SIZE);
+    if (p_msg != NULL) {
+      p_msg->event = BT_EVT_TO_START_QUICK_TIMER;
+      GKI_send_msg(NFC_TASK, NFC_MBOX_ID, p_msg);
     }
+    return;
   }
 
+  /* the timeout counts from now, not from the last update of the list */
+  nfc_sync_quick_timer();
+
   GKI_remove_from_timer_list(&nfc_cb.quick_timer_queue, p_tle);
 
   p_tle->event = type;
   p_tle->ticks = timeout; /* Save the number of ticks for the timer */
 
   GKI_add_to_timer_list(&nfc_cb.quick_timer_queue, p_tle);
+
+  nfc_arm_quick_timer();
 }
 
 /*******************************************************************************
@@ -267,7 +345,7 @@ void nfc_start_quick_timer(TIMER_LIST_ENT* p_tle, uint16_t type,
 void nfc_stop_quick_timer(TIMER_LIST_ENT* p_tle) {
   GKI_remove_from_timer_list(&nfc_cb.quick_timer_queue, p_tle);
 
-  /* if timer list is empty stop periodic GKI timer */
+  /* if timer list is empty stop the GKI timer */
   if (nfc_cb.quick_timer_queue.p_first == NULL) {
     GKI_stop_timer(NFC_QUICK_TIMER_ID);
   }
@@ -285,7 +363,7 @@ void nfc_stop_quick_timer(TIMER_LIST_ENT* p_tle) {
 void nfc_process_quick_timer_evt(void) {
   TIMER_LIST_ENT* p_tle;
 
-  GKI_update_timer_list(&nfc_cb.quick_timer_queue, 1);
+  nfc_sync_quick_timer();
 
   while ((nfc_cb.quick_timer_queue.p_first) &&
          (!nfc_cb.quick_timer_queue.p_first->ticks)) {
@@ -352,10 +430,7 @@ void nfc_process_quick_timer_evt(void) {
     }
   }
 
-  /* if timer list is empty stop periodic GKI timer */
-  if (nfc_cb.quick_timer_queue.p_first == NULL) {
-    GKI_stop_timer(NFC_QUICK_TIMER_ID);
-  }
+  nfc_arm_quick_timer();
 }
 
 /*******************************************************************************
@@ -457,9 +532,7 @@ uint32_t nfc_task(__attribute__((unused)) uint32_t arg) {
 
           case BT_EVT_TO_START_QUICK_TIMER:
             /* Quick-timer is required for LLCP */
-            GKI_start_timer(
-                NFC_QUICK_TIMER_ID,
-                ((GKI_SECS_TO_TICKS(1) / QUICK_TIMER_TICKS_PER_SEC)), true);
+            nfc_arm_quick_timer();
             break;
 
           case BT_EVT_TO_NFC_MSGS:
@@ -161,6 +161,9 @@ void nfc_free_conn_cb(tNFC_CONN_CB* p_cb) {
 
   while ((p_buf = GKI_dequeue(&p_cb->rx_q)) != NULL) GKI_freebuf(p_buf);
 
+#if (NXP_EXTNS == TRUE)
+  nfc_ncif_release_dwp_packet(p_cb);
+#endif
   while ((p_buf = GKI_dequeue(&p_cb->tx_q)) != NULL) GKI_freebuf(p_buf);
 
   nfc_cb.conn_id[p_cb->conn_id] = 0;
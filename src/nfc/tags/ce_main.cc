@@ -47,6 +47,7 @@ void ce_init(void) {
 
   /* Initialize tag-specific fields of ce control block */
   ce_t3t_init();
+  ce_t4t_init();
 }
 
 /*******************************************************************************
@@ -98,6 +98,82 @@ static bool ce_t4t_send_status(uint16_t status) {
   return true;
 }
 
+/*******************************************************************************
+**
+** Function         ce_t4t_parse_body
+**
+** Description      Parse the body of C-APDU following P2: Lc, data and Le, in
+**                  short or extended length (ISO/IEC 7816-4 cases 1 to 4).
+**                  Le of 00 (short) or 0000 (extended) is returned as
+**                  T4T_SHORT_LE_ALL or T4T_EXT_LE_ALL.
+**
+**                  p_body:   the body
+**                  body_len: length of the body
+**                  p_lc:     Lc, 0 if absent
+**                  pp_data:  command data, NULL if absent
+**                  p_le:     Le, 0 if absent
+**
+** Returns          false, if the body length does not match Lc and Le
+**
+*******************************************************************************/
+static bool ce_t4t_parse_body(uint8_t* p_body, uint16_t body_len,
+                              uint16_t* p_lc, uint8_t** pp_data,
+                              uint32_t* p_le) {
+  uint16_t lc, le;
+
+  *p_lc = 0;
+  *pp_data = NULL;
+  *p_le = 0;
+
+  if (body_len == 0) return true;
+
+  if (body_len == 1) {
+    /* short Le */
+    *p_le = (*p_body) ? (*p_body) : T4T_SHORT_LE_ALL;
+    return true;
+  }
+
+  if (*p_body) {
+    /* short Lc and data, then short Le if any */
+    lc = *p_body++;
+    if (body_len == 1 + lc) {
+      *p_le = 0;
+    } else if (body_len == 2 + lc) {
+      *p_le = p_body[lc] ? p_body[lc] : T4T_SHORT_LE_ALL;
+    } else {
+      return false;
+    }
+    *p_lc = lc;
+    *pp_data = p_body;
+    return true;
+  }
+
+  if (body_len < 3) return false;
+  p_body++;
+
+  if (body_len == 3) {
+    /* extended Le */
+    BE_STREAM_TO_UINT16(le, p_body);
+    *p_le = le ? le : T4T_EXT_LE_ALL;
+    return true;
+  }
+
+  /* extended Lc and data, then extended Le without its 00 if any */
+  BE_STREAM_TO_UINT16(lc, p_body);
+  if (lc == 0) return false;
+  if (body_len == 3 + lc) {
+    *p_le = 0;
+  } else if (body_len == 5 + lc) {
+    le = (p_body[lc] << 8) | p_body[lc + 1];
+    *p_le = le ? le : T4T_EXT_LE_ALL;
+  } else {
+    return false;
+  }
+  *p_lc = lc;
+  *pp_data = p_body;
+  return true;
+}
+
 /*******************************************************************************
 **
 ** Function         ce_t4t_select_file
@@ -152,7 +228,7 @@ static bool ce_t4t_select_file(uint16_t file_id) {
 ** Returns          true if success
 **
 *******************************************************************************/
-static bool ce_t4t_read_binary(uint16_t offset, uint8_t length) {
+static bool ce_t4t_read_binary(uint16_t offset, uint16_t length) {
   tCE_T4T_MEM* p_t4t = &ce_cb.mem.t4t;
   uint8_t* p_src = NULL, *p_dst;
   NFC_HDR* p_r_apdu;
@@ -236,7 +312,7 @@ static bool ce_t4t_read_binary(uint16_t offset, uint8_t length) {
 ** Returns          true if success
 **
 *******************************************************************************/
-static bool ce_t4t_update_binary(uint16_t offset, uint8_t length,
+static bool ce_t4t_update_binary(uint16_t offset, uint16_t length,
                                  uint8_t* p_data) {
   tCE_T4T_MEM* p_t4t = &ce_cb.mem.t4t;
   uint8_t* p;
@@ -331,20 +407,23 @@ static void ce_t4t_set_version_in_cc(uint8_t version) {
 ** Function         ce_t4t_process_select_file_cmd
 **
 ** Description      This function processes Select Command by file ID.
+**                  body_len is the length of the command following P2.
 **
 ** Returns          true if success
 **
 *******************************************************************************/
-static bool ce_t4t_process_select_file_cmd(uint8_t* p_cmd) {
-  uint8_t data_len;
+static bool ce_t4t_process_select_file_cmd(uint8_t* p_cmd, uint16_t body_len) {
+  uint16_t data_len;
   uint16_t file_id, status_words;
+  uint32_t le;
 
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("ce_t4t_process_select_file_cmd ()");
 
   p_cmd++; /* skip P2 */
 
-  /* Lc Byte */
-  BE_STREAM_TO_UINT8(data_len, p_cmd);
+  /* Lc, File ID and Le */
+  if (!ce_t4t_parse_body(p_cmd, body_len, &data_len, &p_cmd, &le))
+    data_len = 0;
 
   if (data_len == T4T_FILE_ID_SIZE) {
     /* File ID */
@@ -374,22 +453,32 @@ static bool ce_t4t_process_select_file_cmd(uint8_t* p_cmd) {
 ** Function         ce_t4t_process_select_app_cmd
 **
 ** Description      This function processes Select Command by AID.
+**                  body_len is the length of the command following P2.
 **
 ** Returns          none
 **
 *******************************************************************************/
-static void ce_t4t_process_select_app_cmd(uint8_t* p_cmd, NFC_HDR* p_c_apdu) {
-  uint8_t data_len;
+static void ce_t4t_process_select_app_cmd(uint8_t* p_cmd, uint16_t body_len,
+                                          NFC_HDR* p_c_apdu) {
+  uint16_t data_len;
   uint16_t status_words = 0x0000; /* invalid status words */
   tCE_DATA ce_data;
-  uint8_t xx;
+  uint8_t aid_handle;
+  uint32_t le;
 
   DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("ce_t4t_process_select_app_cmd ()");
 
   p_cmd++; /* skip P2 */
 
-  /* Lc Byte */
-  BE_STREAM_TO_UINT8(data_len, p_cmd);
+  /* Lc, AID and Le */
+  if ((!ce_t4t_parse_body(p_cmd, body_len, &data_len, &p_cmd, &le)) ||
+      (data_len > 0xFF)) {
+    LOG(ERROR) << StringPrintf(
+        "ce_t4t_process_select_app_cmd (): Bad length of SELECT");
+    GKI_freebuf(p_c_apdu);
+    ce_t4t_send_status(T4T_RSP_WRONG_LENGTH);
+    return;
+  }
 
 #if (CE_TEST_INCLUDED == true)
   if (mapping_aid_test_enabled) {
@@ -404,19 +493,16 @@ static void ce_t4t_process_select_app_cmd(uint8_t* p_cmd, NFC_HDR* p_c_apdu) {
 #endif
 
   /*
-  ** Compare AIDs registered by applications
+  ** Look up AIDs registered by applications
   ** if found, use callback of the application
   ** otherwise, return error and maintain the same status
   */
-  ce_cb.mem.t4t.selected_aid_idx = CE_T4T_MAX_REG_AID;
-  for (xx = 0; xx < CE_T4T_MAX_REG_AID; xx++) {
-    if ((ce_cb.mem.t4t.reg_aid[xx].aid_len > 0) &&
-        (ce_cb.mem.t4t.reg_aid[xx].aid_len == data_len) &&
-        (!(memcmp(ce_cb.mem.t4t.reg_aid[xx].aid, p_cmd, data_len)))) {
-      ce_cb.mem.t4t.selected_aid_idx = xx;
-      break;
-    }
-  }
+  aid_handle =
+      ce_t4t_aid_index_lookup(&ce_cb.mem.t4t.aid_index, data_len, p_cmd);
+  if (aid_handle < CE_T4T_MAX_REG_AID)
+    ce_cb.mem.t4t.selected_aid_idx = aid_handle;
+  else
+    ce_cb.mem.t4t.selected_aid_idx = CE_T4T_MAX_REG_AID;
 
   /* if found matched AID */
   if (ce_cb.mem.t4t.selected_aid_idx < CE_T4T_MAX_REG_AID) {
@@ -459,7 +545,7 @@ static void ce_t4t_process_select_app_cmd(uint8_t* p_cmd, NFC_HDR* p_c_apdu) {
           "ce_t4t_process_select_app_cmd (): Not found matched AID");
       status_words = T4T_RSP_NOT_FOUND;
     }
-  } else if (ce_cb.mem.t4t.p_wildcard_aid_cback) {
+  } else if (aid_handle == CE_T4T_WILDCARD_AID_HANDLE) {
     ce_cb.mem.t4t.status &= ~(CE_T4T_STATUS_CC_FILE_SELECTED);
     ce_cb.mem.t4t.status &= ~(CE_T4T_STATUS_NDEF_SELECTED);
     ce_cb.mem.t4t.status &= ~(CE_T4T_STATUS_T4T_APP_SELECTED);
@@ -501,6 +587,22 @@ static void ce_t4t_process_select_app_cmd(uint8_t* p_cmd, NFC_HDR* p_c_apdu) {
   return;
 }
 
+/*******************************************************************************
+**
+** Function         ce_t4t_init
+**
+** Description      Initialize tag-specific fields of ce control block
+**
+** Returns          none
+**
+*******************************************************************************/
+void ce_t4t_init(void) {
+  tCE_T4T_MEM* p_t4t = &ce_cb.mem.t4t;
+
+  ce_t4t_aid_index_init(&p_t4t->aid_index, p_t4t->aid_table,
+                        p_t4t->aid_offset, CE_T4T_MAX_REG_AID + 1);
+}
+
 /*******************************************************************************
 **
 ** Function         ce_t4t_process_timeout
@@ -544,7 +646,8 @@ static void ce_t4t_data_cback(uint8_t conn_id, tNFC_CONN_EVT event,
   NFC_HDR* p_c_apdu;
   uint8_t* p_cmd;
   uint8_t cla, instruct, select_type = 0;
-  uint16_t offset, max_file_size, length;
+  uint16_t offset, max_file_size, length, lc, body_len = 0;
+  uint32_t le;
   tCE_DATA ce_data;
 
   if (event == NFC_DEACTIVATE_CEVT) {
@@ -561,6 +664,10 @@ static void ce_t4t_data_cback(uint8_t conn_id, tNFC_CONN_EVT event,
 
   p_cmd = (uint8_t*)(p_c_apdu + 1) + p_c_apdu->offset;
 
+  /* Lc, data and Le follow CLA, INS, P1 and P2 */
+  if (p_c_apdu->len > T4T_CMD_MIN_HDR_SIZE)
+    body_len = p_c_apdu->len - T4T_CMD_MIN_HDR_SIZE;
+
   /* Class Byte */
   BE_STREAM_TO_UINT8(cla, p_cmd);
 
@@ -581,7 +688,7 @@ static void ce_t4t_data_cback(uint8_t conn_id, tNFC_CONN_EVT event,
     BE_STREAM_TO_UINT8(select_type, p_cmd);
 
     if (select_type == T4T_CMD_P1_SELECT_BY_NAME) {
-      ce_t4t_process_select_app_cmd(p_cmd, p_c_apdu);
+      ce_t4t_process_select_app_cmd(p_cmd, body_len, p_c_apdu);
       return;
     }
   }
@@ -617,7 +724,7 @@ static void ce_t4t_data_cback(uint8_t conn_id, tNFC_CONN_EVT event,
     if (instruct == T4T_CMD_INS_SELECT) {
       /* P1 Byte is already parsed */
       if (select_type == T4T_CMD_P1_SELECT_BY_FILE_ID) {
-        ce_t4t_process_select_file_cmd(p_cmd);
+        ce_t4t_process_select_file_cmd(p_cmd, body_len);
       } else {
         LOG(ERROR) << StringPrintf("CET4T: Bad P1 byte (0x%02X)", select_type);
         ce_t4t_send_status(T4T_RSP_WRONG_PARAMS);
@@ -632,15 +739,26 @@ static void ce_t4t_data_cback(uint8_t conn_id, tNFC_CONN_EVT event,
         }
 
         BE_STREAM_TO_UINT16(offset, p_cmd); /* Offset */
-        BE_STREAM_TO_UINT8(length, p_cmd);  /* Le     */
+
+        /* Le, short or extended. Le asking for all bytes is served with as
+         * many as a R-APDU can carry. */
+        if ((!ce_t4t_parse_body(p_cmd, body_len, &lc, &p_cmd, &le)) ||
+            (lc != 0)) {
+          le = 0;
+        } else if (((le == T4T_SHORT_LE_ALL) || (le == T4T_EXT_LE_ALL)) &&
+                   (le > CE_T4T_MAX_LE)) {
+          le = CE_T4T_MAX_LE;
+        }
 
         /* check if valid parameters */
-        if ((uint32_t)length <= CE_T4T_MAX_LE) {
+        if (le <= CE_T4T_MAX_LE) {
+          length = (uint16_t)le;
+
           /* CE allows to read more than current file size but not max file size
            */
           if (length + offset > max_file_size) {
             if (offset < max_file_size) {
-              length = (uint8_t)(max_file_size - offset);
+              length = (uint16_t)(max_file_size - offset);
 
               DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
                   "CET4T: length is reduced to %d by max_file_size (%d)",
@@ -653,8 +771,8 @@ static void ce_t4t_data_cback(uint8_t conn_id, tNFC_CONN_EVT event,
             }
           }
         } else {
-          LOG(ERROR) << StringPrintf("CET4T: length (%d) must be less than MLe (%lu)",
-                          length, (unsigned long)CE_T4T_MAX_LE);
+          LOG(ERROR) << StringPrintf("CET4T: length (%u) must be less than MLe (%lu)",
+                          le, (unsigned long)CE_T4T_MAX_LE);
           length = 0;
         }
 
@@ -672,7 +790,12 @@ static void ce_t4t_data_cback(uint8_t conn_id, tNFC_CONN_EVT event,
         ce_t4t_send_status(T4T_RSP_CMD_NOT_ALLOWED);
       } else if (ce_cb.mem.t4t.status & CE_T4T_STATUS_NDEF_SELECTED) {
         BE_STREAM_TO_UINT16(offset, p_cmd); /* Offset */
-        BE_STREAM_TO_UINT8(length, p_cmd);  /* Lc     */
+
+        /* Lc and data, short or extended */
+        if (!ce_t4t_parse_body(p_cmd, body_len, &length, &p_cmd, &le)) {
+          LOG(ERROR) << StringPrintf("CET4T: Lc does not match the data");
+          length = 0;
+        }
 
         /* check if valid parameters */
         if ((uint32_t)length <= CE_T4T_MAX_LC) {
@@ -787,6 +910,7 @@ tNFC_STATUS CE_T4tSetLocalNDEFMsg(bool read_only, uint16_t ndef_msg_max,
 
   UINT16_TO_BE_STREAM(p, T4T_CC_FILE_MIN_LEN);
   UINT8_TO_BE_STREAM(p, T4T_MY_VERSION);
+  /* MLe and MLc, up to a CE buffer using extended length APDUs */
   UINT16_TO_BE_STREAM(p, CE_T4T_MAX_LE);
   UINT16_TO_BE_STREAM(p, CE_T4T_MAX_LC);
 
@@ -837,6 +961,34 @@ tNFC_STATUS CE_T4tSetLocalNDEFMsg(bool read_only, uint16_t ndef_msg_max,
 *******************************************************************************/
 tCE_T4T_AID_HANDLE CE_T4tRegisterAID(uint8_t aid_len, uint8_t* p_aid,
                                      tCE_CBACK* p_cback) {
+  return CE_T4tRegisterAIDMatch(aid_len, p_aid, CE_T4T_AID_MATCH_EXACT,
+                                p_cback);
+}
+
+/*******************************************************************************
+**
+** Function         CE_T4tRegisterAIDMatch
+**
+** Description      Register AID in CE T4T, selected as given by match
+**
+**                  aid_len: length of AID (up to NFC_MAX_AID_LEN)
+**                  p_aid:   AID
+**                  match:   CE_T4T_AID_MATCH_EXACT, the AID is selected
+**                           CE_T4T_AID_MATCH_PREFIX, an AID starting with
+**                           the AID is selected
+**                           CE_T4T_AID_MATCH_SUBSET, an AID the AID starts
+**                           with is selected
+**                  p_cback: Raw frame will be forwarded with CE_RAW_FRAME_EVT
+**
+**                  When several AIDs match a SELECT, the one matching all of
+**                  the selected AID is used, otherwise the longest prefix.
+**
+** Returns          tCE_T4T_AID_HANDLE if successful,
+**                  CE_T4T_AID_HANDLE_INVALID otherwisse
+**
+*******************************************************************************/
+tCE_T4T_AID_HANDLE CE_T4tRegisterAIDMatch(uint8_t aid_len, uint8_t* p_aid,
+                                          uint8_t match, tCE_CBACK* p_cback) {
   tCE_T4T_MEM* p_t4t = &ce_cb.mem.t4t;
   uint8_t xx;
 
@@ -854,6 +1006,13 @@ tCE_T4T_AID_HANDLE CE_T4tRegisterAID(uint8_t aid_len, uint8_t* p_aid,
       return CE_T4T_AID_HANDLE_INVALID;
     }
 
+    /* The wildcard AID is the prefix of all AIDs */
+    if (!ce_t4t_aid_index_add(&p_t4t->aid_index, 0, NULL,
+                              CE_T4T_AID_MATCH_PREFIX,
+                              CE_T4T_WILDCARD_AID_HANDLE)) {
+      return CE_T4T_AID_HANDLE_INVALID;
+    }
+
     DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
         "CE_T4tRegisterAID (): handle 0x%02x registered (for wildcard AID)",
         CE_T4T_WILDCARD_AID_HANDLE);
@@ -861,8 +1020,9 @@ tCE_T4T_AID_HANDLE CE_T4tRegisterAID(uint8_t aid_len, uint8_t* p_aid,
     return CE_T4T_WILDCARD_AID_HANDLE;
   }
 
-  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("CE_T4tRegisterAID () AID [%02X%02X%02X%02X...], %d bytes",
-                *p_aid, *(p_aid + 1), *(p_aid + 2), *(p_aid + 3), aid_len);
+  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
+      "CE_T4tRegisterAID () AID [%02X%02X%02X%02X...], %d bytes, match %d",
+      *p_aid, *(p_aid + 1), *(p_aid + 2), *(p_aid + 3), aid_len, match);
 
   if (aid_len > NFC_MAX_AID_LEN) {
     LOG(ERROR) << StringPrintf("CE_T4tRegisterAID (): AID is up to %d bytes",
@@ -870,35 +1030,39 @@ tCE_T4T_AID_HANDLE CE_T4tRegisterAID(uint8_t aid_len, uint8_t* p_aid,
     return CE_T4T_AID_HANDLE_INVALID;
   }
 
+  if (match > CE_T4T_AID_MATCH_SUBSET) {
+    LOG(ERROR) << StringPrintf("CE_T4tRegisterAID (): unknown match %d",
+                               match);
+    return CE_T4T_AID_HANDLE_INVALID;
+  }
+
   if (p_cback == NULL) {
     LOG(ERROR) << StringPrintf("CE_T4tRegisterAID (): callback must be provided");
     return CE_T4T_AID_HANDLE_INVALID;
   }
 
-  for (xx = 0; xx < CE_T4T_MAX_REG_AID; xx++) {
-    if ((p_t4t->reg_aid[xx].aid_len == aid_len) &&
-        (!(memcmp(p_t4t->reg_aid[xx].aid, p_aid, aid_len)))) {
-      LOG(ERROR) << StringPrintf("CE_T4tRegisterAID (): already registered");
-      return CE_T4T_AID_HANDLE_INVALID;
-    }
+  if (ce_t4t_aid_index_find(&p_t4t->aid_index, aid_len, p_aid, match) !=
+      CE_T4T_AID_INDEX_NONE) {
+    LOG(ERROR) << StringPrintf("CE_T4tRegisterAID (): already registered");
+    return CE_T4T_AID_HANDLE_INVALID;
   }
 
   for (xx = 0; xx < CE_T4T_MAX_REG_AID; xx++) {
-    if (p_t4t->reg_aid[xx].aid_len == 0) {
-      p_t4t->reg_aid[xx].aid_len = aid_len;
-      p_t4t->reg_aid[xx].p_cback = p_cback;
-      memcpy(p_t4t->reg_aid[xx].aid, p_aid, aid_len);
-      break;
-    }
+    if (p_t4t->reg_aid[xx].aid_len == 0) break;
   }
 
-  if (xx >= CE_T4T_MAX_REG_AID) {
+  if ((xx >= CE_T4T_MAX_REG_AID) ||
+      (!ce_t4t_aid_index_add(&p_t4t->aid_index, aid_len, p_aid, match, xx))) {
     LOG(ERROR) << StringPrintf("CE_T4tRegisterAID (): No resource");
     return CE_T4T_AID_HANDLE_INVALID;
-  } else {
-    DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("CE_T4tRegisterAID (): handle 0x%02x registered", xx);
   }
 
+  p_t4t->reg_aid[xx].aid_len = aid_len;
+  p_t4t->reg_aid[xx].match = match;
+  p_t4t->reg_aid[xx].p_cback = p_cback;
+  memcpy(p_t4t->reg_aid[xx].aid, p_aid, aid_len);
+  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf("CE_T4tRegisterAID (): handle 0x%02x registered", xx);
+
   return (xx);
 }
 
@@ -920,6 +1084,8 @@ extern void CE_T4tDeregisterAID(tCE_T4T_AID_HANDLE aid_handle) {
   if (aid_handle == CE_T4T_WILDCARD_AID_HANDLE) {
     if (p_t4t->p_wildcard_aid_cback != NULL) {
       p_t4t->p_wildcard_aid_cback = NULL;
+      ce_t4t_aid_index_remove(&p_t4t->aid_index, 0, NULL,
+                              CE_T4T_AID_MATCH_PREFIX);
     } else {
       LOG(ERROR) << StringPrintf("CE_T4tDeregisterAID (): Invalid handle");
     }
@@ -931,8 +1097,91 @@ extern void CE_T4tDeregisterAID(tCE_T4T_AID_HANDLE aid_handle) {
       (p_t4t->reg_aid[aid_handle].aid_len == 0)) {
     LOG(ERROR) << StringPrintf("CE_T4tDeregisterAID (): Invalid handle");
   } else {
+    ce_t4t_aid_index_remove(&p_t4t->aid_index,
+                            p_t4t->reg_aid[aid_handle].aid_len,
+                            p_t4t->reg_aid[aid_handle].aid,
+                            p_t4t->reg_aid[aid_handle].match);
     p_t4t->reg_aid[aid_handle].aid_len = 0;
     p_t4t->reg_aid[aid_handle].p_cback = NULL;
   }
 }
 
+/*******************************************************************************
+**
+** Function         CE_T4tSaveAIDs
+**
+** Description      Copy the registered AIDs in their serialized form
+**
+** Returns          the number of bytes copied
+**
+*******************************************************************************/
+uint16_t CE_T4tSaveAIDs(uint8_t* p_table) {
+  tCE_T4T_MEM* p_t4t = &ce_cb.mem.t4t;
+
+  memcpy(p_table, p_t4t->aid_table, p_t4t->aid_index.table_len);
+  return p_t4t->aid_index.table_len;
+}
+
+/*******************************************************************************
+**
+** Function         CE_T4tLoadAIDs
+**
+** Description      Go back to the AIDs saved by CE_T4tSaveAIDs
+**
+** Returns          false, if the table is not valid
+**
+*******************************************************************************/
+bool CE_T4tLoadAIDs(const uint8_t* p_table, uint16_t table_len) {
+  tCE_T4T_MEM* p_t4t = &ce_cb.mem.t4t;
+  uint8_t cur_table[CE_T4T_AID_SAVE_SIZE];
+  uint16_t cur_len;
+  bool in_table[CE_T4T_MAX_REG_AID + 1];
+  uint16_t xx;
+  const uint8_t* p_rec;
+  uint8_t handle;
+
+  cur_len = CE_T4tSaveAIDs(cur_table);
+  memset(in_table, 0, sizeof(in_table));
+
+  if (!ce_t4t_aid_index_load(&p_t4t->aid_index, p_table, table_len)) {
+    ce_t4t_aid_index_load(&p_t4t->aid_index, cur_table, cur_len);
+    return false;
+  }
+
+  /* Each record must be an AID still registered with its handle, once */
+  for (xx = 0; xx < p_t4t->aid_index.num_aids; xx++) {
+    p_rec = &p_t4t->aid_table[p_t4t->aid_offset[xx]];
+    handle = p_rec[CE_T4T_AID_REC_HANDLE];
+    if ((handle > CE_T4T_WILDCARD_AID_HANDLE) || in_table[handle] ||
+        ((handle == CE_T4T_WILDCARD_AID_HANDLE)
+             ? ((p_t4t->p_wildcard_aid_cback == NULL) ||
+                (p_rec[CE_T4T_AID_REC_LEN] != 0))
+             : ((p_t4t->reg_aid[handle].aid_len == 0) ||
+                (p_t4t->reg_aid[handle].aid_len !=
+                 p_rec[CE_T4T_AID_REC_LEN]) ||
+                (p_t4t->reg_aid[handle].match !=
+                 p_rec[CE_T4T_AID_REC_MATCH]) ||
+                (memcmp(p_t4t->reg_aid[handle].aid,
+                        p_rec + CE_T4T_AID_REC_HDR_LEN,
+                        p_rec[CE_T4T_AID_REC_LEN]) != 0)))) {
+      LOG(ERROR) << StringPrintf(
+          "CE_T4tLoadAIDs (): handle 0x%02x is not registered", handle);
+      ce_t4t_aid_index_load(&p_t4t->aid_index, cur_table, cur_len);
+      return false;
+    }
+    in_table[handle] = true;
+  }
+
+  /* Free the handles registered since the save */
+  for (xx = 0; xx < CE_T4T_MAX_REG_AID; xx++) {
+    if (!in_table[xx]) {
+      p_t4t->reg_aid[xx].aid_len = 0;
+      p_t4t->reg_aid[xx].p_cback = NULL;
+    }
+  }
+  if (!in_table[CE_T4T_WILDCARD_AID_HANDLE])
+    p_t4t->p_wildcard_aid_cback = NULL;
+
+  return true;
+}
+
@@ -0,0 +1,356 @@
+/******************************************************************************
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/******************************************************************************
+ *
+ *  This file contains the AID index of Card Emulation Type 4 Tag
+ *
+ ******************************************************************************/
+#include <string.h>
+
+#include <android-base/stringprintf.h>
+#include <base/logging.h>
+
+#include "ce_t4t_aid.h"
+
+using android::base::StringPrintf;
+
+extern bool nfc_debug_enabled;
+
+/*******************************************************************************
+**
+** Function         ce_t4t_aid_cmp
+**
+** Description      Compare a record with an AID and match, in the order of
+**                  the table: by AID bytes, a shorter AID first when it
+**                  starts the other, then by match
+**
+** Returns          <0, 0 or >0 as the record sorts before, with or after
+**
+*******************************************************************************/
+static int ce_t4t_aid_cmp(const uint8_t* p_rec, uint8_t aid_len,
+                          const uint8_t* p_aid, uint8_t match) {
+  uint8_t rec_len = p_rec[CE_T4T_AID_REC_LEN];
+  uint8_t len = (rec_len < aid_len) ? rec_len : aid_len;
+  int cmp = len ? memcmp(p_rec + CE_T4T_AID_REC_HDR_LEN, p_aid, len) : 0;
+
+  if (cmp != 0) return cmp;
+  if (rec_len != aid_len) return (int)rec_len - aid_len;
+  return (int)p_rec[CE_T4T_AID_REC_MATCH] - match;
+}
+
+/*******************************************************************************
+**
+** Function         ce_t4t_aid_lower_bound
+**
+** Description      Binary search of the first record not before an AID
+**
+** Returns          index of the record, num_aids if there is none
+**
+*******************************************************************************/
+static uint16_t ce_t4t_aid_lower_bound(const tCE_T4T_AID_INDEX* p_idx,
+                                       uint8_t aid_len, const uint8_t* p_aid,
+                                       uint8_t match) {
+  uint16_t lo = 0, hi = p_idx->num_aids;
+
+  while (lo < hi) {
+    uint16_t mid = lo + (hi - lo) / 2;
+    if (ce_t4t_aid_cmp(&p_idx->p_table[p_idx->p_offset[mid]], aid_len, p_aid,
+                       match) < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+/*******************************************************************************
+**
+** Function         ce_t4t_aid_search
+**
+** Description      Binary search of a record
+**
+** Returns          index of the record, num_aids if it is not in the table
+**
+*******************************************************************************/
+static uint16_t ce_t4t_aid_search(const tCE_T4T_AID_INDEX* p_idx,
+                                  uint8_t aid_len, const uint8_t* p_aid,
+                                  uint8_t match) {
+  uint16_t xx = ce_t4t_aid_lower_bound(p_idx, aid_len, p_aid, match);
+
+  if ((xx < p_idx->num_aids) &&
+      (ce_t4t_aid_cmp(&p_idx->p_table[p_idx->p_offset[xx]], aid_len, p_aid,
+                      match) == 0))
+    return xx;
+  return p_idx->num_aids;
+}
+
+/*******************************************************************************
+**
+** Function         ce_t4t_aid_count
+**
+** Description      Count the prefix lengths and subsets in the table
+**
+** Returns          void
+**
+*******************************************************************************/
+static void ce_t4t_aid_count(tCE_T4T_AID_INDEX* p_idx) {
+  p_idx->prefix_lens = 0;
+  p_idx->num_subset = 0;
+  for (uint16_t xx = 0; xx < p_idx->num_aids; xx++) {
+    const uint8_t* p_rec = &p_idx->p_table[p_idx->p_offset[xx]];
+    if (p_rec[CE_T4T_AID_REC_MATCH] == CE_T4T_AID_MATCH_PREFIX)
+      p_idx->prefix_lens |= 1u << p_rec[CE_T4T_AID_REC_LEN];
+    else if (p_rec[CE_T4T_AID_REC_MATCH] == CE_T4T_AID_MATCH_SUBSET)
+      p_idx->num_subset++;
+  }
+}
+
+/*******************************************************************************
+**
+** Function         ce_t4t_aid_index_init
+**
+** Description      Start an empty index in the given storage: p_table of
+**                  CE_T4T_AID_TABLE_SIZE(max_aids) bytes and p_offset of
+**                  max_aids entries
+**
+** Returns          void
+**
+*******************************************************************************/
+void ce_t4t_aid_index_init(tCE_T4T_AID_INDEX* p_idx, uint8_t* p_table,
+                           uint16_t* p_offset, uint16_t max_aids) {
+  p_idx->p_table = p_table;
+  p_idx->p_offset = p_offset;
+  p_idx->max_aids = max_aids;
+  p_idx->num_aids = 0;
+  p_idx->table_len = 0;
+  p_idx->num_subset = 0;
+  p_idx->prefix_lens = 0;
+}
+
+/*******************************************************************************
+**
+** Function         ce_t4t_aid_index_add
+**
+** Description      Add an AID of up to NCI_MAX_AID_LEN bytes with its match
+**                  and handle. An AID of 0 bytes with CE_T4T_AID_MATCH_PREFIX
+**                  matches any SELECT.
+**
+** Returns          false, if the AID is already in the index with this match,
+**                  or the index is full
+**
+*******************************************************************************/
+bool ce_t4t_aid_index_add(tCE_T4T_AID_INDEX* p_idx, uint8_t aid_len,
+                          const uint8_t* p_aid, uint8_t match,
+                          uint8_t handle) {
+  uint16_t xx, offset;
+  uint8_t rec_len = CE_T4T_AID_REC_HDR_LEN + aid_len;
+
+  if ((aid_len > NCI_MAX_AID_LEN) || (match > CE_T4T_AID_MATCH_SUBSET)) {
+    LOG(ERROR) << StringPrintf("ce_t4t_aid_index_add bad AID len:%d match:%d",
+                               aid_len, match);
+    return false;
+  }
+  if (p_idx->num_aids >= p_idx->max_aids) {
+    LOG(ERROR) << StringPrintf("ce_t4t_aid_index_add index is full (%d)",
+                               p_idx->max_aids);
+    return false;
+  }
+
+  xx = ce_t4t_aid_lower_bound(p_idx, aid_len, p_aid, match);
+  if ((xx < p_idx->num_aids) &&
+      (ce_t4t_aid_cmp(&p_idx->p_table[p_idx->p_offset[xx]], aid_len, p_aid,
+                      match) == 0)) {
+    LOG(ERROR) << StringPrintf("ce_t4t_aid_index_add already registered");
+    return false;
+  }
+
+  /* Make room for the record and the offset at xx */
+  offset = (xx < p_idx->num_aids) ? p_idx->p_offset[xx] : p_idx->table_len;
+  memmove(&p_idx->p_table[offset + rec_len], &p_idx->p_table[offset],
+          p_idx->table_len - offset);
+  memmove(&p_idx->p_offset[xx + 1], &p_idx->p_offset[xx],
+          (p_idx->num_aids - xx) * sizeof(uint16_t));
+  p_idx->num_aids++;
+  p_idx->table_len += rec_len;
+  for (uint16_t yy = xx + 1; yy < p_idx->num_aids; yy++)
+    p_idx->p_offset[yy] += rec_len;
+
+  uint8_t* p_rec = &p_idx->p_table[offset];
+  p_rec[CE_T4T_AID_REC_LEN] = aid_len;
+  p_rec[CE_T4T_AID_REC_MATCH] = match;
+  p_rec[CE_T4T_AID_REC_HANDLE] = handle;
+  if (aid_len) memcpy(p_rec + CE_T4T_AID_REC_HDR_LEN, p_aid, aid_len);
+  p_idx->p_offset[xx] = offset;
+
+  if (match == CE_T4T_AID_MATCH_PREFIX)
+    p_idx->prefix_lens |= 1u << aid_len;
+  else if (match == CE_T4T_AID_MATCH_SUBSET)
+    p_idx->num_subset++;
+  return true;
+}
+
+/*******************************************************************************
+**
+** Function         ce_t4t_aid_index_remove
+**
+** Description      Remove an AID registered with this match
+**
+** Returns          false, if the AID is not in the index
+**
+*******************************************************************************/
+bool ce_t4t_aid_index_remove(tCE_T4T_AID_INDEX* p_idx, uint8_t aid_len,
+                             const uint8_t* p_aid, uint8_t match) {
+  uint16_t xx = ce_t4t_aid_search(p_idx, aid_len, p_aid, match);
+  uint16_t offset;
+  uint8_t rec_len = CE_T4T_AID_REC_HDR_LEN + aid_len;
+
+  if (xx == p_idx->num_aids) return false;
+
+  offset = p_idx->p_offset[xx];
+  memmove(&p_idx->p_table[offset], &p_idx->p_table[offset + rec_len],
+          p_idx->table_len - offset - rec_len);
+  memmove(&p_idx->p_offset[xx], &p_idx->p_offset[xx + 1],
+          (p_idx->num_aids - xx - 1) * sizeof(uint16_t));
+  p_idx->num_aids--;
+  p_idx->table_len -= rec_len;
+  for (uint16_t yy = xx; yy < p_idx->num_aids; yy++)
+    p_idx->p_offset[yy] -= rec_len;
+
+  ce_t4t_aid_count(p_idx);
+  return true;
+}
+
+/*******************************************************************************
+**
+** Function         ce_t4t_aid_index_find
+**
+** Description      Find an AID registered with this match
+**
+** Returns          its handle, or CE_T4T_AID_INDEX_NONE
+**
+*******************************************************************************/
+uint8_t ce_t4t_aid_index_find(const tCE_T4T_AID_INDEX* p_idx, uint8_t aid_len,
+                              const uint8_t* p_aid, uint8_t match) {
+  uint16_t xx = ce_t4t_aid_search(p_idx, aid_len, p_aid, match);
+
+  if (xx == p_idx->num_aids) return CE_T4T_AID_INDEX_NONE;
+  return p_idx->p_table[p_idx->p_offset[xx] + CE_T4T_AID_REC_HANDLE];
+}
+
+/*******************************************************************************
+**
+** Function         ce_t4t_aid_index_lookup
+**
+** Description      Find the registered AID that matches most of the selected
+**                  AID: an AID matching all of it (exact first, then the
+**                  first subset in AID order), otherwise the longest prefix.
+**
+** Returns          its handle, or CE_T4T_AID_INDEX_NONE
+**
+*******************************************************************************/
+uint8_t ce_t4t_aid_index_lookup(const tCE_T4T_AID_INDEX* p_idx,
+                                uint8_t aid_len, const uint8_t* p_aid) {
+  uint16_t xx;
+  int len;
+
+  /* The AIDs starting with the selected AID follow each other from there.
+   * Those of the same length match whatever their match, the exact one
+   * first; longer ones only if they are subsets. */
+  for (xx = ce_t4t_aid_lower_bound(p_idx, aid_len, p_aid,
+                                   CE_T4T_AID_MATCH_EXACT);
+       xx < p_idx->num_aids; xx++) {
+    const uint8_t* p_rec = &p_idx->p_table[p_idx->p_offset[xx]];
+    if ((p_rec[CE_T4T_AID_REC_LEN] < aid_len) ||
+        (aid_len && memcmp(p_rec + CE_T4T_AID_REC_HDR_LEN, p_aid, aid_len)))
+      break;
+    if ((p_rec[CE_T4T_AID_REC_LEN] == aid_len) ||
+        (p_rec[CE_T4T_AID_REC_MATCH] == CE_T4T_AID_MATCH_SUBSET))
+      return p_rec[CE_T4T_AID_REC_HANDLE];
+    if (p_idx->num_subset == 0) break;
+  }
+
+  /* Only the lengths prefixes are registered with are searched */
+  len = (aid_len > NCI_MAX_AID_LEN) ? NCI_MAX_AID_LEN : aid_len - 1;
+  for (; len >= 0; len--) {
+    if (!(p_idx->prefix_lens & (1u << len))) continue;
+    xx = ce_t4t_aid_search(p_idx, len, p_aid, CE_T4T_AID_MATCH_PREFIX);
+    if (xx < p_idx->num_aids)
+      return p_idx->p_table[p_idx->p_offset[xx] + CE_T4T_AID_REC_HANDLE];
+  }
+  return CE_T4T_AID_INDEX_NONE;
+}
+
+/*******************************************************************************
+**
+** Function         ce_t4t_aid_index_load
+**
+** Description      Replace the index with a table taken from p_idx->p_table
+**                  of another index. The records are checked to be valid
+**                  and sorted, so that the index is rebuilt in one pass.
+**
+** Returns          false, if the table is not valid. The index is then empty.
+**
+*******************************************************************************/
+bool ce_t4t_aid_index_load(tCE_T4T_AID_INDEX* p_idx, const uint8_t* p_table,
+                           uint16_t table_len) {
+  uint16_t offset = 0, prev = 0;
+
+  p_idx->num_aids = 0;
+  p_idx->table_len = 0;
+  p_idx->num_subset = 0;
+  p_idx->prefix_lens = 0;
+
+  if (table_len > CE_T4T_AID_TABLE_SIZE(p_idx->max_aids)) {
+    LOG(ERROR) << StringPrintf("ce_t4t_aid_index_load %d bytes for %d AIDs",
+                               table_len, p_idx->max_aids);
+    return false;
+  }
+  if (table_len) memmove(p_idx->p_table, p_table, table_len);
+
+  while (offset < table_len) {
+    const uint8_t* p_rec = &p_idx->p_table[offset];
+    if ((table_len - offset < CE_T4T_AID_REC_HDR_LEN) ||
+        (p_rec[CE_T4T_AID_REC_LEN] > NCI_MAX_AID_LEN) ||
+        (p_rec[CE_T4T_AID_REC_MATCH] > CE_T4T_AID_MATCH_SUBSET) ||
+        (table_len - offset - CE_T4T_AID_REC_HDR_LEN <
+         p_rec[CE_T4T_AID_REC_LEN]) ||
+        (p_idx->num_aids >= p_idx->max_aids) ||
+        ((p_idx->num_aids > 0) &&
+         (ce_t4t_aid_cmp(&p_idx->p_table[prev], p_rec[CE_T4T_AID_REC_LEN],
+                         p_rec + CE_T4T_AID_REC_HDR_LEN,
+                         p_rec[CE_T4T_AID_REC_MATCH]) >= 0))) {
+      LOG(ERROR) << StringPrintf("ce_t4t_aid_index_load bad record at %d",
+                                 offset);
+      p_idx->num_aids = 0;
+      p_idx->num_subset = 0;
+      p_idx->prefix_lens = 0;
+      return false;
+    }
+    if (p_rec[CE_T4T_AID_REC_MATCH] == CE_T4T_AID_MATCH_PREFIX)
+      p_idx->prefix_lens |= 1u << p_rec[CE_T4T_AID_REC_LEN];
+    else if (p_rec[CE_T4T_AID_REC_MATCH] == CE_T4T_AID_MATCH_SUBSET)
+      p_idx->num_subset++;
+    p_idx->p_offset[p_idx->num_aids++] = offset;
+    prev = offset;
+    offset += CE_T4T_AID_REC_HDR_LEN + p_rec[CE_T4T_AID_REC_LEN];
+  }
+  p_idx->table_len = table_len;
+
+  DLOG_IF(INFO, nfc_debug_enabled) << StringPrintf(
+      "ce_t4t_aid_index_load %d AIDs, %d bytes", p_idx->num_aids, table_len);
+  return true;
+}
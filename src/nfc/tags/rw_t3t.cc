@@ -81,7 +81,7 @@ extern bool nfc_debug_enabled;
   ((RW_T3T_TOUT_RESP * QUICK_TIMER_TICKS_PER_SEC) / 1000)
 #define RW_T3T_RAW_FRAME_CMD_TIMEOUT_TICKS \
   (RW_T3T_DEFAULT_CMD_TIMEOUT_TICKS * 4)
-#define RW_T3T_MIN_TIMEOUT_TICKS 10
+#define RW_T3T_MIN_TIMEOUT_TICKS ((100 * QUICK_TIMER_TICKS_PER_SEC) / 1000)
 
 /* Macro to extract major version from NDEF version byte */
 #define T3T_GET_MAJOR_VERSION(ver) (ver >> 4)
@@ -216,8 +216,10 @@ static uint32_t rw_t3t_check_timeout(uint16_t num_blocks) {
   uint32_t timeout;
   uint32_t extra;
 
-  timeout = (p_cb->check_tout_a + num_blocks * p_cb->check_tout_b) *
-            QUICK_TIMER_TICKS_PER_SEC / 1000000;
+  /* in 64 bits, the product overflows for long commands at 1ms ticks */
+  timeout = (uint32_t)(((uint64_t)p_cb->check_tout_a +
+                        (uint64_t)num_blocks * p_cb->check_tout_b) *
+                       QUICK_TIMER_TICKS_PER_SEC / 1000000);
   /* allow some extra time for driver */
   extra = (timeout / 10) + RW_T3T_MIN_TIMEOUT_TICKS;
   timeout += extra;
@@ -239,8 +241,10 @@ static uint32_t rw_t3t_update_timeout(uint16_t num_blocks) {
   uint32_t timeout;
   uint32_t extra;
 
-  timeout = (p_cb->update_tout_a + num_blocks * p_cb->update_tout_b) *
-            QUICK_TIMER_TICKS_PER_SEC / 1000000;
+  /* in 64 bits, the product overflows for long commands at 1ms ticks */
+  timeout = (uint32_t)(((uint64_t)p_cb->update_tout_a +
+                        (uint64_t)num_blocks * p_cb->update_tout_b) *
+                       QUICK_TIMER_TICKS_PER_SEC / 1000000);
   /* allow some extra time for driver */
   extra = (timeout / 10) + RW_T3T_MIN_TIMEOUT_TICKS;
   timeout += extra;
@@ -0,0 +1,122 @@
+#include <benchmark/benchmark.h>
+
+#include <string.h>
+
+#include <random>
+#include <vector>
+
+#include "ce_t4t_aid.h"
+
+bool nfc_debug_enabled = false;
+
+namespace {
+
+/* A wallet: state.range(0) payment and transit AIDs, a few of them
+ * registered as prefixes or subsets, and the SELECTs a reader sends */
+struct AidConfig {
+  std::vector<std::vector<uint8_t>> aids;
+  std::vector<uint8_t> matches;
+  std::vector<std::vector<uint8_t>> selects;
+  std::vector<uint8_t> table;
+  std::vector<uint16_t> offset;
+  tCE_T4T_AID_INDEX idx;
+
+  explicit AidConfig(int num_aids)
+      : table(CE_T4T_AID_TABLE_SIZE(num_aids)), offset(num_aids) {
+    std::mt19937 rng(num_aids);
+
+    for (int xx = 0; xx < num_aids; xx++) {
+      /* RID of 5 bytes, then the PIX */
+      std::vector<uint8_t> aid = {0xA0, 0x00, 0x00, (uint8_t)(rng() % 16),
+                                  (uint8_t)(rng() % 16)};
+      aid.resize(7 + rng() % 10);
+      for (size_t yy = 5; yy < aid.size(); yy++) aid[yy] = rng();
+      aids.push_back(aid);
+      matches.push_back((xx % 8) ? CE_T4T_AID_MATCH_EXACT
+                                 : (uint8_t)(1 + (xx / 8) % 2));
+    }
+    ce_t4t_aid_index_init(&idx, table.data(), offset.data(), num_aids);
+    for (int xx = 0; xx < num_aids; xx++)
+      ce_t4t_aid_index_add(&idx, aids[xx].size(), aids[xx].data(), matches[xx],
+                           xx % 0xFF);
+
+    /* Registered AIDs, longer AIDs and AIDs nobody registered */
+    for (int xx = 0; xx < 64; xx++) {
+      std::vector<uint8_t> aid = aids[rng() % num_aids];
+      if (xx % 4 == 1) aid.push_back(0x01);
+      if (xx % 4 == 2) aid.back() ^= 0xFF;
+      selects.push_back(aid);
+    }
+  }
+};
+
+/* SELECT dispatch through the index */
+void BM_AidLookupIndex(benchmark::State& state) {
+  AidConfig config(state.range(0));
+  size_t xx = 0;
+
+  for (auto _ : state) {
+    const std::vector<uint8_t>& aid = config.selects[xx++ % 64];
+    benchmark::DoNotOptimize(
+        ce_t4t_aid_index_lookup(&config.idx, aid.size(), aid.data()));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_AidLookupIndex)->Arg(4)->Arg(64)->Arg(256)->Arg(1024);
+
+/* SELECT dispatch comparing every registered AID, exact match only */
+void BM_AidLookupLinear(benchmark::State& state) {
+  AidConfig config(state.range(0));
+  size_t xx = 0;
+
+  for (auto _ : state) {
+    const std::vector<uint8_t>& aid = config.selects[xx++ % 64];
+    uint8_t handle = CE_T4T_AID_INDEX_NONE;
+    for (size_t yy = 0; yy < config.aids.size(); yy++) {
+      if ((config.aids[yy].size() == aid.size()) &&
+          !memcmp(config.aids[yy].data(), aid.data(), aid.size())) {
+        handle = yy % 0xFF;
+        break;
+      }
+    }
+    benchmark::DoNotOptimize(handle);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_AidLookupLinear)->Arg(4)->Arg(64)->Arg(256)->Arg(1024);
+
+/* Rebuilding the index from its serialized form */
+void BM_AidIndexLoad(benchmark::State& state) {
+  AidConfig config(state.range(0));
+  std::vector<uint8_t> saved(config.table.data(),
+                             config.table.data() + config.idx.table_len);
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        ce_t4t_aid_index_load(&config.idx, saved.data(), saved.size()));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.SetBytesProcessed(state.iterations() * saved.size());
+}
+BENCHMARK(BM_AidIndexLoad)->Arg(4)->Arg(64)->Arg(256)->Arg(1024);
+
+/* Rebuilding the index by registering every AID again */
+void BM_AidIndexAdd(benchmark::State& state) {
+  AidConfig config(state.range(0));
+
+  for (auto _ : state) {
+    ce_t4t_aid_index_init(&config.idx, config.table.data(),
+                          config.offset.data(), state.range(0));
+    for (size_t xx = 0; xx < config.aids.size(); xx++)
+      ce_t4t_aid_index_add(&config.idx, config.aids[xx].size(),
+                           config.aids[xx].data(), config.matches[xx],
+                           xx % 0xFF);
+    benchmark::DoNotOptimize(config.idx.num_aids);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_AidIndexAdd)->Arg(4)->Arg(64)->Arg(256)->Arg(1024);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,251 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <tuple>
+#include <vector>
+
+#include "ce_t4t_aid.h"
+
+bool nfc_debug_enabled = false;
+
+namespace {
+
+/* An index with its own storage */
+class AidIndex {
+ public:
+  explicit AidIndex(uint16_t max_aids)
+      : table_(CE_T4T_AID_TABLE_SIZE(max_aids)), offset_(max_aids) {
+    ce_t4t_aid_index_init(&idx_, table_.data(), offset_.data(), max_aids);
+  }
+  bool Add(std::vector<uint8_t> aid, uint8_t match, uint8_t handle) {
+    return ce_t4t_aid_index_add(&idx_, aid.size(), aid.data(), match, handle);
+  }
+  bool Remove(std::vector<uint8_t> aid, uint8_t match) {
+    return ce_t4t_aid_index_remove(&idx_, aid.size(), aid.data(), match);
+  }
+  uint8_t Lookup(std::vector<uint8_t> aid) {
+    return ce_t4t_aid_index_lookup(&idx_, aid.size(), aid.data());
+  }
+  std::vector<uint8_t> Table() {
+    return std::vector<uint8_t>(table_.data(), table_.data() + idx_.table_len);
+  }
+  bool Load(const std::vector<uint8_t>& table) {
+    return ce_t4t_aid_index_load(&idx_, table.data(), table.size());
+  }
+  tCE_T4T_AID_INDEX* idx() { return &idx_; }
+
+ private:
+  std::vector<uint8_t> table_;
+  std::vector<uint16_t> offset_;
+  tCE_T4T_AID_INDEX idx_;
+};
+
+const std::vector<uint8_t> kPpse = {0x32, 0x50, 0x41, 0x59, 0x2E, 0x53,
+                                    0x59, 0x53, 0x2E, 0x44, 0x44, 0x46,
+                                    0x30, 0x31};
+const std::vector<uint8_t> kVisa = {0xA0, 0x00, 0x00, 0x00, 0x03, 0x10, 0x10};
+
+/* How a registered AID matches a selected AID: the bytes of the selected AID
+ * it matches, or -1 */
+int MatchLen(const std::vector<uint8_t>& aid, uint8_t match,
+             const std::vector<uint8_t>& selected) {
+  bool starts = (selected.size() >= aid.size()) &&
+                std::equal(aid.begin(), aid.end(), selected.begin());
+  bool started = (aid.size() >= selected.size()) &&
+                 std::equal(selected.begin(), selected.end(), aid.begin());
+
+  if (aid.size() == selected.size()) return starts ? selected.size() : -1;
+  if ((match == CE_T4T_AID_MATCH_PREFIX) && starts) return aid.size();
+  if ((match == CE_T4T_AID_MATCH_SUBSET) && started) return selected.size();
+  return -1;
+}
+
+}  // namespace
+
+TEST(CeT4tAidTest, test_exact) {
+  AidIndex index(8);
+
+  ASSERT_TRUE(index.Add(kPpse, CE_T4T_AID_MATCH_EXACT, 0));
+  ASSERT_TRUE(index.Add(kVisa, CE_T4T_AID_MATCH_EXACT, 1));
+  EXPECT_EQ(0, index.Lookup(kPpse));
+  EXPECT_EQ(1, index.Lookup(kVisa));
+  EXPECT_EQ(CE_T4T_AID_INDEX_NONE,
+            index.Lookup({0xA0, 0x00, 0x00, 0x00, 0x03, 0x10}));
+  EXPECT_EQ(CE_T4T_AID_INDEX_NONE,
+            index.Lookup({0xA0, 0x00, 0x00, 0x00, 0x03, 0x10, 0x10, 0x01}));
+  EXPECT_EQ(CE_T4T_AID_INDEX_NONE, index.Lookup({}));
+}
+
+TEST(CeT4tAidTest, test_longest_prefix) {
+  AidIndex index(8);
+
+  ASSERT_TRUE(index.Add({}, CE_T4T_AID_MATCH_PREFIX, 7));
+  ASSERT_TRUE(index.Add({0xA0, 0x00}, CE_T4T_AID_MATCH_PREFIX, 1));
+  ASSERT_TRUE(index.Add({0xA0, 0x00, 0x00, 0x00, 0x03},
+                        CE_T4T_AID_MATCH_PREFIX, 2));
+  EXPECT_EQ(2, index.Lookup(kVisa));
+  EXPECT_EQ(2, index.Lookup({0xA0, 0x00, 0x00, 0x00, 0x03}));
+  EXPECT_EQ(1, index.Lookup({0xA0, 0x00, 0x00, 0x00, 0x04, 0x10, 0x10}));
+  EXPECT_EQ(7, index.Lookup(kPpse));
+  EXPECT_EQ(7, index.Lookup({0xA0}));
+  EXPECT_EQ(7, index.Lookup({}));
+
+  /* Selected AIDs may be longer than registered ones */
+  std::vector<uint8_t> lng(kVisa);
+  lng.resize(40, 0x55);
+  EXPECT_EQ(2, index.Lookup(lng));
+}
+
+TEST(CeT4tAidTest, test_subset) {
+  AidIndex index(8);
+
+  ASSERT_TRUE(index.Add(kVisa, CE_T4T_AID_MATCH_SUBSET, 3));
+  EXPECT_EQ(3, index.Lookup(kVisa));
+  EXPECT_EQ(3, index.Lookup({0xA0, 0x00, 0x00, 0x00, 0x03}));
+  EXPECT_EQ(3, index.Lookup({}));
+  EXPECT_EQ(CE_T4T_AID_INDEX_NONE,
+            index.Lookup({0xA0, 0x00, 0x00, 0x00, 0x04}));
+  EXPECT_EQ(CE_T4T_AID_INDEX_NONE,
+            index.Lookup({0xA0, 0x00, 0x00, 0x00, 0x03, 0x10, 0x10, 0x01}));
+}
+
+TEST(CeT4tAidTest, test_priority) {
+  AidIndex index(8);
+  std::vector<uint8_t> rid = {0xA0, 0x00, 0x00, 0x00, 0x03};
+
+  /* Same AID with every match: exact wins, then whatever matches all of the
+   * selected AID, then the longest prefix */
+  ASSERT_TRUE(index.Add(rid, CE_T4T_AID_MATCH_PREFIX, 1));
+  ASSERT_TRUE(index.Add(kVisa, CE_T4T_AID_MATCH_SUBSET, 2));
+  EXPECT_EQ(2, index.Lookup(kVisa));
+  EXPECT_EQ(2, index.Lookup({0xA0, 0x00, 0x00, 0x00, 0x03, 0x10}));
+  EXPECT_EQ(1, index.Lookup({0xA0, 0x00, 0x00, 0x00, 0x03, 0x20}));
+  ASSERT_TRUE(index.Add(kVisa, CE_T4T_AID_MATCH_EXACT, 3));
+  EXPECT_EQ(3, index.Lookup(kVisa));
+  EXPECT_EQ(1, index.Lookup(rid));
+  ASSERT_TRUE(index.Add(rid, CE_T4T_AID_MATCH_EXACT, 4));
+  EXPECT_EQ(4, index.Lookup(rid));
+
+  ASSERT_TRUE(index.Remove(kVisa, CE_T4T_AID_MATCH_EXACT));
+  EXPECT_EQ(2, index.Lookup(kVisa));
+  ASSERT_TRUE(index.Remove(kVisa, CE_T4T_AID_MATCH_SUBSET));
+  EXPECT_EQ(1, index.Lookup(kVisa));
+  ASSERT_TRUE(index.Remove(rid, CE_T4T_AID_MATCH_PREFIX));
+  EXPECT_EQ(CE_T4T_AID_INDEX_NONE, index.Lookup(kVisa));
+  EXPECT_EQ(4, index.Lookup(rid));
+}
+
+TEST(CeT4tAidTest, test_add_remove) {
+  AidIndex index(2);
+
+  ASSERT_TRUE(index.Add(kPpse, CE_T4T_AID_MATCH_EXACT, 0));
+  EXPECT_FALSE(index.Add(kPpse, CE_T4T_AID_MATCH_EXACT, 1));
+  EXPECT_FALSE(index.Add(std::vector<uint8_t>(NCI_MAX_AID_LEN + 1, 0xA0),
+                         CE_T4T_AID_MATCH_EXACT, 1));
+  EXPECT_FALSE(index.Add(kVisa, CE_T4T_AID_MATCH_SUBSET + 1, 1));
+  ASSERT_TRUE(index.Add(kPpse, CE_T4T_AID_MATCH_PREFIX, 1));
+  EXPECT_FALSE(index.Add(kVisa, CE_T4T_AID_MATCH_EXACT, 2));
+  EXPECT_EQ(2, index.idx()->num_aids);
+
+  EXPECT_FALSE(index.Remove(kVisa, CE_T4T_AID_MATCH_EXACT));
+  EXPECT_FALSE(index.Remove(kPpse, CE_T4T_AID_MATCH_SUBSET));
+  ASSERT_TRUE(index.Remove(kPpse, CE_T4T_AID_MATCH_EXACT));
+  ASSERT_TRUE(index.Add(kVisa, CE_T4T_AID_MATCH_EXACT, 2));
+  EXPECT_EQ(2, index.Lookup(kVisa));
+  EXPECT_EQ(1, index.Lookup(kPpse));
+  EXPECT_EQ(2, ce_t4t_aid_index_find(index.idx(), kVisa.size(), kVisa.data(),
+                                     CE_T4T_AID_MATCH_EXACT));
+  EXPECT_EQ(CE_T4T_AID_INDEX_NONE,
+            ce_t4t_aid_index_find(index.idx(), kPpse.size(), kPpse.data(),
+                                  CE_T4T_AID_MATCH_EXACT));
+}
+
+TEST(CeT4tAidTest, test_load) {
+  AidIndex index(4), copy(4), small(2);
+
+  ASSERT_TRUE(index.Add(kVisa, CE_T4T_AID_MATCH_EXACT, 0));
+  ASSERT_TRUE(index.Add({0xA0}, CE_T4T_AID_MATCH_PREFIX, 1));
+  ASSERT_TRUE(index.Add(kPpse, CE_T4T_AID_MATCH_SUBSET, 2));
+  ASSERT_TRUE(index.Add({}, CE_T4T_AID_MATCH_PREFIX, 3));
+
+  ASSERT_TRUE(copy.Load(index.Table()));
+  EXPECT_EQ(index.Table(), copy.Table());
+  EXPECT_EQ(4, copy.idx()->num_aids);
+  EXPECT_EQ(0, copy.Lookup(kVisa));
+  EXPECT_EQ(1, copy.Lookup({0xA0, 0x01}));
+  EXPECT_EQ(2, copy.Lookup({0x32, 0x50}));
+  EXPECT_EQ(3, copy.Lookup({0x01}));
+  EXPECT_FALSE(copy.Add(kVisa, CE_T4T_AID_MATCH_EXACT, 0));
+
+  /* Too many records, truncated, unsorted */
+  EXPECT_FALSE(small.Load(index.Table()));
+  EXPECT_EQ(0, small.idx()->num_aids);
+  std::vector<uint8_t> table = index.Table();
+  table.pop_back();
+  EXPECT_FALSE(copy.Load(table));
+  EXPECT_EQ(0, copy.idx()->num_aids);
+  EXPECT_EQ(CE_T4T_AID_INDEX_NONE, copy.Lookup(kVisa));
+  EXPECT_FALSE(copy.Load({2, CE_T4T_AID_MATCH_EXACT, 0, 0xA0, 0x01, 1,
+                          CE_T4T_AID_MATCH_EXACT, 1, 0xA0}));
+  EXPECT_FALSE(copy.Load({1, CE_T4T_AID_MATCH_SUBSET + 1, 0, 0xA0}));
+  EXPECT_TRUE(copy.Load({}));
+}
+
+TEST(CeT4tAidTest, test_random) {
+  std::mt19937 rng(24);
+  AidIndex index(300);
+  struct Reg {
+    std::vector<uint8_t> aid;
+    uint8_t match;
+    uint8_t handle;
+  };
+  std::vector<Reg> regs;
+
+  /* Short AIDs over few byte values, so that they start each other */
+  auto random_aid = [&](size_t max_len) {
+    std::vector<uint8_t> aid(rng() % (max_len + 1));
+    for (auto& b : aid) b = 0xA0 + rng() % 3;
+    return aid;
+  };
+
+  for (int xx = 0; xx < 5000; xx++) {
+    if ((rng() % 3) || regs.empty()) {
+      Reg reg = {random_aid(6), (uint8_t)(rng() % 3), (uint8_t)(xx % 0xFF)};
+      bool dup = false;
+      for (const Reg& r : regs)
+        dup |= (r.aid == reg.aid) && (r.match == reg.match);
+      bool added = index.Add(reg.aid, reg.match, reg.handle);
+      EXPECT_EQ(!dup && (regs.size() < 300), added);
+      if (added) regs.push_back(reg);
+    } else {
+      size_t yy = rng() % regs.size();
+      ASSERT_TRUE(index.Remove(regs[yy].aid, regs[yy].match));
+      regs.erase(regs.begin() + yy);
+    }
+
+    /* The best match of a linear scan: longest, then exact, then subset,
+     * then the first AID in order */
+    std::vector<uint8_t> selected = random_aid(8);
+    const Reg* p_best = nullptr;
+    int best_len = -1;
+    for (const Reg& r : regs) {
+      int len = MatchLen(r.aid, r.match, selected);
+      if (len < 0) continue;
+      if ((len > best_len) ||
+          ((len == best_len) &&
+           (std::make_tuple(r.aid, r.match) <
+            std::make_tuple(p_best->aid, p_best->match)))) {
+        p_best = &r;
+        best_len = len;
+      }
+    }
+    ASSERT_EQ(p_best ? p_best->handle : CE_T4T_AID_INDEX_NONE,
+              index.Lookup(selected))
+        << "step " << xx;
+  }
+
+  AidIndex copy(300);
+  ASSERT_TRUE(copy.Load(index.Table()));
+  EXPECT_EQ(regs.size(), copy.idx()->num_aids);
+}
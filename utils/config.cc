@@ -15,6 +15,8 @@
  */
 #include "config.h"
 
+#include <string.h>
+
 #include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/parseint.h>
@@ -39,6 +41,27 @@ bool parseBytesString(std::string in, std::vector<uint8_t>& out) {
   return true;
 }
 
+uint32_t hashKey(const std::string& key) {
+  return ConfigKey::hash(key.c_str());
+}
+
+const size_t kInitialCapacity = 64;
+
+void appendBinary(std::vector<uint8_t>* out, const void* p, size_t length) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(p);
+  out->insert(out->end(), bytes, bytes + length);
+}
+
+bool readBinary(const uint8_t** p, const uint8_t* end, void* out,
+                size_t length) {
+  if ((size_t)(end - *p) < length) return false;
+  memcpy(out, *p, length);
+  *p += length;
+  return true;
+}
+
+std::atomic<uint32_t> next_generation(1);
+
 }  // namespace
 
 ConfigValue::ConfigValue() {}
@@ -63,7 +86,7 @@ ConfigValue::ConfigValue(std::vector<uint8_t> value) {
 
 ConfigValue::Type ConfigValue::getType() const { return type_; }
 
-std::string ConfigValue::getString() const {
+const std::string& ConfigValue::getString() const {
   CHECK(type_ == STRING);
   return value_string_;
 };
@@ -73,21 +96,21 @@ unsigned ConfigValue::getUnsigned() const {
   return value_unsigned_;
 };
 
-std::vector<uint8_t> ConfigValue::getBytes() const {
+const std::vector<uint8_t>& ConfigValue::getBytes() const {
   CHECK(type_ == BYTES);
   return value_bytes_;
 };
 
 bool ConfigValue::parseFromString(std::string in) {
   if (in.length() > 1 && in[0] == '"' && in[in.length() - 1] == '"') {
-    CHECK(in.length() > 2);  // Don't allow empty strings
+    if (in.length() <= 2) return false;  // Don't allow empty strings
     type_ = STRING;
     value_string_ = in.substr(1, in.length() - 2);
     return true;
   }
 
   if (in.length() > 1 && in[0] == '{' && in[in.length() - 1] == '}') {
-    CHECK(in.length() >= 4);  // Needs at least one byte
+    if (in.length() < 4) return false;  // Needs at least one byte
     type_ = BYTES;
     return parseBytesString(in.substr(1, in.length() - 2), value_bytes_);
   }
@@ -102,15 +125,67 @@ bool ConfigValue::parseFromString(std::string in) {
   return false;
 }
 
+bool ConfigValue::operator==(const ConfigValue& other) const {
+  if (type_ != other.type_) return false;
+  switch (type_) {
+    case UNSIGNED:
+      return value_unsigned_ == other.value_unsigned_;
+    case STRING:
+      return value_string_ == other.value_string_;
+    case BYTES:
+      return value_bytes_ == other.value_bytes_;
+  }
+  return false;
+}
+
+ConfigFile::ConfigFile()
+    : slots_(kInitialCapacity), count_(0), generation_(next_generation++) {}
+
+int ConfigFile::findSlot(const char* key, uint32_t hash) const {
+  const size_t mask = slots_.size() - 1;
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    const Slot& slot = slots_[i];
+    if (!slot.used) return -1;
+    if (slot.hash == hash && slot.key == key) return i;
+  }
+}
+
+void ConfigFile::insertSlot(const std::string& key, uint32_t hash,
+                            const ConfigValue& value) {
+  if ((count_ + 1) * 2 > slots_.size()) resize(slots_.size() * 2);
+
+  const size_t mask = slots_.size() - 1;
+  size_t i = hash & mask;
+  while (slots_[i].used) i = (i + 1) & mask;
+
+  Slot& slot = slots_[i];
+  slot.used = true;
+  slot.hash = hash;
+  slot.key = key;
+  slot.value = value;
+  count_++;
+}
+
+void ConfigFile::resize(size_t capacity) {
+  std::vector<Slot> old_slots(capacity);
+  old_slots.swap(slots_);
+  count_ = 0;
+  generation_ = next_generation++;
+
+  for (Slot& slot : old_slots) {
+    if (slot.used) insertSlot(slot.key, slot.hash, slot.value);
+  }
+}
+
 void ConfigFile::addConfig(const std::string& key, ConfigValue& value) {
   CHECK(!hasKey(key));
-  values_.emplace(key, value);
+  insertSlot(key, hashKey(key), value);
 }
 
 bool ConfigFile::updateConfig(const std::string& key, ConfigValue& value) {
-  std::map<std::string, ConfigValue>::iterator it = values_.find(key);
-  if (it != values_.end() && isUpdateAllowed(key)) {
-    it->second = value;
+  int slot = findSlot(key.c_str(), hashKey(key));
+  if (slot >= 0 && isUpdateAllowed(key)) {
+    slots_[slot].value = value;
     return true;
   }
   return false;
@@ -126,55 +201,157 @@ bool ConfigFile::isUpdateAllowed(const std::string& key) {
 }
 
 void ConfigFile::parseFromFile(const std::string& file_name) {
+  bool config_parsed = tryParseFromFile(file_name);
+  CHECK(config_parsed);
+}
+
+void ConfigFile::parseFromString(const std::string& config) {
+  bool config_parsed = tryParseFromString(config);
+  CHECK(config_parsed);
+}
+
+bool ConfigFile::tryParseFromFile(const std::string& file_name) {
   string config;
-  bool config_read = ReadFileToString(file_name, &config);
-  CHECK(config_read);
+  if (!ReadFileToString(file_name, &config)) {
+    LOG(ERROR) << "ConfigFile - Cannot read file '" << file_name << "'";
+    return false;
+  }
   LOG(INFO) << "ConfigFile - Parsing file '" << file_name << "'";
   cur_file_name_ = file_name;
-  parseFromString(config);
+  return tryParseFromString(config);
 }
 
-void ConfigFile::parseFromString(const std::string& config) {
+bool ConfigFile::tryParseFromString(const std::string& config) {
   stringstream ss(config);
   string line;
-  while (getline(ss, line)) {
+  bool parsed = true;
+  while (parsed && getline(ss, line)) {
     line = Trim(line);
     if (line.empty()) continue;
     if (line.at(0) == '#') continue;
     if (line.at(0) == 0) continue;
 
     auto search = line.find('=');
-    CHECK(search != string::npos);
+    if (search == string::npos) {
+      LOG(ERROR) << "ConfigFile - Missing '=' in '" << line << "'";
+      parsed = false;
+      break;
+    }
 
     string key(Trim(line.substr(0, search)));
     string value_string(Trim(line.substr(search + 1, string::npos)));
 
     ConfigValue value;
-    bool value_parsed = value.parseFromString(value_string);
-    CHECK(value_parsed);
-
-    if (cur_file_name_.find("nxpTransit") != std::string::npos) {
+    if (!value.parseFromString(value_string)) {
+      LOG(ERROR) << "ConfigFile - Invalid value [" << key
+                 << "] = " << value_string;
+      parsed = false;
+    } else if (cur_file_name_.find("nxpTransit") != std::string::npos) {
       if (updateConfig(key, value))
         LOG(INFO) << "ConfigFile Updated - [" << key << "] = " << value_string;
+    } else if (hasKey(key)) {
+      LOG(ERROR) << "ConfigFile - Duplicate [" << key << "]";
+      parsed = false;
     } else {
       addConfig(key, value);
       LOG(INFO) << "ConfigFile - [" << key << "] = " << value_string;
     }
   }
   cur_file_name_ = "";
+  return parsed;
+}
+
+// Each value is stored as its type (1 byte), key length (2 bytes), key,
+// then the unsigned value (4 bytes) or the length (4 bytes) and contents of
+// the string or byte array, after a 4 byte count of values.
+void ConfigFile::serializeToBinary(std::vector<uint8_t>* out) {
+  uint32_t count = count_;
+  appendBinary(out, &count, sizeof(count));
+
+  for (const Slot& slot : slots_) {
+    if (!slot.used) continue;
+
+    uint8_t type = slot.value.getType();
+    uint16_t key_length = slot.key.length();
+    appendBinary(out, &type, sizeof(type));
+    appendBinary(out, &key_length, sizeof(key_length));
+    appendBinary(out, slot.key.data(), key_length);
+
+    uint32_t value;
+    switch (slot.value.getType()) {
+      case ConfigValue::UNSIGNED:
+        value = slot.value.getUnsigned();
+        appendBinary(out, &value, sizeof(value));
+        break;
+      case ConfigValue::STRING:
+        value = slot.value.getString().length();
+        appendBinary(out, &value, sizeof(value));
+        appendBinary(out, slot.value.getString().data(), value);
+        break;
+      case ConfigValue::BYTES:
+        value = slot.value.getBytes().size();
+        appendBinary(out, &value, sizeof(value));
+        appendBinary(out, slot.value.getBytes().data(), value);
+        break;
+    }
+  }
+}
+
+bool ConfigFile::parseFromBinary(const uint8_t* data, size_t length) {
+  const uint8_t* p = data;
+  const uint8_t* end = data + length;
+  uint32_t count;
+
+  clear();
+  if (!readBinary(&p, end, &count, sizeof(count))) return false;
+
+  for (uint32_t i = 0; i < count; i++) {
+    uint8_t type;
+    uint16_t key_length;
+    uint32_t value;
+
+    if (!readBinary(&p, end, &type, sizeof(type)) ||
+        !readBinary(&p, end, &key_length, sizeof(key_length)) ||
+        (size_t)(end - p) < key_length)
+      break;
+    std::string key((const char*)p, key_length);
+    p += key_length;
+
+    if (!readBinary(&p, end, &value, sizeof(value)) || hasKey(key)) break;
+
+    if (type == ConfigValue::UNSIGNED) {
+      insertSlot(key, hashKey(key), ConfigValue(value));
+      continue;
+    }
+    if (value == 0 || (size_t)(end - p) < value) break;
+    if (type == ConfigValue::STRING) {
+      insertSlot(key, hashKey(key),
+                 ConfigValue(std::string((const char*)p, value)));
+    } else if (type == ConfigValue::BYTES) {
+      insertSlot(key, hashKey(key),
+                 ConfigValue(std::vector<uint8_t>(p, p + value)));
+    } else {
+      break;
+    }
+    p += value;
+  }
+
+  if (count_ == count && p == end) return true;
+  clear();
+  return false;
 }
 
 bool ConfigFile::hasKey(const std::string& key) {
-  return values_.count(key) != 0;
+  return findSlot(key.c_str(), hashKey(key)) >= 0;
 }
 
 ConfigValue& ConfigFile::getValue(const std::string& key) {
-  auto search = values_.find(key);
-  CHECK(search != values_.end());
-  return search->second;
+  int slot = findSlot(key.c_str(), hashKey(key));
+  CHECK(slot >= 0);
+  return slots_[slot].value;
 }
 
-std::string ConfigFile::getString(const std::string& key) {
+const std::string& ConfigFile::getString(const std::string& key) {
   return getValue(key).getString();
 }
 
@@ -182,9 +359,62 @@ unsigned ConfigFile::getUnsigned(const std::string& key) {
   return getValue(key).getUnsigned();
 }
 
-std::vector<uint8_t> ConfigFile::getBytes(const std::string& key) {
+const std::vector<uint8_t>& ConfigFile::getBytes(const std::string& key) {
   return getValue(key).getBytes();
 }
 
-bool ConfigFile::isEmpty() { return values_.empty(); }
-void ConfigFile::clear() { values_.clear(); }
+ConfigValue* ConfigFile::findValue(const ConfigKey& key) {
+  uint64_t cached = key.cache_.load(std::memory_order_relaxed);
+  if ((uint32_t)(cached >> 32) == generation_)
+    return &slots_[(uint32_t)cached].value;
+
+  int slot = findSlot(key.name_, key.hash_);
+  if (slot < 0) return NULL;
+  key.cache_.store(((uint64_t)generation_ << 32) | (uint32_t)slot,
+                   std::memory_order_relaxed);
+  return &slots_[slot].value;
+}
+
+ConfigValue& ConfigFile::getValue(const ConfigKey& key) {
+  ConfigValue* value = findValue(key);
+  CHECK(value != NULL);
+  return *value;
+}
+
+bool ConfigFile::hasKey(const ConfigKey& key) {
+  return findValue(key) != NULL;
+}
+
+const std::string& ConfigFile::getString(const ConfigKey& key) {
+  return getValue(key).getString();
+}
+
+unsigned ConfigFile::getUnsigned(const ConfigKey& key) {
+  return getValue(key).getUnsigned();
+}
+
+const std::vector<uint8_t>& ConfigFile::getBytes(const ConfigKey& key) {
+  return getValue(key).getBytes();
+}
+
+void ConfigFile::diff(const ConfigFile& other,
+                      std::vector<std::string>* keys) const {
+  for (const Slot& slot : slots_) {
+    if (!slot.used) continue;
+    int found = other.findSlot(slot.key.c_str(), slot.hash);
+    if (found < 0 || other.slots_[found].value != slot.value)
+      keys->push_back(slot.key);
+  }
+  for (const Slot& slot : other.slots_) {
+    if (!slot.used) continue;
+    if (findSlot(slot.key.c_str(), slot.hash) < 0) keys->push_back(slot.key);
+  }
+}
+
+bool ConfigFile::isEmpty() { return count_ == 0; }
+
+void ConfigFile::clear() {
+  std::vector<Slot>(kInitialCapacity).swap(slots_);
+  count_ = 0;
+  generation_ = next_generation++;
+}
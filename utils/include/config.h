@@ -15,6 +15,8 @@
  */
 #pragma once
 
+#include <stdint.h>
+#include <atomic>
 #include <map>
 #include <string>
 #include <vector>
@@ -28,12 +30,15 @@ class ConfigValue {
   ConfigValue(unsigned);
   ConfigValue(std::vector<uint8_t>);
   Type getType() const;
-  std::string getString() const;
+  const std::string& getString() const;
   unsigned getUnsigned() const;
-  std::vector<uint8_t> getBytes() const;
+  const std::vector<uint8_t>& getBytes() const;
 
   bool parseFromString(std::string in);
 
+  bool operator==(const ConfigValue& other) const;
+  bool operator!=(const ConfigValue& other) const { return !(*this == other); }
+
  private:
   Type type_;
   std::string value_string_;
@@ -41,24 +46,91 @@ class ConfigValue {
   std::vector<uint8_t> value_bytes_;
 };
 
+// A config key whose hash is computed at compile time. The slot the key was
+// last found in is cached, so repeated lookups of a key declared once (for
+// example as a global) skip hashing and probing until the config changes.
+class ConfigKey {
+ public:
+  constexpr explicit ConfigKey(const char* name)
+      : name_(name), hash_(hash(name)), cache_(0) {}
+
+  const char* name() const { return name_; }
+
+  // FNV-1a, also used for the keys read from config files
+  static constexpr uint32_t hash(const char* name) {
+    uint32_t h = 2166136261u;
+    while (*name) h = (h ^ (uint8_t)*name++) * 16777619u;
+    return h;
+  }
+
+ private:
+  friend class ConfigFile;
+
+  const char* name_;
+  uint32_t hash_;
+  // Generation of the table the slot was found in (high 32 bits) and the
+  // index of the slot (low 32 bits)
+  mutable std::atomic<uint64_t> cache_;
+};
+
 class ConfigFile {
  public:
+  ConfigFile();
+
   void parseFromFile(const std::string& file_name);
   void parseFromString(const std::string& config);
+  // Same as above, but a missing file or a malformed config is returned as
+  // false instead of aborting. The values parsed before the error are kept.
+  bool tryParseFromFile(const std::string& file_name);
+  bool tryParseFromString(const std::string& config);
   void addConfig(const std::string& config, ConfigValue& value);
 
+  // Binary form of the values, to cache a parsed config. Parsing it back
+  // replaces the current values and fails on malformed input.
+  void serializeToBinary(std::vector<uint8_t>* out);
+  bool parseFromBinary(const uint8_t* data, size_t length);
+
+  // References returned by getString() and getBytes() are only valid until
+  // the values of this ConfigFile change: parsing, addConfig(), clear() or
+  // the destruction of the ConfigFile.
   bool hasKey(const std::string& key);
-  std::string getString(const std::string& key);
+  const std::string& getString(const std::string& key);
   unsigned getUnsigned(const std::string& key);
-  std::vector<uint8_t> getBytes(const std::string& key);
+  const std::vector<uint8_t>& getBytes(const std::string& key);
+
+  bool hasKey(const ConfigKey& key);
+  const std::string& getString(const ConfigKey& key);
+  unsigned getUnsigned(const ConfigKey& key);
+  const std::vector<uint8_t>& getBytes(const ConfigKey& key);
+
+  // Keys that were added, removed or changed value in |other|, in no
+  // particular order
+  void diff(const ConfigFile& other, std::vector<std::string>* keys) const;
 
   bool isEmpty();
   void clear();
 
  private:
+  struct Slot {
+    bool used = false;
+    uint32_t hash;
+    std::string key;
+    ConfigValue value;
+  };
+
+  int findSlot(const char* key, uint32_t hash) const;
+  ConfigValue* findValue(const ConfigKey& key);
   ConfigValue& getValue(const std::string& key);
+  ConfigValue& getValue(const ConfigKey& key);
+  void insertSlot(const std::string& key, uint32_t hash,
+                  const ConfigValue& value);
+  void resize(size_t capacity);
   bool updateConfig(const std::string& config, ConfigValue& value);
   bool isUpdateAllowed(const std::string& key);
   std::string cur_file_name_ = "";
-  std::map<std::string, ConfigValue> values_;
+  // Open addressing with linear probing, the capacity is a power of 2
+  std::vector<Slot> slots_;
+  size_t count_;
+  // Changes whenever slots move or go away, unique across all ConfigFiles
+  uint32_t generation_;
 };
@@ -23,9 +23,10 @@
 typedef struct ringbuffer_t ringbuffer_t;
 
 // NOTE:
-// None of the functions below are thread safe when it comes to accessing the
-// *rb pointer. It is *NOT* possible to insert and pop/delete at the same time.
-// Callers must protect the *rb pointer separately.
+// None of the ringbuffer functions below are thread safe when it comes to
+// accessing the *rb pointer. It is *NOT* possible to insert and pop/delete at
+// the same time. Callers must protect the *rb pointer separately, or use the
+// spsc_ringbuffer variant for one producer and one consumer.
 
 // Create a ringbuffer with the specified size
 // Returns NULL if memory allocation failed. Resulting pointer must be freed
@@ -60,3 +61,63 @@ size_t ringbuffer_pop(ringbuffer_t* rb, uint8_t* p, size_t length);
 // Deletes |length| bytes from the ringbuffer starting from the head
 // Return actual number of bytes deleted.
 size_t ringbuffer_delete(ringbuffer_t* rb, size_t length);
+
+typedef struct spsc_ringbuffer_t spsc_ringbuffer_t;
+
+// NOTE:
+// The spsc_ringbuffer functions below are safe to use without a lock by one
+// producer thread (insert, reserve, commit) and one consumer thread (peek,
+// peek_span, pop, delete) at a time. Size and available may be called from
+// either side and return a snapshot.
+
+// Create a single producer/single consumer ringbuffer with the specified
+// size, which must be a power of 2.
+// Returns NULL if the size is invalid or memory allocation failed. Resulting
+// pointer must be freed using |spsc_ringbuffer_free|.
+spsc_ringbuffer_t* spsc_ringbuffer_init(const size_t size);
+
+// Frees the ringbuffer structure and buffer
+// Save to call with NULL.
+void spsc_ringbuffer_free(spsc_ringbuffer_t* rb);
+
+// Returns remaining buffer size
+size_t spsc_ringbuffer_available(const spsc_ringbuffer_t* rb);
+
+// Returns size of data in buffer
+size_t spsc_ringbuffer_size(const spsc_ringbuffer_t* rb);
+
+// Attempts to insert up to |length| bytes of data at |p| into the buffer
+// Return actual number of bytes added. Can be less than |length| if buffer
+// is full.
+size_t spsc_ringbuffer_insert(spsc_ringbuffer_t* rb, const uint8_t* p,
+                              size_t length);
+
+// Returns the free space following the data in the buffer that can be written
+// in place, and sets |length| to its size. The space is only added to the
+// buffer once |spsc_ringbuffer_commit| is called. The span stops at the end of
+// the buffer, so a second call after committing may return the rest.
+uint8_t* spsc_ringbuffer_reserve(spsc_ringbuffer_t* rb, size_t* length);
+
+// Adds |length| bytes written to the span returned by
+// |spsc_ringbuffer_reserve| to the buffer.
+void spsc_ringbuffer_commit(spsc_ringbuffer_t* rb, size_t length);
+
+// Peek |length| number of bytes from the ringbuffer, starting at |offset|,
+// into the buffer |p|. Return the actual number of bytes peeked. Can be less
+// than |length| if there is less than |length| data available.
+size_t spsc_ringbuffer_peek(const spsc_ringbuffer_t* rb, size_t offset,
+                            uint8_t* p, size_t length);
+
+// Returns the data at the head of the buffer that can be read in place, and
+// sets |length| to its size. The span stops at the end of the buffer. Use
+// |spsc_ringbuffer_delete| to release the bytes once they are consumed.
+const uint8_t* spsc_ringbuffer_peek_span(const spsc_ringbuffer_t* rb,
+                                         size_t* length);
+
+// Does the same as |spsc_ringbuffer_peek|, but also advances the ring buffer
+// head
+size_t spsc_ringbuffer_pop(spsc_ringbuffer_t* rb, uint8_t* p, size_t length);
+
+// Deletes |length| bytes from the ringbuffer starting from the head
+// Return actual number of bytes deleted.
+size_t spsc_ringbuffer_delete(spsc_ringbuffer_t* rb, size_t length);
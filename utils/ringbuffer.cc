@@ -18,6 +18,11 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <new>
 
 #include "ringbuffer.h"
 
@@ -62,10 +67,12 @@ size_t ringbuffer_insert(ringbuffer_t* rb, const uint8_t* p, size_t length) {
 
   if (length > ringbuffer_available(rb)) length = ringbuffer_available(rb);
 
-  for (size_t i = 0; i != length; ++i) {
-    *rb->tail++ = *p++;
-    if (rb->tail >= (rb->base + rb->total)) rb->tail = rb->base;
-  }
+  const size_t first =
+      std::min(length, (size_t)(rb->base + rb->total - rb->tail));
+  memcpy(rb->tail, p, first);
+  memcpy(rb->base, p + first, length - first);
+  rb->tail += length;
+  if (rb->tail >= (rb->base + rb->total)) rb->tail -= rb->total;
 
   rb->available -= length;
   return length;
@@ -95,10 +102,10 @@ size_t ringbuffer_peek(const ringbuffer_t* rb, off_t offset, uint8_t* p,
                                    ? ringbuffer_size(rb) - offset
                                    : length;
 
-  for (size_t copied = 0; copied < bytes_to_copy; ++copied) {
-    *p++ = *b++;
-    if (b >= (rb->base + rb->total)) b = rb->base;
-  }
+  const size_t first =
+      std::min(bytes_to_copy, (size_t)(rb->base + rb->total - b));
+  memcpy(p, b, first);
+  memcpy(p + first, rb->base, bytes_to_copy - first);
 
   return bytes_to_copy;
 }
@@ -114,3 +121,142 @@ size_t ringbuffer_pop(ringbuffer_t* rb, uint8_t* p, size_t length) {
   rb->available += copied;
   return copied;
 }
+
+// Indices run freely and are masked on access, so head == tail means empty
+// and tail - head == total means full. Each side only stores its own index.
+struct spsc_ringbuffer_t {
+  size_t total;
+  size_t mask;
+  uint8_t* base;
+  alignas(64) std::atomic<size_t> head;  // written by the consumer
+  alignas(64) std::atomic<size_t> tail;  // written by the producer
+};
+
+spsc_ringbuffer_t* spsc_ringbuffer_init(const size_t size) {
+  if (size == 0 || (size & (size - 1)) != 0) return NULL;
+
+  spsc_ringbuffer_t* p = new (std::nothrow) spsc_ringbuffer_t;
+  if (p == NULL) return p;
+
+  p->base = static_cast<uint8_t*>(calloc(size, sizeof(uint8_t)));
+  if (p->base == NULL) {
+    delete p;
+    return NULL;
+  }
+  p->total = size;
+  p->mask = size - 1;
+  p->head.store(0, std::memory_order_relaxed);
+  p->tail.store(0, std::memory_order_relaxed);
+
+  return p;
+}
+
+void spsc_ringbuffer_free(spsc_ringbuffer_t* rb) {
+  if (rb != NULL) free(rb->base);
+  delete rb;
+}
+
+size_t spsc_ringbuffer_available(const spsc_ringbuffer_t* rb) {
+  assert(rb);
+  return rb->total - spsc_ringbuffer_size(rb);
+}
+
+size_t spsc_ringbuffer_size(const spsc_ringbuffer_t* rb) {
+  assert(rb);
+  return rb->tail.load(std::memory_order_acquire) -
+         rb->head.load(std::memory_order_acquire);
+}
+
+uint8_t* spsc_ringbuffer_reserve(spsc_ringbuffer_t* rb, size_t* length) {
+  assert(rb);
+  assert(length);
+
+  const size_t tail = rb->tail.load(std::memory_order_relaxed);
+  const size_t room =
+      rb->total - (tail - rb->head.load(std::memory_order_acquire));
+  const size_t offset = tail & rb->mask;
+
+  *length = std::min(room, rb->total - offset);
+  return rb->base + offset;
+}
+
+void spsc_ringbuffer_commit(spsc_ringbuffer_t* rb, size_t length) {
+  assert(rb);
+
+  const size_t tail = rb->tail.load(std::memory_order_relaxed);
+  assert(length <=
+         rb->total - (tail - rb->head.load(std::memory_order_acquire)));
+  rb->tail.store(tail + length, std::memory_order_release);
+}
+
+size_t spsc_ringbuffer_insert(spsc_ringbuffer_t* rb, const uint8_t* p,
+                              size_t length) {
+  assert(rb);
+  assert(p);
+
+  const size_t tail = rb->tail.load(std::memory_order_relaxed);
+  const size_t room =
+      rb->total - (tail - rb->head.load(std::memory_order_acquire));
+  const size_t offset = tail & rb->mask;
+
+  if (length > room) length = room;
+
+  const size_t first = std::min(length, rb->total - offset);
+  memcpy(rb->base + offset, p, first);
+  memcpy(rb->base, p + first, length - first);
+
+  rb->tail.store(tail + length, std::memory_order_release);
+  return length;
+}
+
+const uint8_t* spsc_ringbuffer_peek_span(const spsc_ringbuffer_t* rb,
+                                         size_t* length) {
+  assert(rb);
+  assert(length);
+
+  const size_t head = rb->head.load(std::memory_order_relaxed);
+  const size_t used = rb->tail.load(std::memory_order_acquire) - head;
+  const size_t offset = head & rb->mask;
+
+  *length = std::min(used, rb->total - offset);
+  return rb->base + offset;
+}
+
+size_t spsc_ringbuffer_peek(const spsc_ringbuffer_t* rb, size_t offset,
+                            uint8_t* p, size_t length) {
+  assert(rb);
+  assert(p);
+
+  const size_t head = rb->head.load(std::memory_order_relaxed);
+  const size_t used = rb->tail.load(std::memory_order_acquire) - head;
+
+  if (offset >= used) return 0;
+  if (length > used - offset) length = used - offset;
+
+  const size_t start = (head + offset) & rb->mask;
+  const size_t first = std::min(length, rb->total - start);
+  memcpy(p, rb->base + start, first);
+  memcpy(p + first, rb->base, length - first);
+
+  return length;
+}
+
+size_t spsc_ringbuffer_delete(spsc_ringbuffer_t* rb, size_t length) {
+  assert(rb);
+
+  const size_t head = rb->head.load(std::memory_order_relaxed);
+  const size_t used = rb->tail.load(std::memory_order_acquire) - head;
+
+  if (length > used) length = used;
+
+  rb->head.store(head + length, std::memory_order_release);
+  return length;
+}
+
+size_t spsc_ringbuffer_pop(spsc_ringbuffer_t* rb, uint8_t* p, size_t length) {
+  assert(rb);
+  assert(p);
+
+  const size_t copied = spsc_ringbuffer_peek(rb, 0, p, length);
+  return spsc_ringbuffer_delete(rb, copied);
+}
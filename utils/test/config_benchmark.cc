@@ -0,0 +1,89 @@
+#include <benchmark/benchmark.h>
+
+#include <map>
+#include <string>
+
+#include <config.h>
+
+namespace {
+
+/* A config about the size of a vendor libnfc-nci.conf plus its NXP configs */
+std::string makeConfig() {
+  std::string config;
+  for (int i = 0; i < 150; i++) {
+    config += "NXP_CONFIG_VALUE_" + std::to_string(i) + "=" +
+              std::to_string(i) + "\n";
+  }
+  config += "HOST_LISTEN_TECH_MASK=7\n";
+  config += "NFA_PROPRIETARY_CFG={05:FF:FF:06:81:80:70:FF:FF}\n";
+  return config;
+}
+
+ConfigFile& getConfig() {
+  static ConfigFile config;
+  if (config.isEmpty()) config.parseFromString(makeConfig());
+  return config;
+}
+
+ConfigKey host_listen_key("HOST_LISTEN_TECH_MASK");
+ConfigKey proprietary_key("NFA_PROPRIETARY_CFG");
+
+/* The sorted map the config used to be stored in, for comparison */
+void BM_MapGetUnsigned(benchmark::State& state) {
+  std::map<std::string, unsigned> values;
+  for (int i = 0; i < 150; i++)
+    values.emplace("NXP_CONFIG_VALUE_" + std::to_string(i), i);
+  values.emplace("HOST_LISTEN_TECH_MASK", 7);
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(values.find("HOST_LISTEN_TECH_MASK")->second);
+  }
+}
+BENCHMARK(BM_MapGetUnsigned);
+
+void BM_GetUnsigned(benchmark::State& state) {
+  ConfigFile& config = getConfig();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(config.getUnsigned("HOST_LISTEN_TECH_MASK"));
+  }
+}
+BENCHMARK(BM_GetUnsigned);
+
+void BM_GetUnsignedKey(benchmark::State& state) {
+  ConfigFile& config = getConfig();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(config.getUnsigned(host_listen_key));
+  }
+}
+BENCHMARK(BM_GetUnsignedKey);
+
+void BM_HasKeyGetUnsignedKey(benchmark::State& state) {
+  ConfigFile& config = getConfig();
+  for (auto _ : state) {
+    if (config.hasKey(host_listen_key))
+      benchmark::DoNotOptimize(config.getUnsigned(host_listen_key));
+  }
+}
+BENCHMARK(BM_HasKeyGetUnsignedKey);
+
+/* Copying the bytes out, as callers did when getBytes returned by value */
+void BM_GetBytesCopy(benchmark::State& state) {
+  ConfigFile& config = getConfig();
+  for (auto _ : state) {
+    std::vector<uint8_t> bytes = config.getBytes("NFA_PROPRIETARY_CFG");
+    benchmark::DoNotOptimize(bytes.data());
+  }
+}
+BENCHMARK(BM_GetBytesCopy);
+
+void BM_GetBytesKey(benchmark::State& state) {
+  ConfigFile& config = getConfig();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(config.getBytes(proprietary_key).data());
+  }
+}
+BENCHMARK(BM_GetBytesKey);
+
+}  // namespace
+
+BENCHMARK_MAIN();
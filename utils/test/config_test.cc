@@ -15,6 +15,8 @@
  */
 #include <gtest/gtest.h>
 
+#include <algorithm>
+
 #include <config.h>
 
 namespace {
@@ -99,6 +101,18 @@ TEST(ConfigTestFromString, test_invalid_configs) {
   EXPECT_DEATH(config5.parseFromString(INVALID_CONFIG5), "");
 }
 
+TEST(ConfigTestFromString, test_try_parse_invalid_configs) {
+  for (const char* invalid :
+       {INVALID_CONFIG1, INVALID_CONFIG2, INVALID_CONFIG3, INVALID_CONFIG4,
+        INVALID_CONFIG5}) {
+    ConfigFile config;
+    EXPECT_FALSE(config.tryParseFromString(invalid));
+  }
+  ConfigFile config;
+  EXPECT_TRUE(config.tryParseFromString(SIMPLE_CONFIG));
+  EXPECT_EQ(config.getUnsigned("NUM_VALUE"), 42u);
+}
+
 TEST(ConfigTestFromString, test_clear) {
   ConfigFile config;
   EXPECT_FALSE(config.hasKey("NUM_VALUE"));
@@ -133,3 +147,139 @@ TEST_F(ConfigTestFromFile, test_file_based_config) {
   EXPECT_EQ(bytes[3], 255);
   EXPECT_EQ(bytes[4], 0);
 }
+
+TEST_F(ConfigTestFromFile, test_try_parse_missing_file) {
+  ConfigFile config;
+  EXPECT_FALSE(config.tryParseFromFile("/data/local/tmp/no_such_config.conf"));
+  EXPECT_TRUE(config.isEmpty());
+  EXPECT_TRUE(config.tryParseFromFile(SIMPLE_CONFIG_FILE));
+  EXPECT_EQ(config.getUnsigned("NUM_VALUE"), 42u);
+}
+
+TEST(ConfigTestFromString, test_key_lookup) {
+  static ConfigKey num_key("NUM_VALUE");
+  static ConfigKey bytes_key("BYTES_VALUE");
+  static ConfigKey unknown_key("UNKNOWN_VALUE");
+
+  ConfigFile config;
+  config.parseFromString(SIMPLE_CONFIG);
+  EXPECT_FALSE(config.hasKey(unknown_key));
+  for (int i = 0; i < 3; i++) {
+    EXPECT_TRUE(config.hasKey(num_key));
+    EXPECT_EQ(config.getUnsigned(num_key), 42u);
+  }
+  EXPECT_EQ(config.getString(ConfigKey("STRING_VALUE")), "Hello World!");
+
+  const std::vector<uint8_t>& bytes = config.getBytes(bytes_key);
+  EXPECT_EQ(&bytes, &config.getBytes("BYTES_VALUE"));
+  EXPECT_EQ(bytes.size(), 5u);
+  EXPECT_EQ(bytes[3], 255);
+
+  // A cached slot must not outlive the table it was found in
+  config.clear();
+  EXPECT_FALSE(config.hasKey(num_key));
+  config.parseFromString("NUM_VALUE=7\n");
+  EXPECT_EQ(config.getUnsigned(num_key), 7u);
+
+  ConfigFile other;
+  other.parseFromString("OTHER_VALUE=1\nNUM_VALUE=8\n");
+  EXPECT_EQ(other.getUnsigned(num_key), 8u);
+  EXPECT_EQ(config.getUnsigned(num_key), 7u);
+}
+
+TEST(ConfigTestFromString, test_many_keys) {
+  static ConfigKey first_key("KEY_0");
+  static ConfigKey last_key("KEY_499");
+
+  ConfigFile config;
+  config.parseFromString("KEY_0=0\n");
+  EXPECT_EQ(config.getUnsigned(first_key), 0u);
+
+  // Growing the table moves the slot cached for KEY_0
+  std::string many;
+  for (int i = 1; i < 500; i++)
+    many += "KEY_" + std::to_string(i) + "=" + std::to_string(i) + "\n";
+  config.parseFromString(many);
+
+  for (int i = 0; i < 500; i++)
+    EXPECT_EQ(config.getUnsigned("KEY_" + std::to_string(i)), (unsigned)i);
+  EXPECT_EQ(config.getUnsigned(first_key), 0u);
+  EXPECT_EQ(config.getUnsigned(last_key), 499u);
+  EXPECT_FALSE(config.hasKey("KEY_500"));
+}
+
+TEST(ConfigTestFromString, test_binary_round_trip) {
+  ConfigFile config;
+  config.parseFromString(SIMPLE_CONFIG);
+  std::vector<uint8_t> binary;
+  config.serializeToBinary(&binary);
+
+  ConfigFile copy;
+  EXPECT_TRUE(copy.parseFromBinary(binary.data(), binary.size()));
+  EXPECT_FALSE(copy.hasKey("COMMENTED_OUT_VALUE"));
+  EXPECT_EQ(copy.getUnsigned("NUM_VALUE"), 42u);
+  EXPECT_EQ(copy.getString("STRING_VALUE"), "Hello World!");
+  EXPECT_EQ(copy.getBytes("BYTES_VALUE"), config.getBytes("BYTES_VALUE"));
+
+  std::vector<uint8_t> binary_copy;
+  copy.serializeToBinary(&binary_copy);
+  EXPECT_EQ(binary.size(), binary_copy.size());
+}
+
+TEST(ConfigTestFromString, test_binary_invalid) {
+  ConfigFile config;
+  config.parseFromString(SIMPLE_CONFIG);
+  std::vector<uint8_t> binary;
+  config.serializeToBinary(&binary);
+
+  // Every truncation is rejected and leaves the config empty
+  ConfigFile copy;
+  for (size_t length = 0; length < binary.size(); length++) {
+    EXPECT_FALSE(copy.parseFromBinary(binary.data(), length));
+    EXPECT_TRUE(copy.isEmpty());
+  }
+
+  binary.push_back(0);
+  EXPECT_FALSE(copy.parseFromBinary(binary.data(), binary.size()));
+  binary.pop_back();
+
+  binary[0]++;
+  EXPECT_FALSE(copy.parseFromBinary(binary.data(), binary.size()));
+  EXPECT_TRUE(copy.isEmpty());
+}
+
+TEST(ConfigTestFromString, test_diff) {
+  ConfigFile config;
+  config.parseFromString(SIMPLE_CONFIG);
+  ConfigFile same;
+  same.parseFromString(SIMPLE_CONFIG);
+
+  std::vector<std::string> keys;
+  config.diff(same, &keys);
+  EXPECT_TRUE(keys.empty());
+
+  ConfigFile changed;
+  changed.parseFromString(
+      "NUM_VALUE=43\n"
+      "STRING_VALUE=\"Hello World!\"\n"
+      "BYTES_VALUE={0A:0B:0C:0D:0E:0F}\n"
+      "NEW_VALUE=1");
+  config.diff(changed, &keys);
+  std::sort(keys.begin(), keys.end());
+  EXPECT_EQ(keys, (std::vector<std::string>{"BYTES_VALUE", "NEW_VALUE",
+                                            "NUM_VALUE"}));
+
+  // A value that changes type is a change too
+  ConfigFile retyped;
+  retyped.parseFromString(
+      "NUM_VALUE=\"42\"\n"
+      "STRING_VALUE=\"Hello World!\"\n"
+      "BYTES_VALUE={0A:0B:0C:FF:00}");
+  keys.clear();
+  config.diff(retyped, &keys);
+  EXPECT_EQ(keys, std::vector<std::string>{"NUM_VALUE"});
+
+  keys.clear();
+  retyped.diff(config, &keys);
+  EXPECT_EQ(keys, std::vector<std::string>{"NUM_VALUE"});
+}
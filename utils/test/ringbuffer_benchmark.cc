@@ -0,0 +1,128 @@
+#include <benchmark/benchmark.h>
+
+#include <string.h>
+#include <mutex>
+#include <thread>
+
+#include <ringbuffer.h>
+
+namespace {
+
+const size_t kBufferSize = 64 * 1024;
+
+void BM_RingbufferInsertPop(benchmark::State& state) {
+  ringbuffer_t* rb = ringbuffer_init(kBufferSize);
+  uint8_t chunk[4096];
+  const size_t length = state.range(0);
+
+  memset(chunk, 0xAA, sizeof(chunk));
+  for (auto _ : state) {
+    ringbuffer_insert(rb, chunk, length);
+    ringbuffer_pop(rb, chunk, length);
+  }
+  state.SetBytesProcessed(state.iterations() * length);
+  ringbuffer_free(rb);
+}
+BENCHMARK(BM_RingbufferInsertPop)->Arg(16)->Arg(258)->Arg(4096);
+
+void BM_SpscRingbufferInsertPop(benchmark::State& state) {
+  spsc_ringbuffer_t* rb = spsc_ringbuffer_init(kBufferSize);
+  uint8_t chunk[4096];
+  const size_t length = state.range(0);
+
+  memset(chunk, 0xAA, sizeof(chunk));
+  for (auto _ : state) {
+    spsc_ringbuffer_insert(rb, chunk, length);
+    spsc_ringbuffer_pop(rb, chunk, length);
+  }
+  state.SetBytesProcessed(state.iterations() * length);
+  spsc_ringbuffer_free(rb);
+}
+BENCHMARK(BM_SpscRingbufferInsertPop)->Arg(16)->Arg(258)->Arg(4096);
+
+void BM_SpscRingbufferReserveCommit(benchmark::State& state) {
+  spsc_ringbuffer_t* rb = spsc_ringbuffer_init(kBufferSize);
+  const size_t length = state.range(0);
+  size_t span_length;
+
+  for (auto _ : state) {
+    uint8_t* span = spsc_ringbuffer_reserve(rb, &span_length);
+    if (span_length > length) span_length = length;
+    memset(span, 0xAA, span_length);
+    spsc_ringbuffer_commit(rb, span_length);
+    benchmark::DoNotOptimize(spsc_ringbuffer_peek_span(rb, &span_length));
+    spsc_ringbuffer_delete(rb, span_length);
+  }
+  state.SetBytesProcessed(state.iterations() * length);
+  spsc_ringbuffer_free(rb);
+}
+BENCHMARK(BM_SpscRingbufferReserveCommit)->Arg(16)->Arg(258)->Arg(4096);
+
+/* One thread streams |kStreamBytes| through the buffer to another, the way
+ * callers used to share a ringbuffer under a mutex */
+const size_t kStreamBytes = 16 * 1024 * 1024;
+
+void BM_RingbufferMutexStream(benchmark::State& state) {
+  ringbuffer_t* rb = ringbuffer_init(kBufferSize);
+  std::mutex mutex;
+  const size_t length = state.range(0);
+
+  for (auto _ : state) {
+    std::thread producer([rb, &mutex, length] {
+      uint8_t chunk[4096] = {0};
+      for (size_t sent = 0; sent < kStreamBytes;) {
+        size_t added;
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          added = ringbuffer_insert(rb, chunk, length);
+        }
+        if (added == 0) std::this_thread::yield();
+        sent += added;
+      }
+    });
+    uint8_t chunk[4096];
+    for (size_t received = 0; received < kStreamBytes;) {
+      size_t popped;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        popped = ringbuffer_pop(rb, chunk, length);
+      }
+      if (popped == 0) std::this_thread::yield();
+      received += popped;
+    }
+    producer.join();
+  }
+  state.SetBytesProcessed(state.iterations() * kStreamBytes);
+  ringbuffer_free(rb);
+}
+BENCHMARK(BM_RingbufferMutexStream)->Arg(258)->Arg(4096)->UseRealTime();
+
+void BM_SpscRingbufferStream(benchmark::State& state) {
+  spsc_ringbuffer_t* rb = spsc_ringbuffer_init(kBufferSize);
+  const size_t length = state.range(0);
+
+  for (auto _ : state) {
+    std::thread producer([rb, length] {
+      uint8_t chunk[4096] = {0};
+      for (size_t sent = 0; sent < kStreamBytes;) {
+        size_t added = spsc_ringbuffer_insert(rb, chunk, length);
+        if (added == 0) std::this_thread::yield();
+        sent += added;
+      }
+    });
+    uint8_t chunk[4096];
+    for (size_t received = 0; received < kStreamBytes;) {
+      size_t popped = spsc_ringbuffer_pop(rb, chunk, length);
+      if (popped == 0) std::this_thread::yield();
+      received += popped;
+    }
+    producer.join();
+  }
+  state.SetBytesProcessed(state.iterations() * kStreamBytes);
+  spsc_ringbuffer_free(rb);
+}
+BENCHMARK(BM_SpscRingbufferStream)->Arg(258)->Arg(4096)->UseRealTime();
+
+}  // namespace
+
+BENCHMARK_MAIN();
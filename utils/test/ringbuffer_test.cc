@@ -1,5 +1,8 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <thread>
+
 #include <ringbuffer.h>
 
 TEST(RingbufferTest, test_new_simple) {
@@ -136,3 +139,166 @@ TEST(RingbufferTest, test_multi_insert_delete) {
 
   ringbuffer_free(rb);
 }
+
+TEST(RingbufferTest, test_insert_peek_wrap) {
+  ringbuffer_t* rb = ringbuffer_init(7);
+
+  uint8_t aa[] = {0x01, 0x02, 0x03, 0x04, 0x05};
+  uint8_t bb[] = {0x06, 0x07, 0x08, 0x09, 0x0A};
+  uint8_t peek[7] = {0};
+
+  ringbuffer_insert(rb, aa, sizeof(aa));
+  ringbuffer_delete(rb, 4);
+  EXPECT_EQ((size_t)5, ringbuffer_insert(rb, bb, sizeof(bb)));
+  EXPECT_EQ((size_t)6, ringbuffer_size(rb));
+
+  uint8_t content[] = {0x05, 0x06, 0x07, 0x08, 0x09, 0x0A};
+  EXPECT_EQ((size_t)6, ringbuffer_peek(rb, 0, peek, sizeof(peek)));
+  ASSERT_TRUE(0 == memcmp(content, peek, sizeof(content)));
+
+  EXPECT_EQ((size_t)3, ringbuffer_peek(rb, 3, peek, 3));
+  ASSERT_TRUE(0 == memcmp(content + 3, peek, 3));
+
+  ringbuffer_free(rb);
+}
+
+TEST(SpscRingbufferTest, test_new_simple) {
+  EXPECT_TRUE(spsc_ringbuffer_init(0) == NULL);
+  EXPECT_TRUE(spsc_ringbuffer_init(100) == NULL);
+
+  spsc_ringbuffer_t* rb = spsc_ringbuffer_init(4096);
+  ASSERT_TRUE(rb != NULL);
+  EXPECT_EQ((size_t)4096, spsc_ringbuffer_available(rb));
+  EXPECT_EQ((size_t)0, spsc_ringbuffer_size(rb));
+  spsc_ringbuffer_free(rb);
+}
+
+TEST(SpscRingbufferTest, test_multi_insert_delete) {
+  spsc_ringbuffer_t* rb = spsc_ringbuffer_init(16);
+
+  uint8_t aa[] = {0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA};
+  uint8_t bb[] = {0xBB, 0xBB, 0xBB, 0xBB, 0xBB, 0xBB, 0xBB, 0xBB, 0xBB};
+  uint8_t peek[16] = {0};
+
+  EXPECT_EQ((size_t)10, spsc_ringbuffer_insert(rb, aa, sizeof(aa)));
+  EXPECT_EQ((size_t)6, spsc_ringbuffer_insert(rb, bb, sizeof(bb)));
+  EXPECT_EQ((size_t)0, spsc_ringbuffer_available(rb));
+  EXPECT_EQ((size_t)0, spsc_ringbuffer_insert(rb, bb, sizeof(bb)));
+
+  EXPECT_EQ((size_t)10, spsc_ringbuffer_pop(rb, peek, 10));
+  ASSERT_TRUE(0 == memcmp(aa, peek, 10));
+
+  // Wrap around the end of the buffer
+
+  EXPECT_EQ((size_t)9, spsc_ringbuffer_insert(rb, bb, sizeof(bb)));
+  EXPECT_EQ((size_t)15, spsc_ringbuffer_size(rb));
+  EXPECT_EQ((size_t)15, spsc_ringbuffer_peek(rb, 0, peek, sizeof(peek)));
+  for (size_t i = 0; i < 15; i++) EXPECT_EQ(0xBB, peek[i]);
+
+  EXPECT_EQ((size_t)5, spsc_ringbuffer_peek(rb, 10, peek, sizeof(peek)));
+  EXPECT_EQ((size_t)0, spsc_ringbuffer_peek(rb, 15, peek, sizeof(peek)));
+
+  EXPECT_EQ((size_t)15, spsc_ringbuffer_delete(rb, 16));
+  EXPECT_EQ((size_t)16, spsc_ringbuffer_available(rb));
+
+  spsc_ringbuffer_free(rb);
+}
+
+TEST(SpscRingbufferTest, test_reserve_commit_spans) {
+  spsc_ringbuffer_t* rb = spsc_ringbuffer_init(16);
+  uint8_t aa[12] = {0};
+  size_t length;
+
+  spsc_ringbuffer_insert(rb, aa, sizeof(aa));
+  spsc_ringbuffer_delete(rb, 10);
+
+  // Free space runs from offset 12 to the end, then from the start to 10
+
+  uint8_t* span = spsc_ringbuffer_reserve(rb, &length);
+  EXPECT_EQ((size_t)4, length);
+  memset(span, 0xCC, length);
+  spsc_ringbuffer_commit(rb, length);
+
+  span = spsc_ringbuffer_reserve(rb, &length);
+  EXPECT_EQ((size_t)10, length);
+  memset(span, 0xDD, 3);
+  spsc_ringbuffer_commit(rb, 3);
+  EXPECT_EQ((size_t)9, spsc_ringbuffer_size(rb));
+
+  const uint8_t* data = spsc_ringbuffer_peek_span(rb, &length);
+  EXPECT_EQ((size_t)6, length);
+  EXPECT_EQ(0x00, data[1]);
+  EXPECT_EQ(0xCC, data[2]);
+  spsc_ringbuffer_delete(rb, length);
+
+  data = spsc_ringbuffer_peek_span(rb, &length);
+  EXPECT_EQ((size_t)3, length);
+  EXPECT_EQ(0xDD, data[0]);
+  spsc_ringbuffer_delete(rb, length);
+
+  data = spsc_ringbuffer_peek_span(rb, &length);
+  EXPECT_EQ((size_t)0, length);
+
+  spsc_ringbuffer_free(rb);
+}
+
+TEST(SpscRingbufferTest, test_concurrent_stress) {
+  const size_t kTotal = 8 * 1024 * 1024;
+  spsc_ringbuffer_t* rb = spsc_ringbuffer_init(4096);
+  ASSERT_TRUE(rb != NULL);
+
+  // The producer alternates between copies and in-place writes of a byte
+  // sequence in chunks of varying size
+
+  std::thread producer([rb] {
+    uint8_t chunk[701];
+    size_t sent = 0;
+    for (size_t round = 0; sent < kTotal; round++) {
+      size_t length = std::min(kTotal - sent, 1 + (round * 37) % sizeof(chunk));
+      if (round & 1) {
+        for (size_t i = 0; i < length; i++) chunk[i] = (uint8_t)(sent + i);
+        size_t added = 0;
+        while (added < length) {
+          added += spsc_ringbuffer_insert(rb, chunk + added, length - added);
+          if (added < length) std::this_thread::yield();
+        }
+      } else {
+        size_t room;
+        uint8_t* span = spsc_ringbuffer_reserve(rb, &room);
+        if (room == 0) {
+          std::this_thread::yield();
+          continue;
+        }
+        length = std::min(length, room);
+        for (size_t i = 0; i < length; i++) span[i] = (uint8_t)(sent + i);
+        spsc_ringbuffer_commit(rb, length);
+      }
+      sent += length;
+    }
+  });
+
+  size_t received = 0;
+  size_t errors = 0;
+  uint8_t chunk[523];
+  for (size_t round = 0; received < kTotal; round++) {
+    size_t length;
+    if (round & 1) {
+      const uint8_t* span = spsc_ringbuffer_peek_span(rb, &length);
+      for (size_t i = 0; i < length; i++)
+        if (span[i] != (uint8_t)(received + i)) errors++;
+      spsc_ringbuffer_delete(rb, length);
+    } else {
+      length = spsc_ringbuffer_pop(rb, chunk, 1 + (round * 13) % sizeof(chunk));
+      for (size_t i = 0; i < length; i++)
+        if (chunk[i] != (uint8_t)(received + i)) errors++;
+    }
+    if (length == 0) std::this_thread::yield();
+    received += length;
+  }
+  producer.join();
+
+  EXPECT_EQ((size_t)0, errors);
+  EXPECT_EQ(kTotal, received);
+  EXPECT_EQ((size_t)0, spsc_ringbuffer_size(rb));
+  spsc_ringbuffer_free(rb);
+}